@@ -0,0 +1,68 @@
+#include <stdio.h>
+#include <sys/errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apfs/io.h"
+#include "apfs/func/container.h"
+#include "apfs/func/checkpoint.h"
+
+#include "apfs/struct/object.h"
+#include "apfs/struct/nx.h"
+#include "apfs/struct/fs.h"
+
+/**
+ * Print usage info for this program.
+ */
+void print_usage(char* program_name) {
+    fprintf(stderr, "Usage:   %s <container>\nExample: %s /dev/disk0s2\n\n", program_name, program_name);
+    fprintf(stderr, "Lists every checkpoint in the container's checkpoint descriptor area, newest\n");
+    fprintf(stderr, "first, with whether it is intact and the volumes it contains. The other tools\n");
+    fprintf(stderr, "use the newest intact checkpoint.\n\n");
+}
+
+int main(int argc, char** argv) {
+    // Extrapolate CLI arguments, exit if invalid
+    if (argc != 2) {
+        fprintf(stderr, "Incorrect number of arguments.\n");
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    container_t* container = open_container(argv[1], (xid_t)(~0));
+    if (!container) {
+        return -1;
+    }
+    checkpoint_timeline_t* timeline = get_checkpoint_timeline(container);
+    if (!timeline) {
+        close_container(container);
+        return -1;
+    }
+
+    printf("%5s  %14s  %-36s  %s\n", "Index", "XID", "Status", "Volumes");
+
+    // Mount each checkpoint in turn, to find out whether it's intact. Views
+    // share the node cache, so this mostly reads what differs between them.
+    uint32_t num_intact = 0;
+    for (uint32_t i = 0; i < timeline->num_checkpoints; i++) {
+        checkpoint_t* checkpoint = timeline->checkpoints + i;
+        fprintf(stderr, "\nChecking the checkpoint with XID 0x%llx:\n", checkpoint->xid);
+        container_t* view = open_checkpoint_view(container, i);
+
+        printf("%5u  %#14llx  %-36s", checkpoint->nxsb_index, checkpoint->xid, checkpoint_status_string(checkpoint->status));
+        if (view) {
+            num_intact++;
+            for (uint32_t j = 0; j < view->num_volumes; j++) {
+                printf("%s%s", j > 0 ? ", " : "  ", get_volume_superblock(view, j)->apfs_volname);
+            }
+        } else if (checkpoint->bad_addr) {
+            printf("  at block %#llx", checkpoint->bad_addr);
+        }
+        printf("\n");
+        free_container(view);
+    }
+
+    fprintf(stderr, "\n%u of the %u checkpoints are intact.\n", num_intact, timeline->num_checkpoints);
+    close_container(container);
+    return 0;
+}
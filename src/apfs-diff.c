@@ -0,0 +1,262 @@
+#include <stdio.h>
+#include <sys/errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apfs/io.h"
+#include "apfs/func/btree.h"
+#include "apfs/func/j.h"
+#include "apfs/func/container.h"
+#include "apfs/func/checkpoint.h"
+#include "apfs/func/snapshot.h"
+#include "apfs/func/diff.h"
+
+#include "apfs/struct/object.h"
+#include "apfs/struct/fs.h"
+#include "apfs/struct/j.h"
+
+#include "apfs/string/j.h"
+
+/**
+ * Print usage info for this program.
+ */
+void print_usage(char* program_name) {
+    fprintf(stderr, "Usage:   %s [--records] <container> <volume ID> <old version> <new version>\nExample: %s /dev/disk0s2  0  weekly  current\n\n", program_name, program_name);
+    fprintf(stderr, "Lists the files that were added (A), deleted (D), or modified (M) between two versions\n");
+    fprintf(stderr, "of a volume. With `--records`, each file-system record that changed is listed too.\n\n");
+    fprintf(stderr, "Each version is one of:\n");
+    fprintf(stderr, "- `current`, for the volume as it is now;\n");
+    fprintf(stderr, "- the name of one of the volume's snapshots;\n");
+    fprintf(stderr, "- `xid:<XID>`, for the volume as of a given transaction; or\n");
+    fprintf(stderr, "- `checkpoint:<XID>`, for the volume in the checkpoint with a given XID, as listed by\n");
+    fprintf(stderr, "  `apfs-checkpoints`.\n\n");
+}
+
+/**
+ * State used while printing the differences between two versions of a volume.
+ *
+ * oid:         The ID of the file-system object whose changes are being
+ *      printed, if `have_oid`.
+ */
+typedef struct {
+    diff_tree_t*    old_tree;
+    diff_tree_t*    new_tree;
+    bool            print_records;
+
+    bool            have_oid;
+    oid_t           oid;
+    uint64_t        num_objects;
+    uint64_t        num_records;
+} diff_output_t;
+
+/**
+ * Parse an XID given in hexadecimal with a leading `0x`, or in decimal.
+ */
+bool parse_xid(char* string, xid_t* xid) {
+    return sscanf(string, "0x%llx", xid) == 1 || sscanf(string, "%llu", xid) == 1;
+}
+
+/**
+ * Open a version of a volume for comparison, as named on the command line.
+ *
+ * view:        If the version is that in an older checkpoint, the view of that
+ *      checkpoint will be stored here. It must be freed with `free_container()`
+ *      once the tree is no longer needed.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value on failure.
+ */
+int open_diff_tree(container_t* container, uint32_t volume_id, char* version, diff_tree_t* tree, container_t** view) {
+    *view = NULL;
+    tree->xid = (xid_t)(~0);
+
+    if (strcmp(version, "current") == 0) {
+        return open_volume(container, volume_id, &tree->omap_btree, &tree->fs_root_btree);
+    }
+
+    if (strncmp(version, "xid:", 4) == 0) {
+        if (!parse_xid(version + 4, &tree->xid)) {
+            fprintf(stderr, "%s is not a valid XID.\n", version + 4);
+            return -1;
+        }
+        return open_volume_at_xid(container, volume_id, tree->xid, &tree->omap_btree, &tree->fs_root_btree);
+    }
+
+    if (strncmp(version, "checkpoint:", 11) == 0) {
+        xid_t xid;
+        if (!parse_xid(version + 11, &xid)) {
+            fprintf(stderr, "%s is not a valid XID.\n", version + 11);
+            return -1;
+        }
+        checkpoint_timeline_t* timeline = get_checkpoint_timeline(container);
+        if (!timeline) {
+            return -1;
+        }
+        for (uint32_t i = 0; i < timeline->num_checkpoints; i++) {
+            if (timeline->checkpoints[i].xid != xid) {
+                continue;
+            }
+            *view = open_checkpoint_view(container, i);
+            if (!*view) {
+                fprintf(stderr, "The checkpoint with XID 0x%llx is damaged.\n", xid);
+                return -1;
+            }
+            if (volume_id >= (*view)->num_volumes) {
+                fprintf(stderr, "Volume %u doesn't exist in the checkpoint with XID 0x%llx.\n", volume_id, xid);
+                return -1;
+            }
+            return open_volume(*view, volume_id, &tree->omap_btree, &tree->fs_root_btree);
+        }
+        fprintf(stderr, "There is no checkpoint with XID 0x%llx; see `apfs-checkpoints`.\n", xid);
+        return -1;
+    }
+
+    snapshot_t* snapshots = NULL;
+    uint32_t num_snapshots = 0;
+    if (get_volume_snapshots(container, volume_id, &snapshots, &num_snapshots) != 0) {
+        return -1;
+    }
+    snapshot_t* snapshot = find_snapshot(snapshots, num_snapshots, version);
+    if (snapshot) {
+        tree->xid = snapshot->xid;
+    }
+    free_snapshots(snapshots, num_snapshots);
+    if (!snapshot) {
+        fprintf(stderr, "There is no snapshot named `%s` in volume %u.\n", version, volume_id);
+        return -1;
+    }
+    return open_volume_at_xid(container, volume_id, tree->xid, &tree->omap_btree, &tree->fs_root_btree);
+}
+
+/**
+ * Print a record that changed, within the listing of its object.
+ */
+void print_diff_record(char sign, diff_record_t* rec) {
+    uint8_t type = (rec->key->obj_id_and_type & OBJ_TYPE_MASK) >> OBJ_TYPE_SHIFT;
+    printf("    %c %s", sign, j_key_type_to_string(type));
+
+    if (type == APFS_TYPE_DIR_REC && rec->key_len > sizeof(j_drec_hashed_key_t)) {
+        j_drec_hashed_key_t* key = (j_drec_hashed_key_t*)rec->key;
+        printf(" `%.*s`", (int)(rec->key_len - sizeof(j_drec_hashed_key_t)), (char*)key->name);
+    } else if (type == APFS_TYPE_XATTR && rec->key_len > sizeof(j_xattr_key_t)) {
+        j_xattr_key_t* key = (j_xattr_key_t*)rec->key;
+        printf(" `%.*s`", (int)(rec->key_len - sizeof(j_xattr_key_t)), (char*)key->name);
+    } else if (type == APFS_TYPE_FILE_EXTENT && rec->key_len >= sizeof(j_file_extent_key_t)) {
+        printf(" at logical address 0x%llx", ((j_file_extent_key_t*)rec->key)->logical_addr);
+    }
+    printf("\n");
+}
+
+int print_change(void* context, diff_change_t change, diff_record_t* old_rec, diff_record_t* new_rec) {
+    diff_output_t* output = context;
+    diff_record_t* rec = new_rec ? new_rec : old_rec;
+    oid_t oid = rec->key->obj_id_and_type & OBJ_ID_MASK;
+    uint8_t type = (rec->key->obj_id_and_type & OBJ_TYPE_MASK) >> OBJ_TYPE_SHIFT;
+    output->num_records++;
+
+    // Changes arrive grouped by object, and an object's inode record sorts
+    // before its other records, so the first change to an object says whether
+    // the whole object was added or deleted.
+    if (!output->have_oid || oid != output->oid) {
+        output->have_oid = true;
+        output->oid = oid;
+        output->num_objects++;
+
+        char status = 'M';
+        if (type == APFS_TYPE_INODE && change != DIFF_MODIFIED) {
+            status = change == DIFF_ADDED ? 'A' : 'D';
+        }
+        diff_tree_t* tree = change == DIFF_REMOVED ? output->old_tree : output->new_tree;
+        char* path = get_fs_object_path(tree->omap_btree, tree->fs_root_btree, oid, tree->xid);
+        if (path) {
+            printf("%c  %s\n", status, path);
+            free(path);
+        } else {
+            printf("%c  (object 0x%llx)\n", status, oid);
+        }
+    }
+
+    if (output->print_records) {
+        if (change == DIFF_MODIFIED) {
+            print_diff_record('~', new_rec);
+        } else {
+            print_diff_record(change == DIFF_ADDED ? '+' : '-', rec);
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    setbuf(stdout, NULL);
+
+    // Extrapolate CLI arguments, exit if invalid
+    bool print_records = false;
+    if (argc >= 2 && strcmp(argv[1], "--records") == 0) {
+        print_records = true;
+        argv[1] = argv[0];
+        argv++;
+        argc--;
+    }
+    if (argc != 5) {
+        fprintf(stderr, "Incorrect number of arguments.\n");
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    uint32_t volume_id;
+    if (sscanf(argv[2], "%u", &volume_id) != 1) {
+        fprintf(stderr, "%s is not a valid volume ID.\n", argv[2]);
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    container_t* container = open_container(argv[1], (xid_t)(~0));
+    if (!container) {
+        return -1;
+    }
+    if (volume_id >= container->num_volumes) {
+        fprintf(stderr, "The specified volume ID (%u) does not exist. Exiting.\n", volume_id);
+        close_container(container);
+        return 1;
+    }
+
+    int result = -1;
+    diff_tree_t old_tree = {0};
+    diff_tree_t new_tree = {0};
+    container_t* old_view = NULL;
+    container_t* new_view = NULL;
+    if (
+            open_diff_tree(container, volume_id, argv[3], &old_tree, &old_view) != 0
+            || open_diff_tree(container, volume_id, argv[4], &new_tree, &new_view) != 0
+    ) {
+        goto cleanup;
+    }
+
+    // Each tree is read as of its own XID, passed explicitly, rather than as
+    // of the view XID that `open_volume_at_xid()` set for this thread.
+    fs_view_xid = (xid_t)(~0);
+
+    fprintf(stderr, "\nComparing `%s` with `%s`:\n", argv[3], argv[4]);
+    diff_output_t output = {
+        .old_tree = &old_tree,
+        .new_tree = &new_tree,
+        .print_records = print_records,
+    };
+    diff_stats_t stats;
+    if (diff_fs_trees(&old_tree, &new_tree, print_change, &output, &stats) != 0) {
+        goto cleanup;
+    }
+    fprintf(stderr, "\n%llu records of %llu objects differ.\n", output.num_records, output.num_objects);
+    fprintf(stderr, "Read %llu nodes, skipping %llu shared subtrees, and visited %llu records.\n", stats.nodes_read, stats.subtrees_skipped, stats.records_compared);
+    result = 0;
+
+cleanup:
+    free(old_tree.omap_btree);
+    free(old_tree.fs_root_btree);
+    free(new_tree.omap_btree);
+    free(new_tree.fs_root_btree);
+    free_container(old_view);
+    free_container(new_view);
+    close_container(container);
+    return result;
+}
@@ -0,0 +1,222 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apfs/io.h"
+#include "apfs/func/boolean.h"
+#include "apfs/func/btree.h"
+#include "apfs/func/container.h"
+#include "apfs/func/snapshot.h"
+#include "apfs/func/crypto.h"
+#include "apfs/func/keybag.h"
+#include "apfs/func/j.h"
+#include "apfs/func/du.h"
+
+#include "apfs/struct/object.h"
+#include "apfs/struct/nx.h"
+#include "apfs/struct/fs.h"
+#include "apfs/struct/j.h"
+
+/**
+ * Print usage info for this program.
+ */
+void print_usage(char* program_name) {
+    fprintf(stderr, "Usage:   %s [--depth <n>] [--threads <n>] [--snapshot <name>|--xid <xid>] [--key <volume key>|--password] [--tier2 <HDD>] <container> <volume ID> [<path in volume>]\nExample: %s --depth 1  /dev/disk0s2  0  /Users/john\n\n", program_name, program_name);
+    fprintf(stderr, "For the given directory (by default, the volume's root directory) and each directory\n");
+    fprintf(stderr, "beneath it, prints the logical size and the allocated size of the files in its subtree,\n");
+    fprintf(stderr, "in bytes, and their number, followed by its path; subdirectories come before their parents.\n");
+    fprintf(stderr, "The file-system tree is read once, split across several threads, whatever the path.\n\n");
+    fprintf(stderr, "With `--depth`, only directories at most <n> levels beneath the given one are printed.\n\n");
+    fprintf(stderr, "With `--threads`, the file-system tree's leaf nodes are read with <n> threads, rather\n");
+    fprintf(stderr, "than %u.\n\n", DU_DEFAULT_NUM_THREADS);
+    fprintf(stderr, "With `--snapshot` or `--xid`, the volume is read as of the named snapshot, or as of the\n");
+    fprintf(stderr, "given XID, rather than as it is now. The volume's snapshots are listed either way.\n\n");
+    fprintf(stderr, "With `--key`, an encrypted volume is decrypted with the given volume encryption key, in\n");
+    fprintf(stderr, "hexadecimal. With `--password`, the volume's key is unwrapped with a password (or the\n");
+    fprintf(stderr, "recovery key), read from the terminal or `stdin`, and cached for later invocations.\n\n");
+    fprintf(stderr, "With `--tier2`, the container is read as a Fusion container, whose main device is\n");
+    fprintf(stderr, "<container>, and whose second tier is the given device.\n\n");
+}
+
+/**
+ * Print the sizes of a directory's subdirectories, recursively, and then its
+ * own.
+ *
+ * path:        The path of the directory.
+ *
+ * depth:       How many levels beneath the directory given on the command line
+ *      this directory is.
+ */
+void print_du_dir(du_table_t* table, du_dir_t* dir, const char* path, uint32_t depth, uint32_t max_depth) {
+    // Parent IDs that form a cycle could otherwise lead to endless recursion.
+    if (depth < max_depth && depth < J_MAX_PATH_DEPTH) {
+        size_t num_children = 0;
+        du_dir_t** children = get_du_children(table, dir->oid, &num_children);
+        size_t path_len = strlen(path);
+        bool has_slash = path_len > 0 && path[path_len - 1] == '/';
+        for (size_t i = 0; i < num_children; i++) {
+            char unnamed[32];
+            const char* name = children[i]->name;
+            if (!name) {
+                snprintf(unnamed, sizeof(unnamed), "#%llx", children[i]->oid);
+                name = unnamed;
+            }
+
+            char* child_path = malloc(path_len + strlen(name) + 2);
+            if (!child_path) {
+                fprintf(stderr, "\nABORT: print_du_dir: Could not allocate sufficient memory for `child_path`.\n");
+                exit(-1);
+            }
+            sprintf(child_path, "%s%s%s", path, has_slash ? "" : "/", name);
+            print_du_dir(table, children[i], child_path, depth + 1, max_depth);
+            free(child_path);
+        }
+    }
+
+    printf("%llu\t%llu\t%llu\t%s\n", dir->logical_size, dir->alloced_size, dir->num_files, path);
+}
+
+int main(int argc, char** argv) {
+    setbuf(stdout, NULL);
+
+    // Extrapolate CLI arguments, exit if invalid
+    uint32_t max_depth = UINT32_MAX;
+    unsigned int num_threads = DU_DEFAULT_NUM_THREADS;
+    char* snapshot_name = NULL;
+    xid_t view_xid = 0;
+    bool xid_given = false;
+    char* hex_key = NULL;
+    bool use_password = false;
+    char* tier2_path = NULL;
+    while (argc >= 3 && strncmp(argv[1], "--", 2) == 0) {
+        if (strcmp(argv[1], "--password") == 0) {
+            use_password = true;
+            argv[1] = argv[0];
+            argv++;
+            argc--;
+            continue;
+        }
+        if (strcmp(argv[1], "--depth") == 0) {
+            if (sscanf(argv[2], "%u", &max_depth) != 1) {
+                fprintf(stderr, "%s is not a valid depth.\n", argv[2]);
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[1], "--threads") == 0) {
+            if (sscanf(argv[2], "%u", &num_threads) != 1 || num_threads == 0) {
+                fprintf(stderr, "%s is not a valid number of threads.\n", argv[2]);
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[1], "--snapshot") == 0) {
+            snapshot_name = argv[2];
+        } else if (strcmp(argv[1], "--key") == 0) {
+            hex_key = argv[2];
+        } else if (strcmp(argv[1], "--tier2") == 0) {
+            tier2_path = argv[2];
+        } else if (strcmp(argv[1], "--xid") == 0) {
+            if (sscanf(argv[2], "0x%llx", &view_xid) != 1 && sscanf(argv[2], "%llu", &view_xid) != 1) {
+                fprintf(stderr, "%s is not a valid XID.\n", argv[2]);
+                print_usage(argv[0]);
+                return 1;
+            }
+            xid_given = true;
+        } else {
+            break;
+        }
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+    }
+    if (hex_key && use_password) {
+        fprintf(stderr, "`--key` can't be combined with `--password`.\n");
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (argc != 3 && argc != 4) {
+        fprintf(stderr, "Incorrect number of arguments.\n");
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    nx_device->path = argv[1];
+
+    uint32_t volume_id;
+    if (sscanf(argv[2], "%u", &volume_id) != 1) {
+        fprintf(stderr, "%s is not a valid volume ID.\n", argv[2]);
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    char* path = argc == 4 ? argv[3] : "/";
+
+    container_t* container = open_fusion_container(nx_device->path, tier2_path, (xid_t)(~0));
+    if (!container) {
+        return -1;
+    }
+
+    fprintf(stderr, "\n Volume list\n================\n");
+    for (uint32_t i = 0; i < container->num_volumes; i++) {
+        fprintf(stderr, "%2u: %s\n", i, get_volume_superblock(container, i)->apfs_volname);
+    }
+
+    if (volume_id >= container->num_volumes) {
+        fprintf(stderr, "The specified volume ID (%u) does not exist in the list above. Exiting.\n", volume_id);
+        return 0;
+    }
+
+    if (hex_key && use_volume_key(get_volume_superblock(container, volume_id), hex_key) != 0) {
+        return -1;
+    }
+    if (use_password && unlock_volume(container, volume_id) != 0) {
+        return -1;
+    }
+
+    if ((snapshot_name || xid_given) && select_volume_snapshot(container, volume_id, snapshot_name, &view_xid) != 0) {
+        return -1;
+    }
+
+    btree_node_phys_t* fs_omap_btree;
+    btree_node_phys_t* fs_root_btree;
+    int open_result = (snapshot_name || xid_given)
+        ? open_volume_at_xid(container, volume_id, view_xid, &fs_omap_btree, &fs_root_btree)
+        : open_volume(container, volume_id, &fs_omap_btree, &fs_root_btree);
+    if (open_result != 0) {
+        return -1;
+    }
+
+    oid_t dir_oid = 0;
+    j_rec_t** fs_records = get_fs_records_for_path(fs_omap_btree, fs_root_btree, path, &dir_oid);
+    if (!fs_records) {
+        fprintf(stderr, "Could not find a dentry for that path. Exiting.\n");
+        return 0;
+    }
+    free_j_rec_array(fs_records);
+
+    fprintf(stderr, "Totalling directory sizes with %u threads ... ", num_threads);
+    du_table_t* table = get_fs_dir_sizes(fs_omap_btree, fs_root_btree, num_threads);
+    if (!table) {
+        return -1;
+    }
+    fprintf(stderr, "OK.\nRead %llu leaf nodes; found %zu directories, %llu of them with directory statistics.\n", table->leaves_read, table->num_dirs, table->dirs_from_stats);
+    if (table->orphans) {
+        fprintf(stderr, "- %llu objects have no parent directory, and aren't counted in any directory's totals.\n", table->orphans);
+    }
+
+    du_dir_t* dir = find_du_dir(table, dir_oid);
+    if (!dir) {
+        fprintf(stderr, "`%s` is not a directory. Exiting.\n", path);
+        du_table_free(table);
+        return 0;
+    }
+    fprintf(stderr, "\n");
+    print_du_dir(table, dir, path, 0, max_depth);
+
+    // Closing statements; de-allocate all memory, close all file descriptors.
+    du_table_free(table);
+    free(fs_root_btree);
+    free(fs_omap_btree);
+    close_container(container);
+    fprintf(stderr, "END: All done.\n");
+    return 0;
+}
@@ -40,7 +40,7 @@ int main(int argc, char** argv) {
         return 1;
     }
 
-    char* nx_path = argv[1];
+    nx_device->path = argv[1];
     
     // Capture <fs tree root node address>
     paddr_t fs_root_addr;
@@ -67,9 +67,9 @@ int main(int argc, char** argv) {
     }
     
     // Open (device special) file corresponding to an APFS container, read-only
-    printf("Opening file at `%s` in read-only mode ... ", nx_path);
-    nx = fopen(nx_path, "rb");
-    if (!nx) {
+    printf("Opening file at `%s` in read-only mode ... ", nx_device->path);
+    nx_device->file = fopen(nx_device->path, "rb");
+    if (!nx_device->file) {
         fprintf(stderr, "\nABORT: main: ");
         report_fopen_error();
         printf("\n");
@@ -79,14 +79,14 @@ int main(int argc, char** argv) {
 
     // Read the specified root nodes
     printf("Reading the file-system tree root node (block 0x%llx) ... ", fs_root_addr);
-    btree_node_phys_t* fs_root_node = malloc(nx_block_size);
+    btree_node_phys_t* fs_root_node = malloc(nx_device->block_size);
     if (!fs_root_node) {
         fprintf(stderr, "\nABORT: Could not allocate sufficient memory for `fs_root_node`.\n");
         return -1;
     }
 
     if (read_blocks(fs_root_node, fs_root_addr, 1) == 0) {
-        printf("\nEND: Block index %s does not exist in `%s`.\n", argv[2], nx_path);
+        printf("\nEND: Block index %s does not exist in `%s`.\n", argv[2], nx_device->path);
         return 0;
     }
 
@@ -99,14 +99,14 @@ int main(int argc, char** argv) {
     printf("\n");
 
     printf("Reading the object map root node (block 0x%llx) ... ", omap_root_addr);
-    btree_node_phys_t* omap_root_node = malloc(nx_block_size);
+    btree_node_phys_t* omap_root_node = malloc(nx_device->block_size);
     if (!omap_root_node) {
         fprintf(stderr, "\nABORT: Could not allocate sufficient memory for `omap_root_node`.\n");
         return -1;
     }
 
     if (read_blocks(omap_root_node, omap_root_addr, 1) == 0) {
-        printf("\nEND: Block index %s does not exist in `%s`.\n", argv[2], nx_path);
+        printf("\nEND: Block index %s does not exist in `%s`.\n", argv[2], nx_device->path);
         return 0;
     }
 
@@ -120,17 +120,17 @@ int main(int argc, char** argv) {
 
     // Allocate space for the current working node in the file-system tree,
     // then copy the root node to this space.
-    btree_node_phys_t* node = malloc(nx_block_size);
+    btree_node_phys_t* node = malloc(nx_device->block_size);
     if (!node) {
         fprintf(stderr, "\nABORT: Could not allocate sufficient memory for `node`.\n");
         return -1;
     }
-    memcpy(node, fs_root_node, nx_block_size);
+    memcpy(node, fs_root_node, nx_device->block_size);
 
     // Pointers to areas of the node
     char* toc_start = (char*)node->btn_data + node->btn_table_space.off;
     char* key_start = toc_start + node->btn_table_space.len;
-    char* val_end   = (char*)node + nx_block_size;
+    char* val_end   = (char*)node + nx_device->block_size;
     if (node->btn_flags & BTNODE_ROOT) {
         val_end -= sizeof(btree_info_t);
     }
@@ -183,7 +183,7 @@ int main(int argc, char** argv) {
                 if (!child_node_omap_val) {
                     printf("  ||  UNRESOLVABLE");
                 } else {
-                    btree_node_phys_t* child_node = malloc(nx_block_size);
+                    btree_node_phys_t* child_node = malloc(nx_device->block_size);
                     if (!child_node) {
                         fprintf(stderr, "\nABORT: Could not allocate sufficient memory for `child_node`.\n");
                         return -1;
@@ -339,7 +339,7 @@ int main(int argc, char** argv) {
 
         toc_start = (char*)(node->btn_data) + node->btn_table_space.off;
         key_start = toc_start + node->btn_table_space.len;
-        val_end   = (char*)node + nx_block_size;    // Always dealing with non-root node here
+        val_end   = (char*)node + nx_device->block_size;    // Always dealing with non-root node here
 
         free(child_node_omap_val);
     }
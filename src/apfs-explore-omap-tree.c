@@ -33,7 +33,7 @@ int main(int argc, char** argv) {
         return 1;
     }
     
-    char* nx_path = argv[1];
+    nx_device->path = argv[1];
     
     paddr_t root_node_block_addr;
     bool parse_success = sscanf(argv[2], "0x%llx", &root_node_block_addr);
@@ -47,9 +47,9 @@ int main(int argc, char** argv) {
     }
     
     // Open (device special) file corresponding to an APFS container, read-only
-    printf("Opening file at `%s` in read-only mode ... ", nx_path);
-    nx = fopen(nx_path, "rb");
-    if (!nx) {
+    printf("Opening file at `%s` in read-only mode ... ", nx_device->path);
+    nx_device->file = fopen(nx_device->path, "rb");
+    if (!nx_device->file) {
         fprintf(stderr, "\nABORT: main: ");
         report_fopen_error();
         printf("\n");
@@ -59,14 +59,14 @@ int main(int argc, char** argv) {
 
     // Read the specified root node
     printf("Reading block 0x%llx ... ", root_node_block_addr);
-    btree_node_phys_t* root_node = malloc(nx_block_size);
+    btree_node_phys_t* root_node = malloc(nx_device->block_size);
     if (!root_node) {
         fprintf(stderr, "\nABORT: Could not allocate sufficient memory for `root_node`.\n");
         return -1;
     }
 
     if (read_blocks(root_node, root_node_block_addr, 1) == 0) {
-        printf("\nEND: Block index %s does not exist in `%s`.\n", argv[2], nx_path);
+        printf("\nEND: Block index %s does not exist in `%s`.\n", argv[2], nx_device->path);
         return 0;
     }
 
@@ -80,17 +80,17 @@ int main(int argc, char** argv) {
 
     // Allocate space for the current working node,
     // then copy the root node to this space.
-    btree_node_phys_t* node = malloc(nx_block_size);
+    btree_node_phys_t* node = malloc(nx_device->block_size);
     if (!node) {
         fprintf(stderr, "\nABORT: Could not allocate sufficient memory for `node`.\n");
         return -1;
     }
-    memcpy(node, root_node, nx_block_size);
+    memcpy(node, root_node, nx_device->block_size);
 
     // Pointers to areas of the node
     char* toc_start = (char*)node->btn_data + node->btn_table_space.off;
     char* key_start = toc_start + node->btn_table_space.len;
-    char* val_end   = (char*)node + nx_block_size;
+    char* val_end   = (char*)node + nx_device->block_size;
     if (node->btn_flags & BTNODE_ROOT) {
         val_end -= sizeof(btree_info_t);
     }
@@ -157,7 +157,7 @@ int main(int argc, char** argv) {
 
         toc_start = (char*)(node->btn_data) + node->btn_table_space.off;
         key_start = toc_start + node->btn_table_space.len;
-        val_end   = (char*)node + nx_block_size;    // Always dealing with non-root node here
+        val_end   = (char*)node + nx_device->block_size;    // Always dealing with non-root node here
     }
     
     return 0;
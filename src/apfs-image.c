@@ -0,0 +1,283 @@
+#include <stdio.h>
+#include <sys/errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "apfs/io.h"
+#include "apfs/func/container.h"
+#include "apfs/func/spaceman.h"
+#include "apfs/func/metadata.h"
+
+#include "apfs/struct/object.h"
+#include "apfs/struct/nx.h"
+
+/** Limits **/
+
+#define IMAGE_READ_BLOCKS   256     // = 1 MiB of 4 KiB blocks
+
+/**
+ * Print usage info for this program.
+ */
+void print_usage(char* program_name) {
+    fprintf(stderr, "Usage:   %s [--metadata-first] <container> <output path>\nExample: %s /dev/disk0s2 disk0s2.img\n\n", program_name, program_name);
+    fprintf(stderr, "Copies the blocks of the container that its space manager reports as allocated to\n");
+    fprintf(stderr, "<output path>, at the same offsets, leaving free blocks as holes in a sparse file\n");
+    fprintf(stderr, "of the container's size. The output can be read by the other tools like the container.\n\n");
+    fprintf(stderr, "With --metadata-first, the blocks that the container's checkpoint, object maps, and\n");
+    fprintf(stderr, "file-system trees occupy are copied and synced before anything else, so that the\n");
+    fprintf(stderr, "output can already be listed and explored while the files' data is being copied.\n\n");
+}
+
+double get_seconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/**
+ * Statistics about the blocks copied so far.
+ */
+typedef struct {
+    uint64_t    blocks_copied;
+    uint64_t    reads;
+} image_stats_t;
+
+/**
+ * Write blocks that were read from the container to the same offset in the
+ * output.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value if writing to the output fails.
+ */
+int write_image_blocks(int output_fd, char* buffer, paddr_t addr, size_t num_blocks, image_stats_t* stats) {
+    ssize_t length = num_blocks * nx_device->block_size;
+    if (pwrite(output_fd, buffer, length, addr * nx_device->block_size) != length) {
+        fprintf(stderr, "\nABORT: write_image_blocks: Failed to write blocks 0x%llx to 0x%llx to the output: %s.\n", addr, addr + num_blocks - 1, strerror(errno));
+        return -1;
+    }
+    stats->blocks_copied += num_blocks;
+    return 0;
+}
+
+/**
+ * Copy a range of blocks from the container to the same offset in the output.
+ * The range is read in pieces of at most `IMAGE_READ_BLOCKS` blocks, each
+ * aligned to a multiple of `IMAGE_READ_BLOCKS` blocks where possible, so that
+ * the reads line up with the device's own large transfers. If a piece can't be
+ * read in full, the rest of it is read one block at a time, so that a bad
+ * sector only costs the blocks it lies in.
+ *
+ * buffer:      A buffer of at least `IMAGE_READ_BLOCKS` blocks.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value if writing to the output fails.
+ *      Blocks that can't be read are reported, and left as holes.
+ */
+int copy_blocks(int output_fd, char* buffer, paddr_t start, uint64_t num_blocks, image_stats_t* stats) {
+    paddr_t end = start + num_blocks;
+    for (paddr_t addr = start; addr < end; ) {
+        paddr_t piece_end = (addr / IMAGE_READ_BLOCKS + 1) * IMAGE_READ_BLOCKS;
+        if (piece_end > end) {
+            piece_end = end;
+        }
+        size_t count = piece_end - addr;
+
+        size_t num_read = read_blocks(buffer, addr, count);
+        stats->reads++;
+        if (num_read == (size_t)-1) {
+            num_read = 0;
+        }
+        if (num_read > 0 && write_image_blocks(output_fd, buffer, addr, num_read, stats) != 0) {
+            return -1;
+        }
+
+        // Retry the rest of the piece block by block, reporting each run of
+        // blocks that still can't be read.
+        paddr_t failed_start = 0;
+        size_t num_failed = 0;
+        for (paddr_t block = addr + num_read; block < piece_end; block++) {
+            size_t result = read_blocks(buffer, block, 1);
+            stats->reads++;
+            if (result == 1) {
+                if (write_image_blocks(output_fd, buffer, block, 1, stats) != 0) {
+                    return -1;
+                }
+            } else if (num_failed++ == 0) {
+                failed_start = block;
+            }
+            if (num_failed > 0 && (result == 1 || block + 1 == piece_end)) {
+                paddr_t failed_end = failed_start + num_failed - 1;
+                fprintf(stderr, "- Failed to read blocks 0x%llx to 0x%llx; leaving them empty.\n", failed_start, failed_end);
+                num_failed = 0;
+            }
+        }
+        addr = piece_end;
+    }
+    return 0;
+}
+
+/**
+ * Copy the metadata blocks of the container, as listed by
+ * `list_metadata_blocks()`, coalescing consecutive blocks into single copies.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value on failure.
+ */
+int copy_metadata_blocks(int output_fd, char* buffer, block_list_t* list, image_stats_t* stats) {
+    int result = 0;
+    for (uint64_t i = 0; i < list->num_addrs && result == 0; ) {
+        uint64_t j = i + 1;
+        while (j < list->num_addrs && list->addrs[j] == list->addrs[j - 1] + 1) {
+            j++;
+        }
+        result = copy_blocks(output_fd, buffer, list->addrs[i], j - i, stats);
+        i = j;
+    }
+    return result;
+}
+
+/**
+ * Copy a range of blocks from the container to the same offset in the output,
+ * as `copy_blocks()` does, except for the blocks in a list of those that have
+ * already been copied.
+ *
+ * copied:      The blocks already copied, sorted and without duplicates.
+ *
+ * cursor:      The index in `copied` to start looking from; it's advanced
+ *      past the range, so that copying ranges in ascending order walks the
+ *      list only once.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value if writing to the output fails.
+ */
+int copy_blocks_except(int output_fd, char* buffer, paddr_t start, uint64_t num_blocks, block_list_t* copied, uint64_t* cursor, image_stats_t* stats) {
+    paddr_t end = start + num_blocks;
+    while (*cursor < copied->num_addrs && copied->addrs[*cursor] < start) {
+        (*cursor)++;
+    }
+
+    paddr_t addr = start;
+    while (addr < end) {
+        // Copy up to the next block that was already copied, then skip it
+        paddr_t gap_end = end;
+        if (*cursor < copied->num_addrs && copied->addrs[*cursor] < end) {
+            gap_end = copied->addrs[(*cursor)++];
+        }
+        if (gap_end > addr && copy_blocks(output_fd, buffer, addr, gap_end - addr, stats) != 0) {
+            return -1;
+        }
+        addr = gap_end + 1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    setbuf(stdout, NULL);
+
+    // Extrapolate CLI arguments, exit if invalid
+    bool metadata_first = false;
+    while (argc >= 2 && strncmp(argv[1], "--", 2) == 0) {
+        if (strcmp(argv[1], "--metadata-first") == 0) {
+            metadata_first = true;
+        } else {
+            fprintf(stderr, "Unknown option %s.\n", argv[1]);
+            print_usage(argv[0]);
+            return 1;
+        }
+        argv[1] = argv[0];
+        argv++;
+        argc--;
+    }
+    if (argc != 3) {
+        fprintf(stderr, "Incorrect number of arguments.\n");
+        print_usage(argv[0]);
+        return 1;
+    }
+    char* output_path = argv[2];
+
+    container_t* container = open_container(argv[1], (xid_t)(~0));
+    if (!container) {
+        return -1;
+    }
+
+    int output_fd = -1;
+    char* buffer = NULL;
+    block_list_t* metadata = NULL;
+    int result = -1;
+
+    allocation_map_t* allocation_map = load_allocation_map(container->nxsb);
+    if (!allocation_map) {
+        fprintf(stderr, "Can't image the container without its space manager.\n");
+        goto cleanup;
+    }
+    size_t block_size = nx_device->block_size;
+    uint64_t num_allocated = allocation_map->block_count - allocation_map->free_count;
+    fprintf(stderr, "\nThe checkpoint with XID 0x%llx has %llu of %llu blocks allocated.\n", allocation_map->xid, num_allocated, allocation_map->block_count);
+
+    buffer = malloc(IMAGE_READ_BLOCKS * block_size);
+    if (!buffer) {
+        fprintf(stderr, "\nABORT: main: Could not allocate sufficient memory for `buffer`.\n");
+        goto cleanup;
+    }
+
+    // Setting the size of the output first leaves every block that isn't
+    // written as a hole, on file systems that support them.
+    output_fd = open(output_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (output_fd < 0 || ftruncate(output_fd, allocation_map->block_count * block_size) != 0) {
+        fprintf(stderr, "Could not create the output file `%s`: %s.\n", output_path, strerror(errno));
+        goto cleanup;
+    }
+
+    double start_time = get_seconds();
+    image_stats_t stats = {0};
+
+    if (metadata_first) {
+        metadata = list_metadata_blocks(container, allocation_map);
+        if (!metadata || copy_metadata_blocks(output_fd, buffer, metadata, &stats) != 0) {
+            goto cleanup;
+        }
+        if (fsync(output_fd) != 0) {
+            fprintf(stderr, "Could not sync the output file: %s.\n", strerror(errno));
+            goto cleanup;
+        }
+        fprintf(stderr, "Copied %llu metadata blocks in %.2f seconds; the output can be explored now.\n", stats.blocks_copied, get_seconds() - start_time);
+    }
+
+    // The metadata blocks are allocated too; if they've already been copied,
+    // the runs of allocated blocks are copied around them.
+    paddr_t run_start = 0;
+    uint64_t run_length = 0;
+    uint64_t metadata_cursor = 0;
+    for (paddr_t addr = 0; (run_length = find_next_run(allocation_map, addr, true, &run_start)) != 0; addr = run_start + run_length) {
+        int copy_result = metadata
+            ? copy_blocks_except(output_fd, buffer, run_start, run_length, metadata, &metadata_cursor, &stats)
+            : copy_blocks(output_fd, buffer, run_start, run_length, &stats);
+        if (copy_result != 0) {
+            goto cleanup;
+        }
+    }
+    if (fsync(output_fd) != 0) {
+        fprintf(stderr, "Could not sync the output file: %s.\n", strerror(errno));
+        goto cleanup;
+    }
+
+    double seconds = get_seconds() - start_time;
+    fprintf(stderr, "Copied %llu blocks (%.1f MiB) in %llu reads and %.2f seconds, skipping %llu free blocks (%.1f MiB).\n",
+        stats.blocks_copied, stats.blocks_copied * (double)block_size / (1 << 20), stats.reads, seconds,
+        allocation_map->free_count, allocation_map->free_count * (double)block_size / (1 << 20)
+    );
+    result = 0;
+
+cleanup:
+    if (output_fd >= 0) {
+        close(output_fd);
+    }
+    free(buffer);
+    block_list_free(metadata);
+    allocation_map_free(allocation_map);
+    close_container(container);
+    return result;
+}
@@ -0,0 +1,209 @@
+#include <stdio.h>
+#include <sys/errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apfs/io.h"
+#include "apfs/func/cksum.h"
+#include "apfs/func/container.h"
+#include "apfs/func/scan.h"
+#include "apfs/func/block_index.h"
+
+#include "apfs/struct/object.h"
+#include "apfs/struct/nx.h"
+#include "apfs/struct/btree.h"
+
+/**
+ * Print usage info for this program.
+ */
+void print_usage(char* program_name) {
+    fprintf(stderr, "Usage:   %s build <container or scan> <index file> [<number of threads>]\n", program_name);
+    fprintf(stderr, "         %s query <index file> [<criterion> ...]\n", program_name);
+    fprintf(stderr, "Example: %s build /dev/disk0s2 disk0s2.idx\n", program_name);
+    fprintf(stderr, "         %s query disk0s2.idx type=0x3 subtype=0xe flags=0x2 min-xid=0x1bca00\n\n", program_name);
+    fprintf(stderr, "`build` scans the whole container, or reads a scan written by `apfs-scan`, and\n");
+    fprintf(stderr, "writes an index of the objects found, sorted by address, OID, and XID.\n\n");
+    fprintf(stderr, "`query` lists the objects in an index that match all of the given criteria,\n");
+    fprintf(stderr, "without reading the container. The criteria are `type`, `subtype`, `flags`\n");
+    fprintf(stderr, "(B-tree node flags, all of which must be set), `oid`, `min-xid`, `max-xid`,\n");
+    fprintf(stderr, "`min-addr`, and `max-addr`, each given as `<criterion>=<value>`.\n\n");
+}
+
+/**
+ * Parse a number, given either in hexadecimal prefixed with `0x` or in decimal.
+ */
+bool parse_number(char* arg, uint64_t* value) {
+    return sscanf(arg, "0x%llx", value) == 1 || sscanf(arg, "%llu", value) == 1;
+}
+
+/**
+ * The records found so far by a scan.
+ */
+typedef struct {
+    scan_record_t*  records;
+    uint64_t        num_records;
+    uint64_t        capacity;
+} record_list_t;
+
+bool append_records(void* context, scan_record_t* records, size_t num_records, scan_stats_t* stats) {
+    (void)stats;
+    record_list_t* list = context;
+    if (list->num_records + num_records > list->capacity) {
+        uint64_t capacity = list->capacity ? 2 * list->capacity : 4096;
+        while (capacity < list->num_records + num_records) {
+            capacity *= 2;
+        }
+        scan_record_t* grown = realloc(list->records, capacity * sizeof(scan_record_t));
+        if (!grown) {
+            fprintf(stderr, "\nABORT: Could not allocate sufficient memory for `records`.\n");
+            return false;
+        }
+        list->records = grown;
+        list->capacity = capacity;
+    }
+    memcpy(list->records + list->num_records, records, num_records * sizeof(scan_record_t));
+    list->num_records += num_records;
+    return true;
+}
+
+int build_index(char* input_path, char* index_path, unsigned int num_threads) {
+    // The input is either a scan written by `apfs-scan`, or a container.
+    uint32_t magic = 0;
+    FILE* input = fopen(input_path, "rb");
+    if (!input) {
+        fprintf(stderr, "ABORT: ");
+        report_fopen_error();
+        return -errno;
+    }
+    if (fread(&magic, sizeof(magic), 1, input) != 1) {
+        magic = 0;
+    }
+
+    scan_index_header_t scan_header;
+    record_list_t list = { 0 };
+    if (magic == SCAN_INDEX_MAGIC) {
+        fclose(input);
+        fprintf(stderr, "Reading the scan at `%s` ... ", input_path);
+        if (read_scan_records(input_path, &scan_header, &list.records, &list.num_records) != 0) {
+            return -1;
+        }
+        fprintf(stderr, "OK.\n");
+    } else {
+        nx_device->path = input_path;
+        nx_device->file = input;
+        detect_block_size();
+
+        paddr_t end_addr = INT64_MAX;
+        nx_superblock_t* nxsb = malloc(nx_device->block_size);
+        if (nxsb && read_blocks(nxsb, 0x0, 1) == 1 && is_cksum_valid(nxsb) && nxsb->nx_magic == NX_MAGIC) {
+            end_addr = nxsb->nx_block_count;
+        }
+        free(nxsb);
+
+        fprintf(stderr, "Scanning `%s` with %u threads ... ", input_path, num_threads);
+        scan_stats_t stats;
+        if (scan_blocks(0, end_addr, num_threads, append_records, &list, &stats) != 0) {
+            fprintf(stderr, "FAILED.\n");
+            free(list.records);
+            return -1;
+        }
+        fprintf(stderr, "OK.\n");
+
+        scan_header.magic       = SCAN_INDEX_MAGIC;
+        scan_header.version     = SCAN_INDEX_VERSION;
+        scan_header.block_size  = nx_device->block_size;
+        scan_header.record_size = sizeof(scan_record_t);
+        scan_header.start_addr  = 0;
+        scan_header.end_addr    = stats.blocks_scanned;
+        scan_header.flags       = 0;
+        scan_header.reserved    = 0;
+    }
+
+    fprintf(stderr, "Writing an index of %llu objects to `%s` ... ", list.num_records, index_path);
+    int result = block_index_write(index_path, &scan_header, list.records, list.num_records);
+    if (result == 0) {
+        fprintf(stderr, "OK.\n");
+    }
+    free(list.records);
+    return result;
+}
+
+bool print_record(void* context, scan_record_t* record) {
+    (void)context;
+    printf("%#12llx  %#12llx  %#10llx  %#10x  %#10x  %#6x  %5u",
+        record->addr, record->oid, record->xid, record->type, record->subtype, record->flags, record->level
+    );
+    if (record->type == SCAN_TYPE_FILE_SIGNATURE) {
+        printf("  %s file signature", get_signature_name(record->subtype));
+    }
+    printf("\n");
+    return true;
+}
+
+int query_index(char* index_path, int num_criteria, char** criteria) {
+    block_index_query_t query = { 0 };
+    for (int i = 0; i < num_criteria; i++) {
+        char* value = strchr(criteria[i], '=');
+        uint64_t number = 0;
+        if (!value || !parse_number(value + 1, &number)) {
+            fprintf(stderr, "`%s` is not a valid criterion.\n", criteria[i]);
+            return 1;
+        }
+        size_t name_len = value - criteria[i];
+        #define IS_CRITERION(name)  (name_len == strlen(name) && strncmp(criteria[i], name, name_len) == 0)
+        if (IS_CRITERION("type")) {
+            query.type = number;
+        } else if (IS_CRITERION("subtype")) {
+            query.subtype = number;
+        } else if (IS_CRITERION("flags")) {
+            query.flags = number;
+        } else if (IS_CRITERION("oid")) {
+            query.oid = number;
+        } else if (IS_CRITERION("min-xid")) {
+            query.min_xid = number;
+        } else if (IS_CRITERION("max-xid")) {
+            query.max_xid = number;
+        } else if (IS_CRITERION("min-addr")) {
+            query.min_addr = number;
+        } else if (IS_CRITERION("max-addr")) {
+            query.max_addr = number;
+        } else {
+            fprintf(stderr, "`%s` is not a valid criterion.\n", criteria[i]);
+            return 1;
+        }
+        #undef IS_CRITERION
+    }
+
+    block_index_t* index = block_index_open(index_path);
+    if (!index) {
+        return -1;
+    }
+    if (index->header->scan_flags & SCAN_INDEX_FREE_ONLY) {
+        fprintf(stderr, "- Only the blocks that were free were scanned; the other blocks between %#llx and %#llx may hold objects that aren't in the index.\n", index->header->start_addr, index->header->end_addr);
+    }
+    printf("%12s  %12s  %10s  %10s  %10s  %6s  %5s\n", "Address", "OID", "XID", "Type", "Subtype", "Flags", "Level");
+    uint64_t num_matches = block_index_query(index, &query, print_record, NULL);
+    fprintf(stderr, "Found %llu of the %llu objects in the index.\n", num_matches, index->header->num_records);
+    block_index_close(index);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    // Extrapolate CLI arguments, exit if invalid
+    if (argc >= 4 && argc <= 5 && strcmp(argv[1], "build") == 0) {
+        unsigned int num_threads = SCAN_DEFAULT_NUM_THREADS;
+        if (argc == 5 && (sscanf(argv[4], "%u", &num_threads) != 1 || num_threads == 0)) {
+            fprintf(stderr, "%s is not a valid number of threads.\n", argv[4]);
+            print_usage(argv[0]);
+            return 1;
+        }
+        return build_index(argv[2], argv[3], num_threads);
+    }
+    if (argc >= 3 && strcmp(argv[1], "query") == 0) {
+        return query_index(argv[2], argc - 3, argv + 3);
+    }
+
+    fprintf(stderr, "Incorrect arguments.\n");
+    print_usage(argv[0]);
+    return 1;
+}
@@ -43,12 +43,12 @@ int main(int argc, char** argv) {
         print_usage(argv[0]);
         return 1;
     }
-    nx_path = argv[1];
+    nx_device->path = argv[1];
     
     // Open (device special) file corresponding to an APFS container, read-only
-    printf("Opening file at `%s` in read-only mode ... ", nx_path);
-    nx = fopen(nx_path, "rb");
-    if (!nx) {
+    printf("Opening file at `%s` in read-only mode ... ", nx_device->path);
+    nx_device->file = fopen(nx_device->path, "rb");
+    if (!nx_device->file) {
         fprintf(stderr, "\nABORT: ");
         report_fopen_error();
         printf("\n");
@@ -60,7 +60,7 @@ int main(int argc, char** argv) {
     // This way, we can read the entire block and validate its checksum,
     // but still have direct access to the fields in `nx_superblock_t`
     // without needing to epxlicitly cast to that datatype.
-    nx_superblock_t* nxsb = malloc(nx_block_size);
+    nx_superblock_t* nxsb = malloc(nx_device->block_size);
     if (!nxsb) {
         fprintf(stderr, "ABORT: Could not allocate sufficient memory to create `nxsb`.\n");
         return -1;
@@ -96,7 +96,7 @@ int main(int argc, char** argv) {
     uint32_t xp_desc_blocks = nxsb->nx_xp_desc_blocks & ~(1 << 31);
     printf("- Its length is %u blocks.\n", xp_desc_blocks);
 
-    char (*xp_desc)[nx_block_size] = malloc(xp_desc_blocks * nx_block_size);
+    char (*xp_desc)[nx_device->block_size] = malloc(xp_desc_blocks * nx_device->block_size);
     if (!xp_desc) {
         fprintf(stderr, "ABORT: Could not allocate sufficient memory for %u blocks.\n", xp_desc_blocks);
         return -1;
@@ -176,7 +176,7 @@ int main(int argc, char** argv) {
     printf("Loading the corresponding checkpoint ... ");
     
     // The array `xp` will comprise the blocks in the checkpoint, in order.
-    char (*xp)[nx_block_size] = malloc(nxsb->nx_xp_desc_len * nx_block_size);
+    char (*xp)[nx_device->block_size] = malloc(nxsb->nx_xp_desc_len * nx_device->block_size);
     if (!xp) {
         fprintf(stderr, "\nABORT: Couldn't allocate sufficient memory.\n");
         return -1;
@@ -184,14 +184,14 @@ int main(int argc, char** argv) {
 
     if (nxsb->nx_xp_desc_index + nxsb->nx_xp_desc_len <= xp_desc_blocks) {
         // The simple case: the checkpoint is already contiguous in `xp_desc`.
-        memcpy(xp, xp_desc[nxsb->nx_xp_desc_index], nxsb->nx_xp_desc_len * nx_block_size);
+        memcpy(xp, xp_desc[nxsb->nx_xp_desc_index], nxsb->nx_xp_desc_len * nx_device->block_size);
     } else {
         // The case where the checkpoint wraps around from the end of the
         // checkpoint descriptor area to the start.
         uint32_t segment_1_len = xp_desc_blocks - nxsb->nx_xp_desc_index;
         uint32_t segment_2_len = nxsb->nx_xp_desc_len - segment_1_len;
-        memcpy(xp,                 xp_desc + nxsb->nx_xp_desc_index, segment_1_len * nx_block_size);
-        memcpy(xp + segment_1_len, xp_desc,                          segment_2_len * nx_block_size);
+        memcpy(xp,                 xp_desc + nxsb->nx_xp_desc_index, segment_1_len * nx_device->block_size);
+        memcpy(xp + segment_1_len, xp_desc,                          segment_2_len * nx_device->block_size);
     }
     printf("OK.\n");
     
@@ -226,7 +226,7 @@ int main(int argc, char** argv) {
     printf("- There are %u checkpoint-mappings in this checkpoint.\n\n", xp_obj_len);
 
     printf("Reading the Ephemeral objects used by this checkpoint ... ");
-    char (*xp_obj)[nx_block_size] = malloc(xp_obj_len * nx_block_size);
+    char (*xp_obj)[nx_device->block_size] = malloc(xp_obj_len * nx_device->block_size);
     if (!xp_obj) {
         fprintf(stderr, "\nABORT: Could not allocate sufficient memory for `xp_obj`.\n");
         return -1;
@@ -274,7 +274,7 @@ int main(int argc, char** argv) {
     printf("The container superblock states that the container object map has Physical OID 0x%llx.\n", nxsb->nx_omap_oid);
 
     printf("Loading the container object map ... ");
-    omap_phys_t* nx_omap = malloc(nx_block_size);
+    omap_phys_t* nx_omap = malloc(nx_device->block_size);
     if (read_blocks(nx_omap, nxsb->nx_omap_oid, 1) != 1) {
         fprintf(stderr, "\nABORT: Could not allocate sufficient memory for `nx_omap`.\n");
         return -1;
@@ -304,7 +304,7 @@ int main(int argc, char** argv) {
     }
 
     printf("Reading the root node of the container object map B-tree ... ");
-    btree_node_phys_t* nx_omap_btree = malloc(nx_block_size);
+    btree_node_phys_t* nx_omap_btree = malloc(nx_device->block_size);
     if (!nx_omap_btree) {
         fprintf(stderr, "\nABORT: Could not allocate sufficient memory for `nx_omap_btree`.\n");
         return -1;
@@ -342,7 +342,7 @@ int main(int argc, char** argv) {
     printf("\n");
 
     printf("Reading the APFS volume superblocks ... ");
-    char (*apsbs)[nx_block_size] = malloc(nx_block_size * num_file_systems);
+    char (*apsbs)[nx_device->block_size] = malloc(nx_device->block_size * num_file_systems);
     if (!apsbs) {
         fprintf(stderr, "\nABORT: Could not allocate sufficient memory for `apsbs`.\n");
         return -1;
@@ -400,7 +400,7 @@ int main(int argc, char** argv) {
         printf("The volume object map has Physical OID 0x%llx.\n", apsb->apfs_omap_oid);
 
         printf("Reading the volume object map ... ");
-        omap_phys_t* fs_omap = malloc(nx_block_size);
+        omap_phys_t* fs_omap = malloc(nx_device->block_size);
         if (!fs_omap) {
             fprintf(stderr, "\nABORT: Could not allocate sufficient memory for `fs_omap`.\n");
             return -1;
@@ -433,7 +433,7 @@ int main(int argc, char** argv) {
         }
 
         printf("Reading the root node of the volume object map B-tree ... ");
-        btree_node_phys_t* fs_omap_btree = malloc(nx_block_size);
+        btree_node_phys_t* fs_omap_btree = malloc(nx_device->block_size);
         if (!fs_omap_btree) {
             fprintf(stderr, "\nABORT: Could not allocate sufficient memory for `fs_omap_btree`.\n");
             return -1;
@@ -467,7 +467,7 @@ int main(int argc, char** argv) {
         printf("corresponding block address is 0x%llx.\n", fs_root_val->ov_paddr);
 
         printf("Reading ... ");
-        btree_node_phys_t* fs_root_btree = malloc(nx_block_size);
+        btree_node_phys_t* fs_root_btree = malloc(nx_device->block_size);
         if (!fs_root_btree) {
             fprintf(stderr, "\nABORT: Could not allocate sufficient memory for `fs_root_btree`.\n");
             return -1;
@@ -605,7 +605,7 @@ int main(int argc, char** argv) {
     free(nx_omap);
     free(xp_obj);
     free(nxsb);
-    fclose(nx);
+    fclose(nx_device->file);
     printf("END: All done.\n");
     return 0;
 }
@@ -32,7 +32,7 @@ int main(int argc, char** argv) {
         print_usage(argv[0]);
         return 1;
     }
-    char* nx_path = argv[1];
+    nx_device->path = argv[1];
     paddr_t nx_block_addr = 0x0;
     bool parse_success = sscanf(argv[2], "0x%llx", &nx_block_addr);
     if (!parse_success) {
@@ -45,9 +45,9 @@ int main(int argc, char** argv) {
     }
     
     // Open (device special) file corresponding to an APFS container, read-only
-    printf("Opening file at `%s` in read-only mode ... ", nx_path);
-    nx = fopen(nx_path, "rb");
-    if (!nx) {
+    printf("Opening file at `%s` in read-only mode ... ", nx_device->path);
+    nx_device->file = fopen(nx_device->path, "rb");
+    if (!nx_device->file) {
         fprintf(stderr, "\nABORT: main: ");
         report_fopen_error();
         printf("\n");
@@ -56,9 +56,9 @@ int main(int argc, char** argv) {
     printf("OK.\n\n");
 
     printf("Reading block 0x%llx ... ", nx_block_addr);
-    obj_phys_t* block = malloc(nx_block_size);
+    obj_phys_t* block = malloc(nx_device->block_size);
     if (read_blocks(block, nx_block_addr, 1) == 0) {
-        printf("\nEND: Block index %s does not exist in `%s`.\n", argv[2], nx_path);
+        printf("\nEND: Block index %s does not exist in `%s`.\n", argv[2], nx_device->path);
         goto cleanup;
     }
     printf("validating ... ");
@@ -98,6 +98,6 @@ int main(int argc, char** argv) {
 
 cleanup:
     free(block);
-    fclose(nx);
+    fclose(nx_device->file);
     return 0;
 }
@@ -0,0 +1,256 @@
+#include <stdio.h>
+#include <sys/errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "apfs/io.h"
+#include "apfs/func/cksum.h"
+#include "apfs/func/container.h"
+#include "apfs/func/scan.h"
+#include "apfs/func/spaceman.h"
+
+#include "apfs/struct/object.h"
+#include "apfs/struct/nx.h"
+
+/**
+ * Print usage info for this program.
+ */
+void print_usage(char* program_name) {
+    fprintf(stderr, "Usage:   %s [--free-only] [--signatures] <container> <index file> [<start address> [<end address> [<number of threads>]]]\nExample: %s /dev/disk0s2 disk0s2.idx\n\n", program_name, program_name);
+    fprintf(stderr, "Reads every block of the container, or of the given range of blocks, and\n");
+    fprintf(stderr, "writes a record of each object whose checksum is valid to <index file>, or to\n");
+    fprintf(stderr, "stdout if <index file> is `-`. The range defaults to the whole container; the\n");
+    fprintf(stderr, "end address is excluded from it.\n\n");
+    fprintf(stderr, "With --free-only, only the blocks that the space manager of the container's latest\n");
+    fprintf(stderr, "checkpoint reports as free are read, which is where deleted nodes and file data remain;\n");
+    fprintf(stderr, "the index's header is marked with `SCAN_INDEX_FREE_ONLY` to say so.\n");
+    fprintf(stderr, "With --signatures, blocks that aren't objects but start with the signature of a common\n");
+    fprintf(stderr, "file format (JPEG, PDF, SQLite, ...) are also recorded, with a type of %#x and the\n", SCAN_TYPE_FILE_SIGNATURE);
+    fprintf(stderr, "format as their subtype; see `SCAN_SIGNATURE_...` in `apfs/func/scan.h`.\n\n");
+}
+
+/**
+ * Parse a block address, given either in hexadecimal prefixed with `0x` or in
+ * decimal.
+ */
+bool parse_addr(char* arg, paddr_t* addr) {
+    return sscanf(arg, "0x%llx", addr) == 1 || sscanf(arg, "%llu", addr) == 1;
+}
+
+double get_seconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/**
+ * The state of the index that the scan streams its results to.
+ */
+typedef struct {
+    FILE*       file;
+    bool        write_failed;
+    uint64_t    num_blocks;
+    double      start_time;
+    double      last_report_time;
+} scan_output_t;
+
+bool write_records(void* context, scan_record_t* records, size_t num_records, scan_stats_t* stats) {
+    scan_output_t* output = context;
+    if (fwrite(records, sizeof(scan_record_t), num_records, output->file) != num_records) {
+        fprintf(stderr, "\nABORT: Failed to write to the index file.\n");
+        output->write_failed = true;
+        return false;
+    }
+
+    // Report progress at most once a second, rather than for every chunk.
+    double now = get_seconds();
+    if (now - output->last_report_time >= 1) {
+        output->last_report_time = now;
+        fprintf(stderr, "\rScanned %llu of %llu blocks (%.1f%%); found %llu objects and %llu file signatures; %.1f MiB/s ...",
+            stats->blocks_scanned,
+            output->num_blocks,
+            output->num_blocks ? 100.0 * stats->blocks_scanned / output->num_blocks : 0.0,
+            stats->objects_found,
+            stats->signatures_found,
+            stats->blocks_scanned * nx_device->block_size / (now - output->start_time) / (1 << 20)
+        );
+    }
+    return true;
+}
+
+/**
+ * Count the free blocks in a range.
+ */
+uint64_t count_free_blocks(allocation_map_t* allocation_map, paddr_t start_addr, paddr_t end_addr) {
+    uint64_t count = 0;
+    paddr_t run_start = 0;
+    uint64_t run_length = 0;
+    for (paddr_t addr = start_addr; (run_length = find_next_run(allocation_map, addr, false, &run_start)) != 0 && run_start < end_addr; addr = run_start + run_length) {
+        paddr_t run_end = run_start + run_length;
+        count += (run_end > end_addr ? end_addr : run_end) - run_start;
+    }
+    return count;
+}
+
+int main(int argc, char** argv) {
+    // Extrapolate CLI arguments, exit if invalid
+    bool free_only = false;
+    bool find_signatures = false;
+    while (argc >= 2 && strncmp(argv[1], "--", 2) == 0) {
+        if (strcmp(argv[1], "--free-only") == 0) {
+            free_only = true;
+        } else if (strcmp(argv[1], "--signatures") == 0) {
+            find_signatures = true;
+        } else {
+            fprintf(stderr, "Unknown option %s.\n", argv[1]);
+            print_usage(argv[0]);
+            return 1;
+        }
+        argv[1] = argv[0];
+        argv++;
+        argc--;
+    }
+    if (argc < 3 || argc > 6) {
+        fprintf(stderr, "Incorrect number of arguments.\n");
+        print_usage(argv[0]);
+        return 1;
+    }
+    nx_device->path = argv[1];
+    char* index_path = argv[2];
+
+    paddr_t start_addr = 0;
+    paddr_t end_addr = 0;
+    bool end_given = argc >= 5;
+    if (argc >= 4 && !parse_addr(argv[3], &start_addr)) {
+        fprintf(stderr, "%s is not a valid block address.\n", argv[3]);
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (end_given && !parse_addr(argv[4], &end_addr)) {
+        fprintf(stderr, "%s is not a valid block address.\n", argv[4]);
+        print_usage(argv[0]);
+        return 1;
+    }
+    unsigned int num_threads = SCAN_DEFAULT_NUM_THREADS;
+    if (argc == 6 && (sscanf(argv[5], "%u", &num_threads) != 1 || num_threads == 0)) {
+        fprintf(stderr, "%s is not a valid number of threads.\n", argv[5]);
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    // Scanning only free space needs the space manager, so the container must
+    // be mounted; otherwise, nothing is assumed about what the file holds.
+    allocation_map_t* allocation_map = NULL;
+    if (free_only) {
+        container_t* container = open_container(nx_device->path, (xid_t)(~0));
+        if (!container) {
+            return -1;
+        }
+        allocation_map = load_allocation_map(container->nxsb);
+        if (!allocation_map) {
+            fprintf(stderr, "Can't scan only free space without the space manager.\n");
+            return -1;
+        }
+        if (!end_given || (uint64_t)end_addr > allocation_map->block_count) {
+            end_addr = allocation_map->block_count;
+        }
+    } else {
+        // Open (device special) file corresponding to an APFS container, read-only
+        fprintf(stderr, "Opening file at `%s` in read-only mode ... ", nx_device->path);
+        nx_device->file = fopen(nx_device->path, "rb");
+        if (!nx_device->file) {
+            fprintf(stderr, "\nABORT: ");
+            report_fopen_error();
+            fprintf(stderr, "\n");
+            return -errno;
+        }
+        fprintf(stderr, "OK.\n");
+
+        // Use the block size and block count from block 0x0 if it's a valid
+        // container superblock; if it isn't, scan up to the end of the file.
+        detect_block_size();
+    }
+    if (!end_given && !free_only) {
+        end_addr = INT64_MAX;
+        nx_superblock_t* nxsb = malloc(nx_device->block_size);
+        if (nxsb && read_blocks(nxsb, 0x0, 1) == 1 && is_cksum_valid(nxsb) && nxsb->nx_magic == NX_MAGIC) {
+            end_addr = nxsb->nx_block_count;
+        }
+        free(nxsb);
+    }
+    if (end_addr <= start_addr) {
+        fprintf(stderr, "The end address must be greater than the start address.\n");
+        return 1;
+    }
+
+    scan_output_t output = {
+        .file       = strcmp(index_path, "-") == 0 ? stdout : fopen(index_path, "wb"),
+        .num_blocks = end_addr != INT64_MAX ? end_addr - start_addr : 0,
+    };
+    if (allocation_map) {
+        output.num_blocks = count_free_blocks(allocation_map, start_addr, end_addr);
+    }
+    if (!output.file) {
+        fprintf(stderr, "ABORT: Could not create the index file at `%s`: ", index_path);
+        report_fopen_error();
+        return -errno;
+    }
+
+    scan_index_header_t header = {
+        .magic          = SCAN_INDEX_MAGIC,
+        .version        = SCAN_INDEX_VERSION,
+        .block_size     = nx_device->block_size,
+        .record_size    = sizeof(scan_record_t),
+        .start_addr     = start_addr,
+        .end_addr       = end_addr,
+        .flags          = free_only ? SCAN_INDEX_FREE_ONLY : 0,
+    };
+    if (fwrite(&header, sizeof(header), 1, output.file) != 1) {
+        fprintf(stderr, "ABORT: Failed to write to the index file.\n");
+        return -1;
+    }
+
+    if (allocation_map) {
+        fprintf(stderr, "\nScanning the %llu free blocks between 0x%llx and 0x%llx, as of the checkpoint with XID 0x%llx, with %u threads.\n", output.num_blocks, start_addr, end_addr - 1, allocation_map->xid, num_threads);
+    } else if (output.num_blocks) {
+        fprintf(stderr, "Scanning blocks 0x%llx to 0x%llx with %u threads.\n", start_addr, end_addr - 1, num_threads);
+    } else {
+        fprintf(stderr, "Scanning from block 0x%llx to the end of the container with %u threads.\n", start_addr, num_threads);
+    }
+
+    scan_stats_t stats;
+    output.start_time = get_seconds();
+    output.last_report_time = output.start_time;
+    int result = scan_free_blocks(allocation_map, start_addr, end_addr, num_threads, find_signatures, write_records, &output, &stats);
+    double elapsed = get_seconds() - output.start_time;
+
+    // The scan may have stopped early at the end of the container, so record
+    // the range that was actually scanned.
+    if (!allocation_map && stats.blocks_scanned < (uint64_t)(end_addr - start_addr) && output.file != stdout && !output.write_failed) {
+        header.end_addr = start_addr + stats.blocks_scanned;
+        if (fseek(output.file, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, output.file) != 1) {
+            output.write_failed = true;
+        }
+    }
+    if (fclose(output.file) != 0) {
+        output.write_failed = true;
+    }
+
+    fprintf(stderr, "\r\033[2KFinished scan of %llu blocks in %.1f s (%.1f MiB/s).\n",
+        stats.blocks_scanned,
+        elapsed,
+        elapsed > 0 ? stats.blocks_scanned * nx_device->block_size / elapsed / (1 << 20) : 0.0
+    );
+    fprintf(stderr, "- Objects found:     %llu\n", stats.objects_found);
+    if (find_signatures) {
+        fprintf(stderr, "- File signatures:   %llu\n", stats.signatures_found);
+    }
+    fprintf(stderr, "- Unreadable blocks: %llu\n", stats.blocks_unreadable);
+
+    if (result < 0 || output.write_failed) {
+        fprintf(stderr, "The index at `%s` is incomplete.\n", index_path);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,823 @@
+#include <stdio.h>
+#include <sys/errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "apfs/apfs.h"
+
+#include "apfs/struct/j.h"
+#include "apfs/struct/const.h"
+
+/** Limits **/
+
+#define SERVED_DEFAULT_NUM_THREADS  8
+#define SERVED_QUEUE_SIZE           256         // Connections waiting for a worker
+#define SERVED_NODE_CACHE_SIZE      65536       // = 256 MiB of 4 KiB nodes
+#define SERVED_MAX_REQUEST_LEN      65536       // Bytes per request line
+#define SERVED_MAX_READ_LEN         (64 * 1024 * 1024)  // = 64 MiB
+
+/**
+ * Print usage info for this program.
+ */
+void print_usage(char* program_name) {
+    fprintf(stderr, "Usage:   %s <container> <socket path> [<number of threads>]\nExample: %s /dev/disk0s2  /tmp/apfs.sock\n\n", program_name, program_name);
+    fprintf(stderr, "Mounts the container once, then serves requests from clients that connect to\n");
+    fprintf(stderr, "the Unix-domain socket at <socket path>. Each request is a JSON object on a\n");
+    fprintf(stderr, "single line, and each response is a JSON object on a single line:\n\n");
+    fprintf(stderr, "  {\"id\": 1, \"op\": \"volumes\"}\n");
+    fprintf(stderr, "  {\"id\": 2, \"op\": \"list\",   \"volume\": 0, \"path\": \"/Users\"}\n");
+    fprintf(stderr, "  {\"id\": 3, \"op\": \"stat\",   \"volume\": 0, \"path\": \"/Users/john/notes.txt\"}\n");
+    fprintf(stderr, "  {\"id\": 4, \"op\": \"read\",   \"volume\": 0, \"path\": \"/Users/john/notes.txt\", \"offset\": 0, \"length\": 4096}\n");
+    fprintf(stderr, "  {\"id\": 5, \"op\": \"export\", \"volume\": 0, \"path\": \"/Users/john\", \"dest\": \"/Volumes/Backup/john\"}\n\n");
+    fprintf(stderr, "The response to a successful `read` request, e.g. `{\"id\": 4, \"ok\": true, \"length\": 4096}`,\n");
+    fprintf(stderr, "is followed by exactly `length` bytes of raw file data.\n");
+    fprintf(stderr, "Failed requests get a response like `{\"id\": 3, \"ok\": false, \"error\": \"...\"}`.\n\n");
+}
+
+/**
+ * The volumes of the container; an entry is NULL if the volume couldn't be
+ * opened, e.g. because it is encrypted.
+ */
+apfs_container_t*   container;
+apfs_volume_t**     volumes;
+
+uint64_t            num_requests = 0;
+pthread_mutex_t     stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+volatile sig_atomic_t stopping = 0;
+
+/**
+ * A queue of accepted connections, waiting to be served by a worker thread.
+ */
+typedef struct {
+    int             fds[SERVED_QUEUE_SIZE];
+    size_t          head;
+    size_t          count;
+    pthread_mutex_t lock;
+    pthread_cond_t  not_empty;
+    pthread_cond_t  not_full;
+} client_queue_t;
+
+client_queue_t queue = {
+    .lock       = PTHREAD_MUTEX_INITIALIZER,
+    .not_empty  = PTHREAD_COND_INITIALIZER,
+    .not_full   = PTHREAD_COND_INITIALIZER,
+};
+
+/** Response buffers **/
+
+/**
+ * A growable buffer in which a response is built before it is sent.
+ */
+typedef struct {
+    char*   data;
+    size_t  len;
+    size_t  cap;
+    bool    failed;     // Set if memory could not be allocated
+} strbuf_t;
+
+void strbuf_append(strbuf_t* buf, const char* data, size_t len) {
+    if (buf->failed) {
+        return;
+    }
+    if (buf->len + len + 1 > buf->cap) {
+        size_t cap = buf->cap ? buf->cap : 256;
+        while (buf->len + len + 1 > cap) {
+            cap *= 2;
+        }
+        char* data = realloc(buf->data, cap);
+        if (!data) {
+            buf->failed = true;
+            return;
+        }
+        buf->data = data;
+        buf->cap = cap;
+    }
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+    buf->data[buf->len] = '\0';
+}
+
+void strbuf_puts(strbuf_t* buf, const char* str) {
+    strbuf_append(buf, str, strlen(str));
+}
+
+void strbuf_put_uint(strbuf_t* buf, uint64_t value) {
+    char digits[32];
+    sprintf(digits, "%llu", value);
+    strbuf_puts(buf, digits);
+}
+
+/**
+ * Append a string to `buf` as a JSON string literal. Bytes that aren't
+ * printable ASCII are passed through as-is, except control characters, which
+ * are escaped.
+ */
+void strbuf_put_json_string(strbuf_t* buf, const char* str, size_t len) {
+    strbuf_puts(buf, "\"");
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = str[i];
+        if (c == '"' || c == '\\') {
+            char escaped[2] = { '\\', c };
+            strbuf_append(buf, escaped, 2);
+        } else if (c < 0x20) {
+            char escaped[8];
+            sprintf(escaped, "\\u%04x", c);
+            strbuf_puts(buf, escaped);
+        } else {
+            strbuf_append(buf, (char*)&c, 1);
+        }
+    }
+    strbuf_puts(buf, "\"");
+}
+
+/** Requests **/
+
+typedef struct {
+    uint64_t    id;
+    char*       op;
+    uint32_t    volume;
+    char*       path;
+    char*       dest;
+    uint64_t    offset;
+    uint64_t    length;
+} request_t;
+
+void free_request(request_t* request) {
+    free(request->op);
+    free(request->path);
+    free(request->dest);
+}
+
+char* skip_json_whitespace(char* cursor) {
+    while (*cursor == ' ' || *cursor == '\t' || *cursor == '\r' || *cursor == '\n') {
+        cursor++;
+    }
+    return cursor;
+}
+
+/**
+ * Append a Unicode code point to `out` as UTF-8.
+ */
+char* put_utf8(char* out, uint32_t code_point) {
+    if (code_point < 0x80) {
+        *out++ = code_point;
+    } else if (code_point < 0x800) {
+        *out++ = 0xc0 | (code_point >> 6);
+        *out++ = 0x80 | (code_point & 0x3f);
+    } else if (code_point < 0x10000) {
+        *out++ = 0xe0 | (code_point >> 12);
+        *out++ = 0x80 | ((code_point >> 6) & 0x3f);
+        *out++ = 0x80 | (code_point & 0x3f);
+    } else {
+        *out++ = 0xf0 | (code_point >> 18);
+        *out++ = 0x80 | ((code_point >> 12) & 0x3f);
+        *out++ = 0x80 | ((code_point >> 6) & 0x3f);
+        *out++ = 0x80 | (code_point & 0x3f);
+    }
+    return out;
+}
+
+/**
+ * Parse a JSON string literal starting at `*cursor`, which must point to the
+ * opening quote.
+ *
+ * RETURN VALUE:
+ *      The unescaped string, which must be freed when no longer needed; or
+ *      NULL if the literal is malformed. On success, `*cursor` is advanced past
+ *      the closing quote.
+ */
+char* parse_json_string(char** cursor) {
+    char* in = *cursor + 1;
+    // The unescaped string is never longer than the literal.
+    char* str = malloc(strlen(in) + 1);
+    if (!str) {
+        return NULL;
+    }
+    char* out = str;
+
+    while (*in != '"') {
+        if (*in == '\0') {
+            goto onError;
+        }
+        if (*in != '\\') {
+            *out++ = *in++;
+            continue;
+        }
+
+        in++;
+        switch (*in++) {
+            case '"':   *out++ = '"';   break;
+            case '\\':  *out++ = '\\';  break;
+            case '/':   *out++ = '/';   break;
+            case 'b':   *out++ = '\b';  break;
+            case 'f':   *out++ = '\f';  break;
+            case 'n':   *out++ = '\n';  break;
+            case 'r':   *out++ = '\r';  break;
+            case 't':   *out++ = '\t';  break;
+            case 'u': {
+                uint32_t code_point;
+                if (sscanf(in, "%4x", &code_point) != 1 || strspn(in, "0123456789abcdefABCDEF") < 4) {
+                    goto onError;
+                }
+                in += 4;
+                // Combine a UTF-16 surrogate pair
+                if (code_point >= 0xd800 && code_point < 0xdc00 && in[0] == '\\' && in[1] == 'u') {
+                    uint32_t low;
+                    if (sscanf(in + 2, "%4x", &low) == 1 && low >= 0xdc00 && low < 0xe000) {
+                        code_point = 0x10000 + ((code_point - 0xd800) << 10) + (low - 0xdc00);
+                        in += 6;
+                    }
+                }
+                out = put_utf8(out, code_point);
+            } break;
+            default:
+                goto onError;
+        }
+    }
+
+    *out = '\0';
+    *cursor = in + 1;
+    return str;
+
+onError:
+    free(str);
+    return NULL;
+}
+
+/**
+ * Parse a request, which must be a JSON object whose values are strings,
+ * non-negative integers, booleans, or `null`. Unknown keys are ignored.
+ *
+ * RETURN VALUE:
+ *      NULL on success, or a description of the error.
+ */
+char* parse_request(char* line, request_t* request) {
+    memset(request, 0, sizeof(request_t));
+
+    char* cursor = skip_json_whitespace(line);
+    if (*cursor++ != '{') {
+        return "Requests must be JSON objects.";
+    }
+
+    cursor = skip_json_whitespace(cursor);
+    if (*cursor == '}') {
+        return "The request has no `op`.";
+    }
+
+    while (true) {
+        cursor = skip_json_whitespace(cursor);
+        if (*cursor != '"') {
+            return "Malformed JSON: expected a key.";
+        }
+        char* key = parse_json_string(&cursor);
+        if (!key) {
+            return "Malformed JSON: bad string.";
+        }
+
+        cursor = skip_json_whitespace(cursor);
+        if (*cursor++ != ':') {
+            free(key);
+            return "Malformed JSON: expected `:`.";
+        }
+        cursor = skip_json_whitespace(cursor);
+
+        char* str_value = NULL;
+        uint64_t int_value = 0;
+        if (*cursor == '"') {
+            str_value = parse_json_string(&cursor);
+            if (!str_value) {
+                free(key);
+                return "Malformed JSON: bad string.";
+            }
+        } else if (*cursor >= '0' && *cursor <= '9') {
+            char* end;
+            int_value = strtoull(cursor, &end, 10);
+            cursor = end;
+        } else if (strncmp(cursor, "true", 4) == 0) {
+            int_value = 1;
+            cursor += 4;
+        } else if (strncmp(cursor, "false", 5) == 0) {
+            cursor += 5;
+        } else if (strncmp(cursor, "null", 4) == 0) {
+            cursor += 4;
+        } else {
+            free(key);
+            return "Malformed JSON: unsupported value; only strings, non-negative integers, booleans, and null are accepted.";
+        }
+
+        char** str_field = NULL;
+        if (strcmp(key, "id") == 0) {
+            request->id = int_value;
+        } else if (strcmp(key, "volume") == 0) {
+            request->volume = int_value;
+        } else if (strcmp(key, "offset") == 0) {
+            request->offset = int_value;
+        } else if (strcmp(key, "length") == 0) {
+            request->length = int_value;
+        } else if (strcmp(key, "op") == 0) {
+            str_field = &request->op;
+        } else if (strcmp(key, "path") == 0) {
+            str_field = &request->path;
+        } else if (strcmp(key, "dest") == 0) {
+            str_field = &request->dest;
+        }
+        if (str_field) {
+            free(*str_field);
+            *str_field = str_value;
+        } else {
+            free(str_value);
+        }
+        free(key);
+
+        cursor = skip_json_whitespace(cursor);
+        if (*cursor == ',') {
+            cursor++;
+            continue;
+        }
+        if (*cursor == '}') {
+            break;
+        }
+        return "Malformed JSON: expected `,` or `}`.";
+    }
+
+    if (!request->op) {
+        return "The request has no `op`.";
+    }
+    return NULL;
+}
+
+/** Request handlers **/
+
+/**
+ * Each handler appends the body of a successful response (i.e. the fields
+ * after `"ok": true`) to `response`, or returns a description of the error.
+ * A handler that sends additional data after the response line stores it in
+ * `*payload` and its length in `*payload_len`.
+ */
+
+char* get_dt_type_string(uint16_t type) {
+    switch (type) {
+        case DT_REG:    return "file";
+        case DT_DIR:    return "dir";
+        case DT_LNK:    return "symlink";
+        case DT_FIFO:   return "fifo";
+        case DT_CHR:    return "char-device";
+        case DT_BLK:    return "block-device";
+        case DT_SOCK:   return "socket";
+        default:        return "unknown";
+    }
+}
+
+char* handle_volumes(strbuf_t* response) {
+    strbuf_puts(response, ", \"volumes\": [");
+    for (uint32_t i = 0; i < apfs_num_volumes(container); i++) {
+        apfs_superblock_t* apsb = apfs_volume_superblock(container, i);
+        strbuf_puts(response, i ? ", {\"volume\": " : "{\"volume\": ");
+        strbuf_put_uint(response, i);
+        strbuf_puts(response, ", \"name\": ");
+        strbuf_put_json_string(response, (char*)apsb->apfs_volname, strnlen((char*)apsb->apfs_volname, APFS_VOLNAME_LEN));
+        strbuf_puts(response, volumes[i] ? ", \"available\": true}" : ", \"available\": false}");
+    }
+    strbuf_puts(response, "]");
+    return NULL;
+}
+
+/**
+ * Describe an error returned by a `libapfs` function.
+ */
+char* get_error_string(int64_t result) {
+    switch (-result) {
+        case ENOENT:    return "No such file or directory.";
+        case ENOTDIR:   return "Not a directory.";
+        case EISDIR:
+        case EINVAL:    return "Not a regular file.";
+        case ENOMEM:    return "Could not allocate sufficient memory.";
+        default:        return "An I/O error occurred.";
+    }
+}
+
+char* handle_list(apfs_volume_t* volume, char* path, strbuf_t* response) {
+    apfs_dirent_t* entries;
+    size_t num_entries;
+    int result = apfs_list(volume, path, &entries, &num_entries);
+    if (result < 0) {
+        return get_error_string(result);
+    }
+
+    strbuf_puts(response, ", \"entries\": [");
+    for (size_t i = 0; i < num_entries; i++) {
+        strbuf_puts(response, i ? ", {\"name\": " : "{\"name\": ");
+        strbuf_put_json_string(response, entries[i].name, strlen(entries[i].name));
+        strbuf_puts(response, ", \"file_id\": ");
+        strbuf_put_uint(response, entries[i].file_id);
+        strbuf_puts(response, ", \"type\": \"");
+        strbuf_puts(response, get_dt_type_string(entries[i].type));
+        strbuf_puts(response, "\"}");
+    }
+    strbuf_puts(response, "]");
+    apfs_free_dirents(entries, num_entries);
+    return NULL;
+}
+
+char* handle_stat(apfs_volume_t* volume, char* path, strbuf_t* response) {
+    apfs_stat_t st;
+    int result = apfs_stat(volume, path, &st);
+    if (result < 0) {
+        return result == -EIO ? "The object has no inode record." : get_error_string(result);
+    }
+
+    struct {
+        char*       name;
+        uint64_t    value;
+    } fields[] = {
+        { "file_id",        st.file_id },
+        { "parent_id",      st.parent_id },
+        { "mode",           st.mode },
+        { "uid",            st.uid },
+        { "gid",            st.gid },
+        { (st.mode & S_IFMT) == S_IFDIR ? "nchildren" : "nlink",  st.nlink },
+        { "size",           st.size },
+        { "bsd_flags",      st.bsd_flags },
+        { "create_time",    st.create_time },
+        { "mod_time",       st.mod_time },
+        { "change_time",    st.change_time },
+        { "access_time",    st.access_time },
+    };
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        strbuf_puts(response, ", \"");
+        strbuf_puts(response, fields[i].name);
+        strbuf_puts(response, "\": ");
+        strbuf_put_uint(response, fields[i].value);
+    }
+    strbuf_puts(response, st.compressed ? ", \"compressed\": true" : ", \"compressed\": false");
+
+    char* target;
+    if ((st.mode & S_IFMT) == S_IFLNK && apfs_readlink(volume, path, &target) == 0) {
+        strbuf_puts(response, ", \"target\": ");
+        strbuf_put_json_string(response, target, strlen(target));
+        free(target);
+    }
+
+    char** names;
+    size_t num_names;
+    if (apfs_list_xattrs(volume, path, &names, &num_names) == 0) {
+        strbuf_puts(response, ", \"xattrs\": [");
+        for (size_t i = 0; i < num_names; i++) {
+            if (i) {
+                strbuf_puts(response, ", ");
+            }
+            strbuf_put_json_string(response, names[i], strlen(names[i]));
+        }
+        strbuf_puts(response, "]");
+        apfs_free_xattr_names(names, num_names);
+    }
+    return NULL;
+}
+
+char* handle_read(apfs_volume_t* volume, char* path, request_t* request, strbuf_t* response, char** payload, uint64_t* payload_len) {
+    if (request->length > SERVED_MAX_READ_LEN) {
+        return "The requested length is too large.";
+    }
+
+    char* buffer = malloc(request->length ? request->length : 1);
+    if (!buffer) {
+        return "Could not allocate sufficient memory.";
+    }
+    int64_t result = apfs_read(volume, path, request->offset, request->length, buffer);
+    if (result < 0) {
+        free(buffer);
+        return get_error_string(result);
+    }
+
+    strbuf_puts(response, ", \"length\": ");
+    strbuf_put_uint(response, result);
+    *payload = buffer;
+    *payload_len = result;
+    return NULL;
+}
+
+char* handle_export(apfs_volume_t* volume, char* path, request_t* request, strbuf_t* response) {
+    if (!request->dest || !*request->dest) {
+        return "The request has no `dest`.";
+    }
+
+    apfs_export_stats_t stats;
+    int result = apfs_export(volume, path, request->dest, &stats);
+    if (result < 0) {
+        return result == -ENOENT ? get_error_string(result) : "The object could not be exported.";
+    }
+
+    struct {
+        char*       name;
+        uint64_t    value;
+    } fields[] = {
+        { "files",          stats.num_files },
+        { "dirs",           stats.num_dirs },
+        { "symlinks",       stats.num_symlinks },
+        { "hard_links",     stats.num_hard_links },
+        { "failed",         stats.num_failed },
+        { "bytes_cloned",   stats.bytes_cloned },
+        { "bytes_copied",   stats.bytes_copied },
+    };
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        strbuf_puts(response, ", \"");
+        strbuf_puts(response, fields[i].name);
+        strbuf_puts(response, "\": ");
+        strbuf_put_uint(response, fields[i].value);
+    }
+    return NULL;
+}
+
+/**
+ * Handle a single request line.
+ *
+ * RETURN VALUE:
+ *      Zero on success (including requests that failed, for which an error
+ *      response is sent), or a negative value if the response couldn't be sent.
+ */
+int handle_request(int fd, char* line) {
+    pthread_mutex_lock(&stats_lock);
+    num_requests++;
+    pthread_mutex_unlock(&stats_lock);
+
+    request_t request;
+    strbuf_t response = {0};
+    char* payload = NULL;
+    uint64_t payload_len = 0;
+
+    char* error = parse_request(line, &request);
+    if (error) {
+        goto respond;
+    }
+
+    if (strcmp(request.op, "volumes") == 0) {
+        error = handle_volumes(&response);
+        goto respond;
+    }
+
+    if (request.volume >= apfs_num_volumes(container)) {
+        error = "No such volume.";
+        goto respond;
+    }
+    apfs_volume_t* volume = volumes[request.volume];
+    if (!volume) {
+        error = "The volume could not be opened.";
+        goto respond;
+    }
+
+    char* path = request.path ? request.path : "/";
+    if (strcmp(request.op, "list") == 0) {
+        error = handle_list(volume, path, &response);
+    } else if (strcmp(request.op, "stat") == 0) {
+        error = handle_stat(volume, path, &response);
+    } else if (strcmp(request.op, "read") == 0) {
+        error = handle_read(volume, path, &request, &response, &payload, &payload_len);
+    } else if (strcmp(request.op, "export") == 0) {
+        error = handle_export(volume, path, &request, &response);
+    } else {
+        error = "Unknown `op`; expected `volumes`, `list`, `stat`, `read`, or `export`.";
+    }
+
+respond: ;
+    strbuf_t line_out = {0};
+    strbuf_puts(&line_out, "{\"id\": ");
+    strbuf_put_uint(&line_out, request.id);
+    if (error) {
+        strbuf_puts(&line_out, ", \"ok\": false, \"error\": ");
+        strbuf_put_json_string(&line_out, error, strlen(error));
+    } else {
+        strbuf_puts(&line_out, ", \"ok\": true");
+        if (response.data) {
+            strbuf_append(&line_out, response.data, response.len);
+        }
+    }
+    strbuf_puts(&line_out, "}\n");
+
+    int result = 0;
+    if (line_out.failed || response.failed) {
+        result = -1;
+    } else {
+        struct {
+            char*       data;
+            uint64_t    len;
+        } parts[] = {
+            { line_out.data, line_out.len },
+            { payload, error ? 0 : payload_len },
+        };
+        for (int i = 0; i < 2 && result == 0; i++) {
+            for (uint64_t done = 0; done < parts[i].len; ) {
+                ssize_t num_written = write(fd, parts[i].data + done, parts[i].len - done);
+                if (num_written <= 0) {
+                    if (num_written == -1 && errno == EINTR) {
+                        continue;
+                    }
+                    result = -1;
+                    break;
+                }
+                done += num_written;
+            }
+        }
+    }
+
+    free(line_out.data);
+    free(response.data);
+    free(payload);
+    free_request(&request);
+    return result;
+}
+
+/**
+ * Serve requests from a client until it disconnects.
+ */
+void serve_client(int fd) {
+    char* buffer = malloc(SERVED_MAX_REQUEST_LEN + 1);
+    if (!buffer) {
+        return;
+    }
+    size_t len = 0;
+
+    while (true) {
+        ssize_t num_read = read(fd, buffer + len, SERVED_MAX_REQUEST_LEN - len);
+        if (num_read == -1 && errno == EINTR) {
+            continue;
+        }
+        if (num_read <= 0) {
+            break;
+        }
+        len += num_read;
+
+        // Handle each complete line in the buffer
+        char* line = buffer;
+        char* newline;
+        while ((newline = memchr(line, '\n', buffer + len - line))) {
+            *newline = '\0';
+            if (*skip_json_whitespace(line) != '\0' && handle_request(fd, line) != 0) {
+                goto done;
+            }
+            line = newline + 1;
+        }
+        len -= line - buffer;
+        memmove(buffer, line, len);
+
+        if (len == SERVED_MAX_REQUEST_LEN) {
+            char* error = "{\"id\": 0, \"ok\": false, \"error\": \"The request is too long.\"}\n";
+            write(fd, error, strlen(error));
+            break;
+        }
+    }
+
+done:
+    free(buffer);
+}
+
+void* worker_main(void* arg) {
+    (void)arg;
+    while (true) {
+        pthread_mutex_lock(&queue.lock);
+        while (queue.count == 0) {
+            pthread_cond_wait(&queue.not_empty, &queue.lock);
+        }
+        int fd = queue.fds[queue.head];
+        queue.head = (queue.head + 1) % SERVED_QUEUE_SIZE;
+        queue.count--;
+        pthread_cond_signal(&queue.not_full);
+        pthread_mutex_unlock(&queue.lock);
+
+        serve_client(fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+void handle_stop_signal(int signum) {
+    (void)signum;
+    stopping = 1;
+}
+
+int main(int argc, char** argv) {
+    setbuf(stdout, NULL);
+
+    // Extrapolate CLI arguments, exit if invalid
+    if (argc != 3 && argc != 4) {
+        fprintf(stderr, "Incorrect number of arguments.\n");
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    char* socket_path = argv[2];
+    unsigned int num_threads = SERVED_DEFAULT_NUM_THREADS;
+    if (argc == 4 && (sscanf(argv[3], "%u", &num_threads) != 1 || num_threads == 0)) {
+        fprintf(stderr, "%s is not a valid number of threads.\n", argv[3]);
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "The socket path `%s` is too long.\n", socket_path);
+        return 1;
+    }
+    strcpy(addr.sun_path, socket_path);
+
+    container = apfs_open(argv[1], (xid_t)(~0));
+    if (!container) {
+        return -1;
+    }
+
+    uint32_t num_volumes = apfs_num_volumes(container);
+    volumes = calloc(num_volumes ? num_volumes : 1, sizeof(apfs_volume_t*));
+    if (!volumes) {
+        fprintf(stderr, "\nABORT: Could not allocate sufficient memory for `volumes`.\n");
+        return -1;
+    }
+    for (uint32_t i = 0; i < num_volumes; i++) {
+        fprintf(stderr, "Volume %u (%s): ", i, apfs_volume_superblock(container, i)->apfs_volname);
+        volumes[i] = apfs_open_volume(container, i);
+        if (!volumes[i]) {
+            fprintf(stderr, "Requests for this volume will fail.\n");
+        }
+    }
+
+    if (!apfs_enable_node_cache(container, SERVED_NODE_CACHE_SIZE)) {
+        return -1;
+    }
+
+    // A client disconnecting mid-response must not kill the server.
+    signal(SIGPIPE, SIG_IGN);
+    struct sigaction stop_action = { .sa_handler = handle_stop_signal };
+    sigemptyset(&stop_action.sa_mask);
+    sigaction(SIGINT, &stop_action, NULL);
+    sigaction(SIGTERM, &stop_action, NULL);
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd == -1) {
+        fprintf(stderr, "\nABORT: Could not create a socket: %s.\n", strerror(errno));
+        return -1;
+    }
+    // Replace a stale socket left behind by a previous server, but nothing else.
+    struct stat st;
+    if (lstat(socket_path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(socket_path);
+    }
+    if (bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "\nABORT: Could not bind to `%s`: %s.\n", socket_path, strerror(errno));
+        return -1;
+    }
+    if (listen(listen_fd, SERVED_QUEUE_SIZE) != 0) {
+        fprintf(stderr, "\nABORT: Could not listen on `%s`: %s.\n", socket_path, strerror(errno));
+        unlink(socket_path);
+        return -1;
+    }
+
+    for (unsigned int i = 0; i < num_threads; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, worker_main, NULL) != 0) {
+            if (i == 0) {
+                fprintf(stderr, "\nABORT: Could not create any worker threads.\n");
+                unlink(socket_path);
+                return -1;
+            }
+            num_threads = i;
+            break;
+        }
+        pthread_detach(thread);
+    }
+
+    fprintf(stderr, "\nServing requests on `%s` with %u threads. Send SIGINT or SIGTERM to stop.\n", socket_path, num_threads);
+
+    while (!stopping) {
+        int client_fd = accept(listen_fd, NULL, NULL);
+        if (client_fd == -1) {
+            if (errno != EINTR && errno != ECONNABORTED) {
+                fprintf(stderr, "Could not accept a connection: %s.\n", strerror(errno));
+            }
+            continue;
+        }
+
+        pthread_mutex_lock(&queue.lock);
+        while (queue.count == SERVED_QUEUE_SIZE) {
+            pthread_cond_wait(&queue.not_full, &queue.lock);
+        }
+        queue.fds[(queue.head + queue.count) % SERVED_QUEUE_SIZE] = client_fd;
+        queue.count++;
+        pthread_cond_signal(&queue.not_empty);
+        pthread_mutex_unlock(&queue.lock);
+    }
+
+    close(listen_fd);
+    unlink(socket_path);
+
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    apfs_node_cache_stats(container, &hits, &misses);
+    fprintf(stderr, "\nStopping. Served %llu requests; the node cache had %llu hits and %llu misses.\n", num_requests, hits, misses);
+    fprintf(stderr, "END: All done.\n");
+    return 0;
+}
@@ -0,0 +1,230 @@
+#include <stdio.h>
+#include <sys/errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "apfs/io.h"
+#include "apfs/func/btree.h"
+#include "apfs/func/j.h"
+#include "apfs/func/container.h"
+#include "apfs/func/checkpoint.h"
+#include "apfs/func/node_cache.h"
+#include "apfs/func/diff.h"
+
+#include "apfs/struct/object.h"
+#include "apfs/struct/fs.h"
+#include "apfs/struct/j.h"
+
+/** Limits **/
+
+#define WATCH_DEFAULT_INTERVAL_MS   1000
+#define WATCH_NODE_CACHE_SIZE       65536       // = 256 MiB of 4 KiB nodes
+
+/**
+ * Print usage info for this program.
+ */
+void print_usage(char* program_name) {
+    fprintf(stderr, "Usage:   %s [--interval <milliseconds>] <container> <volume ID>\nExample: %s ~/vm/disk.img  0\n\n", program_name, program_name);
+    fprintf(stderr, "Watches a container that is being written to, e.g. the disk image of a running virtual\n");
+    fprintf(stderr, "machine, and each time a new checkpoint appears, lists the files of the volume that were\n");
+    fprintf(stderr, "added (A), deleted (D), or modified (M) since the previous checkpoint that was seen.\n");
+    fprintf(stderr, "The checkpoint descriptor area is polled every %u milliseconds unless otherwise given.\n\n", WATCH_DEFAULT_INTERVAL_MS);
+}
+
+/**
+ * State used while printing the differences between two checkpoints.
+ *
+ * oid:         The ID of the file-system object whose changes were last
+ *      printed, if `have_oid`.
+ */
+typedef struct {
+    diff_tree_t*    old_tree;
+    diff_tree_t*    new_tree;
+
+    bool            have_oid;
+    oid_t           oid;
+    uint64_t        num_objects;
+} watch_output_t;
+
+int print_change(void* context, diff_change_t change, diff_record_t* old_rec, diff_record_t* new_rec) {
+    watch_output_t* output = context;
+    diff_record_t* rec = new_rec ? new_rec : old_rec;
+    oid_t oid = rec->key->obj_id_and_type & OBJ_ID_MASK;
+    uint8_t type = (rec->key->obj_id_and_type & OBJ_TYPE_MASK) >> OBJ_TYPE_SHIFT;
+
+    // Changes arrive grouped by object, with the inode record first; see
+    // `print_change()` in `apfs-diff.c`.
+    if (output->have_oid && oid == output->oid) {
+        return 0;
+    }
+    output->have_oid = true;
+    output->oid = oid;
+    output->num_objects++;
+
+    char status = 'M';
+    if (type == APFS_TYPE_INODE && change != DIFF_MODIFIED) {
+        status = change == DIFF_ADDED ? 'A' : 'D';
+    }
+    diff_tree_t* tree = change == DIFF_REMOVED ? output->old_tree : output->new_tree;
+    char* path = get_fs_object_path(tree->omap_btree, tree->fs_root_btree, oid, tree->xid);
+    if (path) {
+        printf("%c  %s\n", status, path);
+        free(path);
+    } else {
+        printf("%c  (object 0x%llx)\n", status, oid);
+    }
+    return 0;
+}
+
+/**
+ * Read the root nodes of a volume's trees as of the container's currently
+ * mounted checkpoint.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value on failure.
+ */
+int open_watched_volume(container_t* container, uint32_t volume_id, diff_tree_t* tree) {
+    tree->xid = (xid_t)(~0);
+    if (volume_id >= container->num_volumes) {
+        fprintf(stderr, "Volume %u doesn't exist in the checkpoint with XID 0x%llx.\n", volume_id, container->nxsb->nx_o.o_xid);
+        return -1;
+    }
+    return open_volume(container, volume_id, &tree->omap_btree, &tree->fs_root_btree);
+}
+
+void free_watched_volume(diff_tree_t* tree) {
+    free(tree->omap_btree);
+    free(tree->fs_root_btree);
+    tree->omap_btree = NULL;
+    tree->fs_root_btree = NULL;
+}
+
+/**
+ * Determine whether a timeline still includes the checkpoint with a given XID.
+ */
+bool has_checkpoint(checkpoint_timeline_t* timeline, xid_t xid) {
+    for (uint32_t i = 0; i < timeline->num_checkpoints; i++) {
+        if (timeline->checkpoints[i].xid == xid) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char** argv) {
+    setbuf(stdout, NULL);
+
+    // Extrapolate CLI arguments, exit if invalid
+    unsigned int interval_ms = WATCH_DEFAULT_INTERVAL_MS;
+    while (argc >= 3 && strncmp(argv[1], "--", 2) == 0) {
+        if (strcmp(argv[1], "--interval") == 0) {
+            if (sscanf(argv[2], "%u", &interval_ms) != 1 || interval_ms == 0) {
+                fprintf(stderr, "%s is not a valid interval.\n", argv[2]);
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else {
+            break;
+        }
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+    }
+    if (argc != 3) {
+        fprintf(stderr, "Incorrect number of arguments.\n");
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    uint32_t volume_id;
+    if (sscanf(argv[2], "%u", &volume_id) != 1) {
+        fprintf(stderr, "%s is not a valid volume ID.\n", argv[2]);
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    container_t* container = open_container(argv[1], (xid_t)(~0));
+    if (!container) {
+        return -1;
+    }
+    checkpoint_timeline_t* timeline = get_checkpoint_timeline(container);
+    if (!timeline) {
+        close_container(container);
+        return -1;
+    }
+
+    // Nodes of the previous checkpoint's trees stay in the cache between
+    // polls, so comparing it with the next one only reads what changed.
+    if (!node_cache_enable(WATCH_NODE_CACHE_SIZE)) {
+        close_container(container);
+        return -1;
+    }
+
+    diff_tree_t old_tree = {0};
+    if (open_watched_volume(container, volume_id, &old_tree) != 0) {
+        close_container(container);
+        return -1;
+    }
+    xid_t old_xid = container->nxsb->nx_o.o_xid;
+    fprintf(stderr, "\nWatching volume %u from the checkpoint with XID 0x%llx.\n", volume_id, old_xid);
+
+    while (true) {
+        usleep(interval_ms * 1000);
+
+        uint32_t blocks_read = 0;
+        int num_new = poll_checkpoint_timeline(timeline, &blocks_read);
+        if (num_new < 0) {
+            break;
+        }
+        if (num_new == 0) {
+            continue;
+        }
+
+        // A checkpoint's blocks aren't reused while it remains in the
+        // checkpoint descriptor area. Once it's gone, cached nodes may no
+        // longer match what's on disk, and the old trees can't be trusted.
+        bool fell_behind = !has_checkpoint(timeline, old_xid);
+        if (fell_behind) {
+            node_cache_clear();
+        }
+
+        uint64_t misses_before = nx_device->node_cache->misses;
+        if (mount_checkpoint(container, timeline, 0) != 0) {
+            fprintf(stderr, "The checkpoint with XID 0x%llx is damaged or incomplete; waiting for the next one.\n", timeline->checkpoints[0].xid);
+            continue;
+        }
+        xid_t new_xid = container->nxsb->nx_o.o_xid;
+        diff_tree_t new_tree = {0};
+        if (open_watched_volume(container, volume_id, &new_tree) != 0) {
+            free_watched_volume(&new_tree);
+            continue;
+        }
+
+        if (fell_behind) {
+            printf("\nXID 0x%llx: the checkpoint with XID 0x%llx was overwritten before it could be compared; changes up to here are unknown.\n", new_xid, old_xid);
+        } else {
+            printf("\nXID 0x%llx (%d new checkpoints since 0x%llx):\n", new_xid, num_new, old_xid);
+            watch_output_t output = {
+                .old_tree = &old_tree,
+                .new_tree = &new_tree,
+            };
+            diff_stats_t stats;
+            if (diff_fs_trees(&old_tree, &new_tree, print_change, &output, &stats) != 0) {
+                fprintf(stderr, "Failed to compare the checkpoints with XIDs 0x%llx and 0x%llx.\n", old_xid, new_xid);
+            } else {
+                fprintf(stderr, "%llu objects changed. Compared %llu nodes, skipping %llu shared subtrees; read %u checkpoint descriptor blocks and %llu nodes that weren't cached.\n",
+                    output.num_objects, stats.nodes_read, stats.subtrees_skipped, blocks_read, nx_device->node_cache->misses - misses_before
+                );
+            }
+        }
+
+        free_watched_volume(&old_tree);
+        old_tree = new_tree;
+        old_xid = new_xid;
+    }
+
+    free_watched_volume(&old_tree);
+    close_container(container);
+    return -1;
+}
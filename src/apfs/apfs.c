@@ -0,0 +1,589 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/errno.h>
+#include <sys/stat.h>
+
+#include "apfs.h"
+
+#include "struct/const.h"
+#include "struct/dstream.h"
+
+#include "func/btree.h"
+#include "func/node_cache.h"
+#include "func/cksum_memo.h"
+#include "func/omap_memo.h"
+#include "func/j.h"
+#include "func/xattr.h"
+#include "func/dstream.h"
+#include "func/recover.h"
+#include "func/snapshot.h"
+
+/**
+ * device:      The container's I/O state; see `nx_device_t` in `apfs/io.h`.
+ *
+ * state:       The container's mounted state.
+ */
+struct apfs_container {
+    nx_device_t         device;
+    container_t*        state;
+};
+
+/**
+ * fs_omap_btree, fs_root_btree:    The root nodes of the volume's object map
+ *      B-tree and file-system tree.
+ *
+ * view_xid:    The XID that the volume is read as of, which is made the
+ *      calling thread's `fs_view_xid` while a function acts on the volume; `~0`
+ *      for its latest state.
+ */
+struct apfs_volume {
+    apfs_container_t*   container;
+    uint32_t            volume_id;
+    btree_node_phys_t*  fs_omap_btree;
+    btree_node_phys_t*  fs_root_btree;
+    xid_t               view_xid;
+};
+
+/**
+ * The state of the calling thread that selecting a volume replaces; see
+ * `apfs_select_volume()`.
+ */
+typedef struct {
+    nx_device_t*    device;
+    xid_t           view_xid;
+} apfs_selection_t;
+
+/** Containers **/
+
+nx_device_t* apfs_select(apfs_container_t* container) {
+    nx_device_t* previous = nx_device;
+    nx_device = &container->device;
+    return previous;
+}
+
+void apfs_deselect(nx_device_t* previous) {
+    nx_device = previous;
+}
+
+/**
+ * Make a volume's container the current container of the calling thread, and
+ * the volume's view XID its `fs_view_xid`.
+ *
+ * RETURN VALUE:
+ *      The state replaced, which must be passed to `apfs_deselect_volume()`
+ *      when done.
+ */
+apfs_selection_t apfs_select_volume(apfs_volume_t* volume) {
+    apfs_selection_t previous = {
+        .device     = apfs_select(volume->container),
+        .view_xid   = fs_view_xid,
+    };
+    fs_view_xid = volume->view_xid;
+    return previous;
+}
+
+void apfs_deselect_volume(apfs_selection_t previous) {
+    fs_view_xid = previous.view_xid;
+    apfs_deselect(previous.device);
+}
+
+/**
+ * Mount a container whose `device` has been set up, freeing the container if
+ * that fails.
+ */
+apfs_container_t* apfs_mount(apfs_container_t* container, xid_t max_xid) {
+    nx_device_t* previous = apfs_select(container);
+    container->state = load_container(max_xid);
+    if (!container->state) {
+        if (container->device.file) {
+            fclose(container->device.file);
+        }
+        free(container->device.path);
+        free(container);
+        container = NULL;
+    }
+    apfs_deselect(previous);
+    return container;
+}
+
+apfs_container_t* apfs_open(const char* path, xid_t max_xid) {
+    apfs_container_t* container = calloc(1, sizeof(apfs_container_t));
+    if (!container) {
+        fprintf(stderr, "\nABORT: apfs_open: Could not allocate sufficient memory for `container`.\n");
+        return NULL;
+    }
+    container->device.block_size = NX_DEFAULT_BLOCK_SIZE;
+    container->device.path = strdup(path);
+    if (!container->device.path) {
+        free(container);
+        return NULL;
+    }
+
+    container->device.file = fopen(path, "rb");
+    if (!container->device.file) {
+        fprintf(stderr, "\nABORT: apfs_open: Could not open `%s`: ", path);
+        report_fopen_error();
+        free(container->device.path);
+        free(container);
+        return NULL;
+    }
+    return apfs_mount(container, max_xid);
+}
+
+apfs_container_t* apfs_open_io(const char* name, nx_read_func_t read, void* context, xid_t max_xid) {
+    apfs_container_t* container = calloc(1, sizeof(apfs_container_t));
+    if (!container) {
+        fprintf(stderr, "\nABORT: apfs_open_io: Could not allocate sufficient memory for `container`.\n");
+        return NULL;
+    }
+    container->device.block_size = NX_DEFAULT_BLOCK_SIZE;
+    container->device.read = read;
+    container->device.read_context = context;
+    container->device.path = strdup(name);
+    if (!container->device.path) {
+        free(container);
+        return NULL;
+    }
+
+    return apfs_mount(container, max_xid);
+}
+
+void apfs_close(apfs_container_t* container) {
+    if (!container) {
+        return;
+    }
+    nx_device_t* previous = apfs_select(container);
+    close_container(container->state);
+    node_cache_free(container->device.node_cache);
+    cksum_memo_free(container->device.cksum_memo);
+    omap_memo_free(container->device.omap_memo);
+    apfs_deselect(previous);
+
+    free(container->device.path);
+    free(container);
+}
+
+container_t* apfs_get_container_state(apfs_container_t* container) {
+    return container->state;
+}
+
+size_t apfs_block_size(apfs_container_t* container) {
+    return container->device.block_size;
+}
+
+uint32_t apfs_num_volumes(apfs_container_t* container) {
+    return container->state->num_volumes;
+}
+
+apfs_superblock_t* apfs_volume_superblock(apfs_container_t* container, uint32_t volume_id) {
+    if (volume_id >= container->state->num_volumes) {
+        return NULL;
+    }
+    return container->state->apsbs + volume_id * container->device.block_size;
+}
+
+size_t apfs_read_blocks(apfs_container_t* container, void* buffer, long start_block, size_t num_blocks) {
+    nx_device_t* previous = apfs_select(container);
+    size_t result = read_blocks(buffer, start_block, num_blocks);
+    apfs_deselect(previous);
+    return result;
+}
+
+bool apfs_enable_node_cache(apfs_container_t* container, size_t capacity) {
+    nx_device_t* previous = apfs_select(container);
+    bool result = node_cache_enable(capacity);
+    apfs_deselect(previous);
+    return result;
+}
+
+bool apfs_node_cache_stats(apfs_container_t* container, uint64_t* hits, uint64_t* misses) {
+    node_cache_t* cache = container->device.node_cache;
+    if (!cache) {
+        return false;
+    }
+    pthread_mutex_lock(&cache->lock);
+    *hits = cache->hits;
+    *misses = cache->misses;
+    pthread_mutex_unlock(&cache->lock);
+    return true;
+}
+
+void apfs_set_cksum_policy(apfs_container_t* container, cksum_policy_t policy) {
+    container->device.cksum_policy = policy;
+}
+
+void apfs_set_decmpfs_threads(apfs_container_t* container, unsigned int num_threads) {
+    container->device.decmpfs_num_threads = num_threads;
+}
+
+/** Volumes **/
+
+apfs_volume_t* apfs_open_volume_at_xid(apfs_container_t* container, uint32_t volume_id, xid_t xid) {
+    if (volume_id >= container->state->num_volumes) {
+        return NULL;
+    }
+
+    apfs_volume_t* volume = calloc(1, sizeof(apfs_volume_t));
+    if (!volume) {
+        fprintf(stderr, "\nABORT: apfs_open_volume_at_xid: Could not allocate sufficient memory for `volume`.\n");
+        return NULL;
+    }
+    volume->container = container;
+    volume->volume_id = volume_id;
+    volume->view_xid = xid;
+
+    // `open_volume_at_xid()` sets `fs_view_xid`, which deselecting restores.
+    apfs_selection_t previous = apfs_select_volume(volume);
+    int result = xid == (xid_t)(~0)
+        ? open_volume(container->state, volume_id, &volume->fs_omap_btree, &volume->fs_root_btree)
+        : open_volume_at_xid(container->state, volume_id, xid, &volume->fs_omap_btree, &volume->fs_root_btree);
+    apfs_deselect_volume(previous);
+    if (result != 0) {
+        free(volume);
+        return NULL;
+    }
+    return volume;
+}
+
+apfs_volume_t* apfs_open_volume(apfs_container_t* container, uint32_t volume_id) {
+    return apfs_open_volume_at_xid(container, volume_id, (xid_t)(~0));
+}
+
+apfs_volume_t* apfs_open_snapshot(apfs_container_t* container, uint32_t volume_id, const char* name) {
+    if (!name || volume_id >= container->state->num_volumes) {
+        return NULL;
+    }
+    xid_t xid = 0;
+    nx_device_t* previous = apfs_select(container);
+    int result = select_volume_snapshot(container->state, volume_id, name, &xid);
+    apfs_deselect(previous);
+    return result == 0 ? apfs_open_volume_at_xid(container, volume_id, xid) : NULL;
+}
+
+void apfs_close_volume(apfs_volume_t* volume) {
+    if (!volume) {
+        return;
+    }
+    free(volume->fs_omap_btree);
+    free(volume->fs_root_btree);
+    free(volume);
+}
+
+j_rec_t** apfs_get_records(apfs_volume_t* volume, const char* path, oid_t* file_id) {
+    oid_t id = 0;
+    apfs_selection_t previous = apfs_select_volume(volume);
+    j_rec_t** fs_records = get_fs_records_for_path(volume->fs_omap_btree, volume->fs_root_btree, (char*)path, &id);
+    apfs_deselect_volume(previous);
+    if (file_id) {
+        *file_id = id;
+    }
+    return fs_records;
+}
+
+/**
+ * Get the inode value amongst a file-system object's records.
+ */
+j_inode_val_t* apfs_get_inode(j_rec_t** fs_records) {
+    j_rec_t* inode_rec = get_inode_record(fs_records);
+    return inode_rec ? inode_rec->data + inode_rec->key_len : NULL;
+}
+
+int apfs_stat(apfs_volume_t* volume, const char* path, apfs_stat_t* stat) {
+    oid_t file_id = 0;
+    j_rec_t** fs_records = apfs_get_records(volume, path, &file_id);
+    if (!fs_records) {
+        return -ENOENT;
+    }
+    j_rec_t* inode_rec = get_inode_record(fs_records);
+    if (!inode_rec) {
+        free_j_rec_array(fs_records);
+        return -EIO;
+    }
+    j_inode_val_t* val = inode_rec->data + inode_rec->key_len;
+
+    memset(stat, 0, sizeof(apfs_stat_t));
+    stat->file_id       = file_id;
+    stat->parent_id     = val->parent_id;
+    stat->mode          = val->mode;
+    stat->uid           = val->owner;
+    stat->gid           = val->group;
+    stat->nlink         = val->nlink;
+    stat->bsd_flags     = val->bsd_flags;
+    stat->create_time   = val->create_time;
+    stat->mod_time      = val->mod_time;
+    stat->change_time   = val->change_time;
+    stat->access_time   = val->access_time;
+
+    stat->compressed = get_decmpfs_xattr_record(fs_records) != NULL;
+    if (stat->compressed) {
+        stat->size = val->uncompressed_size;
+    } else {
+        j_dstream_t* dstream = get_inode_dstream(inode_rec);
+        stat->size = dstream ? dstream->size : 0;
+    }
+
+    free_j_rec_array(fs_records);
+    return 0;
+}
+
+int apfs_readlink(apfs_volume_t* volume, const char* path, char** target) {
+    j_rec_t** fs_records = apfs_get_records(volume, path, NULL);
+    if (!fs_records) {
+        return -ENOENT;
+    }
+
+    int result = 0;
+    j_inode_val_t* inode = apfs_get_inode(fs_records);
+    j_rec_t* target_rec = get_xattr_record(fs_records, SYMLINK_EA_NAME);
+    if (!inode || (inode->mode & S_IFMT) != S_IFLNK || !target_rec) {
+        result = -EINVAL;
+        goto cleanup;
+    }
+
+    uint64_t target_len = 0;
+    apfs_selection_t previous = apfs_select_volume(volume);
+    char* value = get_xattr_value(volume->fs_omap_btree, volume->fs_root_btree, target_rec, &target_len);
+    apfs_deselect_volume(previous);
+    if (!value) {
+        result = -EIO;
+        goto cleanup;
+    }
+
+    // The target is stored with a terminating NULL byte, but don't rely on it.
+    *target = strndup(value, target_len);
+    free(value);
+    if (!*target) {
+        result = -ENOMEM;
+    }
+
+cleanup:
+    free_j_rec_array(fs_records);
+    return result;
+}
+
+int apfs_list(apfs_volume_t* volume, const char* path, apfs_dirent_t** entries, size_t* num_entries) {
+    *entries = NULL;
+    *num_entries = 0;
+
+    j_rec_t** fs_records = apfs_get_records(volume, path, NULL);
+    if (!fs_records) {
+        return -ENOENT;
+    }
+
+    int result = 0;
+    j_inode_val_t* inode = apfs_get_inode(fs_records);
+    if (!inode || (inode->mode & S_IFMT) != S_IFDIR) {
+        result = -ENOTDIR;
+        goto cleanup;
+    }
+
+    size_t num_drecs = 0;
+    for (j_rec_t** fs_rec_cursor = fs_records; *fs_rec_cursor; fs_rec_cursor++) {
+        j_key_t* hdr = (*fs_rec_cursor)->data;
+        if ( ((hdr->obj_id_and_type & OBJ_TYPE_MASK) >> OBJ_TYPE_SHIFT)  ==  APFS_TYPE_DIR_REC ) {
+            num_drecs++;
+        }
+    }
+
+    *entries = calloc(num_drecs ? num_drecs : 1, sizeof(apfs_dirent_t));
+    if (!*entries) {
+        result = -ENOMEM;
+        goto cleanup;
+    }
+
+    for (j_rec_t** fs_rec_cursor = fs_records; *fs_rec_cursor; fs_rec_cursor++) {
+        j_rec_t* fs_rec = *fs_rec_cursor;
+        j_key_t* hdr = fs_rec->data;
+        if ( ((hdr->obj_id_and_type & OBJ_TYPE_MASK) >> OBJ_TYPE_SHIFT)  !=  APFS_TYPE_DIR_REC ) {
+            continue;
+        }
+
+        // Spec incorrectly says to use `j_drec_key_t`; see NOTE in `apfs/struct/j.h`
+        j_drec_hashed_key_t* key = fs_rec->data;
+        j_drec_val_t* val = fs_rec->data + fs_rec->key_len;
+
+        apfs_dirent_t* entry = *entries + *num_entries;
+        entry->name = strdup((char*)key->name);
+        if (!entry->name) {
+            apfs_free_dirents(*entries, *num_entries);
+            *entries = NULL;
+            *num_entries = 0;
+            result = -ENOMEM;
+            goto cleanup;
+        }
+        entry->file_id = val->file_id;
+        entry->type = val->flags & DREC_TYPE_MASK;
+        (*num_entries)++;
+    }
+
+cleanup:
+    free_j_rec_array(fs_records);
+    return result;
+}
+
+void apfs_free_dirents(apfs_dirent_t* entries, size_t num_entries) {
+    if (!entries) {
+        return;
+    }
+    for (size_t i = 0; i < num_entries; i++) {
+        free(entries[i].name);
+    }
+    free(entries);
+}
+
+int apfs_list_xattrs(apfs_volume_t* volume, const char* path, char*** names, size_t* num_names) {
+    *names = NULL;
+    *num_names = 0;
+
+    j_rec_t** fs_records = apfs_get_records(volume, path, NULL);
+    if (!fs_records) {
+        return -ENOENT;
+    }
+
+    size_t num_xattrs = 0;
+    for (j_rec_t** fs_rec_cursor = fs_records; *fs_rec_cursor; fs_rec_cursor++) {
+        j_key_t* hdr = (*fs_rec_cursor)->data;
+        if ( ((hdr->obj_id_and_type & OBJ_TYPE_MASK) >> OBJ_TYPE_SHIFT)  ==  APFS_TYPE_XATTR ) {
+            num_xattrs++;
+        }
+    }
+
+    int result = 0;
+    *names = calloc(num_xattrs ? num_xattrs : 1, sizeof(char*));
+    if (!*names) {
+        result = -ENOMEM;
+        goto cleanup;
+    }
+
+    for (j_rec_t** fs_rec_cursor = fs_records; *fs_rec_cursor; fs_rec_cursor++) {
+        j_key_t* hdr = (*fs_rec_cursor)->data;
+        if ( ((hdr->obj_id_and_type & OBJ_TYPE_MASK) >> OBJ_TYPE_SHIFT)  !=  APFS_TYPE_XATTR ) {
+            continue;
+        }
+
+        j_xattr_key_t* key = (*fs_rec_cursor)->data;
+        char* name = strndup((char*)key->name, key->name_len);
+        if (!name) {
+            apfs_free_xattr_names(*names, *num_names);
+            *names = NULL;
+            *num_names = 0;
+            result = -ENOMEM;
+            goto cleanup;
+        }
+        (*names)[(*num_names)++] = name;
+    }
+
+cleanup:
+    free_j_rec_array(fs_records);
+    return result;
+}
+
+void apfs_free_xattr_names(char** names, size_t num_names) {
+    if (!names) {
+        return;
+    }
+    for (size_t i = 0; i < num_names; i++) {
+        free(names[i]);
+    }
+    free(names);
+}
+
+int64_t apfs_read(apfs_volume_t* volume, const char* path, uint64_t offset, uint64_t length, void* buffer) {
+    j_rec_t** fs_records = apfs_get_records(volume, path, NULL);
+    if (!fs_records) {
+        return -ENOENT;
+    }
+
+    int64_t result = 0;
+    apfs_selection_t previous = apfs_select_volume(volume);
+
+    j_inode_val_t* inode = apfs_get_inode(fs_records);
+    if (!inode || (inode->mode & S_IFMT) != S_IFREG) {
+        result = inode && (inode->mode & S_IFMT) == S_IFDIR ? -EISDIR : -EINVAL;
+        goto cleanup;
+    }
+
+    j_rec_t* decmpfs_rec = get_decmpfs_xattr_record(fs_records);
+    if (decmpfs_rec) {
+        // Compressed data can't be read from an arbitrary offset, so
+        // decompress the whole file to a temporary file first.
+        FILE* tmp = tmpfile();
+        if (!tmp) {
+            result = -errno;
+            goto cleanup;
+        }
+        if (write_compressed_file(volume->fs_omap_btree, volume->fs_root_btree, fs_records, decmpfs_rec, tmp) < 0 || fflush(tmp) != 0) {
+            fclose(tmp);
+            result = -EIO;
+            goto cleanup;
+        }
+        struct stat st;
+        uint64_t size = fstat(fileno(tmp), &st) == 0 ? st.st_size : 0;
+        length = offset < size ? (size - offset < length ? size - offset : length) : 0;
+
+        if (length > 0 && pread(fileno(tmp), buffer, length, offset) != (ssize_t)length) {
+            result = -EIO;
+        } else {
+            result = length;
+        }
+        fclose(tmp);
+    } else {
+        file_extent_t* extents = NULL;
+        size_t num_extents = 0;
+        uint64_t size = 0;
+        if (get_file_data_extents(volume->fs_omap_btree, volume->fs_root_btree, fs_records, &extents, &num_extents, &size) != 0) {
+            result = -EIO;
+            goto cleanup;
+        }
+        length = offset < size ? (size - offset < length ? size - offset : length) : 0;
+
+        if (length > 0 && read_dstream_range(extents, num_extents, offset, length, buffer) != 0) {
+            result = -EIO;
+        } else {
+            result = length;
+        }
+        free(extents);
+    }
+
+cleanup:
+    apfs_deselect_volume(previous);
+    free_j_rec_array(fs_records);
+    return result;
+}
+
+int apfs_export(apfs_volume_t* volume, const char* path, const char* dest, apfs_export_stats_t* stats) {
+    j_rec_t** fs_records = apfs_get_records(volume, path, NULL);
+    if (!fs_records) {
+        return -ENOENT;
+    }
+
+    recovery_t recovery = {
+        .fs_omap_btree  = volume->fs_omap_btree,
+        .fs_root_btree  = volume->fs_root_btree,
+        .hard_links     = oid_map_create(0),
+    };
+    if (!recovery.hard_links) {
+        free_j_rec_array(fs_records);
+        return -ENOMEM;
+    }
+
+    apfs_selection_t previous = apfs_select_volume(volume);
+    int result = recover_fs_object(&recovery, fs_records, (char*)dest);
+    apfs_deselect_volume(previous);
+
+    if (stats) {
+        stats->num_files        = recovery.num_files;
+        stats->num_dirs         = recovery.num_dirs;
+        stats->num_symlinks     = recovery.num_symlinks;
+        stats->num_hard_links   = recovery.num_hard_links;
+        stats->num_failed       = recovery.num_failed + (result > 0 && recovery.num_failed == 0);
+        stats->bytes_cloned     = recovery.extent_index.bytes_cloned;
+        stats->bytes_copied     = recovery.extent_index.bytes_copied;
+    }
+
+    oid_map_free(recovery.hard_links, free_hard_link);
+    extent_index_free(&recovery.extent_index);
+    free_j_rec_array(fs_records);
+    return result < 0 ? -EIO : result;
+}
@@ -0,0 +1,317 @@
+/**
+ * The public interface of `libapfs`: read APFS containers through handles,
+ * without having to manage the global state that the tools in this repository
+ * use.
+ *
+ * Each `apfs_container_t` carries its own I/O backend, block size, mounted
+ * state, node cache, checksum policy, and decompression thread count, and each
+ * `apfs_volume_t` the point in time it is read as of, so a program can have
+ * many containers and volumes open at once, and use each of them from as many
+ * threads as it likes. A container is read
+ * either from a file (`apfs_open()`) or through a read function supplied by
+ * the program (`apfs_open_io()`), e.g. to read a disk image held in memory.
+ *
+ * Functions that can fail for more than one reason return a negative `errno`
+ * value on failure, e.g. `-ENOENT` if a path doesn't exist in a volume.
+ *
+ * The lower-level functions declared in `apfs/func` act upon the current
+ * container of the calling thread (see `nx_device` in `apfs/io.h`); use
+ * `apfs_select()` to call them on a container opened through this interface.
+ */
+
+#ifndef APFS_APFS_H
+#define APFS_APFS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "io.h"
+#include "struct/general.h"
+#include "struct/fs.h"
+#include "struct/j.h"
+
+#include "func/container.h"
+#include "func/cksum_memo.h"
+
+typedef struct apfs_container   apfs_container_t;
+typedef struct apfs_volume      apfs_volume_t;
+
+/**
+ * The attributes of a file-system object, as returned by `apfs_stat()`.
+ *
+ * nlink:       The number of hard links to a file, or the number of children
+ *      of a directory.
+ *
+ * size:        The logical size of a file's data, in bytes. For transparently
+ *      compressed files, this is the uncompressed size.
+ *
+ * *_time:      Timestamps, in nanoseconds since 1970-01-01 00:00:00 UTC.
+ */
+typedef struct {
+    oid_t       file_id;
+    oid_t       parent_id;
+    uint16_t    mode;
+    uint32_t    uid;
+    uint32_t    gid;
+    uint32_t    nlink;
+    uint64_t    size;
+    uint32_t    bsd_flags;
+    uint64_t    create_time;
+    uint64_t    mod_time;
+    uint64_t    change_time;
+    uint64_t    access_time;
+    bool        compressed;
+} apfs_stat_t;
+
+/**
+ * A directory entry, as returned by `apfs_list()`.
+ *
+ * type:        The type of the entry's target, as a `DT_*` value.
+ */
+typedef struct {
+    char*       name;
+    oid_t       file_id;
+    uint16_t    type;
+} apfs_dirent_t;
+
+/**
+ * Statistics on an export, as returned by `apfs_export()`.
+ */
+typedef struct {
+    uint64_t    num_files;
+    uint64_t    num_dirs;
+    uint64_t    num_symlinks;
+    uint64_t    num_hard_links;
+    uint64_t    num_failed;
+    uint64_t    bytes_cloned;
+    uint64_t    bytes_copied;
+} apfs_export_stats_t;
+
+/** Containers **/
+
+/**
+ * Open the APFS container at a given path, read-only, and simulate a mount of
+ * it, as `open_container()` does.
+ *
+ * max_xid:     The maximum XID of the checkpoint to mount; `~0` mounts the
+ *      latest checkpoint.
+ *
+ * RETURN VALUE:
+ *      A handle for the container, which must be closed with `apfs_close()`
+ *      when no longer needed; or NULL if an error occurs.
+ */
+apfs_container_t* apfs_open(const char* path, xid_t max_xid);
+
+/**
+ * Open an APFS container that is read through a given function rather than
+ * from a file, and simulate a mount of it.
+ *
+ * name:        A name for the container, used in messages.
+ *
+ * read, context:   The function used to read from the container; see
+ *      `nx_read_func_t` in `apfs/io.h`. `context` is passed to it as is, and
+ *      must remain valid until the container is closed.
+ *
+ * RETURN VALUE:
+ *      As for `apfs_open()`.
+ */
+apfs_container_t* apfs_open_io(const char* name, nx_read_func_t read, void* context, xid_t max_xid);
+
+/**
+ * Close a container, freeing everything associated with it. All of its volumes
+ * must have been closed first.
+ */
+void apfs_close(apfs_container_t* container);
+
+/**
+ * Make a container the current container of the calling thread, so that the
+ * lower-level functions declared in `apfs/func` can be called on it.
+ *
+ * RETURN VALUE:
+ *      The previously current container, which must be passed to
+ *      `apfs_deselect()` when done.
+ */
+nx_device_t* apfs_select(apfs_container_t* container);
+
+/**
+ * Restore the current container of the calling thread, as returned by
+ * `apfs_select()`.
+ */
+void apfs_deselect(nx_device_t* previous);
+
+/**
+ * Get the mounted state of a container, which includes its container
+ * superblock. It must not be modified or freed.
+ */
+container_t* apfs_get_container_state(apfs_container_t* container);
+
+size_t apfs_block_size(apfs_container_t* container);
+
+uint32_t apfs_num_volumes(apfs_container_t* container);
+
+/**
+ * Get the superblock of a given volume, which must not be modified or freed.
+ */
+apfs_superblock_t* apfs_volume_superblock(apfs_container_t* container, uint32_t volume_id);
+
+/**
+ * Read blocks from a container, as `read_blocks()` does.
+ */
+size_t apfs_read_blocks(apfs_container_t* container, void* buffer, long start_block, size_t num_blocks);
+
+/**
+ * Enable caching of B-tree nodes read from a container; see
+ * `apfs/func/node_cache.h`.
+ *
+ * capacity:    The maximum number of nodes to keep in memory.
+ *
+ * RETURN VALUE:
+ *      True on success, or false if memory could not be allocated.
+ */
+bool apfs_enable_node_cache(apfs_container_t* container, size_t capacity);
+
+/**
+ * Get statistics on a container's node cache.
+ *
+ * RETURN VALUE:
+ *      True if the node cache is enabled, else false.
+ */
+bool apfs_node_cache_stats(apfs_container_t* container, uint64_t* hits, uint64_t* misses);
+
+/**
+ * Set what to do with nodes read from a container whose checksums don't
+ * validate; see `cksum_policy_t` in `apfs/func/cksum_memo.h`. The default is
+ * `CKSUM_POLICY_DEFAULT`.
+ */
+void apfs_set_cksum_policy(apfs_container_t* container, cksum_policy_t policy);
+
+/**
+ * Set the number of threads to decompress the resource-fork chunks of files
+ * in a container with; zero, the default, means one thread per online CPU
+ * core.
+ */
+void apfs_set_decmpfs_threads(apfs_container_t* container, unsigned int num_threads);
+
+/** Volumes **/
+
+/**
+ * Open a volume in a container.
+ *
+ * RETURN VALUE:
+ *      A handle for the volume, which must be closed with `apfs_close_volume()`
+ *      when no longer needed; or NULL if the volume doesn't exist or can't be
+ *      opened, e.g. because it is encrypted.
+ */
+apfs_volume_t* apfs_open_volume(apfs_container_t* container, uint32_t volume_id);
+
+/**
+ * Open a volume in a container as of a given XID, usually that of one of its
+ * snapshots; see `open_volume_at_xid()`. Every function called on the handle
+ * reads the volume as of that XID, without affecting other handles.
+ *
+ * RETURN VALUE:
+ *      As for `apfs_open_volume()`.
+ */
+apfs_volume_t* apfs_open_volume_at_xid(apfs_container_t* container, uint32_t volume_id, xid_t xid);
+
+/**
+ * Open a volume in a container as of its snapshot with a given name.
+ *
+ * RETURN VALUE:
+ *      As for `apfs_open_volume()`; NULL if there's no such snapshot.
+ */
+apfs_volume_t* apfs_open_snapshot(apfs_container_t* container, uint32_t volume_id, const char* name);
+
+void apfs_close_volume(apfs_volume_t* volume);
+
+/**
+ * Get the records of the file-system object at a given path in a volume.
+ *
+ * file_id:     If not NULL, the object's inode number will be stored here.
+ *
+ * RETURN VALUE:
+ *      A NULL-terminated array of records, which must be freed with
+ *      `free_j_rec_array()`; or NULL if the path doesn't exist.
+ */
+j_rec_t** apfs_get_records(apfs_volume_t* volume, const char* path, oid_t* file_id);
+
+/**
+ * Get the attributes of the file-system object at a given path in a volume.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative `errno` value on failure.
+ */
+int apfs_stat(apfs_volume_t* volume, const char* path, apfs_stat_t* stat);
+
+/**
+ * Get the target of the symbolic link at a given path in a volume.
+ *
+ * target:      A pointer to the NULL-terminated target will be stored here.
+ *      It must be freed when no longer needed.
+ *
+ * RETURN VALUE:
+ *      Zero on success, `-EINVAL` if the path isn't a symbolic link, or
+ *      another negative `errno` value on failure.
+ */
+int apfs_readlink(apfs_volume_t* volume, const char* path, char** target);
+
+/**
+ * List the entries of the directory at a given path in a volume.
+ *
+ * entries:     A pointer to an array of entries will be stored here. It must
+ *      be freed with `apfs_free_dirents()` when no longer needed.
+ *
+ * num_entries: The number of entries will be stored here.
+ *
+ * RETURN VALUE:
+ *      Zero on success, `-ENOTDIR` if the path isn't a directory, or another
+ *      negative `errno` value on failure.
+ */
+int apfs_list(apfs_volume_t* volume, const char* path, apfs_dirent_t** entries, size_t* num_entries);
+
+void apfs_free_dirents(apfs_dirent_t* entries, size_t num_entries);
+
+/**
+ * List the names of the extended attributes of the file-system object at a
+ * given path in a volume.
+ *
+ * names:       A pointer to an array of names will be stored here. It must be
+ *      freed with `apfs_free_xattr_names()` when no longer needed.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative `errno` value on failure.
+ */
+int apfs_list_xattrs(apfs_volume_t* volume, const char* path, char*** names, size_t* num_names);
+
+void apfs_free_xattr_names(char** names, size_t num_names);
+
+/**
+ * Read data from the regular file at a given path in a volume. Transparently
+ * compressed files are decompressed.
+ *
+ * offset:      The offset within the file to start reading from.
+ *
+ * length:      The maximum number of bytes to read into `buffer`.
+ *
+ * RETURN VALUE:
+ *      The number of bytes read, which is less than `length` if the end of the
+ *      file was reached; `-EISDIR` or `-EINVAL` if the path isn't a regular
+ *      file; or another negative `errno` value on failure.
+ */
+int64_t apfs_read(apfs_volume_t* volume, const char* path, uint64_t offset, uint64_t length, void* buffer);
+
+/**
+ * Export the file-system object at a given path in a volume to a path on the
+ * host, as `apfs-recover` does. Directories are exported recursively.
+ *
+ * stats:       If not NULL, statistics on the export will be stored here.
+ *
+ * RETURN VALUE:
+ *      Zero on success, a positive value if some objects could not be
+ *      exported (see `stats->num_failed`), or a negative `errno` value if
+ *      nothing could be exported.
+ */
+int apfs_export(apfs_volume_t* volume, const char* path, const char* dest, apfs_export_stats_t* stats);
+
+#endif // APFS_APFS_H
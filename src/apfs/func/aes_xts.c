@@ -0,0 +1,435 @@
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "aes_xts.h"
+
+/** S-boxes **/
+
+const uint8_t aes_sbox[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16,
+};
+
+const uint8_t aes_inv_sbox[256] = {
+    0x52, 0x09, 0x6a, 0xd5, 0x30, 0x36, 0xa5, 0x38, 0xbf, 0x40, 0xa3, 0x9e, 0x81, 0xf3, 0xd7, 0xfb,
+    0x7c, 0xe3, 0x39, 0x82, 0x9b, 0x2f, 0xff, 0x87, 0x34, 0x8e, 0x43, 0x44, 0xc4, 0xde, 0xe9, 0xcb,
+    0x54, 0x7b, 0x94, 0x32, 0xa6, 0xc2, 0x23, 0x3d, 0xee, 0x4c, 0x95, 0x0b, 0x42, 0xfa, 0xc3, 0x4e,
+    0x08, 0x2e, 0xa1, 0x66, 0x28, 0xd9, 0x24, 0xb2, 0x76, 0x5b, 0xa2, 0x49, 0x6d, 0x8b, 0xd1, 0x25,
+    0x72, 0xf8, 0xf6, 0x64, 0x86, 0x68, 0x98, 0x16, 0xd4, 0xa4, 0x5c, 0xcc, 0x5d, 0x65, 0xb6, 0x92,
+    0x6c, 0x70, 0x48, 0x50, 0xfd, 0xed, 0xb9, 0xda, 0x5e, 0x15, 0x46, 0x57, 0xa7, 0x8d, 0x9d, 0x84,
+    0x90, 0xd8, 0xab, 0x00, 0x8c, 0xbc, 0xd3, 0x0a, 0xf7, 0xe4, 0x58, 0x05, 0xb8, 0xb3, 0x45, 0x06,
+    0xd0, 0x2c, 0x1e, 0x8f, 0xca, 0x3f, 0x0f, 0x02, 0xc1, 0xaf, 0xbd, 0x03, 0x01, 0x13, 0x8a, 0x6b,
+    0x3a, 0x91, 0x11, 0x41, 0x4f, 0x67, 0xdc, 0xea, 0x97, 0xf2, 0xcf, 0xce, 0xf0, 0xb4, 0xe6, 0x73,
+    0x96, 0xac, 0x74, 0x22, 0xe7, 0xad, 0x35, 0x85, 0xe2, 0xf9, 0x37, 0xe8, 0x1c, 0x75, 0xdf, 0x6e,
+    0x47, 0xf1, 0x1a, 0x71, 0x1d, 0x29, 0xc5, 0x89, 0x6f, 0xb7, 0x62, 0x0e, 0xaa, 0x18, 0xbe, 0x1b,
+    0xfc, 0x56, 0x3e, 0x4b, 0xc6, 0xd2, 0x79, 0x20, 0x9a, 0xdb, 0xc0, 0xfe, 0x78, 0xcd, 0x5a, 0xf4,
+    0x1f, 0xdd, 0xa8, 0x33, 0x88, 0x07, 0xc7, 0x31, 0xb1, 0x12, 0x10, 0x59, 0x27, 0x80, 0xec, 0x5f,
+    0x60, 0x51, 0x7f, 0xa9, 0x19, 0xb5, 0x4a, 0x0d, 0x2d, 0xe5, 0x7a, 0x9f, 0x93, 0xc9, 0x9c, 0xef,
+    0xa0, 0xe0, 0x3b, 0x4d, 0xae, 0x2a, 0xf5, 0xb0, 0xc8, 0xeb, 0xbb, 0x3c, 0x83, 0x53, 0x99, 0x61,
+    0x17, 0x2b, 0x04, 0x7e, 0xba, 0x77, 0xd6, 0x26, 0xe1, 0x69, 0x14, 0x63, 0x55, 0x21, 0x0c, 0x7d,
+};
+
+const uint8_t aes_rcon[11] = { 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36 };
+
+/**
+ * Multiply an element of GF(2^8) by x, i.e. by 2, modulo the AES polynomial.
+ */
+uint8_t aes_xtime(uint8_t a) {
+    return (a << 1) ^ ((a & 0x80) ? 0x1b : 0x00);
+}
+
+uint8_t aes_mul(uint8_t a, uint8_t b) {
+    uint8_t product = 0;
+    for (; b; b >>= 1, a = aes_xtime(a)) {
+        if (b & 1) {
+            product ^= a;
+        }
+    }
+    return product;
+}
+
+uint32_t load_le32(const uint8_t* bytes) {
+    return (uint32_t)bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+uint64_t load_le64(const uint8_t* bytes) {
+    return (uint64_t)load_le32(bytes) | (uint64_t)load_le32(bytes + 4) << 32;
+}
+
+void store_le64(uint8_t* bytes, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        bytes[i] = value >> (8 * i);
+    }
+}
+
+/**
+ * The lookup tables of the portable implementation, which combine the inverse
+ * S-box with the multiplications of the inverse MixColumns step. Each entry of
+ * `aes_dec_tables[i]` is the contribution of a byte in row `i` of the state to
+ * the column it's mixed into, with row 0 in the lowest-order bits.
+ */
+uint32_t        aes_dec_tables[4][256];
+pthread_once_t  aes_dec_tables_once = PTHREAD_ONCE_INIT;
+
+void init_aes_dec_tables() {
+    for (int x = 0; x < 256; x++) {
+        uint8_t y = aes_inv_sbox[x];
+        uint32_t word = (uint32_t)aes_mul(y, 0x0e) | (uint32_t)aes_mul(y, 0x09) << 8
+            | (uint32_t)aes_mul(y, 0x0d) << 16 | (uint32_t)aes_mul(y, 0x0b) << 24;
+        for (int i = 0; i < 4; i++) {
+            aes_dec_tables[i][x] = word;
+            word = (word << 8) | (word >> 24);
+        }
+    }
+}
+
+/**
+ * Expand an AES key into its encryption round keys, with the bytes of each
+ * round key in column order.
+ *
+ * RETURN VALUE:
+ *      The number of rounds.
+ */
+uint32_t aes_expand_key(const uint8_t* key_bytes, size_t key_len, uint8_t* round_keys) {
+    uint32_t key_words = key_len / 4;
+    uint32_t rounds = key_words + 6;
+    memcpy(round_keys, key_bytes, key_len);
+    for (uint32_t i = key_words; i < 4 * (rounds + 1); i++) {
+        uint8_t temp[4];
+        memcpy(temp, round_keys + 4 * (i - 1), 4);
+        if (i % key_words == 0) {
+            uint8_t first = temp[0];
+            temp[0] = aes_sbox[temp[1]] ^ aes_rcon[i / key_words];
+            temp[1] = aes_sbox[temp[2]];
+            temp[2] = aes_sbox[temp[3]];
+            temp[3] = aes_sbox[first];
+        } else if (key_words > 6 && i % key_words == 4) {
+            for (int j = 0; j < 4; j++) {
+                temp[j] = aes_sbox[temp[j]];
+            }
+        }
+        for (int j = 0; j < 4; j++) {
+            round_keys[4 * i + j] = round_keys[4 * (i - key_words) + j] ^ temp[j];
+        }
+    }
+    return rounds;
+}
+
+/**
+ * Apply the inverse MixColumns step to a round key, in place.
+ */
+void aes_inv_mix_columns(uint8_t* block) {
+    for (int c = 0; c < 4; c++) {
+        uint8_t* a = block + 4 * c;
+        uint8_t b0 = aes_mul(a[0], 0x0e) ^ aes_mul(a[1], 0x0b) ^ aes_mul(a[2], 0x0d) ^ aes_mul(a[3], 0x09);
+        uint8_t b1 = aes_mul(a[0], 0x09) ^ aes_mul(a[1], 0x0e) ^ aes_mul(a[2], 0x0b) ^ aes_mul(a[3], 0x0d);
+        uint8_t b2 = aes_mul(a[0], 0x0d) ^ aes_mul(a[1], 0x09) ^ aes_mul(a[2], 0x0e) ^ aes_mul(a[3], 0x0b);
+        uint8_t b3 = aes_mul(a[0], 0x0b) ^ aes_mul(a[1], 0x0d) ^ aes_mul(a[2], 0x09) ^ aes_mul(a[3], 0x0e);
+        a[0] = b0;
+        a[1] = b1;
+        a[2] = b2;
+        a[3] = b3;
+    }
+}
+
+int aes_xts_init(aes_xts_key_t* key, const uint8_t* key_bytes, size_t key_len) {
+    if (key_len != 32 && key_len != 64) {
+        return -1;
+    }
+    pthread_once(&aes_dec_tables_once, init_aes_dec_tables);
+    memset(key, 0, sizeof(aes_xts_key_t));
+
+    size_t half_len = key_len / 2;
+    uint8_t enc_keys[(AES_MAX_ROUNDS + 1) * AES_BLOCK_SIZE];
+    key->rounds = aes_expand_key(key_bytes, half_len, enc_keys);
+    aes_expand_key(key_bytes + half_len, half_len, key->tweak_keys);
+
+    // The equivalent inverse cipher uses the round keys in reverse order,
+    // with the inverse MixColumns step applied to all but the first and last.
+    for (uint32_t r = 0; r <= key->rounds; r++) {
+        uint8_t* dec_key = key->dec_keys + r * AES_BLOCK_SIZE;
+        memcpy(dec_key, enc_keys + (key->rounds - r) * AES_BLOCK_SIZE, AES_BLOCK_SIZE);
+        if (r > 0 && r < key->rounds) {
+            aes_inv_mix_columns(dec_key);
+        }
+        for (int c = 0; c < 4; c++) {
+            key->dec_words[4 * r + c] = load_le32(dec_key + 4 * c);
+        }
+    }
+    memset(enc_keys, 0, sizeof(enc_keys));
+    return 0;
+}
+
+/**
+ * Encrypt a single block with the tweak key, in place.
+ */
+void aes_encrypt_tweak_scalar(const aes_xts_key_t* key, uint8_t* block) {
+    for (int i = 0; i < AES_BLOCK_SIZE; i++) {
+        block[i] ^= key->tweak_keys[i];
+    }
+    for (uint32_t r = 1; r <= key->rounds; r++) {
+        // SubBytes and ShiftRows; byte `row` of column `c` comes from column
+        // `c + row`.
+        uint8_t state[AES_BLOCK_SIZE];
+        for (int c = 0; c < 4; c++) {
+            for (int row = 0; row < 4; row++) {
+                state[4 * c + row] = aes_sbox[block[4 * ((c + row) % 4) + row]];
+            }
+        }
+        if (r < key->rounds) {
+            for (int c = 0; c < 4; c++) {
+                uint8_t* a = state + 4 * c;
+                uint8_t all = a[0] ^ a[1] ^ a[2] ^ a[3];
+                uint8_t first = a[0];
+                a[0] ^= all ^ aes_xtime(a[0] ^ a[1]);
+                a[1] ^= all ^ aes_xtime(a[1] ^ a[2]);
+                a[2] ^= all ^ aes_xtime(a[2] ^ a[3]);
+                a[3] ^= all ^ aes_xtime(a[3] ^ first);
+            }
+        }
+        for (int i = 0; i < AES_BLOCK_SIZE; i++) {
+            block[i] = state[i] ^ key->tweak_keys[r * AES_BLOCK_SIZE + i];
+        }
+    }
+}
+
+void aes_decrypt_block_scalar(const aes_xts_key_t* key, uint8_t* block) {
+    const uint32_t* words = key->dec_words;
+    uint32_t s[4], t[4];
+    for (int c = 0; c < 4; c++) {
+        s[c] = load_le32(block + 4 * c) ^ words[c];
+    }
+    for (uint32_t r = 1; r < key->rounds; r++) {
+        // InvShiftRows: byte `row` of column `c` comes from column `c - row`.
+        for (int c = 0; c < 4; c++) {
+            t[c] = aes_dec_tables[0][s[c] & 0xff]
+                ^ aes_dec_tables[1][(s[(c + 3) % 4] >> 8) & 0xff]
+                ^ aes_dec_tables[2][(s[(c + 2) % 4] >> 16) & 0xff]
+                ^ aes_dec_tables[3][s[(c + 1) % 4] >> 24]
+                ^ words[4 * r + c];
+        }
+        memcpy(s, t, sizeof(s));
+    }
+    const uint8_t* last_key = key->dec_keys + key->rounds * AES_BLOCK_SIZE;
+    for (int c = 0; c < 4; c++) {
+        for (int row = 0; row < 4; row++) {
+            block[4 * c + row] = aes_inv_sbox[(s[(c + 4 - row) % 4] >> (8 * row)) & 0xff] ^ last_key[4 * c + row];
+        }
+    }
+}
+
+/**
+ * Compute the tweaks of the blocks of a sector from the encrypted tweak of its
+ * first block, each being the previous one multiplied by x in GF(2^128).
+ *
+ * tweaks:      The tweaks will be stored here, as `AES_XTS_SECTOR_BLOCKS`
+ *      consecutive blocks.
+ */
+void compute_sector_tweaks(const uint8_t* first_tweak, uint8_t* tweaks) {
+    uint64_t lo = load_le64(first_tweak);
+    uint64_t hi = load_le64(first_tweak + 8);
+    for (int i = 0; i < AES_XTS_SECTOR_BLOCKS; i++) {
+        store_le64(tweaks + i * AES_BLOCK_SIZE, lo);
+        store_le64(tweaks + i * AES_BLOCK_SIZE + 8, hi);
+        uint64_t carry = hi >> 63;
+        hi = (hi << 1) | (lo >> 63);
+        lo = (lo << 1) ^ (carry ? 0x87 : 0);
+    }
+}
+
+void aes_xts_decrypt_scalar(const aes_xts_key_t* key, uint8_t* data, size_t num_sectors, uint64_t sector) {
+    uint8_t tweaks[AES_XTS_SECTOR_SIZE];
+    for (size_t i = 0; i < num_sectors; i++, sector++, data += AES_XTS_SECTOR_SIZE) {
+        uint8_t first_tweak[AES_BLOCK_SIZE] = {0};
+        store_le64(first_tweak, sector);
+        aes_encrypt_tweak_scalar(key, first_tweak);
+        compute_sector_tweaks(first_tweak, tweaks);
+
+        for (int j = 0; j < AES_XTS_SECTOR_SIZE; j++) {
+            data[j] ^= tweaks[j];
+        }
+        for (int j = 0; j < AES_XTS_SECTOR_BLOCKS; j++) {
+            aes_decrypt_block_scalar(key, data + j * AES_BLOCK_SIZE);
+        }
+        for (int j = 0; j < AES_XTS_SECTOR_SIZE; j++) {
+            data[j] ^= tweaks[j];
+        }
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#define AESNI_PARALLEL_BLOCKS   8
+
+__attribute__((target("aes,sse2")))
+__m128i aes_encrypt_tweak_aesni(const aes_xts_key_t* key, uint64_t sector) {
+    const __m128i* keys = (const __m128i*)key->tweak_keys;
+    __m128i block = _mm_xor_si128(_mm_set_epi64x(0, sector), _mm_load_si128(keys));
+    for (uint32_t r = 1; r < key->rounds; r++) {
+        block = _mm_aesenc_si128(block, _mm_load_si128(keys + r));
+    }
+    return _mm_aesenclast_si128(block, _mm_load_si128(keys + key->rounds));
+}
+
+/**
+ * As for `compute_sector_tweaks()`, but starting from the encrypted tweak in a
+ * register. Each 32-bit lane is shifted by one bit, taking the top bit of the
+ * lane below it; the top bit of the whole tweak is reduced into the lowest
+ * byte as 0x87.
+ */
+__attribute__((target("sse2")))
+void compute_sector_tweaks_sse2(__m128i tweak, uint8_t* tweaks) {
+    const __m128i carry_mask = _mm_set_epi32(1, 1, 1, 0x87);
+    for (int i = 0; i < AES_XTS_SECTOR_BLOCKS; i++) {
+        _mm_store_si128((__m128i*)(tweaks + i * AES_BLOCK_SIZE), tweak);
+        __m128i carries = _mm_shuffle_epi32(_mm_srai_epi32(tweak, 31), 0x93);
+        tweak = _mm_xor_si128(_mm_slli_epi32(tweak, 1), _mm_and_si128(carries, carry_mask));
+    }
+}
+
+__attribute__((target("aes,sse2")))
+void aes_xts_decrypt_aesni(const aes_xts_key_t* key, uint8_t* data, size_t num_sectors, uint64_t sector) {
+    const __m128i* keys = (const __m128i*)key->dec_keys;
+    uint32_t rounds = key->rounds;
+    uint8_t tweaks[AES_XTS_SECTOR_SIZE] __attribute__((aligned(16)));
+
+    for (size_t i = 0; i < num_sectors; i++, sector++, data += AES_XTS_SECTOR_SIZE) {
+        compute_sector_tweaks_sse2(aes_encrypt_tweak_aesni(key, sector), tweaks);
+
+        // Interleave the blocks, so that each round's instructions for one
+        // block overlap with those for the others. The blocks are spelled out
+        // rather than looped over, so that they stay in registers.
+        for (int j = 0; j < AES_XTS_SECTOR_BLOCKS; j += AESNI_PARALLEL_BLOCKS) {
+            __m128i* blocks = (__m128i*)(data + j * AES_BLOCK_SIZE);
+            const __m128i* t = (const __m128i*)(tweaks + j * AES_BLOCK_SIZE);
+            __m128i round_key = _mm_load_si128(keys);
+            __m128i x0 = _mm_xor_si128(_mm_xor_si128(_mm_loadu_si128(blocks + 0), t[0]), round_key);
+            __m128i x1 = _mm_xor_si128(_mm_xor_si128(_mm_loadu_si128(blocks + 1), t[1]), round_key);
+            __m128i x2 = _mm_xor_si128(_mm_xor_si128(_mm_loadu_si128(blocks + 2), t[2]), round_key);
+            __m128i x3 = _mm_xor_si128(_mm_xor_si128(_mm_loadu_si128(blocks + 3), t[3]), round_key);
+            __m128i x4 = _mm_xor_si128(_mm_xor_si128(_mm_loadu_si128(blocks + 4), t[4]), round_key);
+            __m128i x5 = _mm_xor_si128(_mm_xor_si128(_mm_loadu_si128(blocks + 5), t[5]), round_key);
+            __m128i x6 = _mm_xor_si128(_mm_xor_si128(_mm_loadu_si128(blocks + 6), t[6]), round_key);
+            __m128i x7 = _mm_xor_si128(_mm_xor_si128(_mm_loadu_si128(blocks + 7), t[7]), round_key);
+            for (uint32_t r = 1; r < rounds; r++) {
+                round_key = _mm_load_si128(keys + r);
+                x0 = _mm_aesdec_si128(x0, round_key);
+                x1 = _mm_aesdec_si128(x1, round_key);
+                x2 = _mm_aesdec_si128(x2, round_key);
+                x3 = _mm_aesdec_si128(x3, round_key);
+                x4 = _mm_aesdec_si128(x4, round_key);
+                x5 = _mm_aesdec_si128(x5, round_key);
+                x6 = _mm_aesdec_si128(x6, round_key);
+                x7 = _mm_aesdec_si128(x7, round_key);
+            }
+            round_key = _mm_load_si128(keys + rounds);
+            _mm_storeu_si128(blocks + 0, _mm_xor_si128(_mm_aesdeclast_si128(x0, round_key), t[0]));
+            _mm_storeu_si128(blocks + 1, _mm_xor_si128(_mm_aesdeclast_si128(x1, round_key), t[1]));
+            _mm_storeu_si128(blocks + 2, _mm_xor_si128(_mm_aesdeclast_si128(x2, round_key), t[2]));
+            _mm_storeu_si128(blocks + 3, _mm_xor_si128(_mm_aesdeclast_si128(x3, round_key), t[3]));
+            _mm_storeu_si128(blocks + 4, _mm_xor_si128(_mm_aesdeclast_si128(x4, round_key), t[4]));
+            _mm_storeu_si128(blocks + 5, _mm_xor_si128(_mm_aesdeclast_si128(x5, round_key), t[5]));
+            _mm_storeu_si128(blocks + 6, _mm_xor_si128(_mm_aesdeclast_si128(x6, round_key), t[6]));
+            _mm_storeu_si128(blocks + 7, _mm_xor_si128(_mm_aesdeclast_si128(x7, round_key), t[7]));
+        }
+    }
+}
+
+
+__attribute__((target("vaes,avx512f,aes,sse2")))
+void aes_xts_decrypt_vaes(const aes_xts_key_t* key, uint8_t* data, size_t num_sectors, uint64_t sector) {
+    uint32_t rounds = key->rounds;
+    __m512i keys[AES_MAX_ROUNDS + 1];
+    for (uint32_t r = 0; r <= rounds; r++) {
+        keys[r] = _mm512_broadcast_i32x4(_mm_load_si128((const __m128i*)(key->dec_keys + r * AES_BLOCK_SIZE)));
+    }
+    uint8_t tweaks[AES_XTS_SECTOR_SIZE] __attribute__((aligned(64)));
+
+    for (size_t i = 0; i < num_sectors; i++, sector++, data += AES_XTS_SECTOR_SIZE) {
+        compute_sector_tweaks_sse2(aes_encrypt_tweak_aesni(key, sector), tweaks);
+
+        // As for `aes_xts_decrypt_aesni()`, the registers are spelled out.
+        __m512i t0 = _mm512_load_si512(tweaks + 0 * 64);
+        __m512i t1 = _mm512_load_si512(tweaks + 1 * 64);
+        __m512i t2 = _mm512_load_si512(tweaks + 2 * 64);
+        __m512i t3 = _mm512_load_si512(tweaks + 3 * 64);
+        __m512i t4 = _mm512_load_si512(tweaks + 4 * 64);
+        __m512i t5 = _mm512_load_si512(tweaks + 5 * 64);
+        __m512i t6 = _mm512_load_si512(tweaks + 6 * 64);
+        __m512i t7 = _mm512_load_si512(tweaks + 7 * 64);
+        __m512i x0 = _mm512_xor_si512(_mm512_xor_si512(_mm512_loadu_si512(data + 0 * 64), t0), keys[0]);
+        __m512i x1 = _mm512_xor_si512(_mm512_xor_si512(_mm512_loadu_si512(data + 1 * 64), t1), keys[0]);
+        __m512i x2 = _mm512_xor_si512(_mm512_xor_si512(_mm512_loadu_si512(data + 2 * 64), t2), keys[0]);
+        __m512i x3 = _mm512_xor_si512(_mm512_xor_si512(_mm512_loadu_si512(data + 3 * 64), t3), keys[0]);
+        __m512i x4 = _mm512_xor_si512(_mm512_xor_si512(_mm512_loadu_si512(data + 4 * 64), t4), keys[0]);
+        __m512i x5 = _mm512_xor_si512(_mm512_xor_si512(_mm512_loadu_si512(data + 5 * 64), t5), keys[0]);
+        __m512i x6 = _mm512_xor_si512(_mm512_xor_si512(_mm512_loadu_si512(data + 6 * 64), t6), keys[0]);
+        __m512i x7 = _mm512_xor_si512(_mm512_xor_si512(_mm512_loadu_si512(data + 7 * 64), t7), keys[0]);
+        for (uint32_t r = 1; r < rounds; r++) {
+            x0 = _mm512_aesdec_epi128(x0, keys[r]);
+            x1 = _mm512_aesdec_epi128(x1, keys[r]);
+            x2 = _mm512_aesdec_epi128(x2, keys[r]);
+            x3 = _mm512_aesdec_epi128(x3, keys[r]);
+            x4 = _mm512_aesdec_epi128(x4, keys[r]);
+            x5 = _mm512_aesdec_epi128(x5, keys[r]);
+            x6 = _mm512_aesdec_epi128(x6, keys[r]);
+            x7 = _mm512_aesdec_epi128(x7, keys[r]);
+        }
+        _mm512_storeu_si512(data + 0 * 64, _mm512_xor_si512(_mm512_aesdeclast_epi128(x0, keys[rounds]), t0));
+        _mm512_storeu_si512(data + 1 * 64, _mm512_xor_si512(_mm512_aesdeclast_epi128(x1, keys[rounds]), t1));
+        _mm512_storeu_si512(data + 2 * 64, _mm512_xor_si512(_mm512_aesdeclast_epi128(x2, keys[rounds]), t2));
+        _mm512_storeu_si512(data + 3 * 64, _mm512_xor_si512(_mm512_aesdeclast_epi128(x3, keys[rounds]), t3));
+        _mm512_storeu_si512(data + 4 * 64, _mm512_xor_si512(_mm512_aesdeclast_epi128(x4, keys[rounds]), t4));
+        _mm512_storeu_si512(data + 5 * 64, _mm512_xor_si512(_mm512_aesdeclast_epi128(x5, keys[rounds]), t5));
+        _mm512_storeu_si512(data + 6 * 64, _mm512_xor_si512(_mm512_aesdeclast_epi128(x6, keys[rounds]), t6));
+        _mm512_storeu_si512(data + 7 * 64, _mm512_xor_si512(_mm512_aesdeclast_epi128(x7, keys[rounds]), t7));
+    }
+}
+
+#endif // x86
+
+aes_xts_decrypt_func_t  aes_xts_decrypt_func = aes_xts_decrypt_scalar;
+const char*             aes_xts_decrypt_name = "scalar";
+pthread_once_t          aes_xts_decrypt_once = PTHREAD_ONCE_INIT;
+
+void select_aes_xts_decrypt_func() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("vaes") && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("aes")) {
+        aes_xts_decrypt_func = aes_xts_decrypt_vaes;
+        aes_xts_decrypt_name = "vaes";
+    } else if (__builtin_cpu_supports("aes") && __builtin_cpu_supports("sse2")) {
+        aes_xts_decrypt_func = aes_xts_decrypt_aesni;
+        aes_xts_decrypt_name = "aesni";
+    }
+#endif
+}
+
+aes_xts_decrypt_func_t get_aes_xts_decrypt_func(const char** name) {
+    pthread_once(&aes_xts_decrypt_once, select_aes_xts_decrypt_func);
+    if (name) {
+        *name = aes_xts_decrypt_name;
+    }
+    return aes_xts_decrypt_func;
+}
+
+void aes_xts_decrypt(const aes_xts_key_t* key, void* data, size_t length, uint64_t sector) {
+    get_aes_xts_decrypt_func(NULL)(key, data, length / AES_XTS_SECTOR_SIZE, sector);
+}
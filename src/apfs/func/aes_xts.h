@@ -0,0 +1,113 @@
+/**
+ * Functions used to decrypt data encrypted with AES-XTS, as APFS does for the
+ * metadata and file data of encrypted volumes (see `apfs/func/crypto.h`).
+ *
+ * XTS encrypts each 512-byte sector separately, under a tweak derived from the
+ * sector's number; APFS numbers sectors from the start of the container for
+ * metadata, and from an extent's `crypto_id` for file data. The key is twice as
+ * long as the AES key it's used with: the first half decrypts the data, and
+ * the second half encrypts the tweaks.
+ *
+ * Sectors are independent of each other, and so are the AES blocks within one
+ * once their tweaks are known, so the CPU-specific implementations decrypt
+ * many blocks at once, keeping the AES units of the CPU busy; a portable one,
+ * using lookup tables, is used on other CPUs.
+ */
+
+#ifndef APFS_FUNC_AES_XTS_H
+#define APFS_FUNC_AES_XTS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+/** AES-XTS constants **/
+
+#define AES_BLOCK_SIZE          16
+#define AES_MAX_ROUNDS          14      // For 256-bit keys
+#define AES_XTS_SECTOR_SIZE     512
+#define AES_XTS_SECTOR_BLOCKS   (AES_XTS_SECTOR_SIZE / AES_BLOCK_SIZE)
+
+/**
+ * An expanded AES-XTS key.
+ *
+ * rounds:          10 for AES-128, or 14 for AES-256.
+ *
+ * dec_keys:        The round keys used to decrypt data, in the order used by
+ *      the equivalent inverse cipher, i.e. as the `aesdec` instruction expects.
+ *
+ * dec_words:       The same round keys as words, with the first byte of each
+ *      column in the lowest-order bits, for the portable implementation.
+ *
+ * tweak_keys:      The round keys used to encrypt the tweaks.
+ */
+typedef struct nx_aes_xts_key {
+    uint32_t    rounds;
+    uint8_t     dec_keys[(AES_MAX_ROUNDS + 1) * AES_BLOCK_SIZE] __attribute__((aligned(16)));
+    uint32_t    dec_words[(AES_MAX_ROUNDS + 1) * 4];
+    uint8_t     tweak_keys[(AES_MAX_ROUNDS + 1) * AES_BLOCK_SIZE] __attribute__((aligned(16)));
+} aes_xts_key_t;
+
+/**
+ * Expand an AES-XTS key.
+ *
+ * key_bytes:   The key; 32 bytes for AES-128, as APFS uses, or 64 bytes for
+ *      AES-256.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value if the key length isn't valid.
+ */
+int aes_xts_init(aes_xts_key_t* key, const uint8_t* key_bytes, size_t key_len);
+
+/**
+ * Decrypt a single AES block in place with the first half of an AES-XTS key,
+ * without any tweak; e.g. to unwrap keys (see `apfs/func/keybag.h`).
+ */
+void aes_decrypt_block_scalar(const aes_xts_key_t* key, uint8_t* block);
+
+/**
+ * A function that decrypts consecutive sectors in place.
+ *
+ * sector:      The number of the first sector, from which its tweak is derived;
+ *      each following sector's number is one more.
+ */
+typedef void (*aes_xts_decrypt_func_t)(const aes_xts_key_t* key, uint8_t* data, size_t num_sectors, uint64_t sector);
+
+/**
+ * Portable implementation of `aes_xts_decrypt_func_t`.
+ */
+void aes_xts_decrypt_scalar(const aes_xts_key_t* key, uint8_t* data, size_t num_sectors, uint64_t sector);
+
+#if defined(__x86_64__) || defined(__i386__)
+/**
+ * Implementations of `aes_xts_decrypt_func_t` using AES-NI, which decrypts
+ * 8 blocks at a time, and VAES, which decrypts a whole sector at a time in
+ * eight 512-bit registers of four blocks each. These may only be called if the
+ * CPU supports the corresponding instruction set.
+ */
+void aes_xts_decrypt_aesni(const aes_xts_key_t* key, uint8_t* data, size_t num_sectors, uint64_t sector);
+void aes_xts_decrypt_vaes(const aes_xts_key_t* key, uint8_t* data, size_t num_sectors, uint64_t sector);
+#endif
+
+/**
+ * Get the fastest implementation of `aes_xts_decrypt_func_t` that the CPU
+ * supports, as determined (once) at runtime.
+ *
+ * name:    If not NULL, the name of the implementation (e.g. "aesni") will be
+ *      stored here.
+ */
+aes_xts_decrypt_func_t get_aes_xts_decrypt_func(const char** name);
+
+/**
+ * Decrypt data in place, using the fastest implementation available.
+ *
+ * length:      The length of the data, in bytes; a multiple of
+ *      `AES_XTS_SECTOR_SIZE`.
+ *
+ * sector:      The number of the first sector of the data.
+ */
+void aes_xts_decrypt(const aes_xts_key_t* key, void* data, size_t length, uint64_t sector);
+
+#endif // APFS_FUNC_AES_XTS_H
@@ -0,0 +1,338 @@
+#include <unistd.h>
+
+#include "block_index.h"
+
+/**
+ * A sort key for one of the secondary sort orders of an index; `pos` is the
+ * position of the record in address order, which breaks ties.
+ */
+typedef struct {
+    uint64_t    primary;
+    uint64_t    secondary;
+    uint64_t    pos;
+} block_index_sort_key_t;
+
+int compare_scan_records(const void* a, const void* b) {
+    paddr_t addr_a = ((const scan_record_t*)a)->addr;
+    paddr_t addr_b = ((const scan_record_t*)b)->addr;
+    return (addr_a > addr_b) - (addr_a < addr_b);
+}
+
+int compare_block_index_sort_keys(const void* a, const void* b) {
+    const block_index_sort_key_t* key_a = a;
+    const block_index_sort_key_t* key_b = b;
+    if (key_a->primary != key_b->primary) {
+        return key_a->primary < key_b->primary ? -1 : 1;
+    }
+    if (key_a->secondary != key_b->secondary) {
+        return key_a->secondary < key_b->secondary ? -1 : 1;
+    }
+    return (key_a->pos > key_b->pos) - (key_a->pos < key_b->pos);
+}
+
+/**
+ * Write the positions of the records in a given secondary sort order.
+ *
+ * by_oid:      If true, sort by OID then XID; else, sort by XID.
+ */
+bool write_block_index_order(FILE* file, scan_record_t* records, uint64_t num_records, block_index_sort_key_t* keys, bool by_oid) {
+    for (uint64_t i = 0; i < num_records; i++) {
+        keys[i].primary     = by_oid ? records[i].oid : records[i].xid;
+        keys[i].secondary   = by_oid ? records[i].xid : 0;
+        keys[i].pos         = i;
+    }
+    qsort(keys, num_records, sizeof(block_index_sort_key_t), compare_block_index_sort_keys);
+
+    // Reuse the start of `keys` for the positions, which can't overtake the
+    // keys they're read from.
+    uint64_t* positions = (uint64_t*)keys;
+    for (uint64_t i = 0; i < num_records; i++) {
+        positions[i] = keys[i].pos;
+    }
+    return fwrite(positions, sizeof(uint64_t), num_records, file) == num_records;
+}
+
+int block_index_write(const char* path, scan_index_header_t* scan_header, scan_record_t* records, uint64_t num_records) {
+    int result = -1;
+    char* tmp_path = malloc(strlen(path) + 32);
+    block_index_sort_key_t* keys = malloc((num_records ? num_records : 1) * sizeof(block_index_sort_key_t));
+    FILE* file = NULL;
+    if (!tmp_path || !keys) {
+        fprintf(stderr, "\nABORT: block_index_write: Could not allocate sufficient memory for `keys`.\n");
+        goto cleanup;
+    }
+
+    qsort(records, num_records, sizeof(scan_record_t), compare_scan_records);
+
+    block_index_header_t header = {
+        .magic          = BLOCK_INDEX_MAGIC,
+        .version        = BLOCK_INDEX_VERSION,
+        .block_size     = scan_header->block_size,
+        .record_size    = sizeof(scan_record_t),
+        .start_addr     = scan_header->start_addr,
+        .end_addr       = scan_header->end_addr,
+        .num_records    = num_records,
+        .scan_flags     = scan_header->flags,
+    };
+    header.records_offset   = sizeof(block_index_header_t);
+    header.by_oid_offset    = header.records_offset + num_records * sizeof(scan_record_t);
+    header.by_xid_offset    = header.by_oid_offset + num_records * sizeof(uint64_t);
+
+    sprintf(tmp_path, "%s.%ld", path, (long)getpid());
+    file = fopen(tmp_path, "wb");
+    if (!file) {
+        fprintf(stderr, "\nABORT: block_index_write: Could not create `%s`.\n", tmp_path);
+        goto cleanup;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(records, sizeof(scan_record_t), num_records, file) == num_records
+        && write_block_index_order(file, records, num_records, keys, true)
+        && write_block_index_order(file, records, num_records, keys, false);
+    ok = (fclose(file) == 0) && ok;
+    if (!ok || rename(tmp_path, path) != 0) {
+        fprintf(stderr, "\nABORT: block_index_write: Failed to write `%s`.\n", path);
+        unlink(tmp_path);
+        goto cleanup;
+    }
+    result = 0;
+
+cleanup:
+    free(keys);
+    free(tmp_path);
+    return result;
+}
+
+int read_scan_records(const char* path, scan_index_header_t* scan_header, scan_record_t** records, uint64_t* num_records) {
+    *records = NULL;
+    *num_records = 0;
+
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "\nABORT: read_scan_records: Could not open `%s`.\n", path);
+        return -1;
+    }
+
+    int result = -1;
+    struct stat st;
+    if (fread(scan_header, sizeof(scan_index_header_t), 1, file) != 1
+        || scan_header->magic != SCAN_INDEX_MAGIC
+        || scan_header->version != SCAN_INDEX_VERSION
+        || scan_header->record_size != sizeof(scan_record_t)
+        || fstat(fileno(file), &st) != 0
+    ) {
+        fprintf(stderr, "\nABORT: read_scan_records: `%s` isn't a scan written by this version of `apfs-scan`.\n", path);
+        goto cleanup;
+    }
+
+    // A scan that was interrupted may end with a partial record, which we
+    // ignore.
+    uint64_t max_records = (st.st_size - sizeof(scan_index_header_t)) / sizeof(scan_record_t);
+    *records = malloc((max_records ? max_records : 1) * sizeof(scan_record_t));
+    if (!*records) {
+        fprintf(stderr, "\nABORT: read_scan_records: Could not allocate sufficient memory for `records`.\n");
+        goto cleanup;
+    }
+    *num_records = fread(*records, sizeof(scan_record_t), max_records, file);
+    result = 0;
+
+cleanup:
+    fclose(file);
+    return result;
+}
+
+/**
+ * Determine whether an array of `count` elements of `elem_size` bytes, starting
+ * at byte `offset` of an index file of `file_size` bytes, lies within it. The
+ * values come from the file, so this is done without any sum or product that
+ * could overflow.
+ */
+bool block_index_array_fits(uint64_t file_size, uint64_t offset, uint64_t count, uint64_t elem_size) {
+    return offset <= file_size && count <= (file_size - offset) / elem_size;
+}
+
+block_index_t* block_index_open(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        fprintf(stderr, "\nABORT: block_index_open: Could not open `%s`.\n", path);
+        return NULL;
+    }
+
+    block_index_t* index = calloc(1, sizeof(block_index_t));
+    struct stat st;
+    if (!index || fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(block_index_header_t)) {
+        goto onError;
+    }
+    index->map_size = st.st_size;
+    index->map = mmap(NULL, index->map_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (index->map == MAP_FAILED) {
+        index->map = NULL;
+        goto onError;
+    }
+
+    block_index_header_t* header = index->map;
+    uint64_t num_records = header->num_records;
+    if (header->magic != BLOCK_INDEX_MAGIC
+        || header->version != BLOCK_INDEX_VERSION
+        || header->record_size != sizeof(scan_record_t)
+        || !block_index_array_fits(index->map_size, header->records_offset, num_records, sizeof(scan_record_t))
+        || !block_index_array_fits(index->map_size, header->by_oid_offset, num_records, sizeof(uint64_t))
+        || !block_index_array_fits(index->map_size, header->by_xid_offset, num_records, sizeof(uint64_t))
+        || (header->records_offset | header->by_oid_offset | header->by_xid_offset) % 8 != 0
+    ) {
+        goto onError;
+    }
+    index->header   = header;
+    index->records  = (scan_record_t*)((char*)index->map + header->records_offset);
+    index->by_oid   = (uint64_t*)((char*)index->map + header->by_oid_offset);
+    index->by_xid   = (uint64_t*)((char*)index->map + header->by_xid_offset);
+
+    // Queries use the positions in the sort orders without checking them.
+    for (uint64_t i = 0; i < num_records; i++) {
+        if (index->by_oid[i] >= num_records || index->by_xid[i] >= num_records) {
+            goto onError;
+        }
+    }
+
+    close(fd);
+    return index;
+
+onError:
+    fprintf(stderr, "\nABORT: block_index_open: `%s` isn't a valid index file.\n", path);
+    block_index_close(index);
+    close(fd);
+    return NULL;
+}
+
+void block_index_close(block_index_t* index) {
+    if (!index) {
+        return;
+    }
+    if (index->map) {
+        munmap(index->map, index->map_size);
+    }
+    free(index);
+}
+
+scan_record_t* block_index_get(block_index_t* index, paddr_t addr) {
+    uint64_t lo = 0;
+    uint64_t hi = index->header->num_records;
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (index->records[mid].addr < addr) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo < index->header->num_records && index->records[lo].addr == addr) {
+        return index->records + lo;
+    }
+    return NULL;
+}
+
+/**
+ * Find the first entry of `index->by_oid` whose record has an OID and XID of at
+ * least the given ones.
+ */
+uint64_t block_index_lower_bound_oid(block_index_t* index, oid_t oid, xid_t xid) {
+    uint64_t lo = 0;
+    uint64_t hi = index->header->num_records;
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        scan_record_t* record = index->records + index->by_oid[mid];
+        if (record->oid < oid || (record->oid == oid && record->xid < xid)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/**
+ * Find the first entry of `index->by_xid` whose record has an XID of at least
+ * the given one.
+ */
+uint64_t block_index_lower_bound_xid(block_index_t* index, xid_t xid) {
+    uint64_t lo = 0;
+    uint64_t hi = index->header->num_records;
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (index->records[index->by_xid[mid]].xid < xid) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+bool block_index_matches(block_index_query_t* query, scan_record_t* record) {
+    return (!query->type        || (record->type & OBJECT_TYPE_MASK) == query->type)
+        && (!query->subtype     || record->subtype == query->subtype)
+        && (record->flags & query->flags) == query->flags
+        && (!query->oid         || record->oid == query->oid)
+        && record->xid >= query->min_xid
+        && (!query->max_xid     || record->xid <= query->max_xid)
+        && record->addr >= query->min_addr
+        && (!query->max_addr    || record->addr <= query->max_addr);
+}
+
+uint64_t block_index_query(block_index_t* index, block_index_query_t* query, bool (*callback)(void* context, scan_record_t* record), void* context) {
+    uint64_t num_records = index->header->num_records;
+    uint64_t num_matches = 0;
+
+    if (query->oid) {
+        for (uint64_t i = block_index_lower_bound_oid(index, query->oid, query->min_xid); i < num_records; i++) {
+            scan_record_t* record = index->records + index->by_oid[i];
+            if (record->oid != query->oid || (query->max_xid && record->xid > query->max_xid)) {
+                break;
+            }
+            if (block_index_matches(query, record)) {
+                num_matches++;
+                if (!callback(context, record)) {
+                    break;
+                }
+            }
+        }
+    } else if (query->min_xid) {
+        for (uint64_t i = block_index_lower_bound_xid(index, query->min_xid); i < num_records; i++) {
+            scan_record_t* record = index->records + index->by_xid[i];
+            if (query->max_xid && record->xid > query->max_xid) {
+                break;
+            }
+            if (block_index_matches(query, record)) {
+                num_matches++;
+                if (!callback(context, record)) {
+                    break;
+                }
+            }
+        }
+    } else {
+        // Find the first record in the address range, as `block_index_get()`
+        // does.
+        uint64_t lo = 0;
+        uint64_t hi = num_records;
+        while (lo < hi) {
+            uint64_t mid = lo + (hi - lo) / 2;
+            if (index->records[mid].addr < query->min_addr) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        for (uint64_t i = lo; i < num_records; i++) {
+            scan_record_t* record = index->records + i;
+            if (query->max_addr && record->addr > query->max_addr) {
+                break;
+            }
+            if (block_index_matches(query, record)) {
+                num_matches++;
+                if (!callback(context, record)) {
+                    break;
+                }
+            }
+        }
+    }
+    return num_matches;
+}
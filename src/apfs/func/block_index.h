@@ -0,0 +1,171 @@
+/**
+ * A persistent index of the objects in a container, built from a scan (see
+ * `apfs/func/scan.h`), which can be memory-mapped and queried by binary search
+ * without reading the container again.
+ *
+ * An index file consists of a `block_index_header_t`, followed by:
+ *
+ * - the `scan_record_t`s of all objects found, sorted by address;
+ *
+ * - the positions of those records (as `uint64_t`s) sorted by OID, then XID,
+ *      then address;
+ *
+ * - the positions of those records sorted by XID, then address.
+ *
+ * Index files use native byte order, and all offsets are multiples of 8 bytes,
+ * so that the mapped file can be used in place.
+ */
+
+#ifndef APFS_FUNC_BLOCK_INDEX_H
+#define APFS_FUNC_BLOCK_INDEX_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../struct/general.h"
+#include "../struct/object.h"
+#include "../struct/btree.h"
+
+#include "scan.h"
+
+/** Index file constants **/
+
+#define BLOCK_INDEX_MAGIC       0x49425041  // = 'APBI' when read as bytes
+#define BLOCK_INDEX_VERSION     2
+
+/**
+ * The header of an index file.
+ *
+ * start_addr, end_addr, scan_flags:    The range of blocks that was scanned,
+ *      and the `flags` of the scan; see `scan_index_header_t`. If
+ *      `SCAN_INDEX_FREE_ONLY` is set in `scan_flags`, blocks in the range
+ *      that have no record may still hold objects.
+ *
+ * records_offset, by_oid_offset, by_xid_offset:    The offsets, in bytes from
+ *      the start of the file, of the records and of the two arrays of
+ *      positions. Each array has `num_records` entries.
+ */
+typedef struct {
+    uint32_t    magic;
+    uint32_t    version;
+    uint32_t    block_size;
+    uint32_t    record_size;
+    paddr_t     start_addr;
+    paddr_t     end_addr;
+    uint64_t    num_records;
+    uint64_t    records_offset;
+    uint64_t    by_oid_offset;
+    uint64_t    by_xid_offset;
+    uint32_t    scan_flags;
+    uint32_t    reserved;
+} block_index_header_t;
+
+/**
+ * An index file that has been opened for querying.
+ */
+typedef struct {
+    void*                   map;
+    size_t                  map_size;
+    block_index_header_t*   header;
+    scan_record_t*          records;
+    uint64_t*               by_oid;
+    uint64_t*               by_xid;
+} block_index_t;
+
+/**
+ * Criteria for `block_index_query()`. Zeroed fields match anything, so a
+ * query is typically set up with a designated initializer, e.g.
+ * `{ .type = OBJECT_TYPE_BTREE_NODE, .subtype = OBJECT_TYPE_FSTREE, .flags = BTNODE_LEAF, .min_xid = n }`
+ * for the file-system tree leaf nodes with an XID of at least `n`.
+ *
+ * type:        An object type, as in `o_type & OBJECT_TYPE_MASK`.
+ *
+ * subtype:     An object subtype, as in `o_subtype`.
+ *
+ * flags:       B-tree node flags, all of which must be set.
+ *
+ * oid:         An OID.
+ *
+ * min_xid, max_xid:    The range of XIDs to match, inclusive; a `max_xid` of
+ *      zero means no upper bound.
+ *
+ * min_addr, max_addr:  The range of addresses to match, inclusive; a
+ *      `max_addr` of zero means no upper bound.
+ */
+typedef struct {
+    uint32_t    type;
+    uint32_t    subtype;
+    uint16_t    flags;
+    oid_t       oid;
+    xid_t       min_xid;
+    xid_t       max_xid;
+    paddr_t     min_addr;
+    paddr_t     max_addr;
+} block_index_query_t;
+
+/**
+ * Sort a scan's records and write them to an index file. The file is written
+ * under a temporary name and then renamed, so that readers never see a
+ * partially written index.
+ *
+ * records:     The records, which will be sorted by address in place.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value on failure.
+ */
+int block_index_write(const char* path, scan_index_header_t* scan_header, scan_record_t* records, uint64_t num_records);
+
+/**
+ * Read the records of a scan, as written by `apfs-scan`.
+ *
+ * scan_header: The header of the scan will be stored here.
+ *
+ * records:     A pointer to an array of records will be stored here. It must be
+ *      freed when no longer needed.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value on failure.
+ */
+int read_scan_records(const char* path, scan_index_header_t* scan_header, scan_record_t** records, uint64_t* num_records);
+
+/**
+ * Open and memory-map an index file, checking that it is well-formed, and
+ * that every position in its sort orders refers to one of its records.
+ *
+ * RETURN VALUE:
+ *      A pointer to the index, which must be closed with `block_index_close()`
+ *      when no longer needed; or NULL if an error occurs.
+ */
+block_index_t* block_index_open(const char* path);
+
+void block_index_close(block_index_t* index);
+
+/**
+ * Get the record of the object at a given address.
+ *
+ * RETURN VALUE:
+ *      A pointer to the record, or NULL if the index has no object at that
+ *      address.
+ */
+scan_record_t* block_index_get(block_index_t* index, paddr_t addr);
+
+/**
+ * Find the records of the objects that match given criteria, using whichever
+ * of the index's sort orders narrows the search the most.
+ *
+ * callback:    Called on each matching record: in order of XID if an OID or a
+ *      minimum XID was given, else in order of address. Returning false stops
+ *      the query.
+ *
+ * RETURN VALUE:
+ *      The number of records that were passed to `callback`.
+ */
+uint64_t block_index_query(block_index_t* index, block_index_query_t* query, bool (*callback)(void* context, scan_record_t* record), void* context);
+
+#endif // APFS_FUNC_BLOCK_INDEX_H
@@ -0,0 +1,37 @@
+#include "boolean.h"
+
+bool is_physical(obj_phys_t* obj) {
+    return (obj->o_type & OBJ_STORAGETYPE_MASK) == OBJ_PHYSICAL;
+}
+
+bool is_ephemeral(obj_phys_t* obj) {
+    return (obj->o_type & OBJ_STORAGETYPE_MASK) == OBJ_EPHEMERAL;
+}
+
+bool is_virtual(obj_phys_t* obj) {
+    return (obj->o_type & OBJ_STORAGETYPE_MASK) == OBJ_VIRTUAL;
+}
+
+bool is_nx_superblock(obj_phys_t* obj) {
+    return (obj->o_type & OBJECT_TYPE_MASK) == OBJECT_TYPE_NX_SUPERBLOCK;
+}
+
+bool is_checkpoint_map_phys(obj_phys_t* obj) {
+    return (obj->o_type & OBJECT_TYPE_MASK) == OBJECT_TYPE_CHECKPOINT_MAP;
+}
+
+bool is_btree_node_phys_root(obj_phys_t* obj) {
+    return (obj->o_type & OBJECT_TYPE_MASK) == OBJECT_TYPE_BTREE;
+}
+
+bool is_btree_node_phys_non_root(obj_phys_t* obj) {
+    return (obj->o_type & OBJECT_TYPE_MASK) == OBJECT_TYPE_BTREE_NODE;
+}
+
+bool is_btree_node_phys(obj_phys_t* obj) {
+    return is_btree_node_phys_root(obj) || is_btree_node_phys_non_root(obj);
+}
+
+bool is_fs_tree(obj_phys_t* obj) {
+    return obj->o_subtype == OBJECT_TYPE_FSTREE;
+}
@@ -11,68 +11,50 @@
 /**
  * Determine whether a given APFS object is of the Physical storage type.
  */
-bool is_physical(obj_phys_t* obj) {
-    return (obj->o_type & OBJ_STORAGETYPE_MASK) == OBJ_PHYSICAL;
-}
+bool is_physical(obj_phys_t* obj);
 
 /**
  * Determine whether a given APFS object is of the Ephemeral storage type.
  */
-bool is_ephemeral(obj_phys_t* obj) {
-    return (obj->o_type & OBJ_STORAGETYPE_MASK) == OBJ_EPHEMERAL;
-}
+bool is_ephemeral(obj_phys_t* obj);
 
 /**
  * Determine whether a given APFS object is of the Virtual storage type.
  */
-bool is_virtual(obj_phys_t* obj) {
-    return (obj->o_type & OBJ_STORAGETYPE_MASK) == OBJ_VIRTUAL;
-}
+bool is_virtual(obj_phys_t* obj);
 
 /**
  * Determine whether a given APFS block is a container superblock based on the
  * type flag in its header.
  */
-bool is_nx_superblock(obj_phys_t* obj) {
-    return (obj->o_type & OBJECT_TYPE_MASK) == OBJECT_TYPE_NX_SUPERBLOCK;
-}
+bool is_nx_superblock(obj_phys_t* obj);
 
 /**
  * Determine whether a given APFS block is a checkpoint mapping block based on
  * the type flag in its header.
  */
-bool is_checkpoint_map_phys(obj_phys_t* obj) {
-    return (obj->o_type & OBJECT_TYPE_MASK) == OBJECT_TYPE_CHECKPOINT_MAP;
-}
+bool is_checkpoint_map_phys(obj_phys_t* obj);
 
 /**
  * Determine whether a given APFS object is the root node of a B-tree.
  */
-bool is_btree_node_phys_root(obj_phys_t* obj) {
-    return (obj->o_type & OBJECT_TYPE_MASK) == OBJECT_TYPE_BTREE;
-}
+bool is_btree_node_phys_root(obj_phys_t* obj);
 
 /**
  * Determine whether a given APFS object is a non-root node of a B-tree.
  */
-bool is_btree_node_phys_non_root(obj_phys_t* obj) {
-    return (obj->o_type & OBJECT_TYPE_MASK) == OBJECT_TYPE_BTREE_NODE;
-}
+bool is_btree_node_phys_non_root(obj_phys_t* obj);
 
 /**
  * Determine whether a given APFS object is a B-tree node (regardless of
  * whether it is a root node or otherwise).
  */
-bool is_btree_node_phys(obj_phys_t* obj) {
-    return is_btree_node_phys_root(obj) || is_btree_node_phys_non_root(obj);
-}
+bool is_btree_node_phys(obj_phys_t* obj);
 
 /**
  * Determine whether a given APFS object has the subtype corresponding to a
  * file-system records tree.
  */
-bool is_fs_tree(obj_phys_t* obj) {
-    return obj->o_subtype == OBJECT_TYPE_FSTREE;
-}
+bool is_fs_tree(obj_phys_t* obj);
 
 #endif // APFS_FUNC_BOOLEAN_H
@@ -0,0 +1,424 @@
+#include "btree.h"
+
+__thread xid_t fs_view_xid = (xid_t)(~0);
+
+omap_val_t* get_btree_phys_omap_val(btree_node_phys_t* root_node, oid_t oid, xid_t max_xid) {
+    return get_btree_phys_omap_version(root_node, oid, max_xid, NULL);
+}
+
+omap_val_t* get_btree_phys_omap_version(btree_node_phys_t* root_node, oid_t oid, xid_t max_xid, xid_t* version_xid) {
+    omap_val_t* return_val = malloc(sizeof(omap_val_t));
+    if (!return_val) {
+        fprintf(stderr, "\nABORT: get_btree_phys_omap_version: Could not allocate sufficient memory for `return_val`.\n");
+        return NULL;
+    }
+    if (omap_memo_get(root_node, oid, max_xid, return_val, version_xid)) {
+        if (return_val->ov_flags & OMAP_VAL_DELETED) {
+            free(return_val);
+            return NULL;
+        }
+        return return_val;
+    }
+
+    // Create a copy of the root node to use as the current node we're working with
+    btree_node_phys_t* node = malloc(nx_device->block_size);
+    if (!node) {
+        fprintf(stderr, "\nABORT: get_btree_phys_omap_version: Could not allocate sufficient memory for `node`.\n");
+        goto onError;
+    }
+    memcpy(node, root_node, nx_device->block_size);
+
+    // Pointers to areas of the node
+    char* toc_start = (char*)(node->btn_data) + node->btn_table_space.off;
+    char* key_start = toc_start + node->btn_table_space.len;
+    char* val_end   = (char*)node + nx_device->block_size - sizeof(btree_info_t);
+
+    // Descend the B-tree to find the target key–value pair
+    while (true) {
+        if (!(node->btn_flags & BTNODE_FIXED_KV_SIZE)) {
+            fprintf(stderr, "\nget_btree_phys_omap_version: Object map B-trees don't have variable size keys and values ... do they?\n");
+            goto onError;
+        }
+
+        // TOC entries are instances of `kvoff_t`. Keys are sorted by OID and
+        // then by XID, so binary search for the last TOC entry whose key
+        // doesn't exceed (`oid`, `max_xid`); `lo` is then its index plus one.
+        kvoff_t* toc = (kvoff_t*)toc_start;
+        uint32_t lo = 0;
+        uint32_t hi = node->btn_nkeys;
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            omap_key_t* key = (omap_key_t*)(key_start + toc[mid].k);
+            if (key->ok_oid < oid || (key->ok_oid == oid && key->ok_xid <= max_xid)) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+
+        // If there is no such entry, then the desired (OID, XID) pair
+        // does not exist in this B-tree.
+        if (lo == 0) {
+            goto onError;
+        }
+        kvoff_t* toc_entry = toc + lo - 1;
+        omap_key_t* key = (omap_key_t*)(key_start + toc_entry->k);
+
+        // If this is a leaf node, return the object map value
+        if (node->btn_flags & BTNODE_LEAF) {
+            // If the object doesn't have the specified OID, then no sufficient
+            // object with that OID exists in the B-tree.
+            if (key->ok_oid != oid) {
+                goto onError;
+            }
+            memcpy(return_val, val_end - toc_entry->v, sizeof(omap_val_t));
+
+            // This version remains the latest one until the next version of
+            // the object, if it's in this node. If it isn't, the next version
+            // may still be at the start of the next leaf node, so the range
+            // that can be remembered ends at `max_xid`.
+            xid_t range_end = max_xid;
+            if (lo < node->btn_nkeys) {
+                omap_key_t* next_key = (omap_key_t*)(key_start + toc[lo].k);
+                range_end = next_key->ok_oid == oid ? next_key->ok_xid - 1 : (xid_t)(~0);
+            }
+            omap_memo_put(root_node, oid, key->ok_xid, range_end, return_val);
+            if (version_xid) {
+                *version_xid = key->ok_xid;
+            }
+
+            free(node);
+            if (return_val->ov_flags & OMAP_VAL_DELETED) {
+                free(return_val);
+                return NULL;
+            }
+            return return_val;
+        }
+
+        // Else, read the corresponding child node into memory and loop
+        paddr_t child_node_addr = *(paddr_t*)(val_end - toc_entry->v);
+        size_t result;
+        if ((result = read_node(node, child_node_addr)) != 1) {
+            fprintf(stderr, "ABORT: get_btree_phys_omap_version: Failed to read block 0x%llx (%i).\n", child_node_addr, (int)result);
+            goto onError;
+        }
+
+        if (!verify_node(node, child_node_addr)) {
+            fprintf(stderr, "WARNING: get_btree_phys_omap_version: Checksum of node at block 0x%llx did not validate.\n", child_node_addr);
+            goto onError;
+        }
+
+        toc_start = (char*)(node->btn_data) + node->btn_table_space.off;
+        key_start = toc_start + node->btn_table_space.len;
+        val_end   = (char*)node + nx_device->block_size;    // Always dealing with non-root node here
+    }
+
+onError:
+    free(return_val);
+    free(node);
+    return NULL;
+}
+
+void free_j_rec_array(j_rec_t** records_array) {
+    if (!records_array) {
+        return;
+    }
+
+    for (j_rec_t** cursor = records_array; *cursor; cursor++) {
+        free(*cursor);
+    }
+    free(records_array);
+}
+
+paddr_t get_fs_tree_child_addr(btree_node_phys_t* vol_omap_root_node, oid_t oid, xid_t max_xid) {
+    if (!vol_omap_root_node) {
+        return oid;
+    }
+
+    if (max_xid > fs_view_xid) {
+        max_xid = fs_view_xid;
+    }
+    omap_val_t* omap_val = get_btree_phys_omap_val(vol_omap_root_node, oid, max_xid);
+    if (!omap_val) {
+        return 0;
+    }
+    paddr_t addr = omap_val->ov_paddr;
+    free(omap_val);
+    return addr;
+}
+
+j_rec_t** get_fs_records(btree_node_phys_t* vol_omap_root_node, btree_node_phys_t* vol_fs_root_node, oid_t oid, xid_t max_xid) {
+    /**
+     * `desc_path` describes the path we have taken to descend down the file-
+     * system root tree. The value of `desc_path[i]` is the index of the key
+     * chosen `i` levels beneath the root level, out of the keys within the
+     * node that key was chosen from.
+     *
+     * Since these B+ trees do not container pointers to their siblings, this
+     * info is needed in order to easily walk the tree after we find the first
+     * record with the given OID.
+     */
+    uint32_t desc_path[vol_fs_root_node->btn_level + 1];
+    uint16_t i = 0;     // `i` keeps tracks of how many descents we've made from the root node.
+    btree_node_phys_t* node = NULL;
+    j_rec_t** records = NULL;
+    btree_info_t* bt_info = NULL;
+
+    // Initialise the array of records which will be returned to the caller
+    size_t num_records = 0;
+    records = malloc(sizeof(j_rec_t*));
+    if (!records) {
+        fprintf(stderr, "\nABORT: get_fs_records: Could not allocate sufficient memory for `records`.\n");
+        goto onFatal;
+    }
+    records[0] = NULL;
+
+    // Create a copy of the root node to use as the current node we're working with
+    node = malloc(nx_device->block_size);
+    if (!node) {
+        fprintf(stderr, "\nABORT: get_fs_records: Could not allocate sufficient memory for `node`.\n");
+        goto onFatal;
+    }
+    memcpy(node, vol_fs_root_node, nx_device->block_size);
+
+    // Pointers to areas of the node
+    char* toc_start = (char*)(node->btn_data) + node->btn_table_space.off;
+    char* key_start = toc_start + node->btn_table_space.len;
+    char* val_end   = (char*)node + nx_device->block_size - sizeof(btree_info_t);
+
+    // We may need access to the B-tree info after discarding our copy of the root node
+    bt_info = malloc(sizeof(btree_info_t));
+    if (!bt_info) {
+        fprintf(stderr, "\nABORT: get_fs_records: Could not allocate sufficient memory for `bt_info`.\n");
+        goto onFatal;
+    }
+    memcpy(bt_info, val_end, sizeof(btree_info_t));
+
+    // Find the first (leftmost/least) record in the tree with the given OID
+    while (true) {
+        if (node->btn_flags & BTNODE_FIXED_KV_SIZE) {
+            fprintf(stderr, "\nget_fs_records: File-system root B-trees don't have fixed size keys and values ... do they?\n");
+            goto onFatal;
+        }
+
+        // TOC entries are instances of `kvloc_t`
+        kvloc_t* toc_entry = toc_start;
+
+        // Determine which entry in this node we should descend
+        for (desc_path[i] = 0;    desc_path[i] < node->btn_nkeys;    desc_path[i]++, toc_entry++) {
+            j_key_t* key = key_start + toc_entry->k.off;
+            oid_t record_oid = key->obj_id_and_type & OBJ_ID_MASK;
+
+            if (record_oid == oid) {
+                if (node->btn_flags & BTNODE_LEAF) {
+                    // This is the first entry in this leaf node with the given
+                    // OID, and thus the first record in the whole tree with
+                    // the given OID
+                    break;
+                }
+
+                // A record with the given OID may exist as a descendant of the
+                // previous entry; backtrack so we descend that entry ...
+                if (desc_path[i] != 0) {
+                    desc_path[i]--;
+                    toc_entry--;
+                }
+                // ... unless this is the first entry in the node, in which
+                // case, backtracking is impossible, and this is the entry we
+                // should descend
+                break;
+            }
+
+            if (record_oid > oid) {
+                if (node->btn_flags & BTNODE_LEAF) {
+                    // If a record with the given OID exists in this leaf node,
+                    // we would've encountered it by now. Hence, this leaf node
+                    // contains no entries with the given OID, and so no record
+                    // with the given OID exists in the whole tree
+                    goto onFatal;
+                }
+
+                // We just passed the entry we want to descend; backtrack
+                desc_path[i]--;
+                toc_entry--;
+                break;
+            }
+        }
+
+        // `toc_entry` now points to the correct entry to descend; or
+        // it points before `toc_start` if no records with the
+        // desired OID exist in this B-tree.
+        if ((char*)toc_entry < toc_start) {
+            goto onFatal;
+        }
+
+        // If this is a leaf node, then it contains the first record with the
+        // given OID, and `desc_path` desribes the path taken to reach this
+        // node. Break from the while-loop so that we can walk along the tree
+        // to get the rest of the records with the given OID.
+        if (node->btn_flags & BTNODE_LEAF) {
+            break;
+        }
+
+        if (desc_path[i] >= node->btn_nkeys) {
+            desc_path[i]--;
+            toc_entry--;
+        }
+
+        // Else, read the corresponding child node into memory and loop
+        oid_t* child_node_virt_oid = val_end - toc_entry->v.off;
+        paddr_t child_node_addr = get_fs_tree_child_addr(vol_omap_root_node, *child_node_virt_oid, max_xid);
+        if (!child_node_addr) {
+            fprintf(stderr, "get_fs_records: Need to descend to node with Virtual OID 0x%llx, but the file-system object map lists no objects with this Virtual OID.\n", *child_node_virt_oid);
+            goto onFatal;
+        }
+        
+        if (read_node(node, child_node_addr) != 1) {
+            fprintf(stderr, "ERROR: get_fs_records: Failed to read block 0x%llx.\n", child_node_addr);
+            goto onFatal;
+        }
+
+        if (!verify_node(node, child_node_addr)) {
+            fprintf(stderr, "\nABORT: get_fs_records:%i Checksum of node at block 0x%llx did not validate.\n", __LINE__, child_node_addr);
+            goto onFatal;
+        }
+
+        toc_start = (char*)(node->btn_data) + node->btn_table_space.off;
+        key_start = toc_start + node->btn_table_space.len;
+        val_end   = (char*)node + nx_device->block_size;    // Always dealing with non-root node here
+
+        i++;
+    }
+
+    /*
+     * Now that we've found the first record with the given OID, walk along the
+     * tree to get the rest of the records with that OID.
+     * 
+     * We do so by following `desc_path`, which describes the path to the the
+     * next leaf-node entry in order, and then adjusting the values in
+     * `desc_path` so that our next descent from the root takes us to the next
+     * unvisited leaf-node entry in order.
+     * 
+     * TODO: This procedure could be optimised by walking along leaf nodes
+     * directly rather than making a new descent from the root just to find the
+     * sibling of an entry in a leaf node --- HINT: make `desc_path` one entry
+     * shorter
+     */
+    while (true) {
+        // Reset current node and pointers to the root node
+        memcpy(node, vol_fs_root_node, nx_device->block_size);
+        toc_start = (char*)(node->btn_data) + node->btn_table_space.off;
+        key_start = toc_start + node->btn_table_space.len;
+        val_end   = (char*)node + nx_device->block_size - sizeof(btree_info_t);
+
+        for (i = 0; i <= vol_fs_root_node->btn_level; i++) {
+
+            if (node->btn_flags & BTNODE_FIXED_KV_SIZE) {
+                fprintf(stderr, "\nget_fs_records: File-system root B-trees don't have fixed size keys and values ... do they?\n");
+                goto onFatal;
+            }
+
+            if (desc_path[i] >= node->btn_nkeys) {
+                // We've already gone through the last entry in this node.
+
+                if (node->btn_flags & BTNODE_ROOT) {
+                    // We've gone through the whole tree; return the results
+                    free(node);
+                    free(bt_info);
+                    return records;
+                }
+                
+                // Prep `desc_path` to take us to the leftmost descendant of
+                // this node's sibling; then break from this for-loop so that
+                // we loop inside the while-loop, i.e. make a new descent from
+                // the root.
+                desc_path[i - 1]++;
+                for (uint16_t j = i; j <= vol_fs_root_node->btn_level; j++) {
+                    desc_path[j] = 0;
+                }
+                break;
+            }
+
+            // TOC entries are instances of `kvloc_t`; look at the entry
+            // described by `desc_path`
+            kvloc_t* toc_entry = (kvloc_t*)toc_start + desc_path[i];
+
+            // If this is a leaf node, we have the next
+            // record; add it to the records array
+            if (node->btn_flags & BTNODE_LEAF) {
+                j_key_t* key = key_start + toc_entry->k.off;
+                oid_t record_oid = key->obj_id_and_type & OBJ_ID_MASK;
+
+                if (record_oid != oid) {
+                    // This record doesn't have the right OID, so we must have
+                    // found all of the relevant records; return the results
+                    free(bt_info);
+                    free(node);
+                    return records;
+                }
+
+                char* val = val_end - toc_entry->v.off;
+
+                records[num_records] = malloc(sizeof(j_rec_t) + toc_entry->k.len + toc_entry->v.len);
+                if (!records[num_records]) {
+                    fprintf(stderr, "\nABORT: get_fs_records: Could not allocate sufficient memory for `records[%lu]`.\n", num_records);
+                    goto onFatal;
+                }
+                
+                records[num_records]->key_len = toc_entry->k.len;
+                records[num_records]->val_len = toc_entry->v.len;
+                memcpy(
+                    records[num_records]->data,
+                    key,
+                    records[num_records]->key_len
+                );
+                memcpy(
+                    records[num_records]->data + records[num_records]->key_len,
+                    val,
+                    records[num_records]->val_len
+                );
+
+                num_records++;
+                records = realloc(records, (num_records + 1) * sizeof(j_rec_t*));
+                if (!records) {
+                    fprintf(stderr, "\nABORT: get_fs_records: Could not allocate sufficient memory for `records`.\n");
+                    goto onFatal;
+                }
+                records[num_records] = NULL;
+
+                // Prep `desc_path` for the next descent from the root node,
+                // then actually start the next descent from the root node.
+                desc_path[i]++;
+                break;
+            }
+
+            // Else, read the corresponding child node into memory and loop
+            oid_t* child_node_virt_oid = val_end - toc_entry->v.off;
+            paddr_t child_node_addr = get_fs_tree_child_addr(vol_omap_root_node, *child_node_virt_oid, max_xid);
+            if (!child_node_addr) {
+                fprintf(stderr, "get_fs_records: Need to descend to node with Virtual OID 0x%llx, but the file-system object map lists no objects with this Virtual OID.\n", *child_node_virt_oid);
+                goto onFatal;
+            }
+            
+            if (read_node(node, child_node_addr) != 1) {
+                fprintf(stderr, "\nABORT: get_fs_records: Failed to read block 0x%llx.\n", child_node_addr);
+                goto onFatal;
+            }
+
+            if (!verify_node(node, child_node_addr)) {
+                fprintf(stderr, "\nABORT: get_fs_records:%i Checksum of node at block 0x%llx did not validate.\n", __LINE__, child_node_addr);
+                goto onFatal;
+            }
+
+            toc_start = (char*)(node->btn_data) + node->btn_table_space.off;
+            key_start = toc_start + node->btn_table_space.len;
+            val_end   = (char*)node + nx_device->block_size;    // Always dealing with non-root node here
+        }
+    }
+
+onFatal:
+    free(bt_info);
+    free(node);
+    free_j_rec_array(records);
+    return NULL;
+}
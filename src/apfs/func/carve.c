@@ -0,0 +1,929 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include "carve.h"
+
+/**
+ * A record gathered from a leaf node, as held in memory and in sorted runs.
+ *
+ * xid:         The XID of the leaf node that the record was found in.
+ *
+ * data:        The record's key, followed by its value.
+ */
+typedef struct {
+    xid_t       xid;
+    uint16_t    key_len;
+    uint16_t    val_len;
+    uint32_t    reserved;
+    char        data[];
+} carve_rec_t;
+
+/**
+ * The state of the sort phase of carving.
+ *
+ * arena:       Memory in which records are gathered until they are sorted and
+ *      spilled to a run.
+ *
+ * recs:        Pointers to the records in `arena`, which are what get sorted.
+ *
+ * runs:        Temporary files holding sorted runs of records, in which each
+ *      key appears at most once.
+ */
+typedef struct {
+    char*           arena;
+    size_t          arena_size;
+    size_t          arena_used;
+    carve_rec_t**   recs;
+    size_t          max_recs;
+    size_t          num_recs;
+    FILE*           runs[CARVE_MAX_RUNS];
+    size_t          num_runs;
+    carve_stats_t*  stats;
+} carve_sort_t;
+
+/**
+ * A cursor over a sorted run, used when merging runs.
+ */
+typedef struct {
+    FILE*           file;
+    carve_rec_t*    rec;
+    size_t          capacity;
+} carve_cursor_t;
+
+/**
+ * The state of packing records (or, for index nodes, keys and child addresses)
+ * into the nodes of the rebuilt tree, which are written to `fd`.
+ *
+ * toc, keys, vals, val_offsets:    The entries of the node being filled, which
+ *      is laid out when it is written, once its number of entries is known.
+ *      `val_offsets[i]` is the offset of the `i`th value within `vals`.
+ */
+typedef struct {
+    int         fd;
+    uint64_t    num_nodes;
+    uint16_t    level;
+    xid_t       xid;
+
+    uint32_t    nkeys;
+    kvloc_t*    toc;
+    char*       keys;
+    size_t      keys_len;
+    char*       vals;
+    size_t      vals_len;
+    uint16_t*   val_offsets;
+    char*       node;
+
+    uint32_t    longest_key;
+    uint32_t    longest_val;
+    uint64_t    key_count;
+} carve_packer_t;
+
+#define CARVE_ALIGN(len)    (((len) + 7) & ~(size_t)7)
+
+/**
+ * Create a temporary file in `$TMPDIR` (or `/tmp`), which is deleted as soon
+ * as it is closed.
+ */
+FILE* carve_tmpfile() {
+    const char* dir = getenv("TMPDIR");
+    if (!dir || !*dir) {
+        dir = "/tmp";
+    }
+    char* path = malloc(strlen(dir) + 32);
+    if (!path) {
+        return NULL;
+    }
+    sprintf(path, "%s/apfs-carve.XXXXXX", dir);
+    int fd = mkstemp(path);
+    if (fd == -1) {
+        fprintf(stderr, "\nABORT: carve_tmpfile: Could not create a temporary file in `%s`.\n", dir);
+        free(path);
+        return NULL;
+    }
+    unlink(path);
+    free(path);
+
+    FILE* file = fdopen(fd, "w+b");
+    if (!file) {
+        close(fd);
+    }
+    return file;
+}
+
+/**
+ * Compare two records by key, and then by XID, highest first, so that the
+ * first of the records with a given key is the one to keep.
+ */
+int compare_carve_recs(carve_rec_t* rec1, carve_rec_t* rec2) {
+    int result = compare_j_keys((j_key_t*)rec1->data, rec1->key_len, (j_key_t*)rec2->data, rec2->key_len);
+    if (result != 0) {
+        return result;
+    }
+    return (rec1->xid < rec2->xid) - (rec1->xid > rec2->xid);
+}
+
+int compare_carve_rec_ptrs(const void* a, const void* b) {
+    return compare_carve_recs(*(carve_rec_t**)a, *(carve_rec_t**)b);
+}
+
+int compare_paddrs(const void* a, const void* b) {
+    paddr_t addr1 = *(const paddr_t*)a;
+    paddr_t addr2 = *(const paddr_t*)b;
+    return (addr1 > addr2) - (addr1 < addr2);
+}
+
+bool write_carve_rec(FILE* file, carve_rec_t* rec) {
+    return fwrite(rec, sizeof(carve_rec_t) + rec->key_len + rec->val_len, 1, file) == 1;
+}
+
+/**
+ * Read the next record of a run into a cursor.
+ *
+ * RETURN VALUE:
+ *      True if a record was read, or false at the end of the run or if an
+ *      error occurs, in which case `cursor->rec` is NULL.
+ */
+bool carve_cursor_next(carve_cursor_t* cursor) {
+    carve_rec_t header;
+    if (fread(&header, sizeof(carve_rec_t), 1, cursor->file) != 1) {
+        cursor->rec = NULL;
+        return false;
+    }
+    size_t size = sizeof(carve_rec_t) + header.key_len + header.val_len;
+    if (size > cursor->capacity) {
+        carve_rec_t* grown = realloc(cursor->rec, size);
+        if (!grown) {
+            free(cursor->rec);
+            cursor->rec = NULL;
+            cursor->capacity = 0;
+            return false;
+        }
+        cursor->rec = grown;
+        cursor->capacity = size;
+    } else if (!cursor->rec) {
+        cursor->rec = malloc(cursor->capacity);
+        if (!cursor->rec) {
+            return false;
+        }
+    }
+    memcpy(cursor->rec, &header, sizeof(carve_rec_t));
+    if (fread(cursor->rec->data, header.key_len + header.val_len, 1, cursor->file) != 1 && header.key_len + header.val_len > 0) {
+        free(cursor->rec);
+        cursor->rec = NULL;
+        cursor->capacity = 0;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Restore the heap property of a heap of cursors, ordered by their current
+ * records, from a given position downwards.
+ */
+void sift_carve_cursors(carve_cursor_t** heap, size_t heap_size, size_t pos) {
+    while (true) {
+        size_t least = pos;
+        size_t left = 2 * pos + 1;
+        size_t right = left + 1;
+        if (left < heap_size && compare_carve_recs(heap[left]->rec, heap[least]->rec) < 0) {
+            least = left;
+        }
+        if (right < heap_size && compare_carve_recs(heap[right]->rec, heap[least]->rec) < 0) {
+            least = right;
+        }
+        if (least == pos) {
+            return;
+        }
+        carve_cursor_t* tmp = heap[pos];
+        heap[pos] = heap[least];
+        heap[least] = tmp;
+        pos = least;
+    }
+}
+
+/**
+ * Merge sorted runs, passing each distinct key's first record (i.e. the one
+ * with the highest XID) to `emit`, in order of key. The runs are closed.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value if an error occurs or `emit`
+ *      returns false.
+ */
+int merge_carve_runs(FILE** runs, size_t num_runs, bool (*emit)(void* context, carve_rec_t* rec), void* context) {
+    int result = -1;
+    carve_cursor_t cursors[CARVE_MAX_RUNS + 1];
+    carve_cursor_t* heap[CARVE_MAX_RUNS + 1];
+    size_t heap_size = 0;
+    carve_rec_t* last = NULL;
+    size_t last_capacity = 0;
+
+    for (size_t i = 0; i < num_runs; i++) {
+        cursors[i].file = runs[i];
+        cursors[i].rec = NULL;
+        cursors[i].capacity = 4096;
+        rewind(runs[i]);
+        if (carve_cursor_next(cursors + i)) {
+            heap[heap_size++] = cursors + i;
+        }
+    }
+    for (size_t i = heap_size; i-- > 0; ) {
+        sift_carve_cursors(heap, heap_size, i);
+    }
+
+    while (heap_size > 0) {
+        carve_cursor_t* cursor = heap[0];
+        carve_rec_t* rec = cursor->rec;
+        if (!last || compare_j_keys((j_key_t*)last->data, last->key_len, (j_key_t*)rec->data, rec->key_len) != 0) {
+            if (!emit(context, rec)) {
+                goto cleanup;
+            }
+
+            size_t size = sizeof(carve_rec_t) + rec->key_len + rec->val_len;
+            if (size > last_capacity) {
+                carve_rec_t* grown = realloc(last, size);
+                if (!grown) {
+                    fprintf(stderr, "\nABORT: merge_carve_runs: Could not allocate sufficient memory for `last`.\n");
+                    goto cleanup;
+                }
+                last = grown;
+                last_capacity = size;
+            }
+            memcpy(last, rec, size);
+        }
+
+        if (!carve_cursor_next(cursor)) {
+            heap[0] = heap[--heap_size];
+        }
+        sift_carve_cursors(heap, heap_size, 0);
+    }
+    result = 0;
+
+cleanup:
+    free(last);
+    for (size_t i = 0; i < num_runs; i++) {
+        free(cursors[i].rec);
+        fclose(runs[i]);
+    }
+    return result;
+}
+
+bool emit_carve_rec_to_run(void* context, carve_rec_t* rec) {
+    return write_carve_rec(context, rec);
+}
+
+/**
+ * Sort the records gathered in memory, and spill them to a new run. Once there
+ * are `CARVE_MAX_RUNS` runs, they are merged into one, so that the number of
+ * open runs stays bounded.
+ */
+bool spill_carve_run(carve_sort_t* sort) {
+    if (sort->num_recs == 0) {
+        return true;
+    }
+
+    FILE* run = carve_tmpfile();
+    if (!run) {
+        return false;
+    }
+    qsort(sort->recs, sort->num_recs, sizeof(carve_rec_t*), compare_carve_rec_ptrs);
+    for (size_t i = 0; i < sort->num_recs; i++) {
+        carve_rec_t* rec = sort->recs[i];
+        if (i > 0 && compare_j_keys((j_key_t*)sort->recs[i - 1]->data, sort->recs[i - 1]->key_len, (j_key_t*)rec->data, rec->key_len) == 0) {
+            continue;
+        }
+        if (!write_carve_rec(run, rec)) {
+            fprintf(stderr, "\nABORT: spill_carve_run: Failed to write to a temporary file.\n");
+            fclose(run);
+            return false;
+        }
+    }
+    sort->runs[sort->num_runs++] = run;
+    sort->stats->num_runs++;
+    sort->num_recs = 0;
+    sort->arena_used = 0;
+
+    if (sort->num_runs == CARVE_MAX_RUNS) {
+        FILE* merged = carve_tmpfile();
+        if (!merged) {
+            return false;
+        }
+        int result = merge_carve_runs(sort->runs, sort->num_runs, emit_carve_rec_to_run, merged);
+        sort->num_runs = 0;
+        if (result != 0) {
+            fclose(merged);
+            return false;
+        }
+        sort->runs[sort->num_runs++] = merged;
+    }
+    return true;
+}
+
+bool add_carve_rec(carve_sort_t* sort, char* key, uint16_t key_len, char* val, uint16_t val_len, xid_t xid) {
+    size_t size = CARVE_ALIGN(sizeof(carve_rec_t) + key_len + val_len);
+    if (sort->arena_used + size > sort->arena_size || sort->num_recs == sort->max_recs) {
+        if (!spill_carve_run(sort)) {
+            return false;
+        }
+    }
+
+    carve_rec_t* rec = (carve_rec_t*)(sort->arena + sort->arena_used);
+    rec->xid        = xid;
+    rec->key_len    = key_len;
+    rec->val_len    = val_len;
+    rec->reserved   = 0;
+    memcpy(rec->data, key, key_len);
+    memcpy(rec->data + key_len, val, val_len);
+    sort->arena_used += size;
+    sort->recs[sort->num_recs++] = rec;
+    return true;
+}
+
+/**
+ * Determine whether a block is a leaf node of a file-system tree that should
+ * be carved, given the options in effect.
+ */
+bool is_carvable_leaf(btree_node_phys_t* node, carve_options_t* options) {
+    uint32_t type = node->btn_o.o_type & OBJECT_TYPE_MASK;
+    if ((type != OBJECT_TYPE_BTREE && type != OBJECT_TYPE_BTREE_NODE)
+        || node->btn_o.o_subtype != OBJECT_TYPE_FSTREE
+        || !(node->btn_flags & BTNODE_LEAF)
+        || (node->btn_flags & BTNODE_FIXED_KV_SIZE)
+        || node->btn_o.o_xid < options->min_xid
+        || (options->max_xid && node->btn_o.o_xid > options->max_xid)
+    ) {
+        return false;
+    }
+
+    if (options->vol_omap_root_node) {
+        omap_val_t* omap_val = get_btree_phys_omap_val(options->vol_omap_root_node, node->btn_o.o_oid, (xid_t)(~0));
+        if (!omap_val) {
+            return false;
+        }
+        free(omap_val);
+    }
+    return true;
+}
+
+/**
+ * Add the records of a leaf node to the sort.
+ */
+bool add_leaf_records(carve_sort_t* sort, btree_node_phys_t* node) {
+    char* block_end = (char*)node + nx_device->block_size;
+    char* toc_start = (char*)(node->btn_data) + node->btn_table_space.off;
+    char* key_start = toc_start + node->btn_table_space.len;
+    char* val_end   = block_end - ((node->btn_flags & BTNODE_ROOT) ? sizeof(btree_info_t) : 0);
+    if (key_start > val_end || toc_start + node->btn_nkeys * sizeof(kvloc_t) > key_start) {
+        return true;    // Malformed; ignore it.
+    }
+
+    kvloc_t* toc_entry = (kvloc_t*)toc_start;
+    for (uint32_t i = 0; i < node->btn_nkeys; i++, toc_entry++) {
+        char* key = key_start + toc_entry->k.off;
+        char* val = val_end - toc_entry->v.off;
+        if (toc_entry->k.len < sizeof(j_key_t)
+            || key + toc_entry->k.len > val_end
+            || toc_entry->v.off < toc_entry->v.len
+            || val < key_start
+        ) {
+            continue;
+        }
+        if (!add_carve_rec(sort, key, toc_entry->k.len, val, toc_entry->v.len, node->btn_o.o_xid)) {
+            return false;
+        }
+        sort->stats->records_read++;
+    }
+    return true;
+}
+
+/**
+ * Lay out the node being filled by a packer, and write it.
+ *
+ * index:       The index of the node within the tree's nodes.
+ */
+bool write_carve_node(carve_packer_t* packer, uint64_t index, bool is_root) {
+    size_t block_size = nx_device->block_size;
+    btree_node_phys_t* node = (btree_node_phys_t*)packer->node;
+    memset(node, 0, block_size);
+
+    size_t toc_len = packer->nkeys * sizeof(kvloc_t);
+    char* key_start = (char*)(node->btn_data) + toc_len;
+    char* val_end   = packer->node + block_size - (is_root ? sizeof(btree_info_t) : 0);
+
+    node->btn_flags = (packer->level == 0 ? BTNODE_LEAF : 0) | (is_root ? BTNODE_ROOT : 0);
+    node->btn_level = packer->level;
+    node->btn_nkeys = packer->nkeys;
+    node->btn_table_space.off   = 0;
+    node->btn_table_space.len   = toc_len;
+    node->btn_free_space.off    = packer->keys_len;
+    node->btn_free_space.len    = (val_end - packer->vals_len) - (key_start + packer->keys_len);
+    node->btn_key_free_list.off = 0xffff;
+    node->btn_val_free_list.off = 0xffff;
+
+    memcpy(node->btn_data, packer->toc, toc_len);
+    memcpy(key_start, packer->keys, packer->keys_len);
+    for (uint32_t i = 0; i < packer->nkeys; i++) {
+        memcpy(val_end - packer->toc[i].v.off, packer->vals + packer->val_offsets[i], packer->toc[i].v.len);
+    }
+
+    if (is_root) {
+        btree_info_t* info = (btree_info_t*)val_end;
+        info->bt_fixed.bt_flags     = BTREE_PHYSICAL;
+        info->bt_fixed.bt_node_size = block_size;
+        info->bt_longest_key        = packer->longest_key;
+        info->bt_longest_val        = packer->longest_val;
+        info->bt_key_count          = packer->key_count;
+        info->bt_node_count         = packer->num_nodes;
+    }
+
+    node->btn_o.o_oid       = CARVE_BASE_ADDR + index;
+    node->btn_o.o_xid       = packer->xid;
+    node->btn_o.o_type      = OBJ_PHYSICAL | (is_root ? OBJECT_TYPE_BTREE : OBJECT_TYPE_BTREE_NODE);
+    node->btn_o.o_subtype   = OBJECT_TYPE_FSTREE;
+    *(uint64_t*)(node->btn_o.o_cksum) = compute_block_cksum((uint32_t*)node);
+
+    packer->nkeys = 0;
+    packer->keys_len = 0;
+    packer->vals_len = 0;
+    return pwrite(packer->fd, node, block_size, (off_t)(index * block_size)) == (ssize_t)block_size;
+}
+
+/**
+ * Determine whether an entry fits in the node being filled by a packer.
+ */
+bool carve_entry_fits(carve_packer_t* packer, uint16_t key_len, uint16_t val_len, bool is_root) {
+    size_t capacity = nx_device->block_size - sizeof(btree_node_phys_t) - (is_root ? sizeof(btree_info_t) : 0);
+    size_t used = (packer->nkeys + 1) * sizeof(kvloc_t) + packer->keys_len + packer->vals_len;
+    return used + CARVE_ALIGN(key_len) + CARVE_ALIGN(val_len) <= capacity;
+}
+
+/**
+ * Add an entry to the node being filled by a packer. If it doesn't fit, the
+ * node is written first, and the entry starts a new one.
+ */
+bool pack_carve_entry(carve_packer_t* packer, char* key, uint16_t key_len, char* val, uint16_t val_len) {
+    if (!carve_entry_fits(packer, key_len, val_len, false)) {
+        if (packer->nkeys == 0) {
+            return false;   // Too large for any node
+        }
+        if (!write_carve_node(packer, packer->num_nodes++, false)) {
+            return false;
+        }
+    }
+
+    kvloc_t* toc_entry = packer->toc + packer->nkeys;
+    toc_entry->k.off = packer->keys_len;
+    toc_entry->k.len = key_len;
+    memcpy(packer->keys + packer->keys_len, key, key_len);
+    packer->keys_len += CARVE_ALIGN(key_len);
+
+    packer->val_offsets[packer->nkeys] = packer->vals_len;
+    memcpy(packer->vals + packer->vals_len, val, val_len);
+    packer->vals_len += CARVE_ALIGN(val_len);
+    toc_entry->v.off = packer->vals_len;
+    toc_entry->v.len = val_len;
+
+    packer->nkeys++;
+    if (packer->level == 0) {
+        packer->key_count++;
+        if (key_len > packer->longest_key) {
+            packer->longest_key = key_len;
+        }
+        if (val_len > packer->longest_val) {
+            packer->longest_val = val_len;
+        }
+    }
+    return true;
+}
+
+bool emit_carve_rec_to_packer(void* context, carve_rec_t* rec) {
+    carve_packer_t* packer = context;
+    if (rec->xid > packer->xid) {
+        packer->xid = rec->xid;
+    }
+    if (!pack_carve_entry(packer, rec->data, rec->key_len, rec->data + rec->key_len, rec->val_len)) {
+        fprintf(stderr, "\nABORT: emit_carve_rec_to_packer: Failed to write a node of the rebuilt tree.\n");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Try to rewrite the single node of the top level of the tree as the root node,
+ * which has less room for entries, as it ends with a `btree_info_t`.
+ *
+ * RETURN VALUE:
+ *      True if the node was rewritten; false if its entries don't fit in a root
+ *      node, in which case another level must be added above it.
+ */
+bool make_carve_root(carve_packer_t* packer, uint64_t index) {
+    size_t block_size = nx_device->block_size;
+    char* block = malloc(block_size);
+    if (!block || pread(packer->fd, block, block_size, (off_t)(index * block_size)) != (ssize_t)block_size) {
+        free(block);
+        return false;
+    }
+
+    btree_node_phys_t* node = (btree_node_phys_t*)block;
+    char* toc_start = (char*)(node->btn_data) + node->btn_table_space.off;
+    char* key_start = toc_start + node->btn_table_space.len;
+    char* val_end   = block + block_size;
+
+    // Repacking a leaf node's records mustn't count them again.
+    uint64_t key_count = packer->key_count;
+    bool fits = true;
+    kvloc_t* toc_entry = (kvloc_t*)toc_start;
+    for (uint32_t i = 0; i < node->btn_nkeys && fits; i++, toc_entry++) {
+        fits = carve_entry_fits(packer, toc_entry->k.len, toc_entry->v.len, true);
+        if (fits) {
+            pack_carve_entry(packer, key_start + toc_entry->k.off, toc_entry->k.len, val_end - toc_entry->v.off, toc_entry->v.len);
+        }
+    }
+    free(block);
+    packer->key_count = key_count;
+
+    if (!fits) {
+        packer->nkeys = 0;
+        packer->keys_len = 0;
+        packer->vals_len = 0;
+        return false;
+    }
+    return write_carve_node(packer, index, true);
+}
+
+/**
+ * Build the levels of index nodes above the leaf nodes, up to the root node.
+ *
+ * RETURN VALUE:
+ *      The index of the root node, or -1 if an error occurs.
+ */
+int64_t build_carve_index_levels(carve_packer_t* packer) {
+    size_t block_size = nx_device->block_size;
+    char* child = malloc(block_size);
+    if (!child) {
+        return -1;
+    }
+
+    uint64_t level_start = 0;
+    uint64_t level_end = packer->num_nodes;
+    int64_t root_index = -1;
+    while (true) {
+        if (level_end - level_start == 1) {
+            if (make_carve_root(packer, level_start)) {
+                root_index = level_start;
+                break;
+            }
+        }
+
+        packer->level++;
+        for (uint64_t i = level_start; i < level_end; i++) {
+            if (pread(packer->fd, child, block_size, (off_t)(i * block_size)) != (ssize_t)block_size) {
+                goto cleanup;
+            }
+            btree_node_phys_t* node = (btree_node_phys_t*)child;
+            kvloc_t* toc_entry = (kvloc_t*)((char*)(node->btn_data) + node->btn_table_space.off);
+            char* first_key = (char*)(node->btn_data) + node->btn_table_space.off + node->btn_table_space.len + toc_entry->k.off;
+            paddr_t child_addr = CARVE_BASE_ADDR + i;
+            if (!pack_carve_entry(packer, first_key, toc_entry->k.len, (char*)&child_addr, sizeof(paddr_t))) {
+                goto cleanup;
+            }
+        }
+        if (packer->nkeys > 0 && !write_carve_node(packer, packer->num_nodes++, false)) {
+            goto cleanup;
+        }
+        level_start = level_end;
+        level_end = packer->num_nodes;
+    }
+
+cleanup:
+    free(child);
+    return root_index;
+}
+
+/**
+ * Pack the records of the sorted runs into a new tree.
+ *
+ * RETURN VALUE:
+ *      A pointer to the new tree, or NULL if an error occurs.
+ */
+carved_tree_t* pack_carved_tree(FILE** runs, size_t num_runs, carve_stats_t* stats) {
+    size_t block_size = nx_device->block_size;
+    carved_tree_t* tree = NULL;
+    FILE* nodes_file = carve_tmpfile();
+    carve_packer_t packer = {
+        .fd             = nodes_file ? fileno(nodes_file) : -1,
+        .toc            = malloc(block_size),
+        .keys           = malloc(block_size),
+        .vals           = malloc(block_size),
+        .val_offsets    = malloc(block_size / sizeof(kvloc_t) * sizeof(uint16_t)),
+        .node           = malloc(block_size),
+    };
+    if (!nodes_file || !packer.toc || !packer.keys || !packer.vals || !packer.val_offsets || !packer.node) {
+        fprintf(stderr, "\nABORT: pack_carved_tree: Could not allocate sufficient memory for `packer`.\n");
+        for (size_t i = 0; i < num_runs; i++) {
+            fclose(runs[i]);
+        }
+        goto cleanup;
+    }
+
+    if (merge_carve_runs(runs, num_runs, emit_carve_rec_to_packer, &packer) != 0) {
+        goto cleanup;
+    }
+    if (packer.nkeys > 0 && !write_carve_node(&packer, packer.num_nodes++, false)) {
+        goto cleanup;
+    }
+    stats->records_kept = packer.key_count;
+    if (packer.num_nodes == 0) {
+        fprintf(stderr, "\nABORT: pack_carved_tree: No records were found.\n");
+        goto cleanup;
+    }
+
+    int64_t root_index = build_carve_index_levels(&packer);
+    if (root_index < 0) {
+        fprintf(stderr, "\nABORT: pack_carved_tree: Failed to write the index nodes of the rebuilt tree.\n");
+        goto cleanup;
+    }
+    stats->num_nodes = packer.num_nodes;
+
+    tree = calloc(1, sizeof(carved_tree_t));
+    if (!tree) {
+        goto cleanup;
+    }
+    tree->base_addr = CARVE_BASE_ADDR;
+    tree->num_nodes = packer.num_nodes;
+    tree->map_size  = packer.num_nodes * block_size;
+    tree->nodes     = mmap(NULL, tree->map_size, PROT_READ, MAP_SHARED, packer.fd, 0);
+    if (tree->nodes == MAP_FAILED) {
+        fprintf(stderr, "\nABORT: pack_carved_tree: Could not map the rebuilt tree into memory.\n");
+        free(tree);
+        tree = NULL;
+        goto cleanup;
+    }
+    tree->root = (btree_node_phys_t*)(tree->nodes + root_index * block_size);
+
+cleanup:
+    if (nodes_file) {
+        fclose(nodes_file);     // The mapping remains valid.
+    }
+    free(packer.toc);
+    free(packer.keys);
+    free(packer.vals);
+    free(packer.val_offsets);
+    free(packer.node);
+    return tree;
+}
+
+carved_tree_t* carve_fs_tree_from_leaves(paddr_t* leaf_addrs, uint64_t num_leaves, carve_options_t* options, carve_stats_t* stats) {
+    size_t block_size = nx_device->block_size;
+    size_t memory_limit = options->memory_limit ? options->memory_limit : CARVE_DEFAULT_MEMORY;
+    if (memory_limit < CARVE_MIN_MEMORY_BLOCKS * block_size) {
+        memory_limit = CARVE_MIN_MEMORY_BLOCKS * block_size;     // Any record must fit in the arena.
+    }
+    carved_tree_t* tree = NULL;
+    char* batch = NULL;
+
+    memset(stats, 0, sizeof(carve_stats_t));
+    stats->leaves_found = num_leaves;
+
+    // Three quarters of the memory hold records, and the rest holds pointers
+    // to them; every record takes at least 24 bytes, so there are always
+    // enough pointers.
+    carve_sort_t sort = {
+        .arena_size = memory_limit / 4 * 3,
+        .max_recs   = memory_limit / 4 / sizeof(carve_rec_t*),
+        .stats      = stats,
+    };
+    sort.arena = malloc(sort.arena_size);
+    sort.recs = malloc(sort.max_recs * sizeof(carve_rec_t*));
+    batch = malloc(CARVE_READ_BATCH * block_size);
+    if (!sort.arena || !sort.recs || !batch) {
+        fprintf(stderr, "\nABORT: carve_fs_tree_from_leaves: Could not allocate sufficient memory for `sort`.\n");
+        goto cleanup;
+    }
+
+    // Read the leaf nodes in order of address, coalescing adjacent ones into
+    // single reads, and validate each batch's checksums at once.
+    qsort(leaf_addrs, num_leaves, sizeof(paddr_t), compare_paddrs);
+    uint64_t i = 0;
+    while (i < num_leaves) {
+        const void* blocks[CARVE_READ_BATCH];
+        uint8_t ok[CARVE_READ_BATCH];
+        size_t num_blocks = 0;
+        while (i < num_leaves && num_blocks < CARVE_READ_BATCH) {
+            size_t run_len = 1;
+            while (i + run_len < num_leaves
+                && num_blocks + run_len < CARVE_READ_BATCH
+                && leaf_addrs[i + run_len] == leaf_addrs[i] + (paddr_t)run_len
+            ) {
+                run_len++;
+            }
+            char* dest = batch + num_blocks * block_size;
+            size_t num_read = read_blocks(dest, leaf_addrs[i], run_len);
+            if (num_read == (size_t)(-1)) {
+                num_read = 0;
+            }
+            for (size_t j = 0; j < num_read; j++) {
+                blocks[num_blocks++] = dest + j * block_size;
+            }
+            i += run_len;
+
+            // Skip duplicate addresses.
+            while (i < num_leaves && leaf_addrs[i] == leaf_addrs[i - 1]) {
+                i++;
+            }
+        }
+
+        validate_blocks(blocks, num_blocks, ok);
+        for (size_t j = 0; j < num_blocks; j++) {
+            btree_node_phys_t* node = (btree_node_phys_t*)blocks[j];
+            if (!ok[j] || !is_carvable_leaf(node, options)) {
+                continue;
+            }
+            stats->leaves_used++;
+            if (!add_leaf_records(&sort, node)) {
+                goto cleanup;
+            }
+        }
+    }
+
+    if (!spill_carve_run(&sort)) {
+        goto cleanup;
+    }
+    free(sort.arena);
+    free(sort.recs);
+    sort.arena = NULL;
+    sort.recs = NULL;
+
+    tree = pack_carved_tree(sort.runs, sort.num_runs, stats);
+    sort.num_runs = 0;
+
+cleanup:
+    for (size_t j = 0; j < sort.num_runs; j++) {
+        fclose(sort.runs[j]);
+    }
+    free(sort.arena);
+    free(sort.recs);
+    free(batch);
+    return tree;
+}
+
+/**
+ * The addresses of candidate leaf nodes found so far.
+ */
+typedef struct {
+    paddr_t*            addrs;
+    uint64_t            num_addrs;
+    uint64_t            capacity;
+    carve_options_t*    options;
+} carve_leaf_list_t;
+
+bool add_carve_leaf(void* context, scan_record_t* record) {
+    carve_leaf_list_t* list = context;
+    if (list->num_addrs == list->capacity) {
+        uint64_t capacity = list->capacity ? 2 * list->capacity : 1024;
+        paddr_t* grown = realloc(list->addrs, capacity * sizeof(paddr_t));
+        if (!grown) {
+            fprintf(stderr, "\nABORT: add_carve_leaf: Could not allocate sufficient memory for `addrs`.\n");
+            return false;
+        }
+        list->addrs = grown;
+        list->capacity = capacity;
+    }
+    list->addrs[list->num_addrs++] = record->addr;
+    return true;
+}
+
+/**
+ * Determine whether an object found by a scan is a candidate leaf node.
+ */
+bool is_carve_leaf_record(scan_record_t* record, carve_options_t* options) {
+    uint32_t type = record->type & OBJECT_TYPE_MASK;
+    return (type == OBJECT_TYPE_BTREE || type == OBJECT_TYPE_BTREE_NODE)
+        && record->subtype == OBJECT_TYPE_FSTREE
+        && (record->flags & BTNODE_LEAF)
+        && record->xid >= options->min_xid
+        && (!options->max_xid || record->xid <= options->max_xid);
+}
+
+bool add_scanned_carve_leaves(void* context, scan_record_t* records, size_t num_records, scan_stats_t* stats) {
+    (void)stats;
+    carve_leaf_list_t* list = context;
+    for (size_t i = 0; i < num_records; i++) {
+        if (is_carve_leaf_record(records + i, list->options) && !add_carve_leaf(list, records + i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+carved_tree_t* carve_fs_tree(const char* index_path, carve_options_t* options, carve_stats_t* stats) {
+    carve_leaf_list_t list = { .options = options };
+
+    if (index_path) {
+        block_index_t* index = block_index_open(index_path);
+        if (!index) {
+            return NULL;
+        }
+        // Root nodes that are also leaf nodes have a different type from
+        // other nodes, so look for both.
+        block_index_query_t query = {
+            .type       = OBJECT_TYPE_BTREE_NODE,
+            .subtype    = OBJECT_TYPE_FSTREE,
+            .flags      = BTNODE_LEAF,
+            .min_xid    = options->min_xid,
+            .max_xid    = options->max_xid,
+        };
+        block_index_query(index, &query, add_carve_leaf, &list);
+        query.type = OBJECT_TYPE_BTREE;
+        block_index_query(index, &query, add_carve_leaf, &list);
+        block_index_close(index);
+    } else {
+        paddr_t end_addr = INT64_MAX;
+        nx_superblock_t* nxsb = malloc(nx_device->block_size);
+        if (nxsb && read_blocks(nxsb, 0x0, 1) == 1 && is_cksum_valid((uint32_t*)nxsb) && nxsb->nx_magic == NX_MAGIC) {
+            end_addr = nxsb->nx_block_count;
+        }
+        free(nxsb);
+        if (scan_blocks(0, end_addr, options->num_threads, add_scanned_carve_leaves, &list, NULL) != 0) {
+            free(list.addrs);
+            return NULL;
+        }
+    }
+
+    carved_tree_t* tree = carve_fs_tree_from_leaves(list.addrs, list.num_addrs, options, stats);
+    free(list.addrs);
+    return tree;
+}
+
+void carved_tree_free(carved_tree_t* tree) {
+    if (!tree) {
+        return;
+    }
+    munmap(tree->nodes, tree->map_size);
+    free(tree);
+}
+
+bool read_carved_node(void* buffer, paddr_t addr) {
+    carved_tree_t* tree = nx_device->carved_tree;
+    if (!tree || addr < tree->base_addr || (uint64_t)(addr - tree->base_addr) >= tree->num_nodes) {
+        return false;
+    }
+    memcpy(buffer, tree->nodes + (addr - tree->base_addr) * nx_device->block_size, nx_device->block_size);
+    return true;
+}
+
+int open_carved_volume(container_t* container, uint32_t volume_id, const char* index_path, btree_node_phys_t** fs_omap_btree, btree_node_phys_t** fs_root_btree) {
+    *fs_omap_btree = NULL;
+    *fs_root_btree = NULL;
+
+    carve_options_t options = { .num_threads = SCAN_DEFAULT_NUM_THREADS };
+    char* memory_env = getenv(CARVE_MEMORY_ENV);
+    unsigned int memory_mib = 0;
+    if (memory_env && sscanf(memory_env, "%u", &memory_mib) == 1 && memory_mib > 0) {
+        options.memory_limit = (size_t)memory_mib * 1024 * 1024;
+    }
+
+    paddr_t omap_tree_addr = container->volumes[volume_id].omap_tree_addr;
+    btree_node_phys_t* vol_omap_root_node = NULL;
+    if (container->num_volumes > 1) {
+        vol_omap_root_node = malloc(nx_device->block_size);
+        if (!vol_omap_root_node
+            || !omap_tree_addr
+            || read_blocks(vol_omap_root_node, omap_tree_addr, 1) != 1
+            || !is_cksum_valid((uint32_t*)vol_omap_root_node)
+        ) {
+            fprintf(stderr, "\nABORT: open_carved_volume: The object map B-tree of volume %u could not be read, so its leaf nodes can't be told apart from those of other volumes.\n", volume_id);
+            free(vol_omap_root_node);
+            return -1;
+        }
+        options.vol_omap_root_node = vol_omap_root_node;
+    }
+
+    if (index_path) {
+        fprintf(stderr, "Rebuilding the file-system tree of volume %u from the leaf nodes listed in `%s` ... ", volume_id, index_path);
+    } else {
+        fprintf(stderr, "Rebuilding the file-system tree of volume %u from the leaf nodes found by scanning the container ... ", volume_id);
+    }
+    carve_stats_t stats;
+    carved_tree_t* tree = carve_fs_tree(index_path, &options, &stats);
+    free(vol_omap_root_node);
+    if (!tree) {
+        fprintf(stderr, "FAILED.\n");
+        return -1;
+    }
+    fprintf(stderr, "OK.\n");
+    fprintf(stderr, "Used %llu of %llu candidate leaf nodes; kept %llu of their %llu records, sorted in %llu runs, in %llu nodes.\n",
+        stats.leaves_used, stats.leaves_found, stats.records_kept, stats.records_read, stats.num_runs, stats.num_nodes
+    );
+
+    *fs_root_btree = malloc(nx_device->block_size);
+    if (!*fs_root_btree) {
+        fprintf(stderr, "\nABORT: open_carved_volume: Could not allocate sufficient memory for the root node.\n");
+        carved_tree_free(tree);
+        return -1;
+    }
+    memcpy(*fs_root_btree, tree->root, nx_device->block_size);
+    carved_tree_free(nx_device->carved_tree);
+    nx_device->carved_tree = tree;
+    return 0;
+}
@@ -0,0 +1,179 @@
+/**
+ * Functions used to rebuild a volume's file-system tree from whatever leaf
+ * nodes of it can still be found on disk, for when the tree of the current
+ * checkpoint is damaged, e.g. because some of its index nodes were overwritten.
+ *
+ * Every leaf node of a file-system tree whose checksum is valid is gathered
+ * (using an index built by `apfs-index`, or a scan of the container), and all
+ * of their records are sorted by key with an external merge sort, keeping only
+ * the version of each record from the leaf node with the highest XID. The
+ * surviving records are then packed into a new B-tree, which is held in an
+ * unlinked temporary file that is memory-mapped, so that memory use stays
+ * bounded no matter how many leaf nodes there are.
+ *
+ * The rebuilt tree refers to its child nodes by physical address, and its nodes
+ * are given addresses from `CARVE_BASE_ADDR` upwards, which `read_node()`
+ * serves from the temporary file while the tree is installed as the current
+ * container's `carved_tree`. It can then be passed to `get_fs_records()` and
+ * the functions built upon it, along with a NULL object map.
+ */
+
+#ifndef APFS_FUNC_CARVE_H
+#define APFS_FUNC_CARVE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "../io.h"
+#include "../struct/general.h"
+#include "../struct/object.h"
+#include "../struct/btree.h"
+#include "../struct/j.h"
+
+#include "btree.h"
+#include "container.h"
+#include "j.h"
+#include "scan.h"
+#include "block_index.h"
+
+/** Carving constants **/
+
+#define CARVE_BASE_ADDR         0x4000000000000000  // Beyond the end of any real container
+#define CARVE_DEFAULT_MEMORY    (64 * 1024 * 1024)  // = 64 MiB
+#define CARVE_MIN_MEMORY_BLOCKS 16      // Least memory to use, in blocks
+#define CARVE_MAX_RUNS          64      // Sorted runs to merge at once
+#define CARVE_READ_BATCH        256     // Leaf nodes to read at once
+
+/**
+ * The environment variable that sets the memory limit used by
+ * `open_carved_volume()`, in MiB.
+ */
+#define CARVE_MEMORY_ENV        "APFS_CARVE_MEMORY"
+
+/**
+ * A file-system tree rebuilt by `carve_fs_tree()`.
+ *
+ * nodes:       The tree's nodes, memory-mapped from a temporary file. The node
+ *      at index `i` has the address `base_addr + i`.
+ *
+ * root:        The root node of the tree, which is within `nodes`.
+ */
+typedef struct nx_carved_tree {
+    paddr_t             base_addr;
+    uint64_t            num_nodes;
+    char*               nodes;
+    size_t              map_size;
+    btree_node_phys_t*  root;
+} carved_tree_t;
+
+/**
+ * Options for `carve_fs_tree()`; zeroed fields take their default values.
+ *
+ * vol_omap_root_node:  If not NULL, only leaf nodes whose OIDs are listed in
+ *      this object map are used. This tells the leaf nodes of a given volume
+ *      apart from those of other volumes, but also excludes leaf nodes that
+ *      have since been freed, so it is best only used when the container has
+ *      more than one volume.
+ *
+ * min_xid, max_xid:    The range of XIDs of leaf nodes to use, inclusive; a
+ *      `max_xid` of zero means no upper bound.
+ *
+ * memory_limit:    Roughly the most memory to use for sorting records, in
+ *      bytes; `CARVE_DEFAULT_MEMORY` by default, and at least
+ *      `CARVE_MIN_MEMORY_BLOCKS` blocks' worth.
+ *
+ * num_threads: The number of threads to scan the container with, if no index
+ *      is used; see `scan_blocks()`.
+ */
+typedef struct {
+    btree_node_phys_t*  vol_omap_root_node;
+    xid_t               min_xid;
+    xid_t               max_xid;
+    size_t              memory_limit;
+    unsigned int        num_threads;
+} carve_options_t;
+
+/**
+ * Statistics on carving.
+ *
+ * leaves_found:    The number of candidate leaf nodes found.
+ *
+ * leaves_used:     The number of leaf nodes whose records were used.
+ *
+ * records_read:    The number of records in those leaf nodes.
+ *
+ * records_kept:    The number of distinct records, i.e. those in the rebuilt
+ *      tree.
+ *
+ * num_runs:        The number of sorted runs that records were spilled to.
+ */
+typedef struct {
+    uint64_t    leaves_found;
+    uint64_t    leaves_used;
+    uint64_t    records_read;
+    uint64_t    records_kept;
+    uint64_t    num_runs;
+    uint64_t    num_nodes;
+} carve_stats_t;
+
+/**
+ * Rebuild a file-system tree from given leaf nodes of the current container
+ * (see `nx_device` in `apfs/io.h`).
+ *
+ * leaf_addrs:  The addresses of candidate leaf nodes. Blocks which turn out not
+ *      to be valid leaf nodes of a file-system tree are ignored.
+ *
+ * RETURN VALUE:
+ *      A pointer to the rebuilt tree, which must be freed with
+ *      `carved_tree_free()` when no longer needed; or NULL if no records were
+ *      found or an error occurs.
+ */
+carved_tree_t* carve_fs_tree_from_leaves(paddr_t* leaf_addrs, uint64_t num_leaves, carve_options_t* options, carve_stats_t* stats);
+
+/**
+ * Rebuild a file-system tree from all of the leaf nodes of file-system trees in
+ * the current container, as found in an index built by `apfs-index`, or else by
+ * scanning the whole container; see `carve_fs_tree_from_leaves()`.
+ *
+ * index_path:  The path of the index, or NULL to scan the container.
+ */
+carved_tree_t* carve_fs_tree(const char* index_path, carve_options_t* options, carve_stats_t* stats);
+
+void carved_tree_free(carved_tree_t* tree);
+
+/**
+ * Read a node of the rebuilt tree that is installed as the current container's
+ * `carved_tree`, if the given address is one of its nodes.
+ *
+ * RETURN VALUE:
+ *      True if the node was read into `buffer`, or false if the address isn't
+ *      one of the tree's nodes.
+ */
+bool read_carved_node(void* buffer, paddr_t addr);
+
+/**
+ * Rebuild the file-system tree of a volume with `carve_fs_tree()`, for use in
+ * place of `open_volume()`, and install it as the current container's
+ * `carved_tree`, which `close_container()` frees.
+ *
+ * If the container has more than one volume, only leaf nodes listed in the
+ * volume's object map are used, so that records of other volumes are left out.
+ *
+ * index_path:  The path of an index built by `apfs-index`, or NULL to scan the
+ *      container.
+ *
+ * fs_omap_btree:   NULL is stored here, since the rebuilt tree refers to its
+ *      nodes by physical address.
+ *
+ * fs_root_btree:   A copy of the rebuilt tree's root node is stored here. It
+ *      must be freed when no longer needed.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value if the tree couldn't be rebuilt.
+ */
+int open_carved_volume(container_t* container, uint32_t volume_id, const char* index_path, btree_node_phys_t** fs_omap_btree, btree_node_phys_t** fs_root_btree);
+
+#endif // APFS_FUNC_CARVE_H
@@ -0,0 +1,201 @@
+#include "changed.h"
+
+void changed_set_free(changed_set_t* changed) {
+    if (!changed) {
+        return;
+    }
+    free(changed->oids);
+    free(changed);
+}
+
+bool add_changed_oid(changed_set_t* changed, oid_t oid) {
+    // Records are visited in key order, so duplicates are usually adjacent;
+    // any others are removed once the walk is done.
+    if (changed->num_oids > 0 && changed->oids[changed->num_oids - 1] == oid) {
+        return true;
+    }
+    if (changed->num_oids == changed->capacity) {
+        size_t capacity = changed->capacity ? 2 * changed->capacity : 1024;
+        oid_t* oids = realloc(changed->oids, capacity * sizeof(oid_t));
+        if (!oids) {
+            fprintf(stderr, "\nABORT: add_changed_oid: Could not allocate sufficient memory for `oids`.\n");
+            return false;
+        }
+        changed->oids = oids;
+        changed->capacity = capacity;
+    }
+    changed->oids[changed->num_oids++] = oid;
+    return true;
+}
+
+int compare_oids(const void* a, const void* b) {
+    oid_t oid_a = *(const oid_t*)a;
+    oid_t oid_b = *(const oid_t*)b;
+    return oid_a < oid_b ? -1 : oid_a > oid_b;
+}
+
+/**
+ * Visit a node of a file-system tree, and recursively the children of it that
+ * are newer than `since_xid`, adding the OIDs of the records found in them to
+ * `changed`.
+ *
+ * nodes:       Buffers for the nodes beneath `node`, one block per level,
+ *      allocated as needed; `nodes[i]` is used for nodes at level `i`.
+ *
+ * dstreams:    If not NULL, only the inode numbers of inode records whose
+ *      `private_id` is in this set, and differs from the inode number, are
+ *      added; see `get_fs_dstream_owners()`.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value on failure.
+ */
+int visit_changed_node(changed_set_t* changed, btree_node_phys_t* fs_omap_btree, btree_node_phys_t* node, btree_node_phys_t** nodes, xid_t since_xid, changed_set_t* dstreams) {
+    char* toc_start = (char*)(node->btn_data) + node->btn_table_space.off;
+    char* key_start = toc_start + node->btn_table_space.len;
+    char* val_end   = (char*)node + nx_device->block_size;
+    if (node->btn_flags & BTNODE_ROOT) {
+        val_end -= sizeof(btree_info_t);
+    }
+    if (node->btn_flags & BTNODE_FIXED_KV_SIZE) {
+        fprintf(stderr, "\nABORT: visit_changed_node: File-system trees don't have fixed-size keys and values.\n");
+        return -1;
+    }
+
+    kvloc_t* toc_entry = (kvloc_t*)toc_start;
+    for (uint32_t i = 0; i < node->btn_nkeys; i++, toc_entry++) {
+        if ((char*)(toc_entry + 1) > key_start || key_start + toc_entry->k.off + sizeof(j_key_t) > val_end) {
+            fprintf(stderr, "\nABORT: visit_changed_node: Entry %u of the node with OID 0x%llx is malformed.\n", i, node->btn_o.o_oid);
+            return -1;
+        }
+
+        if (node->btn_flags & BTNODE_LEAF) {
+            j_key_t* key = (j_key_t*)(key_start + toc_entry->k.off);
+            oid_t oid = key->obj_id_and_type & OBJ_ID_MASK;
+            if (dstreams) {
+                if ((key->obj_id_and_type & OBJ_TYPE_MASK) >> OBJ_TYPE_SHIFT != APFS_TYPE_INODE
+                    || toc_entry->v.len < offsetof(j_inode_val_t, private_id) + sizeof(uint64_t)
+                    || val_end - toc_entry->v.off < key_start
+                ) {
+                    continue;
+                }
+                j_inode_val_t* val = (j_inode_val_t*)(val_end - toc_entry->v.off);
+                if (val->private_id == oid || !is_fs_object_changed(dstreams, val->private_id)) {
+                    continue;
+                }
+            }
+            if (!add_changed_oid(changed, oid)) {
+                return -1;
+            }
+            continue;
+        }
+
+        // Skip the child without reading it if the object map says it's no
+        // newer than `since_xid`. Physical child nodes have to be read to tell.
+        oid_t child_oid = *(oid_t*)(val_end - toc_entry->v.off);
+        paddr_t child_addr = child_oid;
+        if (fs_omap_btree) {
+            xid_t child_xid = 0;
+            omap_val_t* omap_val = get_btree_phys_omap_version(fs_omap_btree, child_oid, fs_view_xid, &child_xid);
+            if (!omap_val) {
+                fprintf(stderr, "\nABORT: visit_changed_node: Could not resolve the child node with OID 0x%llx.\n", child_oid);
+                return -1;
+            }
+            child_addr = omap_val->ov_paddr;
+            free(omap_val);
+            if (child_xid <= since_xid) {
+                changed->subtrees_skipped++;
+                continue;
+            }
+        }
+
+        uint16_t child_level = node->btn_level - 1;
+        btree_node_phys_t* child = nodes[child_level];
+        if (read_node(child, child_addr) != 1 || !verify_node(child, child_addr)) {
+            fprintf(stderr, "\nABORT: visit_changed_node: Failed to read the node at block 0x%llx.\n", child_addr);
+            return -1;
+        }
+        changed->nodes_read++;
+        if (child->btn_level != child_level) {
+            fprintf(stderr, "\nABORT: visit_changed_node: The node at block 0x%llx is not a level-%u node.\n", child_addr, child_level);
+            return -1;
+        }
+        if (child->btn_o.o_xid <= since_xid) {
+            changed->subtrees_skipped++;
+            continue;
+        }
+        if (visit_changed_node(changed, fs_omap_btree, child, nodes, since_xid, dstreams) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Walk the nodes of a file-system tree that are newer than `since_xid`; see
+ * `visit_changed_node()`.
+ *
+ * RETURN VALUE:
+ *      A pointer to the set of OIDs found, which must be freed with
+ *      `changed_set_free()`; or NULL if an error occurs.
+ */
+changed_set_t* walk_changed_nodes(btree_node_phys_t* fs_omap_btree, btree_node_phys_t* fs_root_btree, xid_t since_xid, changed_set_t* dstreams) {
+    changed_set_t* changed = calloc(1, sizeof(changed_set_t));
+    btree_node_phys_t** nodes = calloc(fs_root_btree->btn_level + 1, sizeof(btree_node_phys_t*));
+    if (!changed || !nodes) {
+        fprintf(stderr, "\nABORT: walk_changed_nodes: Could not allocate sufficient memory.\n");
+        goto onError;
+    }
+    for (uint16_t i = 0; i < fs_root_btree->btn_level; i++) {
+        nodes[i] = malloc(nx_device->block_size);
+        if (!nodes[i]) {
+            fprintf(stderr, "\nABORT: walk_changed_nodes: Could not allocate sufficient memory for `nodes`.\n");
+            goto onError;
+        }
+    }
+
+    if (fs_root_btree->btn_o.o_xid > since_xid && visit_changed_node(changed, fs_omap_btree, fs_root_btree, nodes, since_xid, dstreams) != 0) {
+        goto onError;
+    }
+
+    qsort(changed->oids, changed->num_oids, sizeof(oid_t), compare_oids);
+    size_t num_unique = 0;
+    for (size_t i = 0; i < changed->num_oids; i++) {
+        if (num_unique == 0 || changed->oids[num_unique - 1] != changed->oids[i]) {
+            changed->oids[num_unique++] = changed->oids[i];
+        }
+    }
+    changed->num_oids = num_unique;
+
+    for (uint16_t i = 0; i < fs_root_btree->btn_level; i++) {
+        free(nodes[i]);
+    }
+    free(nodes);
+    return changed;
+
+onError:
+    if (nodes) {
+        for (uint16_t i = 0; i < fs_root_btree->btn_level; i++) {
+            free(nodes[i]);
+        }
+    }
+    free(nodes);
+    changed_set_free(changed);
+    return NULL;
+}
+
+changed_set_t* get_fs_objects_changed_since(btree_node_phys_t* fs_omap_btree, btree_node_phys_t* fs_root_btree, xid_t since_xid) {
+    return walk_changed_nodes(fs_omap_btree, fs_root_btree, since_xid, NULL);
+}
+
+changed_set_t* get_fs_dstream_owners(btree_node_phys_t* fs_omap_btree, btree_node_phys_t* fs_root_btree, oid_t* dstream_ids, size_t num_dstream_ids) {
+    changed_set_t dstreams = {
+        .oids       = dstream_ids,
+        .num_oids   = num_dstream_ids,
+    };
+    // Every node is newer than transaction zero, so the whole tree is read.
+    return walk_changed_nodes(fs_omap_btree, fs_root_btree, 0, &dstreams);
+}
+
+bool is_fs_object_changed(changed_set_t* changed, oid_t oid) {
+    return bsearch(&oid, changed->oids, changed->num_oids, sizeof(oid_t), compare_oids) != NULL;
+}
@@ -0,0 +1,95 @@
+/**
+ * Functions used to find the file-system objects that have changed since a
+ * given transaction, without reading the parts of a file-system tree that
+ * haven't.
+ *
+ * B-tree nodes are never modified in place: changing a record writes a new
+ * copy of its leaf node, and of every node above it, in the transaction that
+ * made the change. So a node whose XID doesn't exceed a given XID can't
+ * contain (or lead to) any record written after that transaction, and the
+ * whole subtree beneath it can be skipped. For trees whose child nodes are
+ * Virtual objects, the XID of each child is found in the object map, so
+ * skipped nodes aren't even read.
+ *
+ * The objects found are a superset of those that gained or changed records:
+ * every record in a newer leaf node is counted, even if only one of them was
+ * written. Records that were removed leave no trace, so an object that only
+ * lost records is found only if others in the same leaf node remain.
+ */
+
+#ifndef APFS_FUNC_CHANGED_H
+#define APFS_FUNC_CHANGED_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "../io.h"
+#include "../struct/general.h"
+#include "../struct/object.h"
+#include "../struct/btree.h"
+#include "../struct/omap.h"
+#include "../struct/j.h"
+
+#include "btree.h"
+
+/**
+ * The IDs of the file-system objects that have records in nodes newer than a
+ * given XID.
+ *
+ * oids:        The IDs, sorted and without duplicates.
+ *
+ * nodes_read, subtrees_skipped:    Statistics on the walk of the tree.
+ */
+typedef struct {
+    oid_t*      oids;
+    size_t      num_oids;
+    size_t      capacity;
+
+    uint64_t    nodes_read;
+    uint64_t    subtrees_skipped;
+} changed_set_t;
+
+/**
+ * Find the file-system objects that have records in nodes of a file-system
+ * tree written after a given transaction. Child nodes are resolved as of
+ * `fs_view_xid`; see `apfs/func/btree.h`.
+ *
+ * fs_omap_btree:   The root node of the volume object map B-tree, or NULL if
+ *      the tree refers to its child nodes by physical address.
+ *
+ * since_xid:   Nodes whose XIDs don't exceed this are skipped.
+ *
+ * RETURN VALUE:
+ *      A pointer to the set of objects, which must be freed with
+ *      `changed_set_free()`; or NULL if an error occurs.
+ */
+changed_set_t* get_fs_objects_changed_since(btree_node_phys_t* fs_omap_btree, btree_node_phys_t* fs_root_btree, xid_t since_xid);
+
+/**
+ * Find the inodes whose data streams have any of the given IDs, i.e. whose
+ * `private_id` is one of them and differs from their own inode number. The
+ * extents of such a file, e.g. a clone, are keyed by the ID of its data
+ * stream, so a change to its contents may only be found under that ID. Child
+ * nodes are resolved as of `fs_view_xid`; every node of the tree is read.
+ *
+ * dstream_ids:     The IDs of the data streams, sorted.
+ *
+ * RETURN VALUE:
+ *      A pointer to the set of inode numbers, which must be freed with
+ *      `changed_set_free()`; or NULL if an error occurs.
+ */
+changed_set_t* get_fs_dstream_owners(btree_node_phys_t* fs_omap_btree, btree_node_phys_t* fs_root_btree, oid_t* dstream_ids, size_t num_dstream_ids);
+
+void changed_set_free(changed_set_t* changed);
+
+/**
+ * Determine whether a given object is in a set returned by
+ * `get_fs_objects_changed_since()`.
+ */
+bool is_fs_object_changed(changed_set_t* changed, oid_t oid);
+
+#endif // APFS_FUNC_CHANGED_H
@@ -0,0 +1,507 @@
+#include "checkpoint.h"
+
+int compare_checkpoints(const void* a, const void* b) {
+    xid_t xid_a = ((const checkpoint_t*)a)->xid;
+    xid_t xid_b = ((const checkpoint_t*)b)->xid;
+    return (xid_a < xid_b) - (xid_a > xid_b);
+}
+
+void index_checkpoints(checkpoint_timeline_t* timeline, checkpoint_t* known, uint32_t num_known) {
+    timeline->num_checkpoints = 0;
+    for (uint32_t i = 0; i < timeline->xp_desc_blocks; i++) {
+        nx_superblock_t* xp_nxsb = (nx_superblock_t*)(timeline->xp_desc + i * nx_device->block_size);
+        if (!timeline->cksum_ok[i] || !is_nx_superblock(xp_nxsb)) {
+            continue;
+        }
+        if (xp_nxsb->nx_magic != NX_MAGIC) {
+            fprintf(stderr, "- Container superblock at index %u within this area is malformed; incorrect magic number. Skipping it.\n", i);
+            continue;
+        }
+        checkpoint_t* checkpoint = timeline->checkpoints + timeline->num_checkpoints++;
+        checkpoint->nxsb_index  = i;
+        checkpoint->xid         = xp_nxsb->nx_o.o_xid;
+        checkpoint->status      = CHECKPOINT_UNCHECKED;
+        checkpoint->bad_addr    = 0;
+        checkpoint->objects_checked = false;
+
+        // Keep what is already known about a checkpoint that is still there.
+        for (uint32_t j = 0; j < num_known; j++) {
+            if (known[j].nxsb_index == i && known[j].xid == checkpoint->xid) {
+                *checkpoint = known[j];
+                break;
+            }
+        }
+    }
+    qsort(timeline->checkpoints, timeline->num_checkpoints, sizeof(checkpoint_t), compare_checkpoints);
+}
+
+checkpoint_timeline_t* load_checkpoint_timeline(nx_superblock_t* nxsb) {
+    uint32_t xp_desc_blocks = nxsb->nx_xp_desc_blocks & ~(1 << 31);
+    if (nxsb->nx_xp_desc_blocks >> 31) {
+        fprintf(stderr, "END: The checkpoint descriptor area is not contiguous. The ability to handle this case has not yet been implemented.\n\n");   // TODO: implement case when xp_desc area is not contiguous
+        return NULL;
+    }
+
+    checkpoint_timeline_t* timeline = calloc(1, sizeof(checkpoint_timeline_t));
+    if (!timeline) {
+        fprintf(stderr, "\nABORT: load_checkpoint_timeline: Could not allocate sufficient memory for `timeline`.\n");
+        return NULL;
+    }
+
+    fprintf(stderr, "Loading the checkpoint descriptor area (%u blocks at 0x%llx) into memory ... ", xp_desc_blocks, nxsb->nx_xp_desc_base);
+    timeline->xp_desc_blocks = xp_desc_blocks;
+    timeline->xp_desc = malloc(xp_desc_blocks * nx_device->block_size);
+    timeline->cksum_ok = malloc(xp_desc_blocks ? xp_desc_blocks : 1);
+    timeline->checkpoints = malloc((xp_desc_blocks ? xp_desc_blocks : 1) * sizeof(checkpoint_t));
+    if (!timeline->xp_desc || !timeline->cksum_ok || !timeline->checkpoints) {
+        fprintf(stderr, "\nABORT: Could not allocate sufficient memory for %u blocks.\n", xp_desc_blocks);
+        goto onError;
+    }
+    if (read_blocks(timeline->xp_desc, nxsb->nx_xp_desc_base, xp_desc_blocks) != xp_desc_blocks) {
+        fprintf(stderr, "\nABORT: Failed to read all blocks in the checkpoint descriptor area.\n");
+        goto onError;
+    }
+    fprintf(stderr, "OK.\n");
+
+    validate_block_range(timeline->xp_desc, xp_desc_blocks, timeline->cksum_ok);
+    index_checkpoints(timeline, NULL, 0);
+    return timeline;
+
+onError:
+    checkpoint_timeline_free(timeline);
+    return NULL;
+}
+
+void checkpoint_timeline_free(checkpoint_timeline_t* timeline) {
+    if (!timeline) {
+        return;
+    }
+    free(timeline->xp_desc);
+    free(timeline->cksum_ok);
+    free(timeline->checkpoints);
+    free(timeline);
+}
+
+int poll_checkpoint_timeline(checkpoint_timeline_t* timeline, uint32_t* blocks_read) {
+    size_t block_size = nx_device->block_size;
+    uint32_t num_read = 0;
+    uint32_t num_stored = 0;
+    int num_new = 0;
+    if (blocks_read) {
+        *blocks_read = 0;
+    }
+    if (timeline->num_checkpoints == 0 || timeline->xp_desc_blocks == 0) {
+        return 0;
+    }
+
+    char* block = malloc(block_size);
+    checkpoint_t* known = malloc(timeline->num_checkpoints * sizeof(checkpoint_t));
+    if (!block || !known) {
+        fprintf(stderr, "\nABORT: poll_checkpoint_timeline: Could not allocate sufficient memory.\n");
+        free(block);
+        free(known);
+        return -1;
+    }
+
+    // Each checkpoint is written starting at the index that follows the
+    // previous one, with its container superblock last, so follow the ring
+    // from the newest known checkpoint until reaching a block that isn't newer.
+    nx_superblock_t* newest = get_checkpoint_superblock(timeline, timeline->checkpoints);
+    xid_t newest_xid = timeline->checkpoints[0].xid;
+    paddr_t xp_desc_base = newest->nx_xp_desc_base;
+    uint32_t index = newest->nx_xp_desc_next % timeline->xp_desc_blocks;
+    while (num_read < timeline->xp_desc_blocks) {
+        if (read_blocks(block, xp_desc_base + index, 1) != 1) {
+            fprintf(stderr, "\nABORT: poll_checkpoint_timeline: Failed to read block 0x%llx.\n", xp_desc_base + index);
+            num_new = -1;
+            break;
+        }
+        num_read++;
+        if (!is_cksum_valid(block) || ((obj_phys_t*)block)->o_xid <= newest_xid) {
+            break;
+        }
+
+        // The blocks of a checkpoint that is still being written are kept
+        // too, and read again next time, until its superblock appears.
+        memcpy(timeline->xp_desc + index * block_size, block, block_size);
+        timeline->cksum_ok[index] = true;
+        num_stored++;
+        nx_superblock_t* nxsb = (nx_superblock_t*)block;
+        if (is_nx_superblock(nxsb) && nxsb->nx_magic == NX_MAGIC) {
+            newest_xid = nxsb->nx_o.o_xid;
+            index = nxsb->nx_xp_desc_next % timeline->xp_desc_blocks;
+            num_new++;
+        } else {
+            index = (index + 1) % timeline->xp_desc_blocks;
+        }
+    }
+
+    // A writer that has gone all the way around the ring since the last poll
+    // will have overwritten blocks that weren't followed, so check that the
+    // known superblocks are still there, and if not, read the whole area again.
+    if (num_stored > 0 && num_new >= 0) {
+        bool lapped = false;
+        for (uint32_t i = 0; i < timeline->num_checkpoints && !lapped; i++) {
+            uint32_t nxsb_index = timeline->checkpoints[i].nxsb_index;
+            if (read_blocks(block, xp_desc_base + nxsb_index, 1) != 1) {
+                fprintf(stderr, "\nABORT: poll_checkpoint_timeline: Failed to read block 0x%llx.\n", xp_desc_base + nxsb_index);
+                num_new = -1;
+                break;
+            }
+            num_read++;
+            lapped = memcmp(block, timeline->xp_desc + nxsb_index * block_size, block_size) != 0;
+        }
+        if (lapped) {
+            fprintf(stderr, "Checkpoints were overwritten since the checkpoint descriptor area was last read; reading all of it again.\n");
+            if (read_blocks(timeline->xp_desc, xp_desc_base, timeline->xp_desc_blocks) != timeline->xp_desc_blocks) {
+                fprintf(stderr, "\nABORT: poll_checkpoint_timeline: Failed to read all blocks in the checkpoint descriptor area.\n");
+                num_new = -1;
+            }
+            num_read += timeline->xp_desc_blocks;
+            validate_block_range(timeline->xp_desc, timeline->xp_desc_blocks, timeline->cksum_ok);
+        }
+    }
+
+    // Even blocks of a checkpoint that is incomplete may have overwritten the
+    // superblock of an old one.
+    if (num_stored > 0) {
+        memcpy(known, timeline->checkpoints, timeline->num_checkpoints * sizeof(checkpoint_t));
+        index_checkpoints(timeline, known, timeline->num_checkpoints);
+    }
+    if (blocks_read) {
+        *blocks_read = num_read;
+    }
+    free(known);
+    free(block);
+    return num_new;
+}
+
+nx_superblock_t* get_checkpoint_superblock(checkpoint_timeline_t* timeline, checkpoint_t* checkpoint) {
+    return (nx_superblock_t*)(timeline->xp_desc + checkpoint->nxsb_index * nx_device->block_size);
+}
+
+const char* checkpoint_status_string(checkpoint_status_t status) {
+    switch (status) {
+        case CHECKPOINT_UNCHECKED:
+            return "Not checked";
+        case CHECKPOINT_OK:
+            return "OK";
+        case CHECKPOINT_BAD_MAP:
+            return "Malformed checkpoint-mapping block";
+        case CHECKPOINT_BAD_EPHEMERAL:
+            return "Malformed Ephemeral object";
+        case CHECKPOINT_BAD_OMAP:
+            return "Malformed container object map";
+        case CHECKPOINT_BAD_VOLUME:
+            return "Malformed volume superblock";
+        default:
+            return "Unknown";
+    }
+}
+
+/**
+ * Get the number of mappings in a checkpoint-mapping block, limited to as many
+ * as fit in the block, so that a malformed count can't lead to reads past it.
+ */
+uint32_t get_checkpoint_map_count(checkpoint_map_phys_t* xp_map) {
+    uint32_t max_count = (nx_device->block_size - sizeof(checkpoint_map_phys_t)) / sizeof(checkpoint_mapping_t);
+    return xp_map->cpm_count < max_count ? xp_map->cpm_count : max_count;
+}
+
+checkpoint_status_t validate_checkpoint(checkpoint_timeline_t* timeline, checkpoint_t* checkpoint) {
+    if (checkpoint->status != CHECKPOINT_UNCHECKED || checkpoint->objects_checked) {
+        return checkpoint->status;
+    }
+
+    size_t block_size = nx_device->block_size;
+    nx_superblock_t* nxsb = get_checkpoint_superblock(timeline, checkpoint);
+    char* xp_obj = NULL;
+    paddr_t* xp_obj_addrs = NULL;
+    uint8_t* cksum_ok = NULL;
+
+    if (nxsb->nx_xp_desc_index >= timeline->xp_desc_blocks || nxsb->nx_xp_desc_len > timeline->xp_desc_blocks) {
+        fprintf(stderr, "The container superblock with XID 0x%llx describes a checkpoint that doesn't fit in the checkpoint descriptor area.\n", checkpoint->xid);
+        checkpoint->status = CHECKPOINT_BAD_MAP;
+        goto cleanup;
+    }
+
+    // The blocks of the checkpoint may wrap around the end of the checkpoint
+    // descriptor area.
+    // Every block of the checkpoint other than its superblock must be one of
+    // its checkpoint-mapping blocks; if any was overwritten by a newer
+    // checkpoint, this one's Ephemeral objects can't be found.
+    uint32_t xp_obj_len = 0;
+    for (uint32_t i = 0; i < nxsb->nx_xp_desc_len; i++) {
+        uint32_t index = (nxsb->nx_xp_desc_index + i) % timeline->xp_desc_blocks;
+        if (index == checkpoint->nxsb_index) {
+            continue;
+        }
+        checkpoint_map_phys_t* xp_map = (checkpoint_map_phys_t*)(timeline->xp_desc + index * block_size);
+        if (
+                !timeline->cksum_ok[index]
+                || !is_checkpoint_map_phys(xp_map)
+                || xp_map->cpm_o.o_xid != nxsb->nx_o.o_xid
+        ) {
+            fprintf(stderr, "The block at index %u within the checkpoint descriptor area is not a valid checkpoint-mapping block of the checkpoint with XID 0x%llx.\n", index, checkpoint->xid);
+            checkpoint->status = CHECKPOINT_BAD_MAP;
+            checkpoint->bad_addr = nxsb->nx_xp_desc_base + index;
+            goto cleanup;
+        }
+        xp_obj_len += get_checkpoint_map_count(xp_map);
+    }
+
+    fprintf(stderr, "Reading and validating the %u Ephemeral objects used by this checkpoint ... ", xp_obj_len);
+    xp_obj = malloc((xp_obj_len ? xp_obj_len : 1) * block_size);
+    xp_obj_addrs = malloc((xp_obj_len ? xp_obj_len : 1) * sizeof(paddr_t));
+    cksum_ok = malloc(xp_obj_len ? xp_obj_len : 1);
+    if (!xp_obj || !xp_obj_addrs || !cksum_ok) {
+        fprintf(stderr, "\nABORT: Could not allocate sufficient memory for `xp_obj`.\n");
+        goto cleanup;   // Leave the checkpoint unchecked, as it may be fine.
+    }
+    uint32_t num_read = 0;
+    for (uint32_t i = 0; i < nxsb->nx_xp_desc_len; i++) {
+        uint32_t index = (nxsb->nx_xp_desc_index + i) % timeline->xp_desc_blocks;
+        if (index == checkpoint->nxsb_index) {
+            continue;
+        }
+        checkpoint_map_phys_t* xp_map = (checkpoint_map_phys_t*)(timeline->xp_desc + index * block_size);
+        uint32_t count = get_checkpoint_map_count(xp_map);
+        for (uint32_t j = 0; j < count && num_read < xp_obj_len; j++) {
+            if (read_blocks(xp_obj + num_read * block_size, xp_map->cpm_map[j].cpm_paddr, 1) != 1) {
+                fprintf(stderr, "FAILED.\nFailed to read block 0x%llx.\n", xp_map->cpm_map[j].cpm_paddr);
+                checkpoint->status = CHECKPOINT_BAD_EPHEMERAL;
+                checkpoint->bad_addr = xp_map->cpm_map[j].cpm_paddr;
+                goto cleanup;
+            }
+            xp_obj_addrs[num_read] = xp_map->cpm_map[j].cpm_paddr;
+            num_read++;
+        }
+    }
+    if (validate_block_range(xp_obj, num_read, cksum_ok) != num_read) {
+        uint32_t i = 0;
+        while (cksum_ok[i]) {
+            i++;
+        }
+        fprintf(stderr, "FAILED.\nThe Ephemeral object at 0x%llx is malformed.\n", xp_obj_addrs[i]);
+        checkpoint->status = CHECKPOINT_BAD_EPHEMERAL;
+        checkpoint->bad_addr = xp_obj_addrs[i];
+        goto cleanup;
+    }
+    fprintf(stderr, "OK.\n");
+
+    // The rest of the checkpoint is checked by `mount_checkpoint()`.
+    checkpoint->objects_checked = true;
+
+cleanup:
+    free(cksum_ok);
+    free(xp_obj_addrs);
+    free(xp_obj);
+    return checkpoint->status;
+}
+
+int mount_checkpoint(container_t* container, checkpoint_timeline_t* timeline, uint32_t index) {
+    int result = -1;
+    size_t block_size = nx_device->block_size;
+    checkpoint_t* checkpoint = timeline->checkpoints + index;
+    nx_superblock_t* nxsb = get_checkpoint_superblock(timeline, checkpoint);
+    omap_phys_t* nx_omap = NULL;
+    btree_node_phys_t* omap_btree = NULL;
+    char* apsbs = NULL;
+    container_t* mounted = NULL;
+
+    checkpoint_status_t status = validate_checkpoint(timeline, checkpoint);
+    if (status != CHECKPOINT_UNCHECKED && status != CHECKPOINT_OK) {
+        return -1;
+    }
+
+    // Resolve the checkpoint into a scratch state, so that `container` is
+    // left untouched if the checkpoint turns out to be damaged.
+    mounted = calloc(1, sizeof(container_t));
+    if (!mounted) {
+        fprintf(stderr, "\nABORT: mount_checkpoint: Could not allocate sufficient memory for `mounted`.\n");
+        return -1;
+    }
+
+    fprintf(stderr, "Loading the container object map (Physical OID 0x%llx) ... ", nxsb->nx_omap_oid);
+    nx_omap = malloc(block_size);
+    omap_btree = malloc(block_size);
+    if (!nx_omap || !omap_btree) {
+        fprintf(stderr, "\nABORT: Could not allocate sufficient memory for `nx_omap`.\n");
+        goto cleanup;
+    }
+    if (read_node(nx_omap, nxsb->nx_omap_oid) != 1
+        || !is_cksum_valid(nx_omap)
+        || (nx_omap->om_tree_type & OBJ_STORAGETYPE_MASK) != OBJ_PHYSICAL
+    ) {
+        fprintf(stderr, "FAILED.\n");
+        checkpoint->status = CHECKPOINT_BAD_OMAP;
+        checkpoint->bad_addr = nxsb->nx_omap_oid;
+        goto cleanup;
+    }
+    fprintf(stderr, "OK.\n");
+
+    fprintf(stderr, "Reading the root node of the container object map B-tree ... ");
+    if (read_node(omap_btree, nx_omap->om_tree_oid) != 1 || !is_cksum_valid(omap_btree)) {
+        fprintf(stderr, "FAILED.\n");
+        checkpoint->status = CHECKPOINT_BAD_OMAP;
+        checkpoint->bad_addr = nx_omap->om_tree_oid;
+        goto cleanup;
+    }
+    fprintf(stderr, "OK.\n");
+    mounted->omap_tree_addr = nx_omap->om_tree_oid;
+    mounted->omap_btree = omap_btree;
+
+    while (mounted->num_volumes < NX_MAX_FILE_SYSTEMS && nxsb->nx_fs_oid[mounted->num_volumes] != 0) {
+        mounted->num_volumes++;
+    }
+
+    fprintf(stderr, "Reading and validating the %u APFS volume superblocks ... ", mounted->num_volumes);
+    apsbs = malloc(block_size * (mounted->num_volumes ? mounted->num_volumes : 1));
+    if (!apsbs) {
+        fprintf(stderr, "\nABORT: Could not allocate sufficient memory for `apsbs`.\n");
+        goto cleanup;
+    }
+    mounted->apsbs = apsbs;
+    for (uint32_t i = 0; i < mounted->num_volumes; i++) {
+        omap_val_t* fs_val = get_btree_phys_omap_val(omap_btree, nxsb->nx_fs_oid[i], nxsb->nx_o.o_xid);
+        if (!fs_val) {
+            fprintf(stderr, "FAILED.\n- No objects with OID 0x%llx exist in the container object map.\n", nxsb->nx_fs_oid[i]);
+            checkpoint->status = CHECKPOINT_BAD_VOLUME;
+            goto cleanup;
+        }
+        mounted->volumes[i].apsb_addr = fs_val->ov_paddr;
+        free(fs_val);
+
+        apfs_superblock_t* apsb = (apfs_superblock_t*)(apsbs + i * block_size);
+        if (read_node(apsb, mounted->volumes[i].apsb_addr) != 1
+            || !is_cksum_valid(apsb)
+            || apsb->apfs_magic != APFS_MAGIC
+        ) {
+            fprintf(stderr, "FAILED.\n- The APFS volume with OID 0x%llx is malformed.\n", nxsb->nx_fs_oid[i]);
+            checkpoint->status = CHECKPOINT_BAD_VOLUME;
+            checkpoint->bad_addr = mounted->volumes[i].apsb_addr;
+            goto cleanup;
+        }
+        locate_volume_trees(mounted, i);
+    }
+    fprintf(stderr, "OK.\n");
+    checkpoint->status = CHECKPOINT_OK;
+
+    // Only now replace the container's state.
+    if (!container->nxsb) {
+        container->nxsb = malloc(block_size);
+        if (!container->nxsb) {
+            fprintf(stderr, "\nABORT: Could not allocate sufficient memory to create `nxsb`.\n");
+            goto cleanup;
+        }
+    }
+    memcpy(container->nxsb, nxsb, block_size);
+    container->nxsb_index = checkpoint->nxsb_index;
+    free(container->omap_btree);
+    free(container->apsbs);
+    container->omap_tree_addr = mounted->omap_tree_addr;
+    container->omap_btree = omap_btree;
+    container->num_volumes = mounted->num_volumes;
+    container->apsbs = apsbs;
+    memcpy(container->volumes, mounted->volumes, sizeof(container->volumes));
+    omap_btree = NULL;
+    apsbs = NULL;
+    result = 0;
+
+cleanup:
+    free(mounted);
+    free(apsbs);
+    free(omap_btree);
+    free(nx_omap);
+    return result;
+}
+
+void* read_ephemeral_object(nx_superblock_t* nxsb, oid_t oid, uint32_t* size) {
+    size_t block_size = nx_device->block_size;
+    uint32_t xp_desc_blocks = nxsb->nx_xp_desc_blocks & ~(1 << 31);
+    if ((nxsb->nx_xp_desc_blocks >> 31) || xp_desc_blocks == 0) {
+        fprintf(stderr, "\nABORT: read_ephemeral_object: The checkpoint descriptor area is not contiguous.\n");
+        return NULL;
+    }
+
+    checkpoint_map_phys_t* xp_map = malloc(block_size);
+    if (!xp_map) {
+        fprintf(stderr, "\nABORT: read_ephemeral_object: Could not allocate sufficient memory for `xp_map`.\n");
+        return NULL;
+    }
+
+    checkpoint_mapping_t mapping = {0};
+    bool found = false;
+    for (uint32_t i = 0; i < nxsb->nx_xp_desc_len && !found; i++) {
+        paddr_t addr = nxsb->nx_xp_desc_base + (nxsb->nx_xp_desc_index + i) % xp_desc_blocks;
+        if (read_blocks(xp_map, addr, 1) != 1) {
+            fprintf(stderr, "\nABORT: read_ephemeral_object: Failed to read block 0x%llx.\n", addr);
+            free(xp_map);
+            return NULL;
+        }
+        if (!is_checkpoint_map_phys(xp_map) || !is_cksum_valid(xp_map) || xp_map->cpm_o.o_xid != nxsb->nx_o.o_xid) {
+            continue;
+        }
+        uint32_t count = get_checkpoint_map_count(xp_map);
+        for (uint32_t j = 0; j < count; j++) {
+            if (xp_map->cpm_map[j].cpm_oid == oid) {
+                mapping = xp_map->cpm_map[j];
+                found = true;
+                break;
+            }
+        }
+    }
+    free(xp_map);
+    if (!found) {
+        fprintf(stderr, "The Ephemeral object with OID 0x%llx is not in the checkpoint with XID 0x%llx.\n", oid, nxsb->nx_o.o_xid);
+        return NULL;
+    }
+
+    uint32_t num_blocks = (mapping.cpm_size + block_size - 1) / block_size;
+    void* object = malloc((num_blocks ? num_blocks : 1) * block_size);
+    if (!object) {
+        fprintf(stderr, "\nABORT: read_ephemeral_object: Could not allocate sufficient memory for `object`.\n");
+        return NULL;
+    }
+    if (num_blocks == 0 || read_blocks(object, mapping.cpm_paddr, num_blocks) != num_blocks) {
+        fprintf(stderr, "Failed to read the Ephemeral object with OID 0x%llx at block 0x%llx.\n", oid, mapping.cpm_paddr);
+        free(object);
+        return NULL;
+    }
+    if (num_blocks == 1 && !is_cksum_valid(object)) {
+        fprintf(stderr, "The Ephemeral object with OID 0x%llx at block 0x%llx is malformed.\n", oid, mapping.cpm_paddr);
+        free(object);
+        return NULL;
+    }
+    *size = mapping.cpm_size;
+    return object;
+}
+
+checkpoint_timeline_t* get_checkpoint_timeline(container_t* container) {
+    if (!container->timeline) {
+        container->timeline = load_checkpoint_timeline(container->nxsb);
+    }
+    return container->timeline;
+}
+
+container_t* open_checkpoint_view(container_t* container, uint32_t index) {
+    checkpoint_timeline_t* timeline = get_checkpoint_timeline(container);
+    if (!timeline || index >= timeline->num_checkpoints) {
+        return NULL;
+    }
+    node_cache_enable(CHECKPOINT_VIEW_CACHE_NODES);
+
+    container_t* view = calloc(1, sizeof(container_t));
+    if (!view) {
+        fprintf(stderr, "\nABORT: open_checkpoint_view: Could not allocate sufficient memory for `view`.\n");
+        return NULL;
+    }
+    view->dev   = container->dev;
+    view->ino   = container->ino;
+    view->size  = container->size;
+    if (mount_checkpoint(view, timeline, index) != 0) {
+        free_container(view);
+        return NULL;
+    }
+    return view;
+}
@@ -0,0 +1,207 @@
+/**
+ * Functions used to enumerate all of the checkpoints in a container's
+ * checkpoint descriptor area, and to mount any one of them, so that reading a
+ * container can fall back to an older checkpoint when the objects of the
+ * newest one are damaged.
+ *
+ * The checkpoint descriptor area is read once into a timeline of the
+ * checkpoints whose container superblocks are valid, newest first. Whether the
+ * rest of each checkpoint (its checkpoint-mapping blocks, Ephemeral objects,
+ * container object map, and volume superblocks) is intact is only determined
+ * when the checkpoint is first mounted, and is remembered in the timeline.
+ *
+ * A checkpoint can be opened as a read-only view, which is a `container_t`
+ * like the one `open_container()` returns. Views read through `read_node()`,
+ * so while the node cache is enabled (which opening a view does), nodes shared
+ * by several checkpoints are only read and verified once.
+ */
+
+#ifndef APFS_FUNC_CHECKPOINT_H
+#define APFS_FUNC_CHECKPOINT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "../io.h"
+#include "../struct/general.h"
+#include "../struct/object.h"
+#include "../struct/nx.h"
+#include "../struct/omap.h"
+#include "../struct/fs.h"
+
+#include "boolean.h"
+#include "cksum.h"
+#include "btree.h"
+#include "container.h"
+#include "node_cache.h"
+
+/** Checkpoint constants **/
+
+#define CHECKPOINT_VIEW_CACHE_NODES     4096    // Node cache capacity enabled by `open_checkpoint_view()`
+
+/**
+ * Whether a checkpoint is intact, and if not, which part of it is damaged.
+ */
+typedef enum {
+    CHECKPOINT_UNCHECKED = 0,   // Not yet mounted
+    CHECKPOINT_OK,
+    CHECKPOINT_BAD_MAP,         // A checkpoint-mapping block is malformed
+    CHECKPOINT_BAD_EPHEMERAL,   // An Ephemeral object is unreadable or malformed
+    CHECKPOINT_BAD_OMAP,        // The container object map is unreadable or malformed
+    CHECKPOINT_BAD_VOLUME,      // A volume superblock is missing or malformed
+} checkpoint_status_t;
+
+/**
+ * A checkpoint in a timeline.
+ *
+ * nxsb_index:  The index of the checkpoint's container superblock within the
+ *      checkpoint descriptor area.
+ *
+ * bad_addr:    If the checkpoint is damaged, the address of the damaged object,
+ *      if known.
+ *
+ * objects_checked: Whether the checkpoint's checkpoint-mapping blocks and
+ *      Ephemeral objects have been found to be intact.
+ */
+typedef struct {
+    uint32_t            nxsb_index;
+    xid_t               xid;
+    checkpoint_status_t status;
+    paddr_t             bad_addr;
+    bool                objects_checked;
+} checkpoint_t;
+
+/**
+ * The checkpoints of a container.
+ *
+ * xp_desc:     A copy of the whole checkpoint descriptor area, which is
+ *      `xp_desc_blocks` blocks long.
+ *
+ * cksum_ok:    Whether the checksum of each block of `xp_desc` is valid.
+ *
+ * checkpoints: The checkpoints whose container superblocks are valid, sorted by
+ *      XID, newest first.
+ */
+typedef struct nx_checkpoint_timeline {
+    char*           xp_desc;
+    uint32_t        xp_desc_blocks;
+    uint8_t*        cksum_ok;
+    uint32_t        num_checkpoints;
+    checkpoint_t*   checkpoints;
+} checkpoint_timeline_t;
+
+/**
+ * Read the checkpoint descriptor area described by a container superblock, and
+ * enumerate the checkpoints within it.
+ *
+ * RETURN VALUE:
+ *      A pointer to the timeline, which must be freed with
+ *      `checkpoint_timeline_free()` when no longer needed; or NULL if an error
+ *      occurs.
+ */
+checkpoint_timeline_t* load_checkpoint_timeline(nx_superblock_t* nxsb);
+
+/**
+ * Enumerate the checkpoints in the copy of the checkpoint descriptor area held
+ * by a timeline, replacing `timeline->checkpoints`.
+ *
+ * known:       Checkpoints from a previous enumeration, whose status is kept
+ *      if they are still present; or NULL.
+ */
+void index_checkpoints(checkpoint_timeline_t* timeline, checkpoint_t* known, uint32_t num_known);
+
+void checkpoint_timeline_free(checkpoint_timeline_t* timeline);
+
+/**
+ * Bring a timeline up to date with any checkpoints written since it was
+ * loaded or last polled, e.g. while another system is writing to the
+ * container. Only the blocks of the new checkpoints are read, plus the one
+ * after them, so polling a container that hasn't changed reads one block.
+ * When there are new checkpoints, the superblocks of the known ones are read
+ * again too, to tell whether the writer has gone all the way around the
+ * checkpoint descriptor area, in which case the whole area is read again.
+ * Checkpoints that the new ones have overwritten are dropped.
+ *
+ * blocks_read: If not NULL, the number of blocks read will be stored here.
+ *
+ * RETURN VALUE:
+ *      The number of new checkpoints, or a negative value if an error occurs.
+ */
+int poll_checkpoint_timeline(checkpoint_timeline_t* timeline, uint32_t* blocks_read);
+
+/**
+ * Get a pointer to the container superblock of a checkpoint, within
+ * `timeline->xp_desc`.
+ */
+nx_superblock_t* get_checkpoint_superblock(checkpoint_timeline_t* timeline, checkpoint_t* checkpoint);
+
+/**
+ * Get a string describing a checkpoint status, e.g. for listings.
+ */
+const char* checkpoint_status_string(checkpoint_status_t status);
+
+/**
+ * Check a checkpoint's checkpoint-mapping blocks and Ephemeral objects, unless
+ * that has already been done, storing the outcome in `checkpoint->status`.
+ *
+ * RETURN VALUE:
+ *      `checkpoint->status`, which is either `CHECKPOINT_UNCHECKED` (meaning
+ *      that the rest of the checkpoint has yet to be checked by mounting it),
+ *      or else `CHECKPOINT_OK` or the reason the checkpoint is damaged.
+ */
+checkpoint_status_t validate_checkpoint(checkpoint_timeline_t* timeline, checkpoint_t* checkpoint);
+
+/**
+ * Simulate a mount of a given checkpoint: validate it, then resolve its
+ * container object map and volume superblocks into `container`, whose fields
+ * are only changed if this succeeds. The outcome is stored in the checkpoint's
+ * `status`.
+ *
+ * index:       The index of the checkpoint within `timeline->checkpoints`.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value on failure.
+ */
+int mount_checkpoint(container_t* container, checkpoint_timeline_t* timeline, uint32_t index);
+
+/**
+ * Read an Ephemeral object of the checkpoint described by a given container
+ * superblock, by looking it up in that checkpoint's checkpoint-mapping blocks.
+ * Objects that are only one block long are checked for a valid checksum.
+ *
+ * size:        The size of the object, in bytes, will be stored here.
+ *
+ * RETURN VALUE:
+ *      A pointer to the object, with a whole number of blocks of memory
+ *      allocated for it, which must be freed when no longer needed; or NULL if
+ *      the object can't be found or read.
+ */
+void* read_ephemeral_object(nx_superblock_t* nxsb, oid_t oid, uint32_t* size);
+
+/**
+ * Get the timeline of a container's checkpoints, loading it if the container's
+ * state was loaded from the cache.
+ *
+ * RETURN VALUE:
+ *      A pointer to the timeline, which is freed along with the container; or
+ *      NULL if an error occurs.
+ */
+checkpoint_timeline_t* get_checkpoint_timeline(container_t* container);
+
+/**
+ * Open a read-only view of a given checkpoint of a container, enabling the
+ * node cache if it isn't enabled already.
+ *
+ * index:       The index of the checkpoint within the container's timeline.
+ *
+ * RETURN VALUE:
+ *      A pointer to the view, which must be freed with `free_container()`
+ *      before `container` is closed; or NULL if the checkpoint is damaged or an
+ *      error occurs.
+ */
+container_t* open_checkpoint_view(container_t* container, uint32_t index);
+
+#endif // APFS_FUNC_CHECKPOINT_H
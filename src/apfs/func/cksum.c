@@ -0,0 +1,251 @@
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "cksum.h"
+
+#define FLETCHER_MODULUS    0xffffffffULL   // = 2^32 - 1
+
+void fletcher_sums_scalar(uint32_t* words, size_t num_words, uint64_t* simple_sum, uint64_t* second_sum) {
+    uint64_t sum1 = *simple_sum;
+    uint64_t sum2 = *second_sum;
+    while (num_words > 0) {
+        size_t n = num_words < FLETCHER_CHUNK_WORDS ? num_words : FLETCHER_CHUNK_WORDS;
+        for (size_t i = 0; i < n; i++) {
+            sum1 += words[i];
+            sum2 += sum1;
+        }
+        sum1 %= FLETCHER_MODULUS;
+        sum2 %= FLETCHER_MODULUS;
+        words += n;
+        num_words -= n;
+    }
+    *simple_sum = sum1;
+    *second_sum = sum2;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+/**
+ * Fold the lanes of a SIMD implementation into the running sums, after it has
+ * processed `num_words` words. Word `i` went to lane `i % num_lanes`, which
+ * summed the words it was given in `lane_sum1` and the running values of
+ * `lane_sum1` after each of its words in `lane_sum2`.
+ *
+ * The contribution of the words to `second_sum` is the sum, over all words,
+ * of each word times the number of words from it to the end, inclusive. Each
+ * lane counts this in units of `num_lanes` words, so it overcounts word `i` by
+ * `i % num_lanes` times the word, which is subtracted. This is exact, since
+ * the lane sums never exceed 64 bits within `FLETCHER_CHUNK_WORDS` words.
+ */
+void fletcher_fold_lanes(uint64_t* lane_sum1, uint64_t* lane_sum2, size_t num_lanes, size_t num_words, uint64_t* simple_sum, uint64_t* second_sum) {
+    uint64_t sum1 = 0;
+    uint64_t sum2 = 0;
+    uint64_t overcount = 0;
+    for (size_t j = 0; j < num_lanes; j++) {
+        sum1 += lane_sum1[j];
+        sum2 += lane_sum2[j];
+        overcount += j * lane_sum1[j];
+    }
+    sum2 = num_lanes * sum2 - overcount;
+
+    // The previous `simple_sum` is added to `second_sum` once per word.
+    *second_sum = (*second_sum + num_words * *simple_sum + sum2) % FLETCHER_MODULUS;
+    *simple_sum = (*simple_sum + sum1) % FLETCHER_MODULUS;
+}
+
+__attribute__((target("sse2")))
+void fletcher_sums_sse2(uint32_t* words, size_t num_words, uint64_t* simple_sum, uint64_t* second_sum) {
+    __m128i zero = _mm_setzero_si128();
+    while (num_words >= 4) {
+        size_t n = num_words < FLETCHER_CHUNK_WORDS ? num_words & ~(size_t)3 : FLETCHER_CHUNK_WORDS;
+
+        // `a0`/`b0` hold lanes 0 and 1, and `a1`/`b1` hold lanes 2 and 3.
+        __m128i a0 = zero, a1 = zero, b0 = zero, b1 = zero;
+        for (size_t i = 0; i < n; i += 4) {
+            __m128i w = _mm_loadu_si128((__m128i*)(words + i));
+            a0 = _mm_add_epi64(a0, _mm_unpacklo_epi32(w, zero));
+            a1 = _mm_add_epi64(a1, _mm_unpackhi_epi32(w, zero));
+            b0 = _mm_add_epi64(b0, a0);
+            b1 = _mm_add_epi64(b1, a1);
+        }
+
+        uint64_t lane_sum1[4], lane_sum2[4];
+        _mm_storeu_si128((__m128i*)lane_sum1,       a0);
+        _mm_storeu_si128((__m128i*)(lane_sum1 + 2), a1);
+        _mm_storeu_si128((__m128i*)lane_sum2,       b0);
+        _mm_storeu_si128((__m128i*)(lane_sum2 + 2), b1);
+        fletcher_fold_lanes(lane_sum1, lane_sum2, 4, n, simple_sum, second_sum);
+
+        words += n;
+        num_words -= n;
+    }
+    fletcher_sums_scalar(words, num_words, simple_sum, second_sum);
+}
+
+__attribute__((target("avx2")))
+void fletcher_sums_avx2(uint32_t* words, size_t num_words, uint64_t* simple_sum, uint64_t* second_sum) {
+    while (num_words >= 8) {
+        size_t n = num_words < FLETCHER_CHUNK_WORDS ? num_words & ~(size_t)7 : FLETCHER_CHUNK_WORDS;
+
+        // `a0`/`b0` hold lanes 0 to 3, and `a1`/`b1` hold lanes 4 to 7.
+        __m256i a0 = _mm256_setzero_si256(), a1 = a0, b0 = a0, b1 = a0;
+        for (size_t i = 0; i < n; i += 8) {
+            a0 = _mm256_add_epi64(a0, _mm256_cvtepu32_epi64(_mm_loadu_si128((__m128i*)(words + i))));
+            a1 = _mm256_add_epi64(a1, _mm256_cvtepu32_epi64(_mm_loadu_si128((__m128i*)(words + i + 4))));
+            b0 = _mm256_add_epi64(b0, a0);
+            b1 = _mm256_add_epi64(b1, a1);
+        }
+
+        uint64_t lane_sum1[8], lane_sum2[8];
+        _mm256_storeu_si256((__m256i*)lane_sum1,       a0);
+        _mm256_storeu_si256((__m256i*)(lane_sum1 + 4), a1);
+        _mm256_storeu_si256((__m256i*)lane_sum2,       b0);
+        _mm256_storeu_si256((__m256i*)(lane_sum2 + 4), b1);
+        fletcher_fold_lanes(lane_sum1, lane_sum2, 8, n, simple_sum, second_sum);
+
+        words += n;
+        num_words -= n;
+    }
+    fletcher_sums_scalar(words, num_words, simple_sum, second_sum);
+}
+
+__attribute__((target("avx512f")))
+void fletcher_sums_avx512(uint32_t* words, size_t num_words, uint64_t* simple_sum, uint64_t* second_sum) {
+    while (num_words >= 16) {
+        size_t n = num_words < FLETCHER_CHUNK_WORDS ? num_words & ~(size_t)15 : FLETCHER_CHUNK_WORDS;
+
+        // `a0`/`b0` hold lanes 0 to 7, and `a1`/`b1` hold lanes 8 to 15.
+        __m512i a0 = _mm512_setzero_si512(), a1 = a0, b0 = a0, b1 = a0;
+        for (size_t i = 0; i < n; i += 16) {
+            a0 = _mm512_add_epi64(a0, _mm512_cvtepu32_epi64(_mm256_loadu_si256((__m256i*)(words + i))));
+            a1 = _mm512_add_epi64(a1, _mm512_cvtepu32_epi64(_mm256_loadu_si256((__m256i*)(words + i + 8))));
+            b0 = _mm512_add_epi64(b0, a0);
+            b1 = _mm512_add_epi64(b1, a1);
+        }
+
+        uint64_t lane_sum1[16], lane_sum2[16];
+        _mm512_storeu_si512(lane_sum1,     a0);
+        _mm512_storeu_si512(lane_sum1 + 8, a1);
+        _mm512_storeu_si512(lane_sum2,     b0);
+        _mm512_storeu_si512(lane_sum2 + 8, b1);
+        fletcher_fold_lanes(lane_sum1, lane_sum2, 16, n, simple_sum, second_sum);
+
+        words += n;
+        num_words -= n;
+    }
+    fletcher_sums_scalar(words, num_words, simple_sum, second_sum);
+}
+
+#endif // x86
+
+fletcher_sums_func_t    fletcher_sums_func = fletcher_sums_scalar;
+const char*             fletcher_sums_name = "scalar";
+pthread_once_t          fletcher_sums_once = PTHREAD_ONCE_INIT;
+
+void select_fletcher_sums_func() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        fletcher_sums_func = fletcher_sums_avx512;
+        fletcher_sums_name = "avx512";
+    } else if (__builtin_cpu_supports("avx2")) {
+        fletcher_sums_func = fletcher_sums_avx2;
+        fletcher_sums_name = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        fletcher_sums_func = fletcher_sums_sse2;
+        fletcher_sums_name = "sse2";
+    }
+#endif
+}
+
+fletcher_sums_func_t get_fletcher_sums_func(const char** name) {
+    pthread_once(&fletcher_sums_once, select_fletcher_sums_func);
+    if (name) {
+        *name = fletcher_sums_name;
+    }
+    return fletcher_sums_func;
+}
+
+uint64_t fletcher_cksum(uint32_t* block, bool compute) {
+    int num_words = nx_device->block_size / 4;  // Using 32-bit words.
+    uint32_t modulus = ~0;  // all ones; = 2^32 - 1
+
+    // These are 32-bit values, but we need at least 33 bits of memory for each
+    // of these in order to compute them, as values can overflow during
+    // summation before the modulus is taken.
+    // We use the next best thing: 64 bits.
+    uint64_t simple_sum = 0;
+    uint64_t second_sum = 0;
+
+    // NOTE: When computing the checksum, `i = 2` is used here since we treat
+    // the first 64 bits of the block as zero. When validating the checksum, we
+    // compute the traditional Fletcher-64 checksum of the entire block.
+    int i = compute ? 2 : 0;
+    get_fletcher_sums_func(NULL)(block + i, num_words - i, &simple_sum, &second_sum);
+
+    /**
+     * APFS uses a variant of the traditional Flecther-64 checksum.
+     * See: https://blog.cugu.eu/post/apfs/#checksum
+     * 
+     * In particular:
+     * 
+     * - Instead of `simple_sum`, APFS uses `c1`, which (in number theory lingo)
+     * is the remainder of `- (simple_sum + second_sum)` modulo `modulus`.
+     * 
+     * - Instead of `second_sum`, APFS uses `c2`, which (in number theory lingo)
+     * is the remainder of  `- (simple_sum + c1)` modulo `modulus`. However, it
+     * turns out that this `c2` value always just equals `second_sum` itself,
+     * so there is no need to compute `c2`.
+     * 
+     * This variant of Fletcher-64 means that, when validating against the
+     * stored checksum, we just compute the traditional Fletcher-64 checksum of
+     * the whole block (including the stored checksum) and the computed value
+     * should be zero if the stored checksum is correct.
+     * 
+     * Here, if we are computing the checksum rather than validating the block
+     * against the stored checksum, we compute `c1` and just store it in the
+     * variable `simple_sum`.
+     */
+    // if (compute) {
+        simple_sum = modulus - ((simple_sum + second_sum) % modulus);
+    // }
+
+    return (second_sum << 32) | simple_sum;
+}
+
+uint64_t compute_block_cksum(uint32_t* block) {
+    return fletcher_cksum(block, 1);
+}
+
+char is_cksum_valid(uint32_t* block) {
+    // TODO: The following "simple" implementation doesn't appear to work.
+    // return fletcher_cksum(block, 0) == 0;
+
+    // The following gives the correct result.
+    return compute_block_cksum(block) == *(uint64_t*)block; // dereference of cast give
+}
+
+size_t validate_blocks(const void* blocks[], size_t num_blocks, uint8_t* ok) {
+    size_t num_valid = 0;
+    for (size_t i = 0; i < num_blocks; i++) {
+        ok[i] = is_cksum_valid((uint32_t*)blocks[i]);
+        num_valid += ok[i];
+    }
+    return num_valid;
+}
+
+size_t validate_block_range(const void* blocks, size_t num_blocks, uint8_t* ok) {
+    const void* pointers[64];
+    size_t num_valid = 0;
+    for (size_t i = 0; i < num_blocks; i += 64) {
+        size_t n = num_blocks - i < 64 ? num_blocks - i : 64;
+        for (size_t k = 0; k < n; k++) {
+            pointers[k] = (const char*)blocks + (i + k) * nx_device->block_size;
+        }
+        num_valid += validate_blocks(pointers, n, ok + i);
+    }
+    return num_valid;
+}
@@ -6,14 +6,66 @@
 #define APFS_FUNC_CKSUM_H
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include "../io.h"
 
+/**
+ * The number of words that the `fletcher_sums_*()` functions add up before
+ * reducing their sums modulo 2^32 - 1. With this many words, neither sum can
+ * exceed 64 bits in the meantime, even in the SIMD lanes.
+ */
+#define FLETCHER_CHUNK_WORDS    4096
+
+/**
+ * A function that adds `num_words` 32-bit words to the two running sums of a
+ * Fletcher-64 checksum, as if by:
+ *
+ *      for each word:
+ *          simple_sum = (simple_sum + word)       % (2^32 - 1)
+ *          second_sum = (second_sum + simple_sum) % (2^32 - 1)
+ *
+ * Rather than taking two remainders per word, the sums are accumulated in
+ * 64 bits and only reduced once per `FLETCHER_CHUNK_WORDS` words, which gives
+ * the same result since reduction modulo 2^32 - 1 can be deferred.
+ *
+ * simple_sum, second_sum:  The running sums, each less than 2^32 - 1, which
+ *      are updated in place.
+ */
+typedef void (*fletcher_sums_func_t)(uint32_t* words, size_t num_words, uint64_t* simple_sum, uint64_t* second_sum);
+
+/**
+ * Portable implementation of `fletcher_sums_func_t`.
+ */
+void fletcher_sums_scalar(uint32_t* words, size_t num_words, uint64_t* simple_sum, uint64_t* second_sum);
+
+#if defined(__x86_64__) || defined(__i386__)
+/**
+ * SIMD implementations of `fletcher_sums_func_t`, which split the words
+ * between 4, 8, or 16 lanes of 64-bit sums respectively. These may only be
+ * called if the CPU supports the corresponding instruction set.
+ */
+void fletcher_sums_sse2(uint32_t* words, size_t num_words, uint64_t* simple_sum, uint64_t* second_sum);
+void fletcher_sums_avx2(uint32_t* words, size_t num_words, uint64_t* simple_sum, uint64_t* second_sum);
+void fletcher_sums_avx512(uint32_t* words, size_t num_words, uint64_t* simple_sum, uint64_t* second_sum);
+#endif
+
+/**
+ * Get the fastest implementation of `fletcher_sums_func_t` that the CPU
+ * supports, as determined (once) at runtime.
+ *
+ * name:    If not NULL, the name of the implementation (e.g. "avx2") will be
+ *      stored here.
+ */
+fletcher_sums_func_t get_fletcher_sums_func(const char** name);
+
 /**
  * Compute or validate the checksum of a given APFS block. This is a helper
  * function for `compute_block_cksum()` and `is_cksum_valid()`.
  * 
  * block:   A pointer to the raw APFS block data. This pointer should point
- *          to at least `nx_block_size` bytes (typically 4096 bytes) of data.
+ *          to at least `nx_device->block_size` bytes (typically 4096 bytes)
+ *          of data.
  * 
  * compute: If true, then compute the checksum of the block, treating the
  *          first 64 bits of the block (where the checksum is stored) as zero.
@@ -25,77 +77,44 @@
  *          If `compute` is false, return zero if the checksum validates
  *          successfully, and non-zero if it fails to do so.
  */
-uint64_t fletcher_cksum(uint32_t* block, bool compute) {
-    int num_words = nx_block_size / 4;  // Using 32-bit words.
-    uint32_t modulus = ~0;  // all ones; = 2^32 - 1
-
-    // These are 32-bit values, but we need at least 33 bits of memory for each
-    // of these in order to compute them, as values can overflow during
-    // summation before the modulus is taken.
-    // We use the next best thing: 64 bits.
-    uint64_t simple_sum = 0;
-    uint64_t second_sum = 0;
-
-    // NOTE: When computing the checksum, `i = 2` is used here since we treat
-    // the first 64 bits of the block as zero. When validating the checksum, we
-    // compute the traditional Fletcher-64 checksum of the entire block.
-    for (int i = (compute ? 2 : 0); i < num_words; i++) {
-        simple_sum = (simple_sum + block[i])    % modulus;
-        second_sum = (second_sum + simple_sum)  % modulus;
-    }
-
-    /**
-     * APFS uses a variant of the traditional Flecther-64 checksum.
-     * See: https://blog.cugu.eu/post/apfs/#checksum
-     * 
-     * In particular:
-     * 
-     * - Instead of `simple_sum`, APFS uses `c1`, which (in number theory lingo)
-     * is the remainder of `- (simple_sum + second_sum)` modulo `modulus`.
-     * 
-     * - Instead of `second_sum`, APFS uses `c2`, which (in number theory lingo)
-     * is the remainder of  `- (simple_sum + c1)` modulo `modulus`. However, it
-     * turns out that this `c2` value always just equals `second_sum` itself,
-     * so there is no need to compute `c2`.
-     * 
-     * This variant of Fletcher-64 means that, when validating against the
-     * stored checksum, we just compute the traditional Fletcher-64 checksum of
-     * the whole block (including the stored checksum) and the computed value
-     * should be zero if the stored checksum is correct.
-     * 
-     * Here, if we are computing the checksum rather than validating the block
-     * against the stored checksum, we compute `c1` and just store it in the
-     * variable `simple_sum`.
-     */
-    // if (compute) {
-        simple_sum = modulus - ((simple_sum + second_sum) % modulus);
-    // }
-
-    return (second_sum << 32) | simple_sum;
-}
+uint64_t fletcher_cksum(uint32_t* block, bool compute);
 
 /**
  * Get/compute the checksum of a given APFS block, treating the first 64 bits
  * of the block (the location where the checksum is usually stored) as zero.
  * 
  * block:   A pointer to the raw APFS block data. This pointer should point to
- *      at least `nx_block_size` bytes (typically 4096 bytes) of data.
+ *      at least `nx_device->block_size` bytes (typically 4096 bytes) of data.
  * 
  * RETURN VALUE:    The computed checksum.
  */
-uint64_t compute_block_cksum(uint32_t* block) {
-    return fletcher_cksum(block, 1);
-}
+uint64_t compute_block_cksum(uint32_t* block);
 
 /**
  * Determine whether a given APFS block has a valid checksum.
  */
-char is_cksum_valid(uint32_t* block) {
-    // TODO: The following "simple" implementation doesn't appear to work.
-    // return fletcher_cksum(block, 0) == 0;
+char is_cksum_valid(uint32_t* block);
+
+/**
+ * Determine whether each of several APFS blocks has a valid checksum, as
+ * `is_cksum_valid()` does for one.
+ *
+ * blocks:      Pointers to the blocks, each `nx_device->block_size` bytes long.
+ *
+ * num_blocks:  The number of blocks.
+ *
+ * ok:          For each block, 1 will be stored here if its checksum is valid,
+ *      or 0 if it isn't.
+ *
+ * RETURN VALUE:    The number of blocks whose checksum is valid.
+ */
+size_t validate_blocks(const void* blocks[], size_t num_blocks, uint8_t* ok);
 
-    // The following gives the correct result.
-    return compute_block_cksum(block) == *(uint64_t*)block; // dereference of cast give
-}
+/**
+ * Determine whether each of several contiguous APFS blocks (e.g. as read by
+ * a single call to `read_blocks()`) has a valid checksum; see
+ * `validate_blocks()`.
+ */
+size_t validate_block_range(const void* blocks, size_t num_blocks, uint8_t* ok);
 
 #endif // APFS_FUNC_CKSUM_H
@@ -0,0 +1,97 @@
+#include "cksum_memo.h"
+
+cksum_policy_t get_cksum_policy() {
+    if (nx_device->cksum_policy != CKSUM_POLICY_DEFAULT) {
+        return nx_device->cksum_policy;
+    }
+
+    char* env_policy = getenv("APFS_CKSUM_POLICY");
+    if (env_policy) {
+        if (strcmp(env_policy, "warn") == 0) {
+            return CKSUM_POLICY_WARN;
+        }
+        if (strcmp(env_policy, "off") == 0) {
+            return CKSUM_POLICY_OFF;
+        }
+    }
+    return CKSUM_POLICY_STRICT;
+}
+
+void cksum_memo_free(cksum_memo_t* memo) {
+    if (!memo) {
+        return;
+    }
+    oid_map_free(memo->nodes, free);
+    pthread_mutex_destroy(&memo->lock);
+    free(memo);
+}
+
+bool cksum_memo_enable() {
+    if (nx_device->cksum_memo) {
+        return true;
+    }
+
+    cksum_memo_t* memo = calloc(1, sizeof(cksum_memo_t));
+    if (!memo) {
+        fprintf(stderr, "\nABORT: cksum_memo_enable: Could not allocate sufficient memory for `memo`.\n");
+        return false;
+    }
+    memo->nodes = oid_map_create(1024);
+    if (!memo->nodes) {
+        free(memo);
+        return false;
+    }
+    pthread_mutex_init(&memo->lock, NULL);
+
+    nx_device->cksum_memo = memo;
+    return true;
+}
+
+bool verify_node(void* node, paddr_t addr) {
+    cksum_policy_t policy = get_cksum_policy();
+    if (policy == CKSUM_POLICY_OFF) {
+        return true;
+    }
+
+    obj_phys_t* obj = node;
+    uint64_t cksum = *(uint64_t*)obj->o_cksum;
+
+    cksum_memo_t* memo = nx_device->cksum_memo;
+    if (memo) {
+        pthread_mutex_lock(&memo->lock);
+        cksum_memo_entry_t* entry = oid_map_get(memo->nodes, addr);
+        if (entry && entry->cksum == cksum && entry->xid == obj->o_xid) {
+            bool valid = entry->valid;
+            memo->hits++;
+            pthread_mutex_unlock(&memo->lock);
+            return valid || policy != CKSUM_POLICY_STRICT;
+        }
+        memo->misses++;
+        pthread_mutex_unlock(&memo->lock);
+    }
+
+    bool valid = is_cksum_valid(node);
+    if (!valid && policy == CKSUM_POLICY_WARN) {
+        fprintf(stderr, "WARNING: Checksum of node at block 0x%llx did not validate; using it anyway.\n", addr);
+    }
+
+    if (memo) {
+        // Not being able to remember the outcome isn't an error; the node will
+        // just be verified again the next time it's read.
+        cksum_memo_entry_t* entry = malloc(sizeof(cksum_memo_entry_t));
+        if (entry) {
+            entry->cksum = cksum;
+            entry->xid = obj->o_xid;
+            entry->valid = valid;
+
+            pthread_mutex_lock(&memo->lock);
+            free(oid_map_remove(memo->nodes, addr));
+            if (!oid_map_put(memo->nodes, addr, entry)) {
+                free(entry);
+            }
+            pthread_mutex_unlock(&memo->lock);
+        }
+    }
+
+    return valid || policy != CKSUM_POLICY_STRICT;
+}
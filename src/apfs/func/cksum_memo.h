@@ -0,0 +1,108 @@
+/**
+ * Verification of the checksums of B-tree nodes as they are read, such that
+ * each node is only verified once per run.
+ *
+ * Looking up file-system objects reads the same few nodes (chiefly the upper
+ * levels of each tree) over and over, so rather than computing a node's
+ * checksum every time, we remember the checksum and XID that each node had
+ * when it was verified. A node whose stored checksum and XID match what we
+ * remember needs no further work. Nodes that failed verification are
+ * remembered too, so that each one is only reported once.
+ *
+ * Each container has its own memo, which is created when the container is
+ * mounted (see `load_container()`), and may be used from multiple threads at
+ * once. Nodes are still verified if a container has no memo, just every time
+ * they are read.
+ */
+
+#ifndef APFS_FUNC_CKSUM_MEMO_H
+#define APFS_FUNC_CKSUM_MEMO_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "../io.h"
+#include "../struct/general.h"
+#include "../struct/object.h"
+
+#include "cksum.h"
+#include "oid_map.h"
+
+/**
+ * What to do when a node's checksum doesn't validate.
+ *
+ * CKSUM_POLICY_DEFAULT:    Use the policy named by the environment variable
+ *      `APFS_CKSUM_POLICY` (`strict`, `warn`, or `off`), or else
+ *      `CKSUM_POLICY_STRICT`.
+ *
+ * CKSUM_POLICY_STRICT:     Treat the node as unreadable.
+ *
+ * CKSUM_POLICY_WARN:       Print a warning, then use the node anyway.
+ *
+ * CKSUM_POLICY_OFF:        Don't verify checksums at all.
+ */
+typedef enum {
+    CKSUM_POLICY_DEFAULT = 0,
+    CKSUM_POLICY_STRICT,
+    CKSUM_POLICY_WARN,
+    CKSUM_POLICY_OFF,
+} cksum_policy_t;
+
+/**
+ * The outcome of verifying a node, as remembered by the memo.
+ */
+typedef struct {
+    uint64_t    cksum;
+    xid_t       xid;
+    bool        valid;
+} cksum_memo_entry_t;
+
+/**
+ * nodes:       Maps the physical address of each verified node to the outcome
+ *      of verifying it.
+ *
+ * hits, misses:    Statistics on lookups.
+ */
+typedef struct nx_cksum_memo {
+    oid_map_t*      nodes;
+    pthread_mutex_t lock;
+
+    uint64_t        hits;
+    uint64_t        misses;
+} cksum_memo_t;
+
+/**
+ * Get the policy in effect for the current container (see `cksum_policy` in
+ * `nx_device_t`), resolving `CKSUM_POLICY_DEFAULT`.
+ */
+cksum_policy_t get_cksum_policy();
+
+/**
+ * Create the memo of the current container (see `nx_device` in `apfs/io.h`),
+ * if it doesn't already have one.
+ *
+ * RETURN VALUE:
+ *      True on success, or false if memory could not be allocated.
+ */
+bool cksum_memo_enable();
+
+/**
+ * Free a memo and all of the entries in it.
+ */
+void cksum_memo_free(cksum_memo_t* memo);
+
+/**
+ * Verify the checksum of a B-tree node that was read from a given address in
+ * the current container (see `nx_device` in `apfs/io.h`), unless a node with
+ * the same checksum and XID was already verified at that address.
+ *
+ * RETURN VALUE:
+ *      True if the node may be used, i.e. if its checksum is valid or the
+ *      policy in effect isn't `CKSUM_POLICY_STRICT`. Otherwise, false.
+ */
+bool verify_node(void* node, paddr_t addr);
+
+#endif // APFS_FUNC_CKSUM_MEMO_H
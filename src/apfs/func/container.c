@@ -0,0 +1,507 @@
+#include "container.h"
+#include "carve.h"
+#include "checkpoint.h"
+#include "fusion.h"
+
+apfs_superblock_t* get_volume_superblock(container_t* container, uint32_t volume_id) {
+    return container->apsbs + volume_id * nx_device->block_size;
+}
+
+void free_container(container_t* container) {
+    if (!container) {
+        return;
+    }
+    free(container->nxsb);
+    free(container->omap_btree);
+    free(container->apsbs);
+    checkpoint_timeline_free(container->timeline);
+    free(container);
+}
+
+void close_container(container_t* container) {
+    if (!container) {
+        return;
+    }
+    free_container(container);
+    carved_tree_free(nx_device->carved_tree);
+    nx_device->carved_tree = NULL;
+    free(nx_device->volume_key);
+    nx_device->volume_key = NULL;
+    fusion_map_free(nx_device->fusion_map);
+    nx_device->fusion_map = NULL;
+    if (nx_device->tier2_file) {
+        fclose(nx_device->tier2_file);
+        nx_device->tier2_file = NULL;
+        nx_device->tier2_path = NULL;
+    }
+    if (nx_device->file) {
+        fclose(nx_device->file);
+        nx_device->file = NULL;
+    }
+}
+
+char* get_cache_dir() {
+    if (getenv("APFS_NO_CACHE")) {
+        return NULL;
+    }
+
+    char* env_dir = getenv("APFS_CACHE_DIR");
+    if (env_dir && *env_dir) {
+        return strdup(env_dir);
+    }
+
+    char* base = getenv("XDG_CACHE_HOME");
+    char* suffix = "/apfs-tools";
+    if (!base || !*base) {
+        base = getenv("HOME");
+        suffix = "/.cache/apfs-tools";
+    }
+    if (!base || !*base) {
+        return NULL;
+    }
+    char* dir = malloc(strlen(base) + strlen(suffix) + 1);
+    if (dir) {
+        sprintf(dir, "%s%s", base, suffix);
+        // Create each missing component, e.g. `~/.cache` then `~/.cache/apfs-tools`
+        for (char* slash = dir + strlen(base) + 1; (slash = strchr(slash, '/')); slash++) {
+            *slash = '\0';
+            mkdir(dir, 0700);
+            *slash = '/';
+        }
+        mkdir(dir, 0700);
+    }
+    return dir;
+}
+
+char* get_container_cache_path(container_t* container) {
+    char* dir = get_cache_dir();
+    if (!dir) {
+        return NULL;
+    }
+
+    char* path = malloc(strlen(dir) + 64);
+    if (path) {
+        sprintf(path, "%s/nx-%llx-%llx.cache", dir, container->dev, container->ino);
+    }
+    free(dir);
+    return path;
+}
+
+bool load_container_cache(container_t* container, char* cache_path) {
+    FILE* cache = fopen(cache_path, "rb");
+    if (!cache) {
+        return false;
+    }
+
+    bool result = false;
+    char* block = malloc(nx_device->block_size);
+    container_cache_t* header = malloc(sizeof(container_cache_t));
+    container->nxsb = malloc(nx_device->block_size);
+    if (!block || !header || !container->nxsb) {
+        goto cleanup;
+    }
+
+    if (
+            fread(header, sizeof(container_cache_t), 1, cache) != 1
+            || header->magic        != CONTAINER_CACHE_MAGIC
+            || header->version      != CONTAINER_CACHE_VERSION
+            || header->block_size   != nx_device->block_size
+            || header->dev          != container->dev
+            || header->ino          != container->ino
+            || header->size         != container->size
+            || header->num_volumes  >  NX_MAX_FILE_SYSTEMS
+            || fread(container->nxsb, nx_device->block_size, 1, cache) != 1
+    ) {
+        goto cleanup;
+    }
+    nx_superblock_t* nxsb = container->nxsb;
+    xid_t xid = nxsb->nx_o.o_xid;
+    if (xid != header->xid || (nxsb->nx_xp_desc_blocks >> 31) || header->nxsb_index >= nxsb->nx_xp_desc_blocks) {
+        goto cleanup;
+    }
+
+    // The container superblock must still be on disk, unchanged.
+    if (
+            read_blocks(block, nxsb->nx_xp_desc_base + header->nxsb_index, 1) != 1
+            || memcmp(block, nxsb, nx_device->block_size) != 0
+    ) {
+        fprintf(stderr, "The cached container state is out of date.\n");
+        goto cleanup;
+    }
+
+    // A newer checkpoint would begin at the next index in the checkpoint
+    // descriptor area, and a clean unmount would also write it to block 0x0.
+    paddr_t next_addr = nxsb->nx_xp_desc_base + nxsb->nx_xp_desc_next % nxsb->nx_xp_desc_blocks;
+    paddr_t check_addrs[] = { next_addr, 0x0 };
+    for (int i = 0; i < 2; i++) {
+        if (read_blocks(block, check_addrs[i], 1) != 1) {
+            goto cleanup;
+        }
+        if (is_cksum_valid(block) && ((obj_phys_t*)block)->o_xid > xid) {
+            fprintf(stderr, "The cached container state is out of date; a newer checkpoint exists.\n");
+            goto cleanup;
+        }
+    }
+
+    container->omap_btree = malloc(nx_device->block_size);
+    container->apsbs = malloc(nx_device->block_size * (header->num_volumes ? header->num_volumes : 1));
+    if (!container->omap_btree || !container->apsbs) {
+        goto cleanup;
+    }
+    if (
+            read_blocks(container->omap_btree, header->omap_tree_addr, 1) != 1
+            || !is_cksum_valid(container->omap_btree)
+    ) {
+        goto cleanup;
+    }
+    for (uint32_t i = 0; i < header->num_volumes; i++) {
+        apfs_superblock_t* apsb = container->apsbs + i * nx_device->block_size;
+        if (
+                read_blocks(apsb, header->volumes[i].apsb_addr, 1) != 1
+                || !is_cksum_valid(apsb)
+                || apsb->apfs_magic != APFS_MAGIC
+                || apsb->apfs_o.o_oid != nxsb->nx_fs_oid[i]
+        ) {
+            goto cleanup;
+        }
+    }
+
+    container->nxsb_index       = header->nxsb_index;
+    container->omap_tree_addr   = header->omap_tree_addr;
+    container->num_volumes      = header->num_volumes;
+    memcpy(container->volumes, header->volumes, sizeof(container->volumes));
+    container->from_cache       = true;
+    result = true;
+
+cleanup:
+    if (!result) {
+        free(container->nxsb);
+        free(container->omap_btree);
+        free(container->apsbs);
+        container->nxsb         = NULL;
+        container->omap_btree   = NULL;
+        container->apsbs        = NULL;
+    }
+    free(header);
+    free(block);
+    fclose(cache);
+    return result;
+}
+
+void save_container_cache(container_t* container, char* cache_path) {
+    container_cache_t* header = calloc(1, sizeof(container_cache_t));
+    char* tmp_path = malloc(strlen(cache_path) + 32);
+    if (!header || !tmp_path) {
+        free(header);
+        free(tmp_path);
+        return;
+    }
+
+    header->magic           = CONTAINER_CACHE_MAGIC;
+    header->version         = CONTAINER_CACHE_VERSION;
+    header->dev             = container->dev;
+    header->ino             = container->ino;
+    header->size            = container->size;
+    header->block_size      = nx_device->block_size;
+    header->nxsb_index      = container->nxsb_index;
+    header->xid             = container->nxsb->nx_o.o_xid;
+    header->omap_tree_addr  = container->omap_tree_addr;
+    header->num_volumes     = container->num_volumes;
+    memcpy(header->volumes, container->volumes, sizeof(header->volumes));
+
+    sprintf(tmp_path, "%s.%ld", cache_path, (long)getpid());
+    FILE* cache = fopen(tmp_path, "wb");
+    if (!cache) {
+        free(header);
+        free(tmp_path);
+        return;
+    }
+    bool ok = fwrite(header, sizeof(container_cache_t), 1, cache) == 1
+        && fwrite(container->nxsb, nx_device->block_size, 1, cache) == 1;
+    ok = (fclose(cache) == 0) && ok;
+    if (!ok || rename(tmp_path, cache_path) != 0) {
+        unlink(tmp_path);
+    }
+
+    free(header);
+    free(tmp_path);
+}
+
+void locate_volume_trees(container_t* container, uint32_t volume_id) {
+    apfs_superblock_t* apsb = get_volume_superblock(container, volume_id);
+    container_volume_t* volume = container->volumes + volume_id;
+
+    omap_phys_t* fs_omap = malloc(nx_device->block_size);
+    btree_node_phys_t* fs_omap_btree = malloc(nx_device->block_size);
+    if (!fs_omap || !fs_omap_btree) {
+        goto cleanup;
+    }
+
+    if (
+            read_node(fs_omap, apsb->apfs_omap_oid) != 1
+            || !is_cksum_valid(fs_omap)
+            || (fs_omap->om_tree_type & OBJ_STORAGETYPE_MASK) != OBJ_PHYSICAL
+    ) {
+        goto cleanup;
+    }
+    if (read_node(fs_omap_btree, fs_omap->om_tree_oid) != 1 || !is_cksum_valid(fs_omap_btree)) {
+        goto cleanup;
+    }
+    volume->omap_tree_addr = fs_omap->om_tree_oid;
+
+    omap_val_t* fs_root_val = get_btree_phys_omap_val(fs_omap_btree, apsb->apfs_root_tree_oid, apsb->apfs_o.o_xid);
+    if (fs_root_val) {
+        volume->fs_root_addr = fs_root_val->ov_paddr;
+        free(fs_root_val);
+    }
+
+cleanup:
+    free(fs_omap_btree);
+    free(fs_omap);
+}
+
+int mount_container(container_t* container, xid_t max_xid) {
+    int result = -1;
+
+    fprintf(stderr, "Simulating a mount of the APFS container.\n");
+
+    // Using `nx_superblock_t*`, but allocating a whole block of memory.
+    // This way, we can read the entire block and validate its checksum,
+    // but still have direct access to the fields in `nx_superblock_t`
+    // without needing to epxlicitly cast to that datatype.
+    nx_superblock_t* nxsb = malloc(nx_device->block_size);
+    if (!nxsb) {
+        fprintf(stderr, "ABORT: Could not allocate sufficient memory to create `nxsb`.\n");
+        goto cleanup;
+    }
+
+    if (read_blocks(nxsb, 0x0, 1) != 1) {
+        fprintf(stderr, "ABORT: Failed to successfully read block 0x0.\n");
+        goto cleanup;
+    }
+
+    fprintf(stderr, "Validating checksum of block 0x0 ... ");
+    if (!is_cksum_valid(nxsb)) {
+        fprintf(stderr, "FAILED.\n!! APFS ERROR !! Checksum of block 0x0 should validate, but it doesn't. Proceeding as if it does.\n");
+    } else {
+        fprintf(stderr, "OK.\n");
+    }
+
+    if (!is_nx_superblock(nxsb)) {
+        fprintf(stderr, "\nABORT: Block 0x0 isn't a container superblock.\n\n");
+        goto cleanup;
+    }
+    if (nxsb->nx_magic != NX_MAGIC) {
+        fprintf(stderr, "!! APFS ERROR !! Container superblock at 0x0 doesn't have the correct magic number. Proceeding as if it does.\n");
+    }
+
+    checkpoint_timeline_t* timeline = load_checkpoint_timeline(nxsb);
+    if (!timeline) {
+        goto cleanup;
+    }
+    checkpoint_timeline_free(container->timeline);
+    container->timeline = timeline;
+
+    // Mount the latest checkpoint whose XID doesn't exceed `max_xid`, falling
+    // back to older checkpoints if it's damaged.
+    bool found = false;
+    for (uint32_t i = 0; i < timeline->num_checkpoints; i++) {
+        checkpoint_t* checkpoint = timeline->checkpoints + i;
+        if (checkpoint->xid > max_xid) {
+            continue;
+        }
+        if (!found) {
+            fprintf(stderr, "The latest container superblock lies at index %u within the checkpoint descriptor area, and has XID 0x%llx.\n", checkpoint->nxsb_index, checkpoint->xid);
+        } else {
+            fprintf(stderr, "Falling back to the container superblock at index %u within the checkpoint descriptor area, which has XID 0x%llx.\n", checkpoint->nxsb_index, checkpoint->xid);
+        }
+        found = true;
+        if (mount_checkpoint(container, timeline, i) == 0) {
+            result = 0;
+            break;
+        }
+    }
+
+    if (!found) {
+        fprintf(stderr, "No container superblock with an XID that doesn't exceed 0x%llx exists in the checkpoint descriptor area.\n", max_xid);
+    } else if (result != 0) {
+        fprintf(stderr, "No checkpoint with an XID that doesn't exceed 0x%llx is intact.\n", max_xid);
+    }
+
+cleanup:
+    free(nxsb);
+    return result;
+}
+
+void detect_block_size() {
+    nx_device->block_size = NX_DEFAULT_BLOCK_SIZE;
+
+    char* block = malloc(NX_MAXIMUM_BLOCK_SIZE);
+    if (!block) {
+        return;
+    }
+
+    // Every block size is a multiple of the minimum, so the first
+    // `NX_DEFAULT_BLOCK_SIZE` bytes can always be read as a block.
+    nx_superblock_t* nxsb = block;
+    if (read_blocks(block, 0x0, 1) == 1
+        && is_nx_superblock(nxsb)
+        && nxsb->nx_magic == NX_MAGIC
+        && nxsb->nx_block_size != NX_DEFAULT_BLOCK_SIZE
+        && nxsb->nx_block_size >= NX_MINIMUM_BLOCK_SIZE
+        && nxsb->nx_block_size <= NX_MAXIMUM_BLOCK_SIZE
+        && (nxsb->nx_block_size & (nxsb->nx_block_size - 1)) == 0
+    ) {
+        // Only adopt the block size if the whole block's checksum validates
+        // with it, so that a corrupted field can't derail everything else.
+        nx_device->block_size = nxsb->nx_block_size;
+        if (read_blocks(block, 0x0, 1) == 1 && is_cksum_valid(block)) {
+            fprintf(stderr, "The container's block size is %lu bytes.\n", nx_device->block_size);
+        } else {
+            nx_device->block_size = NX_DEFAULT_BLOCK_SIZE;
+        }
+    }
+    free(block);
+}
+
+container_t* load_container(xid_t max_xid) {
+    container_t* container = calloc(1, sizeof(container_t));
+    if (!container) {
+        fprintf(stderr, "\nABORT: load_container: Could not allocate sufficient memory for `container`.\n");
+        return NULL;
+    }
+
+    detect_block_size();
+    cksum_memo_enable();
+    omap_memo_enable(0);
+
+    // The cache is keyed by the identity of the file: the device number of
+    // a device special file, or the device and inode number of an image file.
+    // Containers that aren't read from a file aren't cached.
+    struct stat st;
+    if (nx_device->file && fstat(fileno(nx_device->file), &st) == 0) {
+        bool is_device = S_ISBLK(st.st_mode) || S_ISCHR(st.st_mode);
+        container->dev  = is_device ? st.st_rdev : st.st_dev;
+        container->ino  = is_device ? 0 : st.st_ino;
+        container->size = st.st_size;
+    }
+
+    char* cache_path = (max_xid == (xid_t)(~0) && container->dev) ? get_container_cache_path(container) : NULL;
+    if (cache_path && load_container_cache(container, cache_path)) {
+        fprintf(stderr, "Loaded the state of the container at XID 0x%llx from the cache at `%s`.\n", container->nxsb->nx_o.o_xid, cache_path);
+        free(cache_path);
+        return container;
+    }
+
+    if (mount_container(container, max_xid) != 0) {
+        free(cache_path);
+        free_container(container);
+        return NULL;
+    }
+
+    // The cache only ever describes the latest checkpoint, so don't save it
+    // if we had to fall back to an older one.
+    if (cache_path && container->nxsb->nx_o.o_xid == container->timeline->checkpoints[0].xid) {
+        save_container_cache(container, cache_path);
+    }
+    free(cache_path);
+    return container;
+}
+
+container_t* open_container(char* path, xid_t max_xid) {
+    // Open (device special) file corresponding to an APFS container, read-only
+    fprintf(stderr, "Opening file at `%s` in read-only mode ... ", path);
+    nx_device->path = path;
+    nx_device->file = fopen(nx_device->path, "rb");
+    if (!nx_device->file) {
+        fprintf(stderr, "\nABORT: ");
+        report_fopen_error();
+        return NULL;
+    }
+    fprintf(stderr, "OK.\n");
+
+    container_t* container = load_container(max_xid);
+    if (!container) {
+        fclose(nx_device->file);
+        nx_device->file = NULL;
+    }
+    return container;
+}
+
+container_t* open_fusion_container(char* path, char* tier2_path, xid_t max_xid) {
+    if (!tier2_path) {
+        return open_container(path, max_xid);
+    }
+
+    // The second tier is opened first, in case any of the objects read while
+    // mounting the container are stored on it.
+    if (open_fusion_tier2(tier2_path) != 0) {
+        return NULL;
+    }
+    container_t* container = open_container(path, max_xid);
+    if (!container) {
+        fclose(nx_device->tier2_file);
+        nx_device->tier2_file = NULL;
+        nx_device->tier2_path = NULL;
+        return NULL;
+    }
+    if (!(container->nxsb->nx_incompatible_features & NX_INCOMPAT_FUSION)) {
+        fprintf(stderr, "\nABORT: open_fusion_container: `%s` isn't a Fusion container, so it has no second tier.\n", path);
+        close_container(container);
+        return NULL;
+    }
+
+    nx_device->fusion_map = load_fusion_map(container->nxsb);
+    if (nx_device->fusion_map) {
+        uint64_t num_blocks = 0;
+        for (uint64_t i = 0; i < nx_device->fusion_map->num_ranges; i++) {
+            num_blocks += nx_device->fusion_map->ranges[i].length;
+        }
+        fprintf(stderr, "The Fusion middle tree has %llu ranges of second-tier blocks (%llu blocks) cached on the main device.\n", nx_device->fusion_map->num_ranges, num_blocks);
+    }
+    return container;
+}
+
+int open_volume(container_t* container, uint32_t volume_id, btree_node_phys_t** fs_omap_btree, btree_node_phys_t** fs_root_btree) {
+    *fs_omap_btree = NULL;
+    *fs_root_btree = NULL;
+
+    container_volume_t* volume = container->volumes + volume_id;
+    if (!volume->omap_tree_addr) {
+        fprintf(stderr, "\nABORT: open_volume: The object map B-tree of volume %u could not be located.\n", volume_id);
+        return -1;
+    }
+    if (!volume->fs_root_addr) {
+        fprintf(stderr, "\nABORT: open_volume: The file-system tree of volume %u could not be located.\n", volume_id);
+        return -1;
+    }
+
+    fprintf(stderr, "Reading the root nodes of the volume object map B-tree (0x%llx) and file-system tree (0x%llx) ... ", volume->omap_tree_addr, volume->fs_root_addr);
+    *fs_omap_btree = malloc(nx_device->block_size);
+    *fs_root_btree = malloc(nx_device->block_size);
+    if (!*fs_omap_btree || !*fs_root_btree) {
+        fprintf(stderr, "\nABORT: open_volume: Could not allocate sufficient memory for the root nodes.\n");
+        goto onError;
+    }
+    if (read_blocks(*fs_omap_btree, volume->omap_tree_addr, 1) != 1) {
+        fprintf(stderr, "\nABORT: open_volume: Failed to read block 0x%llx.\n", volume->omap_tree_addr);
+        goto onError;
+    }
+    if (read_node(*fs_root_btree, volume->fs_root_addr) != 1) {
+        fprintf(stderr, "\nABORT: open_volume: Failed to read block 0x%llx.\n", volume->fs_root_addr);
+        goto onError;
+    }
+    if (!is_cksum_valid(*fs_omap_btree) || !is_cksum_valid(*fs_root_btree)) {
+        fprintf(stderr, "FAILED. A checksum did not validate.\n");
+        goto onError;
+    }
+    fprintf(stderr, "OK.\n");
+    return 0;
+
+onError:
+    free(*fs_omap_btree);
+    free(*fs_root_btree);
+    *fs_omap_btree = NULL;
+    *fs_root_btree = NULL;
+    return -1;
+}
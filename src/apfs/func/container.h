@@ -0,0 +1,273 @@
+/**
+ * Functions used to open an APFS container and its volumes, i.e. to simulate
+ * a mount of the container: locate the latest container superblock and its
+ * checkpoint, resolve the container object map, and read the volume
+ * superblocks.
+ *
+ * Since tools are often run many times in a row on the same container, the
+ * resolved state can be saved to a small cache file. Later invocations then
+ * only need to read a handful of blocks to confirm that the container hasn't
+ * changed since, rather than the whole checkpoint descriptor area and every
+ * Ephemeral object. See `get_container_cache_path()` for how the cache is
+ * located and disabled.
+ */
+
+#ifndef APFS_FUNC_CONTAINER_H
+#define APFS_FUNC_CONTAINER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "../io.h"
+#include "../struct/general.h"
+#include "../struct/object.h"
+#include "../struct/nx.h"
+#include "../struct/omap.h"
+#include "../struct/fs.h"
+
+#include "boolean.h"
+#include "cksum.h"
+#include "btree.h"
+
+struct nx_checkpoint_timeline;
+
+/** Cache file constants **/
+
+#define CONTAINER_CACHE_MAGIC       0x43465041  // = 'APFC' when read as bytes
+#define CONTAINER_CACHE_VERSION     1
+
+/**
+ * The locations of the structures needed to read a volume.
+ *
+ * apsb_addr:       Physical address of the volume superblock.
+ *
+ * omap_tree_addr:  Physical address of the root node of the volume object
+ *      map B-tree, or zero if it couldn't be located.
+ *
+ * fs_root_addr:    Physical address of the root node of the file-system tree,
+ *      or zero if it couldn't be located.
+ */
+typedef struct {
+    paddr_t     apsb_addr;
+    paddr_t     omap_tree_addr;
+    paddr_t     fs_root_addr;
+} container_volume_t;
+
+/**
+ * The state of a container after simulating a mount of it, as returned by
+ * `open_container()`.
+ *
+ * nxsb:            The latest valid container superblock, with a whole block
+ *      of memory allocated for it.
+ *
+ * nxsb_index:      The index of `nxsb` within the checkpoint descriptor area.
+ *
+ * omap_tree_addr:  Physical address of the root node of the container object
+ *      map B-tree.
+ *
+ * omap_btree:      The root node of the container object map B-tree.
+ *
+ * num_volumes:     The number of volumes in the container.
+ *
+ * apsbs:           The volume superblocks, one block each; see
+ *      `get_volume_superblock()`.
+ *
+ * volumes:         The locations of the structures of each volume.
+ *
+ * dev, ino, size:  Identity of the container's (device special) file, used to
+ *      key the cache.
+ *
+ * from_cache:      Whether the state was loaded from the cache, rather than by
+ *      reading the checkpoint descriptor area.
+ *
+ * timeline:        The checkpoints of the container, or NULL if they haven't
+ *      been enumerated, e.g. because the state was loaded from the cache; see
+ *      `get_checkpoint_timeline()` in `apfs/func/checkpoint.h`.
+ */
+typedef struct {
+    nx_superblock_t*    nxsb;
+    uint32_t            nxsb_index;
+    paddr_t             omap_tree_addr;
+    btree_node_phys_t*  omap_btree;
+    uint32_t            num_volumes;
+    char*               apsbs;
+    container_volume_t  volumes[NX_MAX_FILE_SYSTEMS];
+
+    uint64_t            dev;
+    uint64_t            ino;
+    uint64_t            size;
+    bool                from_cache;
+
+    struct nx_checkpoint_timeline*  timeline;
+} container_t;
+
+/**
+ * The header of a cache file. It is followed by a copy of the container
+ * superblock, which is `block_size` bytes long. Cache files are only ever
+ * read on the machine that wrote them, so they use native byte order.
+ */
+typedef struct {
+    uint32_t            magic;
+    uint32_t            version;
+    uint64_t            dev;
+    uint64_t            ino;
+    uint64_t            size;
+    uint32_t            block_size;
+    uint32_t            nxsb_index;
+    xid_t               xid;
+    paddr_t             omap_tree_addr;
+    uint32_t            num_volumes;
+    uint32_t            reserved;
+    container_volume_t  volumes[NX_MAX_FILE_SYSTEMS];
+} container_cache_t;
+
+/**
+ * Get a pointer to the superblock of a given volume in a container.
+ */
+apfs_superblock_t* get_volume_superblock(container_t* container, uint32_t volume_id);
+
+/**
+ * Free a container's state, without closing the container's file; e.g. for
+ * views opened by `open_checkpoint_view()`.
+ */
+void free_container(container_t* container);
+
+/**
+ * Free a container's state, including any carved tree installed by
+ * `open_carved_volume()`, and close the container's file.
+ */
+void close_container(container_t* container);
+
+/**
+ * Determine the directory that cache files are stored in: the directory named
+ * by the environment variable `APFS_CACHE_DIR`, or else
+ * `$XDG_CACHE_HOME/apfs-tools` or `~/.cache/apfs-tools`, which is created if it
+ * doesn't exist. Setting the environment variable `APFS_NO_CACHE` disables
+ * caching.
+ *
+ * RETURN VALUE:
+ *      A pointer to the path, which must be freed when no longer needed; or
+ *      NULL if caching is disabled or the directory can't be determined.
+ */
+char* get_cache_dir();
+
+/**
+ * Determine the path of the cache file for a given container, in the
+ * directory given by `get_cache_dir()`.
+ *
+ * RETURN VALUE:
+ *      A pointer to the path, which must be freed when no longer needed; or
+ *      NULL if the cache is disabled or its directory can't be determined.
+ */
+char* get_container_cache_path(container_t* container);
+
+/**
+ * Load a container's state from its cache file, and check that it still
+ * describes the latest checkpoint of the container. This only involves reading
+ * the cached container superblock's block, block 0x0, the block where the next
+ * checkpoint would be written, and the root nodes and superblocks that
+ * `container` refers to.
+ *
+ * RETURN VALUE:
+ *      True if the cached state was loaded and is up to date. Otherwise, false,
+ *      in which case `container` must be filled in by a full mount instead.
+ */
+bool load_container_cache(container_t* container, char* cache_path);
+
+/**
+ * Save a container's state to its cache file. The file is written under a
+ * temporary name and then renamed, so that concurrent invocations never see a
+ * partially written cache file. Failure to save the cache is not an error.
+ */
+void save_container_cache(container_t* container, char* cache_path);
+
+/**
+ * Locate the object map B-tree and file-system tree of a given volume, storing
+ * their addresses in `container->volumes[volume_id]`. If either can't be
+ * located, its address is left as zero.
+ */
+void locate_volume_trees(container_t* container, uint32_t volume_id);
+
+/**
+ * Simulate a mount of the container: enumerate the checkpoints in the
+ * checkpoint descriptor area, then mount the latest one whose XID doesn't
+ * exceed `max_xid` (see `mount_checkpoint()`). If that checkpoint is damaged,
+ * e.g. because one of its Ephemeral objects or volume superblocks is
+ * malformed, each older checkpoint is tried in turn.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value on failure.
+ */
+int mount_container(container_t* container, xid_t max_xid);
+
+/**
+ * Determine the block size of the current container from its container
+ * superblock at block 0x0, and make it the block size that I/O functions use.
+ * If block 0x0 isn't a valid container superblock, the default block size is
+ * assumed.
+ */
+void detect_block_size();
+
+/**
+ * Simulate a mount of the current container (see `nx_device` in `apfs/io.h`),
+ * which must already be open for reading, using the cache if the container is
+ * read from a file.
+ *
+ * max_xid:     As for `open_container()`.
+ *
+ * RETURN VALUE:
+ *      A pointer to the container's state, as for `open_container()`; or NULL
+ *      if an error occurs.
+ */
+container_t* load_container(xid_t max_xid);
+
+/**
+ * Open the APFS container at a given path, read-only, and simulate a mount of
+ * it. The container becomes the one that `read_blocks()` reads from.
+ *
+ * path:        The path of the container's (device special) file.
+ *
+ * max_xid:     The maximum XID of the checkpoint to mount; `~0` mounts the
+ *      latest checkpoint. The cache is only used for the latest checkpoint.
+ *
+ * RETURN VALUE:
+ *      A pointer to the container's state, which must be freed with
+ *      `close_container()` when no longer needed; or NULL if an error occurs.
+ */
+container_t* open_container(char* path, xid_t max_xid);
+
+/**
+ * Open a container as `open_container()` does, and if it's a Fusion container
+ * whose second tier is given, open that too, and read its Fusion middle tree;
+ * see `apfs/func/fusion.h`.
+ *
+ * tier2_path:  The path of the second tier's (device special) file, or NULL to
+ *      open just the main device.
+ *
+ * RETURN VALUE:
+ *      As for `open_container()`.
+ */
+container_t* open_fusion_container(char* path, char* tier2_path, xid_t max_xid);
+
+/**
+ * Read the root nodes of a volume's object map B-tree and file-system tree.
+ *
+ * volume_id:       The index of the volume within the container.
+ *
+ * fs_omap_btree:   The root node of the volume object map B-tree will be
+ *      stored here. It must be freed when no longer needed.
+ *
+ * fs_root_btree:   The root node of the file-system tree will be stored here.
+ *      It must be freed when no longer needed.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value on failure.
+ */
+int open_volume(container_t* container, uint32_t volume_id, btree_node_phys_t** fs_omap_btree, btree_node_phys_t** fs_root_btree);
+
+#endif // APFS_FUNC_CONTAINER_H
@@ -0,0 +1,93 @@
+#include "crypto.h"
+
+size_t parse_volume_key(const char* hex, uint8_t* key_bytes) {
+    size_t key_len = strlen(hex) / 2;
+    if (strlen(hex) % 2 != 0 || (key_len != 32 && key_len != 64)) {
+        return 0;
+    }
+    for (size_t i = 0; i < key_len; i++) {
+        unsigned int byte;
+        if (!isxdigit(hex[2 * i]) || !isxdigit(hex[2 * i + 1]) || sscanf(hex + 2 * i, "%2x", &byte) != 1) {
+            return 0;
+        }
+        key_bytes[i] = byte;
+    }
+    return key_len;
+}
+
+int set_volume_key(const uint8_t* key_bytes, size_t key_len) {
+    free(nx_device->volume_key);
+    nx_device->volume_key = NULL;
+    if (!key_bytes) {
+        return 0;
+    }
+
+    aes_xts_key_t* key = malloc(sizeof(aes_xts_key_t));
+    if (!key) {
+        fprintf(stderr, "\nABORT: set_volume_key: Could not allocate sufficient memory for `key`.\n");
+        return -1;
+    }
+    if (aes_xts_init(key, key_bytes, key_len) != 0) {
+        fprintf(stderr, "\nABORT: set_volume_key: A key of %zu bytes isn't valid for AES-XTS.\n", key_len);
+        free(key);
+        return -1;
+    }
+    nx_device->volume_key = key;
+    return 0;
+}
+
+bool is_volume_encrypted(apfs_superblock_t* apsb) {
+    return !(apsb->apfs_fs_flags & APFS_FS_UNENCRYPTED);
+}
+
+int use_volume_key(apfs_superblock_t* apsb, const char* hex_key) {
+    if (!is_volume_encrypted(apsb)) {
+        fprintf(stderr, "The volume `%s` isn't encrypted; ignoring the key.\n", apsb->apfs_volname);
+        return 0;
+    }
+    if (!(apsb->apfs_fs_flags & APFS_FS_ONEKEY)) {
+        fprintf(stderr, "The volume `%s` uses a key per file, so only its metadata can be decrypted.\n", apsb->apfs_volname);
+    }
+
+    uint8_t key_bytes[VOLUME_KEY_MAX_SIZE];
+    size_t key_len = parse_volume_key(hex_key, key_bytes);
+    if (key_len == 0) {
+        fprintf(stderr, "The key must be given as 64 or 128 hexadecimal digits.\n");
+        return -1;
+    }
+    int result = set_volume_key(key_bytes, key_len);
+    memset(key_bytes, 0, sizeof(key_bytes));
+    if (result == 0) {
+        const char* name = NULL;
+        get_aes_xts_decrypt_func(&name);
+        fprintf(stderr, "Decrypting the volume `%s` with AES-%zu-XTS (%s).\n", apsb->apfs_volname, key_len * 4, name);
+    }
+    return result;
+}
+
+bool decrypt_node(void* node, paddr_t addr) {
+    aes_xts_key_t* key = nx_device->volume_key;
+    if (!key || is_cksum_valid(node)) {
+        return false;
+    }
+
+    char* copy = malloc(nx_device->block_size);
+    if (!copy) {
+        return false;
+    }
+    memcpy(copy, node, nx_device->block_size);
+    aes_xts_decrypt(key, copy, nx_device->block_size, addr * (nx_device->block_size / AES_XTS_SECTOR_SIZE));
+
+    bool decrypted = is_cksum_valid((uint32_t*)copy);
+    if (decrypted) {
+        memcpy(node, copy, nx_device->block_size);
+    }
+    free(copy);
+    return decrypted;
+}
+
+void decrypt_file_blocks(void* data, size_t num_blocks, uint64_t sector) {
+    if (nx_device->volume_key) {
+        aes_xts_decrypt(nx_device->volume_key, data, num_blocks * nx_device->block_size, sector);
+    }
+}
@@ -0,0 +1,98 @@
+/**
+ * Functions used to read encrypted volumes, given their volume encryption key.
+ *
+ * A volume is encrypted unless `APFS_FS_UNENCRYPTED` is set in its superblock.
+ * Its file-system tree nodes, and the other objects whose object map entries
+ * have `OMAP_VAL_ENCRYPTED` set, are encrypted with AES-XTS under the volume
+ * key, each 512-byte sector being tweaked by its number from the start of the
+ * container. File data is encrypted under the same key if `APFS_FS_ONEKEY` is
+ * set, each extent's sectors being tweaked by their number from the extent's
+ * `crypto_id`. Volumes that use a separate key per file, as on iOS, aren't
+ * supported.
+ *
+ * The key is held by the current container (see `volume_key` in `nx_device_t`),
+ * and `read_node()` decrypts the nodes it reads with it. Rather than thread
+ * the object map flags down to every place that reads a node, a node whose
+ * checksum doesn't validate as read is decrypted, and kept decrypted if its
+ * checksum then validates; the checksum of ciphertext practically never does.
+ */
+
+#ifndef APFS_FUNC_CRYPTO_H
+#define APFS_FUNC_CRYPTO_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "../io.h"
+#include "../struct/general.h"
+#include "../struct/fs.h"
+
+#include "aes_xts.h"
+#include "cksum.h"
+
+/** Volume key constants **/
+
+#define VOLUME_KEY_MAX_SIZE     64      // = AES-256-XTS; APFS uses AES-128-XTS
+
+/**
+ * Parse a key given in hexadecimal, e.g. on the command line.
+ *
+ * key_bytes:   The key will be stored here; at least `VOLUME_KEY_MAX_SIZE`
+ *      bytes.
+ *
+ * RETURN VALUE:
+ *      The length of the key in bytes, or zero if the string isn't a key of a
+ *      length that AES-XTS accepts.
+ */
+size_t parse_volume_key(const char* hex, uint8_t* key_bytes);
+
+/**
+ * Set the key used to decrypt the current container's encrypted volume, or
+ * forget the key if `key_bytes` is NULL. Nodes already in the container's node
+ * cache aren't affected.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value if the key isn't valid or memory
+ *      couldn't be allocated.
+ */
+int set_volume_key(const uint8_t* key_bytes, size_t key_len);
+
+/**
+ * Determine whether a volume's metadata and data are encrypted.
+ */
+bool is_volume_encrypted(apfs_superblock_t* apsb);
+
+/**
+ * Set the key of a volume from a key given in hexadecimal, as tools accept it
+ * with `--key`; see `parse_volume_key()` and `set_volume_key()`. The key is
+ * ignored, with a message, if the volume isn't encrypted.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value if the key isn't valid.
+ */
+int use_volume_key(apfs_superblock_t* apsb, const char* hex_key);
+
+/**
+ * If a node just read from a given address doesn't have a valid checksum, try
+ * decrypting it with the current container's volume key, if any.
+ *
+ * RETURN VALUE:
+ *      True if the node was decrypted, in which case its checksum is valid;
+ *      false if it's left as it was.
+ */
+bool decrypt_node(void* node, paddr_t addr);
+
+/**
+ * Decrypt blocks of file data in place with the current container's volume
+ * key, if any.
+ *
+ * sector:      The number of the first 512-byte sector of the data, counted
+ *      from the `crypto_id` of the extent the data belongs to.
+ */
+void decrypt_file_blocks(void* data, size_t num_blocks, uint64_t sector);
+
+#endif // APFS_FUNC_CRYPTO_H
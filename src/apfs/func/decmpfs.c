@@ -0,0 +1,420 @@
+#include "decmpfs.h"
+
+uint32_t decmpfs_read_be32(uint8_t* bytes) {
+    return ((uint32_t)bytes[0] << 24)
+         | ((uint32_t)bytes[1] << 16)
+         | ((uint32_t)bytes[2] <<  8)
+         |  (uint32_t)bytes[3];
+}
+
+bool decmpfs_type_uses_rsrc(uint32_t type) {
+    switch (type) {
+        case DECMPFS_TYPE_ZLIB_RSRC:
+        case DECMPFS_TYPE_LZVN_RSRC:
+        case DECMPFS_TYPE_RAW_RSRC:
+        case DECMPFS_TYPE_LZFSE_RSRC:
+            return true;
+        default:
+            return false;
+    }
+}
+
+char* decmpfs_type_to_string(uint32_t type) {
+    switch (type) {
+        case DECMPFS_TYPE_UNCOMPRESSED_ATTR:
+        case DECMPFS_TYPE_RAW_ATTR:
+            return "uncompressed, inline";
+        case DECMPFS_TYPE_ZLIB_ATTR:
+            return "zlib, inline";
+        case DECMPFS_TYPE_ZLIB_RSRC:
+            return "zlib, resource fork";
+        case DECMPFS_TYPE_DATALESS:
+            return "dataless";
+        case DECMPFS_TYPE_LZVN_ATTR:
+            return "LZVN, inline";
+        case DECMPFS_TYPE_LZVN_RSRC:
+            return "LZVN, resource fork";
+        case DECMPFS_TYPE_RAW_RSRC:
+            return "uncompressed, resource fork";
+        case DECMPFS_TYPE_LZFSE_ATTR:
+            return "LZFSE, inline";
+        case DECMPFS_TYPE_LZFSE_RSRC:
+            return "LZFSE, resource fork";
+        case DECMPFS_TYPE_LZBITMAP_ATTR:
+            return "LZBITMAP, inline";
+        case DECMPFS_TYPE_LZBITMAP_RSRC:
+            return "LZBITMAP, resource fork";
+        default:
+            return "unknown";
+    }
+}
+
+int64_t decmpfs_zlib_decode(uint8_t* dst, size_t dst_size, uint8_t* src, size_t src_size) {
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    if (inflateInit(&strm) != Z_OK) {
+        return -1;
+    }
+
+    strm.next_in    = src;
+    strm.avail_in   = src_size;
+    strm.next_out   = dst;
+    strm.avail_out  = dst_size;
+
+    int ret = inflate(&strm, Z_FINISH);
+    int64_t produced = strm.total_out;
+    inflateEnd(&strm);
+
+    // If `dst` was filled before the stream ended, `inflate()` reports
+    // `Z_BUF_ERROR`; we treat this as success, truncating the output.
+    if (ret != Z_STREAM_END && !(ret == Z_BUF_ERROR && produced == (int64_t)dst_size)) {
+        return -1;
+    }
+    return produced;
+}
+
+int64_t decmpfs_lzfse_decode(uint8_t* dst, size_t dst_size, uint8_t* src, size_t src_size) {
+#ifdef __APPLE__
+    size_t produced = compression_decode_buffer(dst, dst_size, src, src_size, NULL, COMPRESSION_LZFSE);
+    if (produced == 0 && dst_size != 0) {
+        return -1;
+    }
+    return produced;
+#else
+    (void)dst; (void)dst_size; (void)src; (void)src_size;
+    return -1;
+#endif
+}
+
+int64_t decmpfs_decompress(uint32_t type, uint8_t* dst, size_t dst_size, uint8_t* src, size_t src_size) {
+    size_t raw_size;
+
+    switch (type) {
+        case DECMPFS_TYPE_UNCOMPRESSED_ATTR:
+        case DECMPFS_TYPE_RAW_ATTR:
+        case DECMPFS_TYPE_RAW_RSRC:
+            raw_size = src_size < dst_size ? src_size : dst_size;
+            memcpy(dst, src, raw_size);
+            return raw_size;
+
+        case DECMPFS_TYPE_ZLIB_ATTR:
+        case DECMPFS_TYPE_ZLIB_RSRC:
+            if (src_size > 0 && (src[0] & DECMPFS_ZLIB_RAW_MARKER_MASK) == DECMPFS_ZLIB_RAW_MARKER_MASK) {
+                break;
+            }
+            return decmpfs_zlib_decode(dst, dst_size, src, src_size);
+
+        case DECMPFS_TYPE_LZVN_ATTR:
+        case DECMPFS_TYPE_LZVN_RSRC:
+            if (src_size > 0 && src[0] == DECMPFS_LZVN_RAW_MARKER) {
+                break;
+            }
+            return lzvn_decode(dst, dst_size, src, src_size);
+
+        case DECMPFS_TYPE_LZFSE_ATTR:
+        case DECMPFS_TYPE_LZFSE_RSRC:
+            if (src_size > 0 && src[0] == DECMPFS_LZFSE_RAW_MARKER) {
+                break;
+            }
+            return decmpfs_lzfse_decode(dst, dst_size, src, src_size);
+
+        default:
+            return -1;
+    }
+
+    // The data is stored uncompressed, following a one-byte marker.
+    raw_size = src_size - 1 < dst_size ? src_size - 1 : dst_size;
+    memcpy(dst, src + 1, raw_size);
+    return raw_size;
+}
+
+void* decmpfs_batch_worker(void* arg) {
+    decmpfs_batch_t* batch = arg;
+    while (true) {
+        pthread_mutex_lock(&batch->lock);
+        size_t i = batch->next_chunk++;
+        pthread_mutex_unlock(&batch->lock);
+
+        if (i >= batch->num_chunks) {
+            return NULL;
+        }
+
+        decmpfs_chunk_t* chunk = batch->chunks + i;
+        chunk->result = decmpfs_decompress(batch->type, chunk->dst, chunk->dst_size, chunk->src, chunk->src_size);
+    }
+}
+
+unsigned int decmpfs_get_num_threads() {
+    if (nx_device->decmpfs_num_threads > 0) {
+        return nx_device->decmpfs_num_threads;
+    }
+    long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return num_cpus > 0 ? num_cpus : 1;
+}
+
+void decmpfs_decompress_chunks(uint32_t type, decmpfs_chunk_t* chunks, size_t num_chunks) {
+    decmpfs_batch_t batch = {
+        .type       = type,
+        .chunks     = chunks,
+        .num_chunks = num_chunks,
+        .next_chunk = 0,
+    };
+    pthread_mutex_init(&batch.lock, NULL);
+
+    size_t num_threads = decmpfs_get_num_threads();
+    if (num_threads > num_chunks) {
+        num_threads = num_chunks;
+    }
+
+    // The calling thread also acts as a worker, so we spawn one fewer thread.
+    pthread_t threads[num_threads > 0 ? num_threads : 1];
+    size_t num_spawned = 0;
+    for (size_t i = 1; i < num_threads; i++) {
+        if (pthread_create(&threads[num_spawned], NULL, decmpfs_batch_worker, &batch) != 0) {
+            break;  // Carry on with however many threads we have.
+        }
+        num_spawned++;
+    }
+
+    decmpfs_batch_worker(&batch);
+
+    for (size_t i = 0; i < num_spawned; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_mutex_destroy(&batch.lock);
+}
+
+int64_t decmpfs_get_rsrc_chunks(
+    uint32_t        type,
+    uint64_t        uncompressed_size,
+    file_extent_t*  rsrc_extents,
+    size_t          num_rsrc_extents,
+    uint64_t        rsrc_size,
+    uint64_t**      chunk_offsets,
+    uint64_t**      chunk_sizes
+) {
+    *chunk_offsets = NULL;
+    *chunk_sizes = NULL;
+
+    uint64_t num_chunks = uncompressed_size / DECMPFS_CHUNK_SIZE + (uncompressed_size % DECMPFS_CHUNK_SIZE != 0);
+
+    // Each chunk has an entry in the chunk table, which lies within the
+    // resource fork, so a corrupt uncompressed size can't make us allocate
+    // more entries than the resource fork could possibly hold.
+    uint64_t entry_size = type == DECMPFS_TYPE_ZLIB_RSRC ? sizeof(decmpfs_zlib_chunk_t) : sizeof(uint32_t);
+    if (num_chunks > rsrc_size / entry_size) {
+        fprintf(stderr, "\nERROR: decmpfs_get_rsrc_chunks: A resource fork of %llu bytes can't hold the chunk table for %llu bytes of data.\n", rsrc_size, uncompressed_size);
+        return -1;
+    }
+
+    uint64_t* offsets = malloc((num_chunks + 1) * sizeof(uint64_t));
+    uint64_t* sizes   = malloc((num_chunks + 1) * sizeof(uint64_t));
+    uint8_t*  table   = NULL;
+    if (!offsets || !sizes) {
+        fprintf(stderr, "\nABORT: decmpfs_get_rsrc_chunks: Could not allocate sufficient memory for the chunk table.\n");
+        goto onError;
+    }
+
+    if (type == DECMPFS_TYPE_ZLIB_RSRC) {
+        uint8_t header[sizeof(decmpfs_rsrc_header_t)];
+        if (rsrc_size < sizeof(header) || read_dstream_range(rsrc_extents, num_rsrc_extents, 0, sizeof(header), header) != 0) {
+            fprintf(stderr, "\nERROR: decmpfs_get_rsrc_chunks: Could not read the resource-fork header.\n");
+            goto onError;
+        }
+        uint64_t table_base = (uint64_t)decmpfs_read_be32(header) + 4;     // `data_offset + 4`
+
+        uint32_t table_count = 0;
+        if (table_base + 4 > rsrc_size || read_dstream_range(rsrc_extents, num_rsrc_extents, table_base, 4, &table_count) != 0) {
+            fprintf(stderr, "\nERROR: decmpfs_get_rsrc_chunks: Could not read the number of chunks.\n");
+            goto onError;
+        }
+        if (table_count != num_chunks) {
+            fprintf(stderr, "\nERROR: decmpfs_get_rsrc_chunks: The resource fork lists %u chunks, but %llu were expected.\n", table_count, num_chunks);
+            goto onError;
+        }
+
+        uint64_t table_size = num_chunks * sizeof(decmpfs_zlib_chunk_t);
+        table = malloc(table_size ? table_size : 1);
+        if (!table) {
+            fprintf(stderr, "\nABORT: decmpfs_get_rsrc_chunks: Could not allocate sufficient memory for `table`.\n");
+            goto onError;
+        }
+        if (table_base + 4 + table_size > rsrc_size || read_dstream_range(rsrc_extents, num_rsrc_extents, table_base + 4, table_size, table) != 0) {
+            fprintf(stderr, "\nERROR: decmpfs_get_rsrc_chunks: Could not read the chunk table.\n");
+            goto onError;
+        }
+
+        decmpfs_zlib_chunk_t* entries = table;
+        for (uint64_t i = 0; i < num_chunks; i++) {
+            offsets[i]  = table_base + entries[i].offset;
+            sizes[i]    = entries[i].length;
+        }
+    } else {
+        uint64_t table_size = (num_chunks + 1) * sizeof(uint32_t);
+        table = malloc(table_size);
+        if (!table) {
+            fprintf(stderr, "\nABORT: decmpfs_get_rsrc_chunks: Could not allocate sufficient memory for `table`.\n");
+            goto onError;
+        }
+        if (table_size > rsrc_size || read_dstream_range(rsrc_extents, num_rsrc_extents, 0, table_size, table) != 0) {
+            fprintf(stderr, "\nERROR: decmpfs_get_rsrc_chunks: Could not read the chunk table.\n");
+            goto onError;
+        }
+
+        uint32_t* entries = table;
+        for (uint64_t i = 0; i < num_chunks; i++) {
+            if (entries[i + 1] < entries[i]) {
+                fprintf(stderr, "\nERROR: decmpfs_get_rsrc_chunks: The chunk table is malformed.\n");
+                goto onError;
+            }
+            offsets[i]  = entries[i];
+            sizes[i]    = entries[i + 1] - entries[i];
+        }
+    }
+
+    for (uint64_t i = 0; i < num_chunks; i++) {
+        if (offsets[i] + sizes[i] > rsrc_size) {
+            fprintf(stderr, "\nERROR: decmpfs_get_rsrc_chunks: Chunk %llu lies beyond the end of the resource fork.\n", i);
+            goto onError;
+        }
+    }
+
+    free(table);
+    *chunk_offsets = offsets;
+    *chunk_sizes = sizes;
+    return num_chunks;
+
+onError:
+    free(table);
+    free(offsets);
+    free(sizes);
+    return -1;
+}
+
+int decmpfs_write_data(
+    decmpfs_disk_header_t*  hdr,
+    size_t                  hdr_len,
+    file_extent_t*          rsrc_extents,
+    size_t                  num_rsrc_extents,
+    uint64_t                rsrc_size,
+    FILE*                   out
+) {
+    if (hdr_len < sizeof(decmpfs_disk_header_t) || hdr->compression_magic != DECMPFS_MAGIC) {
+        fprintf(stderr, "\nERROR: decmpfs_write_data: The decmpfs header is malformed.\n");
+        return -1;
+    }
+
+    uint32_t type = hdr->compression_type;
+    uint64_t uncompressed_size = hdr->uncompressed_size;
+
+    if (!decmpfs_type_uses_rsrc(type)) {
+        uint8_t* data = malloc(uncompressed_size ? uncompressed_size : 1);
+        if (!data) {
+            fprintf(stderr, "\nABORT: decmpfs_write_data: Could not allocate sufficient memory for `data`.\n");
+            return -1;
+        }
+
+        int64_t result = decmpfs_decompress(type, data, uncompressed_size, hdr->attr_bytes, hdr_len - sizeof(decmpfs_disk_header_t));
+        if (result != (int64_t)uncompressed_size) {
+            fprintf(stderr, "\nERROR: decmpfs_write_data: Failed to decompress inline data (%s).\n", decmpfs_type_to_string(type));
+            free(data);
+            return -1;
+        }
+        if (uncompressed_size > 0 && fwrite(data, uncompressed_size, 1, out) != 1) {
+            fprintf(stderr, "\nERROR: decmpfs_write_data: Failed to write decompressed data.\n");
+            free(data);
+            return -1;
+        }
+        free(data);
+        return 0;
+    }
+
+    uint64_t* chunk_offsets = NULL;
+    uint64_t* chunk_sizes = NULL;
+    int64_t num_chunks = decmpfs_get_rsrc_chunks(type, uncompressed_size, rsrc_extents, num_rsrc_extents, rsrc_size, &chunk_offsets, &chunk_sizes);
+    if (num_chunks < 0) {
+        return -1;
+    }
+
+    size_t batch_size = decmpfs_get_num_threads() * DECMPFS_CHUNKS_PER_THREAD;
+    decmpfs_chunk_t* chunks = malloc(batch_size * sizeof(decmpfs_chunk_t));
+    uint8_t* dst_buffer = malloc(batch_size * DECMPFS_CHUNK_SIZE);
+    uint8_t* src_buffer = NULL;
+    size_t src_buffer_size = 0;
+    int ret = 0;
+
+    if (!chunks || !dst_buffer) {
+        fprintf(stderr, "\nABORT: decmpfs_write_data: Could not allocate sufficient memory for the chunk buffers.\n");
+        ret = -1;
+        goto cleanup;
+    }
+
+    for (uint64_t first = 0; first < (uint64_t)num_chunks; first += batch_size) {
+        size_t count = num_chunks - first < batch_size ? num_chunks - first : batch_size;
+
+        // Read the compressed data for the whole batch in one go; chunks are
+        // almost always laid out contiguously and in order.
+        uint64_t span_start = chunk_offsets[first];
+        uint64_t span_end   = chunk_offsets[first] + chunk_sizes[first];
+        for (size_t i = 1; i < count; i++) {
+            if (chunk_offsets[first + i] < span_start) {
+                span_start = chunk_offsets[first + i];
+            }
+            if (chunk_offsets[first + i] + chunk_sizes[first + i] > span_end) {
+                span_end = chunk_offsets[first + i] + chunk_sizes[first + i];
+            }
+        }
+        size_t span_size = span_end - span_start;
+
+        if (span_size > src_buffer_size) {
+            uint8_t* new_buffer = realloc(src_buffer, span_size);
+            if (!new_buffer) {
+                fprintf(stderr, "\nABORT: decmpfs_write_data: Could not allocate sufficient memory for `src_buffer`.\n");
+                ret = -1;
+                goto cleanup;
+            }
+            src_buffer = new_buffer;
+            src_buffer_size = span_size;
+        }
+        if (read_dstream_range(rsrc_extents, num_rsrc_extents, span_start, span_size, src_buffer) != 0) {
+            ret = -1;
+            goto cleanup;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            uint64_t chunk_start = (first + i) * DECMPFS_CHUNK_SIZE;
+            chunks[i].src       = src_buffer + (chunk_offsets[first + i] - span_start);
+            chunks[i].src_size  = chunk_sizes[first + i];
+            chunks[i].dst       = dst_buffer + i * DECMPFS_CHUNK_SIZE;
+            chunks[i].dst_size  = uncompressed_size - chunk_start < DECMPFS_CHUNK_SIZE ? uncompressed_size - chunk_start : DECMPFS_CHUNK_SIZE;
+            chunks[i].result    = -1;
+        }
+
+        decmpfs_decompress_chunks(type, chunks, count);
+
+        for (size_t i = 0; i < count; i++) {
+            if (chunks[i].result != (int64_t)chunks[i].dst_size) {
+                fprintf(stderr, "\nWARNING: decmpfs_write_data: Chunk %llu failed to decompress (%s); writing zeroes in its place.\n", first + i, decmpfs_type_to_string(type));
+                memset(chunks[i].dst, 0, chunks[i].dst_size);
+                ret = 1;
+            }
+        }
+
+        // Chunk outputs are contiguous in `dst_buffer`, and every chunk but
+        // the file's last is exactly `DECMPFS_CHUNK_SIZE` bytes long.
+        size_t out_size = (count - 1) * DECMPFS_CHUNK_SIZE + chunks[count - 1].dst_size;
+        if (fwrite(dst_buffer, out_size, 1, out) != 1) {
+            fprintf(stderr, "\nERROR: decmpfs_write_data: Failed to write decompressed data.\n");
+            ret = -1;
+            goto cleanup;
+        }
+    }
+
+cleanup:
+    free(src_buffer);
+    free(dst_buffer);
+    free(chunks);
+    free(chunk_offsets);
+    free(chunk_sizes);
+    return ret;
+}
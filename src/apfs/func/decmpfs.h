@@ -0,0 +1,194 @@
+/**
+ * Functions used to decompress transparently compressed (`decmpfs`) files.
+ *
+ * The compressed data of such a file is stored either inline in its
+ * `com.apple.decmpfs` extended attribute, or in its resource fork, i.e. its
+ * `com.apple.ResourceFork` extended attribute, in which case it is divided
+ * into independently compressed chunks of `DECMPFS_CHUNK_SIZE` bytes. Chunks
+ * are decompressed in parallel, in batches, and written out in order as each
+ * batch completes, so memory usage is bounded regardless of file size.
+ */
+
+#ifndef APFS_FUNC_DECMPFS_H
+#define APFS_FUNC_DECMPFS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <zlib.h>
+
+#ifdef __APPLE__
+#include <compression.h>
+#endif
+
+#include "../struct/decmpfs.h"
+
+#include "dstream.h"
+#include "lzvn.h"
+
+/**
+ * The number of chunks to decompress per thread in each batch.
+ */
+#define DECMPFS_CHUNKS_PER_THREAD   4
+
+/**
+ * Read a big-endian 32-bit value, as used in resource-fork headers.
+ */
+uint32_t decmpfs_read_be32(uint8_t* bytes);
+
+/**
+ * Determine whether a given compression type stores its data in the
+ * resource fork rather than inline in the `com.apple.decmpfs` attribute.
+ */
+bool decmpfs_type_uses_rsrc(uint32_t type);
+
+/**
+ * Get a human-readable name for a given compression type.
+ */
+char* decmpfs_type_to_string(uint32_t type);
+
+/**
+ * Decompress a single zlib stream.
+ *
+ * RETURN VALUE:    The number of bytes written to `dst`, or a negative value
+ *      if an error occurs.
+ */
+int64_t decmpfs_zlib_decode(uint8_t* dst, size_t dst_size, uint8_t* src, size_t src_size);
+
+/**
+ * Decompress a single LZFSE stream.
+ *
+ * NOTE: LZFSE decoding relies on Apple's `libcompression`, which is only
+ * available on macOS; on other platforms, this always fails.
+ *
+ * RETURN VALUE:    The number of bytes written to `dst`, or a negative value
+ *      if an error occurs.
+ */
+int64_t decmpfs_lzfse_decode(uint8_t* dst, size_t dst_size, uint8_t* src, size_t src_size);
+
+/**
+ * Decompress a single unit of compressed data, i.e. either a whole inline
+ * payload, or a single resource-fork chunk.
+ *
+ * type:        The compression type, as found in the decmpfs header.
+ *
+ * dst:         The location where decompressed data will be stored.
+ *
+ * dst_size:    The number of bytes that the data is expected to decompress
+ *      to. No more than this many bytes will be written to `dst`.
+ *
+ * src:         A pointer to the compressed data.
+ *
+ * src_size:    The length of the compressed data, in bytes.
+ *
+ * RETURN VALUE:
+ *      The number of bytes written to `dst`, or a negative value if the data
+ *      is malformed or the compression type is unsupported.
+ */
+int64_t decmpfs_decompress(uint32_t type, uint8_t* dst, size_t dst_size, uint8_t* src, size_t src_size);
+
+/**
+ * A single resource-fork chunk to be decompressed.
+ *
+ * src, src_size:   The compressed data.
+ *
+ * dst, dst_size:   Where to store the decompressed data, and the number of
+ *      bytes that the chunk is expected to decompress to.
+ *
+ * result:          The return value of `decmpfs_decompress()` for this chunk.
+ */
+typedef struct {
+    uint8_t*    src;
+    size_t      src_size;
+    uint8_t*    dst;
+    size_t      dst_size;
+    int64_t     result;
+} decmpfs_chunk_t;
+
+/**
+ * State shared between the threads that decompress a batch of chunks.
+ * Each thread repeatedly claims the next unclaimed chunk until none remain.
+ */
+typedef struct {
+    uint32_t            type;
+    decmpfs_chunk_t*    chunks;
+    size_t              num_chunks;
+    size_t              next_chunk;
+    pthread_mutex_t     lock;
+} decmpfs_batch_t;
+
+void* decmpfs_batch_worker(void* arg);
+
+/**
+ * Get the number of threads to use for decompression in the current container
+ * (see `decmpfs_num_threads` in `nx_device_t`).
+ */
+unsigned int decmpfs_get_num_threads();
+
+/**
+ * Decompress a batch of chunks in parallel. The result for each chunk is
+ * stored in its `result` field.
+ */
+void decmpfs_decompress_chunks(uint32_t type, decmpfs_chunk_t* chunks, size_t num_chunks);
+
+/**
+ * Locate the chunks within a resource fork.
+ *
+ * type:        The compression type.
+ *
+ * uncompressed_size:   The uncompressed size of the file.
+ *
+ * rsrc_extents, num_rsrc_extents, rsrc_size:
+ *      The file extents and size of the resource fork's data stream.
+ *
+ * chunk_offsets, chunk_sizes:
+ *      Pointers to arrays of the offset within the resource fork and the
+ *      compressed size of each chunk will be stored here. These arrays must
+ *      be freed when no longer needed.
+ *
+ * RETURN VALUE:
+ *      The number of chunks, or a negative value if an error occurs.
+ */
+int64_t decmpfs_get_rsrc_chunks(
+    uint32_t        type,
+    uint64_t        uncompressed_size,
+    file_extent_t*  rsrc_extents,
+    size_t          num_rsrc_extents,
+    uint64_t        rsrc_size,
+    uint64_t**      chunk_offsets,
+    uint64_t**      chunk_sizes
+);
+
+/**
+ * Decompress the data of a compressed file and write it to a given stream.
+ *
+ * hdr:         A pointer to the value of the file's `com.apple.decmpfs`
+ *      extended attribute, which begins with a decmpfs header.
+ *
+ * hdr_len:     The length of that value, in bytes.
+ *
+ * rsrc_extents, num_rsrc_extents, rsrc_size:
+ *      The file extents and size of the data stream of the file's
+ *      `com.apple.ResourceFork` extended attribute. These are ignored if the
+ *      compressed data is stored inline.
+ *
+ * out:         The stream to write the decompressed data to.
+ *
+ * RETURN VALUE:
+ *      Zero on success. A positive value if the data was written, but some
+ *      chunks failed to decompress and were written as zeroes instead.
+ *      A negative value if an error occurs that prevents writing the data.
+ */
+int decmpfs_write_data(
+    decmpfs_disk_header_t*  hdr,
+    size_t                  hdr_len,
+    file_extent_t*          rsrc_extents,
+    size_t                  num_rsrc_extents,
+    uint64_t                rsrc_size,
+    FILE*                   out
+);
+
+#endif // APFS_FUNC_DECMPFS_H
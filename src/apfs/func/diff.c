@@ -0,0 +1,319 @@
+#include "diff.h"
+
+/**
+ * A position within one of the trees being compared.
+ *
+ * nodes:       The nodes on the path from the root to the current entry, by
+ *      level; `nodes[root_level]` is the root node itself. Only the levels from
+ *      `level` upwards are part of the current path.
+ *
+ * index:       The index of the current entry within each node on the path.
+ *
+ * level:       The level of the node containing the current entry.
+ *
+ * end:         Whether every entry has been visited.
+ */
+typedef struct {
+    diff_tree_t*        tree;
+    uint16_t            root_level;
+    btree_node_phys_t** nodes;
+    uint32_t*           index;
+    uint16_t            level;
+    bool                end;
+    diff_stats_t*       stats;
+} diff_cursor_t;
+
+/**
+ * Get the key and value of the entry at a given index within a node of a
+ * file-system tree.
+ *
+ * RETURN VALUE:
+ *      False if the entry lies outside the node, otherwise true.
+ */
+bool get_diff_entry(btree_node_phys_t* node, uint32_t index, diff_record_t* entry) {
+    char* toc_start = (char*)(node->btn_data) + node->btn_table_space.off;
+    char* key_start = toc_start + node->btn_table_space.len;
+    char* val_end   = (char*)node + nx_device->block_size;
+    if (node->btn_flags & BTNODE_ROOT) {
+        val_end -= sizeof(btree_info_t);
+    }
+
+    kvloc_t* toc_entry = (kvloc_t*)toc_start + index;
+    if (
+            (char*)(toc_entry + 1) > key_start
+            || key_start + toc_entry->k.off + toc_entry->k.len > val_end
+            || toc_entry->v.off > val_end - key_start
+            || toc_entry->v.len > toc_entry->v.off
+            || toc_entry->k.len < sizeof(j_key_t)
+    ) {
+        return false;
+    }
+    entry->key = (j_key_t*)(key_start + toc_entry->k.off);
+    entry->key_len = toc_entry->k.len;
+    entry->val = val_end - toc_entry->v.off;
+    entry->val_len = toc_entry->v.len;
+    return true;
+}
+
+void free_diff_cursor(diff_cursor_t* cursor) {
+    if (cursor->nodes) {
+        // The root node belongs to the caller
+        for (uint16_t i = 0; i < cursor->root_level; i++) {
+            free(cursor->nodes[i]);
+        }
+    }
+    free(cursor->nodes);
+    free(cursor->index);
+}
+
+int init_diff_cursor(diff_cursor_t* cursor, diff_tree_t* tree, diff_stats_t* stats) {
+    memset(cursor, 0, sizeof(diff_cursor_t));
+    cursor->tree = tree;
+    cursor->stats = stats;
+
+    btree_node_phys_t* root = tree->fs_root_btree;
+    if (root->btn_flags & BTNODE_FIXED_KV_SIZE) {
+        fprintf(stderr, "\nABORT: init_diff_cursor: File-system trees don't have fixed-size keys and values.\n");
+        return -1;
+    }
+    cursor->root_level = root->btn_level;
+    cursor->nodes = calloc(cursor->root_level + 1, sizeof(btree_node_phys_t*));
+    cursor->index = calloc(cursor->root_level + 1, sizeof(uint32_t));
+    if (!cursor->nodes || !cursor->index) {
+        fprintf(stderr, "\nABORT: init_diff_cursor: Could not allocate sufficient memory for the cursor.\n");
+        return -1;
+    }
+    cursor->nodes[cursor->root_level] = root;
+    cursor->level = cursor->root_level;
+    cursor->end = root->btn_nkeys == 0;
+    return 0;
+}
+
+/**
+ * Move a cursor to the next entry at the same level, or, once a node's entries
+ * are exhausted, to the entry following it in its parent. If the current entry
+ * refers to a child node, the whole subtree is skipped.
+ */
+void advance_diff_cursor(diff_cursor_t* cursor) {
+    cursor->index[cursor->level]++;
+    while (cursor->index[cursor->level] >= cursor->nodes[cursor->level]->btn_nkeys) {
+        if (cursor->level == cursor->root_level) {
+            cursor->end = true;
+            return;
+        }
+        cursor->level++;
+        cursor->index[cursor->level]++;
+    }
+}
+
+/**
+ * Resolve the child node that the current entry of a cursor refers to.
+ *
+ * RETURN VALUE:
+ *      The physical address of the child node, or zero if it couldn't be
+ *      resolved.
+ */
+paddr_t get_diff_child_addr(diff_cursor_t* cursor, diff_record_t* entry) {
+    if (entry->val_len < sizeof(oid_t)) {
+        return 0;
+    }
+    oid_t child_oid = *(oid_t*)entry->val;
+    if (!cursor->tree->omap_btree) {
+        return child_oid;
+    }
+    omap_val_t* omap_val = get_btree_phys_omap_val(cursor->tree->omap_btree, child_oid, cursor->tree->xid);
+    if (!omap_val) {
+        return 0;
+    }
+    paddr_t addr = omap_val->ov_paddr;
+    free(omap_val);
+    return addr;
+}
+
+/**
+ * Read the child node that the current entry of a cursor refers to, and move
+ * the cursor to the child's first entry.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value on failure.
+ */
+int descend_diff_cursor(diff_cursor_t* cursor, diff_record_t* entry) {
+    paddr_t child_addr = get_diff_child_addr(cursor, entry);
+    if (!child_addr) {
+        fprintf(stderr, "\nABORT: descend_diff_cursor: Could not resolve the child node with OID 0x%llx.\n", *(oid_t*)entry->val);
+        return -1;
+    }
+
+    uint16_t child_level = cursor->level - 1;
+    if (!cursor->nodes[child_level]) {
+        cursor->nodes[child_level] = malloc(nx_device->block_size);
+        if (!cursor->nodes[child_level]) {
+            fprintf(stderr, "\nABORT: descend_diff_cursor: Could not allocate sufficient memory for a node.\n");
+            return -1;
+        }
+    }
+    btree_node_phys_t* child = cursor->nodes[child_level];
+    if (read_node(child, child_addr) != 1 || !verify_node(child, child_addr)) {
+        fprintf(stderr, "\nABORT: descend_diff_cursor: Failed to read the node at block 0x%llx.\n", child_addr);
+        return -1;
+    }
+    if (child->btn_level != child_level || (child->btn_flags & BTNODE_FIXED_KV_SIZE)) {
+        fprintf(stderr, "\nABORT: descend_diff_cursor: The node at block 0x%llx is not a level-%u node of a file-system tree.\n", child_addr, child_level);
+        return -1;
+    }
+    cursor->stats->nodes_read++;
+
+    cursor->level = child_level;
+    cursor->index[child_level] = 0;
+    if (child->btn_nkeys == 0) {
+        advance_diff_cursor(cursor);
+    }
+    return 0;
+}
+
+int get_diff_cursor_entry(diff_cursor_t* cursor, diff_record_t* entry) {
+    if (!get_diff_entry(cursor->nodes[cursor->level], cursor->index[cursor->level], entry)) {
+        fprintf(stderr, "\nABORT: get_diff_cursor_entry: Entry %u of a level-%u node is malformed.\n", cursor->index[cursor->level], cursor->level);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Deal with the current entry of a cursor, which precedes every entry left in
+ * the other tree: descend into its child node if it has one, or else report its
+ * record as being only in its own tree, and advance the cursor.
+ *
+ * RETURN VALUE:
+ *      Zero to continue, or else the nonzero value returned by `callback`, or a
+ *      negative value if a node couldn't be read.
+ */
+int step_diff_cursor(diff_cursor_t* cursor, diff_record_t* entry, diff_change_t change, diff_callback_t callback, void* context) {
+    if (cursor->level > 0) {
+        return descend_diff_cursor(cursor, entry);
+    }
+    cursor->stats->records_compared++;
+    int callback_result = change == DIFF_ADDED
+        ? callback(context, DIFF_ADDED, NULL, entry)
+        : callback(context, DIFF_REMOVED, entry, NULL);
+    advance_diff_cursor(cursor);
+    return callback_result;
+}
+
+int diff_fs_trees(diff_tree_t* old_tree, diff_tree_t* new_tree, diff_callback_t callback, void* context, diff_stats_t* stats) {
+    int result = -1;
+    diff_stats_t local_stats;
+    if (!stats) {
+        stats = &local_stats;
+    }
+    memset(stats, 0, sizeof(diff_stats_t));
+
+    diff_cursor_t old_cursor;
+    diff_cursor_t new_cursor;
+    if (init_diff_cursor(&old_cursor, old_tree, stats) != 0) {
+        free_diff_cursor(&old_cursor);
+        return -1;
+    }
+    if (init_diff_cursor(&new_cursor, new_tree, stats) != 0) {
+        goto cleanup;
+    }
+
+    diff_record_t old_entry;
+    diff_record_t new_entry;
+    while (!old_cursor.end || !new_cursor.end) {
+        if (!old_cursor.end && get_diff_cursor_entry(&old_cursor, &old_entry) != 0) {
+            goto cleanup;
+        }
+        if (!new_cursor.end && get_diff_cursor_entry(&new_cursor, &new_entry) != 0) {
+            goto cleanup;
+        }
+
+        // Once one tree is exhausted, the rest of the other tree differs
+        if (old_cursor.end || new_cursor.end) {
+            int step_result = old_cursor.end
+                ? step_diff_cursor(&new_cursor, &new_entry, DIFF_ADDED, callback, context)
+                : step_diff_cursor(&old_cursor, &old_entry, DIFF_REMOVED, callback, context);
+            if (step_result != 0) {
+                result = step_result;
+                goto cleanup;
+            }
+            continue;
+        }
+
+        int cmp = compare_j_keys(old_entry.key, old_entry.key_len, new_entry.key, new_entry.key_len);
+
+        // Records can only be compared once both cursors are in leaf nodes.
+        // If the entry of the lower cursor precedes the subtree of the higher
+        // one, deal with that entry first; this avoids reading a shared node
+        // just because the trees' nodes start at different keys. Otherwise,
+        // descend the higher cursor.
+        if (old_cursor.level != new_cursor.level) {
+            int step_result;
+            if (old_cursor.level > new_cursor.level) {
+                step_result = cmp > 0
+                    ? step_diff_cursor(&new_cursor, &new_entry, DIFF_ADDED, callback, context)
+                    : descend_diff_cursor(&old_cursor, &old_entry);
+            } else {
+                step_result = cmp < 0
+                    ? step_diff_cursor(&old_cursor, &old_entry, DIFF_REMOVED, callback, context)
+                    : descend_diff_cursor(&new_cursor, &new_entry);
+            }
+            if (step_result != 0) {
+                result = step_result;
+                goto cleanup;
+            }
+            continue;
+        }
+
+        if (old_cursor.level > 0) {
+            // Two index entries with the same first key and the same child
+            // node cover identical runs of records, so skip both subtrees.
+            if (cmp == 0) {
+                paddr_t old_child = get_diff_child_addr(&old_cursor, &old_entry);
+                if (old_child && old_child == get_diff_child_addr(&new_cursor, &new_entry)) {
+                    stats->subtrees_skipped++;
+                    advance_diff_cursor(&old_cursor);
+                    advance_diff_cursor(&new_cursor);
+                    continue;
+                }
+            }
+
+            // Otherwise, descend whichever subtree starts first, or both
+            if (cmp <= 0 && descend_diff_cursor(&old_cursor, &old_entry) != 0) {
+                goto cleanup;
+            }
+            if (cmp >= 0 && descend_diff_cursor(&new_cursor, &new_entry) != 0) {
+                goto cleanup;
+            }
+            continue;
+        }
+
+        int callback_result = 0;
+        if (cmp < 0) {
+            stats->records_compared++;
+            callback_result = callback(context, DIFF_REMOVED, &old_entry, NULL);
+            advance_diff_cursor(&old_cursor);
+        } else if (cmp > 0) {
+            stats->records_compared++;
+            callback_result = callback(context, DIFF_ADDED, NULL, &new_entry);
+            advance_diff_cursor(&new_cursor);
+        } else {
+            stats->records_compared += 2;
+            if (old_entry.val_len != new_entry.val_len || memcmp(old_entry.val, new_entry.val, old_entry.val_len) != 0) {
+                callback_result = callback(context, DIFF_MODIFIED, &old_entry, &new_entry);
+            }
+            advance_diff_cursor(&old_cursor);
+            advance_diff_cursor(&new_cursor);
+        }
+        if (callback_result != 0) {
+            result = callback_result;
+            goto cleanup;
+        }
+    }
+    result = 0;
+
+cleanup:
+    free_diff_cursor(&old_cursor);
+    free_diff_cursor(&new_cursor);
+    return result;
+}
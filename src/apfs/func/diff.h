@@ -0,0 +1,116 @@
+/**
+ * Functions used to compare two versions of a file-system tree, e.g. those of
+ * a volume as of two of its snapshots, or in two checkpoints of a container.
+ *
+ * Both trees are walked in lockstep, in key order, merging the records of
+ * their leaf nodes. Wherever both trees refer to the same child node at the
+ * same position, i.e. the child's first key is the same and both sides' object
+ * maps resolve it to the same physical block, the whole subtree is skipped
+ * without being read: nodes are never modified in place, so a block that both
+ * versions refer to has the same contents in both. The number of nodes read is
+ * therefore proportional to the amount of change, plus the height of the
+ * trees, rather than to the size of the volume.
+ *
+ * Changes are reported in key order, and thus grouped by file-system object.
+ */
+
+#ifndef APFS_FUNC_DIFF_H
+#define APFS_FUNC_DIFF_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "../io.h"
+#include "../struct/general.h"
+#include "../struct/object.h"
+#include "../struct/btree.h"
+#include "../struct/omap.h"
+#include "../struct/j.h"
+
+#include "btree.h"
+#include "j.h"
+
+/**
+ * One version of a file-system tree to compare.
+ *
+ * omap_btree:  The root node of the object map B-tree used to resolve the
+ *      tree's child nodes, or NULL if the tree refers to its child nodes by
+ *      physical address.
+ *
+ * fs_root_btree:   The root node of the tree.
+ *
+ * xid:         The XID to resolve child nodes as of, e.g. that of a snapshot,
+ *      or `~0` for the latest version of each.
+ */
+typedef struct {
+    btree_node_phys_t*  omap_btree;
+    btree_node_phys_t*  fs_root_btree;
+    xid_t               xid;
+} diff_tree_t;
+
+/**
+ * How a record differs between the two trees.
+ */
+typedef enum {
+    DIFF_ADDED,         // Only in the second tree
+    DIFF_REMOVED,       // Only in the first tree
+    DIFF_MODIFIED,      // In both trees, with different values
+} diff_change_t;
+
+/**
+ * A record within a node of one of the trees. The pointers are only valid
+ * until the callback returns.
+ */
+typedef struct {
+    j_key_t*    key;
+    uint16_t    key_len;
+    void*       val;
+    uint16_t    val_len;
+} diff_record_t;
+
+/**
+ * A function that is called with each record that differs between the trees.
+ *
+ * old_rec:     The record in the first tree, or NULL if `change` is
+ *      `DIFF_ADDED`.
+ *
+ * new_rec:     The record in the second tree, or NULL if `change` is
+ *      `DIFF_REMOVED`.
+ *
+ * RETURN VALUE:
+ *      Zero to continue, or a nonzero value to stop comparing the trees.
+ */
+typedef int (*diff_callback_t)(void* context, diff_change_t change, diff_record_t* old_rec, diff_record_t* new_rec);
+
+/**
+ * Statistics gathered while comparing two trees.
+ *
+ * nodes_read:  The number of nodes read below the root of each tree.
+ *
+ * subtrees_skipped:    The number of subtrees that both trees share, and that
+ *      were therefore skipped.
+ *
+ * records_compared:    The number of leaf records visited in either tree.
+ */
+typedef struct {
+    uint64_t    nodes_read;
+    uint64_t    subtrees_skipped;
+    uint64_t    records_compared;
+} diff_stats_t;
+
+/**
+ * Compare two versions of a file-system tree, calling `callback` with each
+ * record that was added, removed, or modified, in key order.
+ *
+ * stats:       If not NULL, statistics will be stored here.
+ *
+ * RETURN VALUE:
+ *      Zero if the trees were compared, the value returned by `callback` if it
+ *      returned nonzero, or a negative value if a node couldn't be read.
+ */
+int diff_fs_trees(diff_tree_t* old_tree, diff_tree_t* new_tree, diff_callback_t callback, void* context, diff_stats_t* stats);
+
+#endif // APFS_FUNC_DIFF_H
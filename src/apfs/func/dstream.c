@@ -0,0 +1,141 @@
+#include "dstream.h"
+
+file_extent_t* get_file_extents(j_rec_t** records, size_t* num_extents) {
+    *num_extents = 0;
+
+    size_t count = 0;
+    for (j_rec_t** cursor = records; cursor && *cursor; cursor++) {
+        j_key_t* hdr = (*cursor)->data;
+        if ( ((hdr->obj_id_and_type & OBJ_TYPE_MASK) >> OBJ_TYPE_SHIFT)  ==  APFS_TYPE_FILE_EXTENT ) {
+            count++;
+        }
+    }
+    if (count == 0) {
+        return NULL;
+    }
+
+    file_extent_t* extents = malloc(count * sizeof(file_extent_t));
+    if (!extents) {
+        fprintf(stderr, "\nABORT: get_file_extents: Could not allocate sufficient memory for `extents`.\n");
+        return NULL;
+    }
+
+    // File-system records are sorted by key, and file extent keys are sorted
+    // by logical address, so the extents will already be in order.
+    size_t i = 0;
+    for (j_rec_t** cursor = records; *cursor; cursor++) {
+        j_rec_t* fs_rec = *cursor;
+        j_key_t* hdr = fs_rec->data;
+        if ( ((hdr->obj_id_and_type & OBJ_TYPE_MASK) >> OBJ_TYPE_SHIFT)  !=  APFS_TYPE_FILE_EXTENT ) {
+            continue;
+        }
+
+        j_file_extent_key_t* key = fs_rec->data;
+        j_file_extent_val_t* val = fs_rec->data + fs_rec->key_len;
+
+        extents[i].logical_addr     = key->logical_addr;
+        extents[i].length           = val->len_and_flags & J_FILE_EXTENT_LEN_MASK;
+        extents[i].phys_block_num   = val->phys_block_num;
+        extents[i].crypto_id        = val->crypto_id;
+        i++;
+    }
+
+    *num_extents = count;
+    return extents;
+}
+
+int read_dstream_range(file_extent_t* extents, size_t num_extents, uint64_t offset, uint64_t length, void* buffer) {
+    memset(buffer, 0, length);
+    uint64_t range_end = offset + length;
+
+    char* block_buffer = NULL;
+
+    for (size_t i = 0; i < num_extents; i++) {
+        file_extent_t* extent = extents + i;
+        uint64_t extent_end = extent->logical_addr + extent->length;
+
+        if (extent_end <= offset) {
+            continue;
+        }
+        if (extent->logical_addr >= range_end) {
+            break;
+        }
+        if (extent->phys_block_num == 0) {
+            // Sparse extent; already zeroed
+            continue;
+        }
+
+        // The part of this extent that overlaps the requested range
+        uint64_t start = extent->logical_addr > offset ? extent->logical_addr : offset;
+        uint64_t end   = extent_end < range_end ? extent_end : range_end;
+
+        while (start < end) {
+            uint64_t offset_in_extent = start - extent->logical_addr;
+            paddr_t  first_block      = extent->phys_block_num + offset_in_extent / nx_device->block_size;
+            uint64_t offset_in_block  = offset_in_extent % nx_device->block_size;
+
+            uint64_t run_len = end - start;
+            if (run_len > DSTREAM_MAX_READ_SIZE - offset_in_block) {
+                run_len = DSTREAM_MAX_READ_SIZE - offset_in_block;
+            }
+            size_t num_blocks = (offset_in_block + run_len + nx_device->block_size - 1) / nx_device->block_size;
+            uint64_t sector = extent->crypto_id + (first_block - extent->phys_block_num) * (nx_device->block_size / AES_XTS_SECTOR_SIZE);
+
+            char* dest = (char*)buffer + (start - offset);
+            if (offset_in_block == 0 && run_len == num_blocks * nx_device->block_size) {
+                // Block-aligned run; read straight into the caller's buffer
+                if (read_blocks(dest, first_block, num_blocks) != num_blocks) {
+                    fprintf(stderr, "\nERROR: read_dstream_range: Failed to read %lu blocks at 0x%llx.\n", num_blocks, first_block);
+                    free(block_buffer);
+                    return -1;
+                }
+                decrypt_file_blocks(dest, num_blocks, sector);
+            } else {
+                if (!block_buffer) {
+                    block_buffer = malloc(DSTREAM_MAX_READ_SIZE + nx_device->block_size);
+                    if (!block_buffer) {
+                        fprintf(stderr, "\nABORT: read_dstream_range: Could not allocate sufficient memory for `block_buffer`.\n");
+                        return -1;
+                    }
+                }
+                if (read_blocks(block_buffer, first_block, num_blocks) != num_blocks) {
+                    fprintf(stderr, "\nERROR: read_dstream_range: Failed to read %lu blocks at 0x%llx.\n", num_blocks, first_block);
+                    free(block_buffer);
+                    return -1;
+                }
+                decrypt_file_blocks(block_buffer, num_blocks, sector);
+                memcpy(dest, block_buffer + offset_in_block, run_len);
+            }
+
+            start += run_len;
+        }
+    }
+
+    free(block_buffer);
+    return 0;
+}
+
+int write_dstream(file_extent_t* extents, size_t num_extents, uint64_t size, FILE* out) {
+    size_t buffer_size = size < DSTREAM_MAX_READ_SIZE ? size : DSTREAM_MAX_READ_SIZE;
+    char* buffer = malloc(buffer_size ? buffer_size : 1);
+    if (!buffer) {
+        fprintf(stderr, "\nABORT: write_dstream: Could not allocate sufficient memory for `buffer`.\n");
+        return -1;
+    }
+
+    for (uint64_t offset = 0; offset < size; offset += buffer_size) {
+        uint64_t length = size - offset < buffer_size ? size - offset : buffer_size;
+        if (read_dstream_range(extents, num_extents, offset, length, buffer) != 0) {
+            free(buffer);
+            return -1;
+        }
+        if (fwrite(buffer, length, 1, out) != 1) {
+            fprintf(stderr, "\nERROR: write_dstream: Failed to write %llu bytes at offset %llu.\n", length, offset);
+            free(buffer);
+            return -1;
+        }
+    }
+
+    free(buffer);
+    return 0;
+}
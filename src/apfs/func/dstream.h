@@ -0,0 +1,112 @@
+/**
+ * Functions used to read the data of APFS data streams, such as the data of
+ * a file or of an extended attribute that is stored as a data stream.
+ */
+
+#ifndef APFS_FUNC_DSTREAM_H
+#define APFS_FUNC_DSTREAM_H
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "../struct/general.h"
+#include "../struct/j.h"
+#include "../struct/dstream.h"
+#include "../io.h"
+
+#include "btree.h"
+#include "crypto.h"
+
+/**
+ * The maximum number of bytes that `read_dstream_range()` will read from the
+ * container in a single call to `read_blocks()`. Physically contiguous data
+ * is read in runs of up to this many bytes, so that large streams are read
+ * with few large reads rather than one read per block.
+ */
+#define DSTREAM_MAX_READ_SIZE   (8 * 1024 * 1024)   // = 8 MiB
+
+/**
+ * A single file extent of a data stream, as described by a file-system record
+ * of type `APFS_TYPE_FILE_EXTENT`.
+ *
+ * logical_addr:    Offset of the extent within the data stream, in bytes.
+ *
+ * length:          Length of the extent, in bytes.
+ *
+ * phys_block_num:  Physical block address of the first block of the extent.
+ *      A value of zero denotes a sparse extent, i.e. one whose data is all
+ *      zeroes and which has no blocks allocated to it.
+ *
+ * crypto_id:       On encrypted volumes, the number of the sector that the
+ *      extent's first block is tweaked as; see `apfs/func/crypto.h`.
+ */
+typedef struct {
+    uint64_t    logical_addr;
+    uint64_t    length;
+    paddr_t     phys_block_num;
+    uint64_t    crypto_id;
+} file_extent_t;
+
+/**
+ * Collect the file extents listed in a given file-system records array.
+ *
+ * records:     A pointer to an array of file-system records, as returned by
+ *      `get_fs_records()`.
+ *
+ * num_extents: The number of extents found will be stored here.
+ *
+ * RETURN VALUE:
+ *      A pointer to an array of `*num_extents` file extents, sorted by their
+ *      logical address, which must be freed when no longer needed; or NULL if
+ *      the records array contains no file extents or an error occurs, in
+ *      which case `*num_extents` will be zero.
+ */
+file_extent_t* get_file_extents(j_rec_t** records, size_t* num_extents);
+
+/**
+ * Read a range of bytes from a data stream.
+ *
+ * extents:     A pointer to an array of the data stream's file extents, sorted
+ *      by logical address, as returned by `get_file_extents()`.
+ *
+ * num_extents: The number of extents in `extents`.
+ *
+ * offset:      The offset within the data stream to start reading from.
+ *
+ * length:      The number of bytes to read.
+ *
+ * buffer:      The location where the data will be stored. It is the
+ *      caller's responsibility to ensure that at least `length` bytes are
+ *      allocated.
+ *
+ * Parts of the range which aren't covered by any extent, as well as sparse
+ * extents, are read as zeroes. Physically contiguous data is read using as
+ * few calls to `read_blocks()` as possible; see `DSTREAM_MAX_READ_SIZE`.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value if a read error occurs.
+ */
+int read_dstream_range(file_extent_t* extents, size_t num_extents, uint64_t offset, uint64_t length, void* buffer);
+
+/**
+ * Write the whole of a data stream to a given file.
+ *
+ * extents:     A pointer to an array of the data stream's file extents, sorted
+ *      by logical address, as returned by `get_file_extents()`.
+ *
+ * num_extents: The number of extents in `extents`.
+ *
+ * size:        The logical size of the data stream, in bytes. Data beyond this
+ *      size (e.g. the remainder of the last allocated block) is not written.
+ *
+ * out:         The file to write the data to.
+ *
+ * The data is read and written in pieces of up to `DSTREAM_MAX_READ_SIZE`
+ * bytes, so memory usage doesn't depend on the size of the data stream.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value if a read or write error occurs.
+ */
+int write_dstream(file_extent_t* extents, size_t num_extents, uint64_t size, FILE* out);
+
+#endif // APFS_FUNC_DSTREAM_H
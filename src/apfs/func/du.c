@@ -0,0 +1,667 @@
+#include "du.h"
+
+/** Limits **/
+
+#define DU_MAX_DEPTH    J_MAX_PATH_DEPTH    // Guards against cycles of parent IDs in a damaged tree
+
+/**
+ * The addresses of the leaf nodes of a file-system tree, in tree order.
+ */
+typedef struct {
+    paddr_t*    addrs;
+    size_t      num_addrs;
+    size_t      capacity;
+} du_leaves_t;
+
+/**
+ * The state of a thread tallying a range of leaf nodes.
+ *
+ * root_leaf:   The root node, to be tallied too if it's a leaf; else NULL.
+ *
+ * entries:     The partial totals of each object seen, in no particular order.
+ *      For a directory, these are the totals of the files directly in it that
+ *      are in this thread's leaf nodes.
+ *
+ * index:       Maps each object's ID to one more than the position of its entry
+ *      in `entries`; this is the table that files are tallied in by parent ID.
+ */
+typedef struct {
+    nx_device_t*        device;
+    paddr_t*            leaves;
+    size_t              num_leaves;
+    btree_node_phys_t*  root_leaf;
+
+    du_dir_t*           entries;
+    size_t              num_entries;
+    size_t              capacity;
+    oid_map_t*          index;
+
+    uint64_t            leaves_read;
+    bool                failed;
+} du_worker_t;
+
+/**
+ * The position of a directory in the order in which totals are added to those
+ * of each directory's parent.
+ */
+typedef struct {
+    uint32_t    depth;
+    size_t      index;
+} du_order_t;
+
+bool add_du_leaf(du_leaves_t* leaves, paddr_t addr) {
+    if (leaves->num_addrs == leaves->capacity) {
+        size_t capacity = leaves->capacity ? 2 * leaves->capacity : 1024;
+        paddr_t* addrs = realloc(leaves->addrs, capacity * sizeof(paddr_t));
+        if (!addrs) {
+            fprintf(stderr, "\nABORT: add_du_leaf: Could not allocate sufficient memory for `addrs`.\n");
+            return false;
+        }
+        leaves->addrs = addrs;
+        leaves->capacity = capacity;
+    }
+    leaves->addrs[leaves->num_addrs++] = addr;
+    return true;
+}
+
+/**
+ * Find the addresses of the leaf nodes beneath a non-leaf node of a file-system
+ * tree, reading only the non-leaf nodes.
+ *
+ * nodes:       Buffers for the nodes beneath `node`, one block per level;
+ *      `nodes[i]` is used for nodes at level `i`.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value on failure.
+ */
+int collect_du_leaves(du_leaves_t* leaves, btree_node_phys_t* fs_omap_btree, btree_node_phys_t* node, btree_node_phys_t** nodes) {
+    char* toc_start = (char*)(node->btn_data) + node->btn_table_space.off;
+    char* key_start = toc_start + node->btn_table_space.len;
+    char* val_end   = (char*)node + nx_device->block_size;
+    if (node->btn_flags & BTNODE_ROOT) {
+        val_end -= sizeof(btree_info_t);
+    }
+    if (node->btn_flags & BTNODE_FIXED_KV_SIZE) {
+        fprintf(stderr, "\nABORT: collect_du_leaves: File-system trees don't have fixed-size keys and values.\n");
+        return -1;
+    }
+
+    kvloc_t* toc_entry = (kvloc_t*)toc_start;
+    for (uint32_t i = 0; i < node->btn_nkeys; i++, toc_entry++) {
+        if ((char*)(toc_entry + 1) > key_start || toc_entry->v.off < sizeof(oid_t) || val_end - toc_entry->v.off < key_start) {
+            fprintf(stderr, "\nABORT: collect_du_leaves: Entry %u of the node with OID 0x%llx is malformed.\n", i, node->btn_o.o_oid);
+            return -1;
+        }
+
+        oid_t child_oid = *(oid_t*)(val_end - toc_entry->v.off);
+        paddr_t child_addr = child_oid;
+        if (fs_omap_btree) {
+            omap_val_t* omap_val = get_btree_phys_omap_val(fs_omap_btree, child_oid, fs_view_xid);
+            if (!omap_val) {
+                fprintf(stderr, "\nABORT: collect_du_leaves: Could not resolve the child node with OID 0x%llx.\n", child_oid);
+                return -1;
+            }
+            child_addr = omap_val->ov_paddr;
+            free(omap_val);
+        }
+
+        // The leaf nodes themselves are read later, by the worker threads.
+        if (node->btn_level == 1) {
+            if (!add_du_leaf(leaves, child_addr)) {
+                return -1;
+            }
+            continue;
+        }
+
+        uint16_t child_level = node->btn_level - 1;
+        btree_node_phys_t* child = nodes[child_level];
+        if (read_node(child, child_addr) != 1 || !verify_node(child, child_addr)) {
+            fprintf(stderr, "\nABORT: collect_du_leaves: Failed to read the node at block 0x%llx.\n", child_addr);
+            return -1;
+        }
+        if (child->btn_level != child_level) {
+            fprintf(stderr, "\nABORT: collect_du_leaves: The node at block 0x%llx is not a level-%u node.\n", child_addr, child_level);
+            return -1;
+        }
+        if (collect_du_leaves(leaves, fs_omap_btree, child, nodes) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Get the entry for a given object in a worker's table, adding an empty one if
+ * there's none yet.
+ *
+ * RETURN VALUE:
+ *      A pointer to the entry, or NULL if memory couldn't be allocated.
+ */
+du_dir_t* get_du_entry(du_worker_t* worker, oid_t oid) {
+    uintptr_t position = (uintptr_t)oid_map_get(worker->index, oid);
+    if (position) {
+        return worker->entries + position - 1;
+    }
+
+    if (worker->num_entries == worker->capacity) {
+        size_t capacity = worker->capacity ? 2 * worker->capacity : 1024;
+        du_dir_t* entries = realloc(worker->entries, capacity * sizeof(du_dir_t));
+        if (!entries) {
+            fprintf(stderr, "\nABORT: get_du_entry: Could not allocate sufficient memory for `entries`.\n");
+            return NULL;
+        }
+        worker->entries = entries;
+        worker->capacity = capacity;
+    }
+    du_dir_t* entry = worker->entries + worker->num_entries++;
+    memset(entry, 0, sizeof(du_dir_t));
+    entry->oid = oid;
+    if (!oid_map_put(worker->index, oid, (void*)(uintptr_t)worker->num_entries)) {
+        fprintf(stderr, "\nABORT: get_du_entry: Could not allocate sufficient memory for `index`.\n");
+        return NULL;
+    }
+    return entry;
+}
+
+/**
+ * Tally the records of a leaf node of a file-system tree in a worker's table.
+ *
+ * rec:         A buffer of at least `sizeof(j_rec_t)` plus one block, in which
+ *      inode records are reassembled for `get_inode_xfield()`.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value on failure.
+ */
+int tally_du_leaf(du_worker_t* worker, btree_node_phys_t* node, j_rec_t* rec) {
+    char* toc_start = (char*)(node->btn_data) + node->btn_table_space.off;
+    char* key_start = toc_start + node->btn_table_space.len;
+    char* val_end   = (char*)node + nx_device->block_size;
+    if (node->btn_flags & BTNODE_ROOT) {
+        val_end -= sizeof(btree_info_t);
+    }
+    if (node->btn_flags & BTNODE_FIXED_KV_SIZE) {
+        fprintf(stderr, "\nABORT: tally_du_leaf: File-system trees don't have fixed-size keys and values.\n");
+        return -1;
+    }
+
+    kvloc_t* toc_entry = (kvloc_t*)toc_start;
+    for (uint32_t i = 0; i < node->btn_nkeys; i++, toc_entry++) {
+        if ((char*)(toc_entry + 1) > key_start) {
+            fprintf(stderr, "- The table of contents of the node with OID 0x%llx is malformed. Skipping its remaining entries.\n", node->btn_o.o_oid);
+            break;
+        }
+        uint16_t key_len = toc_entry->k.len;
+        uint16_t val_len = toc_entry->v.len;
+        char* key_data = key_start + toc_entry->k.off;
+        char* val_data = val_end - toc_entry->v.off;
+        if (key_len < sizeof(j_key_t) || key_data + key_len > val_end || toc_entry->v.off < val_len || val_data < key_start) {
+            fprintf(stderr, "- Entry %u of the node with OID 0x%llx is malformed. Skipping it.\n", i, node->btn_o.o_oid);
+            continue;
+        }
+
+        j_key_t* hdr = (j_key_t*)key_data;
+        oid_t oid = hdr->obj_id_and_type & OBJ_ID_MASK;
+        du_dir_t* entry = NULL;
+        switch ( (hdr->obj_id_and_type & OBJ_TYPE_MASK) >> OBJ_TYPE_SHIFT ) {
+            case APFS_TYPE_INODE: {
+                if (val_len < sizeof(j_inode_val_t)) {
+                    break;
+                }
+                rec->key_len = key_len;
+                rec->val_len = val_len;
+                memcpy(rec->data, key_data, key_len);
+                memcpy(rec->data + key_len, val_data, val_len);
+                j_inode_val_t* val = rec->data + key_len;
+
+                if ((val->mode & S_IFMT) == S_IFDIR) {
+                    entry = get_du_entry(worker, oid);
+                    if (!entry) {
+                        return -1;
+                    }
+                    entry->flags |= DU_DIR_INODE;
+                    entry->parent_id = val->parent_id;
+                    oid_t* dir_stats_key = get_inode_xfield(rec, INO_EXT_TYPE_DIR_STATS_KEY);
+                    if (dir_stats_key) {
+                        entry->dir_stats_id = *dir_stats_key;
+                    }
+                    break;
+                }
+
+                entry = get_du_entry(worker, val->parent_id);
+                if (!entry) {
+                    return -1;
+                }
+                entry->num_files++;
+                j_dstream_t* dstream = get_inode_dstream(rec);
+                if (dstream) {
+                    entry->logical_size += dstream->size;
+                    entry->alloced_size += dstream->alloced_size;
+                }
+            } break;
+            case APFS_TYPE_DIR_REC: {
+                // Spec incorrectly says to use `j_drec_key_t`; see NOTE in `apfs/struct/j.h`
+                j_drec_hashed_key_t*    key = (j_drec_hashed_key_t*)key_data;
+                j_drec_val_t*           val = (j_drec_val_t*)val_data;
+                if (key_len < sizeof(j_drec_hashed_key_t) || val_len < sizeof(j_drec_val_t) || (val->flags & DREC_TYPE_MASK) != DT_DIR) {
+                    break;
+                }
+                size_t name_len = key->name_len_and_hash & J_DREC_LEN_MASK;
+                if (name_len == 0 || name_len > key_len - sizeof(j_drec_hashed_key_t)) {
+                    break;
+                }
+
+                entry = get_du_entry(worker, val->file_id);
+                if (!entry) {
+                    return -1;
+                }
+                if (!entry->name) {
+                    entry->name = malloc(name_len);
+                    if (!entry->name) {
+                        fprintf(stderr, "\nABORT: tally_du_leaf: Could not allocate sufficient memory for `name`.\n");
+                        return -1;
+                    }
+                    // The length includes the terminating NULL byte.
+                    memcpy(entry->name, key->name, name_len - 1);
+                    entry->name[name_len - 1] = '\0';
+                }
+            } break;
+            case APFS_TYPE_DIR_STATS: {
+                // Spec incorrectly says to use `j_drec_val_t`; we use `j_dir_stats_val_t`
+                if (val_len < sizeof(j_dir_stats_val_t)) {
+                    break;
+                }
+                entry = get_du_entry(worker, oid);
+                if (!entry) {
+                    return -1;
+                }
+                entry->flags |= DU_DIR_STATS_RECORD;
+                entry->dir_stats_size = ((j_dir_stats_val_t*)val_data)->total_size;
+            } break;
+            default:
+                break;
+        }
+    }
+    return 0;
+}
+
+void* du_worker(void* arg) {
+    du_worker_t* worker = arg;
+    nx_device = worker->device;
+
+    btree_node_phys_t* node = malloc(nx_device->block_size);
+    j_rec_t* rec = malloc(sizeof(j_rec_t) + nx_device->block_size);
+    if (!node || !rec) {
+        fprintf(stderr, "\nABORT: du_worker: Could not allocate sufficient memory for `node`.\n");
+        worker->failed = true;
+        goto cleanup;
+    }
+
+    if (worker->root_leaf && tally_du_leaf(worker, worker->root_leaf, rec) != 0) {
+        worker->failed = true;
+        goto cleanup;
+    }
+    for (size_t i = 0; i < worker->num_leaves; i++) {
+        paddr_t addr = worker->leaves[i];
+        if (read_node(node, addr) != 1 || !verify_node(node, addr)) {
+            fprintf(stderr, "\nABORT: du_worker: Failed to read the node at block 0x%llx.\n", addr);
+            worker->failed = true;
+            break;
+        }
+        if (node->btn_level != 0) {
+            fprintf(stderr, "\nABORT: du_worker: The node at block 0x%llx is not a leaf node.\n", addr);
+            worker->failed = true;
+            break;
+        }
+        if (tally_du_leaf(worker, node, rec) != 0) {
+            worker->failed = true;
+            break;
+        }
+        worker->leaves_read++;
+    }
+
+cleanup:
+    free(rec);
+    free(node);
+    return NULL;
+}
+
+/**
+ * Run the workers of `get_fs_dir_sizes()`, each in its own thread. A worker
+ * whose thread can't be spawned is run by the calling thread instead.
+ */
+void run_du_workers(du_worker_t* workers, unsigned int num_workers) {
+    // The calling thread also acts as a worker, so we spawn one fewer thread.
+    pthread_t threads[num_workers];
+    bool spawned[num_workers];
+    for (unsigned int i = 1; i < num_workers; i++) {
+        spawned[i] = pthread_create(&threads[i], NULL, du_worker, workers + i) == 0;
+    }
+    du_worker(workers);
+    for (unsigned int i = 1; i < num_workers; i++) {
+        if (spawned[i]) {
+            pthread_join(threads[i], NULL);
+        } else {
+            du_worker(workers + i);
+        }
+    }
+}
+
+int compare_du_dirs(const void* a, const void* b) {
+    oid_t oid_a = ((const du_dir_t*)a)->oid;
+    oid_t oid_b = ((const du_dir_t*)b)->oid;
+    return (oid_a > oid_b) - (oid_a < oid_b);
+}
+
+int compare_du_children(const void* a, const void* b) {
+    const du_dir_t* dir_a = *(const du_dir_t**)a;
+    const du_dir_t* dir_b = *(const du_dir_t**)b;
+    if (dir_a->parent_id != dir_b->parent_id) {
+        return (dir_a->parent_id > dir_b->parent_id) - (dir_a->parent_id < dir_b->parent_id);
+    }
+    // Directories without a name sort last.
+    if (!dir_a->name || !dir_b->name) {
+        return (dir_a->name == NULL) - (dir_b->name == NULL);
+    }
+    return strcmp(dir_a->name, dir_b->name);
+}
+
+int compare_du_order(const void* a, const void* b) {
+    // Deepest first
+    uint32_t depth_a = ((const du_order_t*)a)->depth;
+    uint32_t depth_b = ((const du_order_t*)b)->depth;
+    return (depth_a < depth_b) - (depth_a > depth_b);
+}
+
+/**
+ * Merge the partial totals of an object from one worker's table into those
+ * from another's.
+ */
+void merge_du_entry(du_dir_t* dst, du_dir_t* src) {
+    if (src->flags & DU_DIR_INODE) {
+        dst->parent_id      = src->parent_id;
+        dst->dir_stats_id   = src->dir_stats_id;
+    }
+    if (src->flags & DU_DIR_STATS_RECORD) {
+        dst->dir_stats_size = src->dir_stats_size;
+    }
+    if (!dst->name) {
+        dst->name = src->name;
+    } else {
+        free(src->name);
+    }
+    dst->logical_size   += src->logical_size;
+    dst->alloced_size   += src->alloced_size;
+    dst->num_files      += src->num_files;
+    dst->flags          |= src->flags;
+}
+
+/**
+ * Merge the workers' tables into a single table of directories, sorted by
+ * inode number, and take the logical size of each directory that has a
+ * directory statistics record from that record.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value if memory couldn't be allocated.
+ */
+int merge_du_workers(du_table_t* table, du_worker_t* workers, unsigned int num_workers) {
+    size_t num_entries = 0;
+    for (unsigned int i = 0; i < num_workers; i++) {
+        num_entries += workers[i].num_entries;
+    }
+    du_dir_t* entries = malloc((num_entries ? num_entries : 1) * sizeof(du_dir_t));
+    if (!entries) {
+        fprintf(stderr, "\nABORT: merge_du_workers: Could not allocate sufficient memory for `entries`.\n");
+        return -1;
+    }
+    size_t offset = 0;
+    for (unsigned int i = 0; i < num_workers; i++) {
+        if (workers[i].num_entries == 0) {
+            continue;
+        }
+        memcpy(entries + offset, workers[i].entries, workers[i].num_entries * sizeof(du_dir_t));
+        offset += workers[i].num_entries;
+        // The names now belong to `entries`.
+        workers[i].num_entries = 0;
+    }
+
+    qsort(entries, num_entries, sizeof(du_dir_t), compare_du_dirs);
+    size_t num_unique = 0;
+    for (size_t i = 0; i < num_entries; i++) {
+        if (num_unique > 0 && entries[num_unique - 1].oid == entries[i].oid) {
+            merge_du_entry(entries + num_unique - 1, entries + i);
+        } else {
+            entries[num_unique++] = entries[i];
+        }
+    }
+
+    for (size_t i = 0; i < num_unique; i++) {
+        du_dir_t* dir = entries + i;
+        if (!(dir->flags & DU_DIR_INODE) || !dir->dir_stats_id) {
+            continue;
+        }
+        du_dir_t key = { .oid = dir->dir_stats_id };
+        du_dir_t* stats = bsearch(&key, entries, num_unique, sizeof(du_dir_t), compare_du_dirs);
+        if (stats && (stats->flags & DU_DIR_STATS_RECORD)) {
+            dir->dir_stats_size = stats->dir_stats_size;
+            dir->flags |= DU_FROM_DIR_STATS;
+            table->dirs_from_stats++;
+        }
+    }
+
+    // Keep only the directories. Files tallied against a parent whose inode
+    // wasn't found are orphans.
+    size_t num_dirs = 0;
+    for (size_t i = 0; i < num_unique; i++) {
+        if (entries[i].flags & DU_DIR_INODE) {
+            entries[num_dirs++] = entries[i];
+        } else {
+            table->orphans += entries[i].num_files;
+            free(entries[i].name);
+        }
+    }
+    table->dirs = entries;
+    table->num_dirs = num_dirs;
+    return 0;
+}
+
+/**
+ * Add the totals of each directory in a table to those of its parent, deepest
+ * directories first, so that each directory's totals cover its whole subtree.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value if memory couldn't be allocated.
+ */
+int aggregate_du_table(du_table_t* table) {
+    size_t num_dirs = table->num_dirs;
+    size_t* parents = malloc((num_dirs ? num_dirs : 1) * sizeof(size_t));
+    du_order_t* order = malloc((num_dirs ? num_dirs : 1) * sizeof(du_order_t));
+    if (!parents || !order) {
+        fprintf(stderr, "\nABORT: aggregate_du_table: Could not allocate sufficient memory.\n");
+        free(parents);
+        free(order);
+        return -1;
+    }
+
+    // `num_dirs` stands for "no parent".
+    for (size_t i = 0; i < num_dirs; i++) {
+        du_dir_t* parent = find_du_dir(table, table->dirs[i].parent_id);
+        parents[i] = parent && parent != table->dirs + i ? (size_t)(parent - table->dirs) : num_dirs;
+        if (!parent && table->dirs[i].parent_id != ROOT_DIR_PARENT) {
+            table->orphans++;
+        }
+    }
+    for (size_t i = 0; i < num_dirs; i++) {
+        uint32_t depth = 0;
+        for (size_t j = parents[i]; j != num_dirs && depth <= DU_MAX_DEPTH; j = parents[j]) {
+            depth++;
+        }
+        if (depth > DU_MAX_DEPTH) {
+            fprintf(stderr, "- The ancestors of directory 0x%llx form a cycle. Not counting it in its parent.\n", table->dirs[i].oid);
+            parents[i] = num_dirs;
+            table->orphans++;
+        }
+        order[i].depth = depth;
+        order[i].index = i;
+    }
+    qsort(order, num_dirs, sizeof(du_order_t), compare_du_order);
+
+    for (size_t i = 0; i < num_dirs; i++) {
+        du_dir_t* dir = table->dirs + order[i].index;
+        if (dir->flags & DU_FROM_DIR_STATS) {
+            dir->logical_size = dir->dir_stats_size;
+        }
+        size_t parent_index = parents[order[i].index];
+        if (parent_index == num_dirs) {
+            continue;
+        }
+        du_dir_t* parent = table->dirs + parent_index;
+        parent->logical_size    += dir->logical_size;
+        parent->alloced_size    += dir->alloced_size;
+        parent->num_files       += dir->num_files;
+        parent->num_dirs        += dir->num_dirs + 1;
+    }
+
+    free(order);
+    free(parents);
+    return 0;
+}
+
+du_table_t* get_fs_dir_sizes(btree_node_phys_t* fs_omap_btree, btree_node_phys_t* fs_root_btree, unsigned int num_threads) {
+    du_table_t* table = calloc(1, sizeof(du_table_t));
+    du_leaves_t leaves = { 0 };
+    du_worker_t* workers = NULL;
+    unsigned int num_workers = 0;
+    btree_node_phys_t** nodes = calloc(fs_root_btree->btn_level + 1, sizeof(btree_node_phys_t*));
+    if (!table || !nodes) {
+        fprintf(stderr, "\nABORT: get_fs_dir_sizes: Could not allocate sufficient memory.\n");
+        goto onError;
+    }
+    for (uint16_t i = 0; i < fs_root_btree->btn_level; i++) {
+        nodes[i] = malloc(nx_device->block_size);
+        if (!nodes[i]) {
+            fprintf(stderr, "\nABORT: get_fs_dir_sizes: Could not allocate sufficient memory for `nodes`.\n");
+            goto onError;
+        }
+    }
+    if (fs_root_btree->btn_level > 0 && collect_du_leaves(&leaves, fs_omap_btree, fs_root_btree, nodes) != 0) {
+        goto onError;
+    }
+
+    if (num_threads == 0) {
+        num_threads = DU_DEFAULT_NUM_THREADS;
+    }
+    if (num_threads > leaves.num_addrs) {
+        num_threads = leaves.num_addrs ? leaves.num_addrs : 1;
+    }
+    workers = calloc(num_threads, sizeof(du_worker_t));
+    if (!workers) {
+        fprintf(stderr, "\nABORT: get_fs_dir_sizes: Could not allocate sufficient memory for `workers`.\n");
+        goto onError;
+    }
+    for (unsigned int i = 0; i < num_threads; i++, num_workers++) {
+        // Each worker gets a contiguous range of leaf nodes.
+        size_t start = leaves.num_addrs * i / num_threads;
+        size_t end   = leaves.num_addrs * (i + 1) / num_threads;
+        workers[i].device       = nx_device;
+        workers[i].leaves       = leaves.addrs + start;
+        workers[i].num_leaves   = end - start;
+        workers[i].index        = oid_map_create(1024);
+        if (!workers[i].index) {
+            fprintf(stderr, "\nABORT: get_fs_dir_sizes: Could not allocate sufficient memory for `index`.\n");
+            goto onError;
+        }
+    }
+    if (fs_root_btree->btn_level == 0) {
+        workers[0].root_leaf = fs_root_btree;
+        table->leaves_read++;
+    }
+
+    run_du_workers(workers, num_workers);
+
+    bool failed = false;
+    for (unsigned int i = 0; i < num_workers; i++) {
+        failed |= workers[i].failed;
+        table->leaves_read += workers[i].leaves_read;
+    }
+    if (failed || merge_du_workers(table, workers, num_workers) != 0 || aggregate_du_table(table) != 0) {
+        goto onError;
+    }
+
+    table->children = malloc((table->num_dirs ? table->num_dirs : 1) * sizeof(du_dir_t*));
+    if (!table->children) {
+        fprintf(stderr, "\nABORT: get_fs_dir_sizes: Could not allocate sufficient memory for `children`.\n");
+        goto onError;
+    }
+    for (size_t i = 0; i < table->num_dirs; i++) {
+        table->children[i] = table->dirs + i;
+    }
+    qsort(table->children, table->num_dirs, sizeof(du_dir_t*), compare_du_children);
+
+    for (unsigned int i = 0; i < num_workers; i++) {
+        oid_map_free(workers[i].index, NULL);
+        free(workers[i].entries);
+    }
+    free(workers);
+    for (uint16_t i = 0; i < fs_root_btree->btn_level; i++) {
+        free(nodes[i]);
+    }
+    free(nodes);
+    free(leaves.addrs);
+    return table;
+
+onError:
+    for (unsigned int i = 0; i < num_workers; i++) {
+        oid_map_free(workers[i].index, NULL);
+        for (size_t j = 0; j < workers[i].num_entries; j++) {
+            free(workers[i].entries[j].name);
+        }
+        free(workers[i].entries);
+    }
+    free(workers);
+    if (nodes) {
+        for (uint16_t i = 0; i < fs_root_btree->btn_level; i++) {
+            free(nodes[i]);
+        }
+    }
+    free(nodes);
+    free(leaves.addrs);
+    du_table_free(table);
+    return NULL;
+}
+
+void du_table_free(du_table_t* table) {
+    if (!table) {
+        return;
+    }
+    for (size_t i = 0; i < table->num_dirs; i++) {
+        free(table->dirs[i].name);
+    }
+    free(table->dirs);
+    free(table->children);
+    free(table);
+}
+
+du_dir_t* find_du_dir(du_table_t* table, oid_t oid) {
+    du_dir_t key = { .oid = oid };
+    return bsearch(&key, table->dirs, table->num_dirs, sizeof(du_dir_t), compare_du_dirs);
+}
+
+du_dir_t** get_du_children(du_table_t* table, oid_t parent_id, size_t* num_children) {
+    // Find the first directory whose parent ID is at least `parent_id`.
+    size_t lo = 0;
+    size_t hi = table->num_dirs;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (table->children[mid]->parent_id < parent_id) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    size_t end = lo;
+    while (end < table->num_dirs && table->children[end]->parent_id == parent_id) {
+        end++;
+    }
+    *num_children = end - lo;
+    return table->children + lo;
+}
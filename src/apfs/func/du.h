@@ -0,0 +1,166 @@
+/**
+ * Functions used to total the sizes of the files beneath each directory of a
+ * volume, in a single pass over the leaf nodes of its file-system tree.
+ *
+ * Rather than walking the directory hierarchy, which would look up each
+ * directory's records separately, the leaf nodes are read in tree order and
+ * every inode is tallied against its parent's ID, in a table keyed by that
+ * ID. The leaf nodes are split into contiguous ranges, each tallied by its own
+ * thread into its own table; the tables are then merged, and each directory's
+ * totals are added to its parent's, deepest directories first.
+ *
+ * Where a directory has a directory statistics record (see
+ * `INODE_MAINTAIN_DIR_STATS`), its logical size is taken from the record's
+ * `total_size` instead of the totals of its subtree, which are then only
+ * needed for the other figures. Directory statistics don't record allocated
+ * sizes, so the leaf nodes are read either way.
+ *
+ * A file's logical size is that of its data stream, and its allocated size is
+ * the space allocated to that data stream; compressed files whose data is held
+ * in an extended attribute have neither. A hard-linked file is counted once,
+ * beneath the directory given by its inode's `parent_id`.
+ */
+
+#ifndef APFS_FUNC_DU_H
+#define APFS_FUNC_DU_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "../io.h"
+#include "../struct/general.h"
+#include "../struct/object.h"
+#include "../struct/btree.h"
+#include "../struct/omap.h"
+#include "../struct/j.h"
+#include "../struct/dstream.h"
+#include "../struct/xf.h"
+
+#include "btree.h"
+#include "cksum_memo.h"
+#include "j.h"
+#include "node_cache.h"
+#include "oid_map.h"
+
+/** Size aggregation constants **/
+
+#define DU_DEFAULT_NUM_THREADS  4
+
+// Values of `flags` in `du_dir_t`
+#define DU_DIR_INODE            0x01    // The object's inode is a directory's
+#define DU_DIR_STATS_RECORD     0x02    // The object is a directory statistics record
+#define DU_FROM_DIR_STATS       0x04    // `logical_size` was taken from a directory statistics record
+
+/**
+ * The sizes of the files in a directory's subtree.
+ *
+ * oid:             The inode number of the directory.
+ *
+ * parent_id:       The inode number of its parent directory.
+ *
+ * dir_stats_id:    The ID of its directory statistics record, or zero if it
+ *      has none.
+ *
+ * dir_stats_size:  The `total_size` of its directory statistics record, if
+ *      that was found.
+ *
+ * name:            The directory's name, from the directory record that refers
+ *      to it; or NULL if there's none.
+ *
+ * logical_size:    The total logical size of the files in the subtree.
+ *
+ * alloced_size:    The total space allocated to the files in the subtree.
+ *
+ * num_files:       The number of files, i.e. of inodes other than directories,
+ *      in the subtree.
+ *
+ * num_dirs:        The number of directories in the subtree, excluding the
+ *      directory itself.
+ *
+ * flags:           A bit field of `DU_*` flags.
+ */
+typedef struct {
+    oid_t       oid;
+    oid_t       parent_id;
+    oid_t       dir_stats_id;
+    uint64_t    dir_stats_size;
+    char*       name;
+
+    uint64_t    logical_size;
+    uint64_t    alloced_size;
+    uint64_t    num_files;
+    uint64_t    num_dirs;
+    uint32_t    flags;
+} du_dir_t;
+
+/**
+ * The sizes of every directory in a volume.
+ *
+ * dirs:            The directories, sorted by inode number.
+ *
+ * children:        Pointers to the directories, sorted by parent ID and then
+ *      by name, so that each directory's subdirectories are adjacent; see
+ *      `get_du_children()`.
+ *
+ * leaves_read:     The number of leaf nodes read.
+ *
+ * dirs_from_stats: The number of directories whose logical size was taken
+ *      from a directory statistics record.
+ *
+ * orphans:         The number of objects whose parent directory wasn't found,
+ *      and whose sizes are therefore not counted in any directory but their own.
+ */
+typedef struct {
+    du_dir_t*   dirs;
+    size_t      num_dirs;
+    du_dir_t**  children;
+
+    uint64_t    leaves_read;
+    uint64_t    dirs_from_stats;
+    uint64_t    orphans;
+} du_table_t;
+
+/**
+ * Total the sizes of the files beneath each directory of a volume. Child nodes
+ * are resolved as of `fs_view_xid`; see `apfs/func/btree.h`.
+ *
+ * fs_omap_btree:   The root node of the volume object map B-tree, or NULL if
+ *      the tree refers to its child nodes by physical address.
+ *
+ * num_threads:     The number of threads to tally the leaf nodes with, or zero
+ *      to use `DU_DEFAULT_NUM_THREADS`.
+ *
+ * RETURN VALUE:
+ *      A pointer to the sizes, which must be freed with `du_table_free()`; or
+ *      NULL if an error occurs.
+ */
+du_table_t* get_fs_dir_sizes(btree_node_phys_t* fs_omap_btree, btree_node_phys_t* fs_root_btree, unsigned int num_threads);
+
+void du_table_free(du_table_t* table);
+
+/**
+ * Find a directory in a table returned by `get_fs_dir_sizes()`.
+ *
+ * RETURN VALUE:
+ *      A pointer to the directory's entry, or NULL if there's no directory
+ *      with the given inode number.
+ */
+du_dir_t* find_du_dir(du_table_t* table, oid_t oid);
+
+/**
+ * Get the subdirectories of a directory in a table returned by
+ * `get_fs_dir_sizes()`, sorted by name.
+ *
+ * num_children:    The number of subdirectories will be stored here.
+ *
+ * RETURN VALUE:
+ *      A pointer to the first of `*num_children` pointers within
+ *      `table->children`.
+ */
+du_dir_t** get_du_children(du_table_t* table, oid_t parent_id, size_t* num_children);
+
+#endif // APFS_FUNC_DU_H
@@ -0,0 +1,199 @@
+#include "fusion.h"
+
+/** Limits **/
+
+#define FUSION_MT_MAX_DEPTH     16      // Guards against cycles in a damaged tree
+
+bool is_tier2_addr(paddr_t addr) {
+    return (addr & FUSION_TIER2_DEVICE_BLOCK_ADDR(nx_device->block_size)) != 0;
+}
+
+void fusion_map_free(fusion_map_t* map) {
+    if (!map) {
+        return;
+    }
+    free(map->ranges);
+    free(map);
+}
+
+/**
+ * Add a range to a map, in no particular order.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value if memory couldn't be allocated.
+ */
+int fusion_map_add(fusion_map_t* map, paddr_t tier2_addr, fusion_mt_val_t* val) {
+    if (map->num_ranges == map->capacity) {
+        uint64_t capacity = map->capacity ? 2 * map->capacity : 256;
+        fusion_range_t* ranges = realloc(map->ranges, capacity * sizeof(fusion_range_t));
+        if (!ranges) {
+            fprintf(stderr, "\nABORT: fusion_map_add: Could not allocate sufficient memory for `ranges`.\n");
+            return -1;
+        }
+        map->ranges = ranges;
+        map->capacity = capacity;
+    }
+    fusion_range_t* range = map->ranges + map->num_ranges++;
+    range->tier2_addr   = tier2_addr & ~FUSION_TIER2_DEVICE_BLOCK_ADDR(nx_device->block_size);
+    range->cache_addr   = val->fmv_lba;
+    range->length       = val->fmv_length;
+    range->flags        = val->fmv_flags;
+    return 0;
+}
+
+/**
+ * Add the entries of a middle-tree node and its descendants to a map.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value if memory couldn't be allocated.
+ */
+int add_fusion_mt_node(fusion_map_t* map, paddr_t node_addr, uint32_t depth) {
+    btree_node_phys_t* node = malloc(nx_device->block_size);
+    if (!node) {
+        fprintf(stderr, "\nABORT: add_fusion_mt_node: Could not allocate sufficient memory for `node`.\n");
+        return -1;
+    }
+    if (
+            depth > FUSION_MT_MAX_DEPTH
+            || read_node(node, node_addr) != 1
+            || !is_cksum_valid((uint32_t*)node)
+            || !is_btree_node_phys((obj_phys_t*)node)
+    ) {
+        fprintf(stderr, "- The Fusion middle-tree node at block 0x%llx is malformed. Skipping it and its descendants.\n", node_addr);
+        free(node);
+        return 0;
+    }
+
+    char* toc_start = (char*)(node->btn_data) + node->btn_table_space.off;
+    char* key_start = toc_start + node->btn_table_space.len;
+    char* val_end   = (char*)node + nx_device->block_size;
+    if (node->btn_flags & BTNODE_ROOT) {
+        val_end -= sizeof(btree_info_t);
+    }
+    bool is_leaf = node->btn_flags & BTNODE_LEAF;
+    size_t val_size = is_leaf ? sizeof(fusion_mt_val_t) : sizeof(oid_t);
+
+    // The TOC entries of nodes with fixed-size keys and values are instances
+    // of `kvoff_t`, and otherwise of `kvloc_t`.
+    bool fixed_kv_size = node->btn_flags & BTNODE_FIXED_KV_SIZE;
+    size_t toc_entry_size = fixed_kv_size ? sizeof(kvoff_t) : sizeof(kvloc_t);
+
+    int result = 0;
+    for (uint32_t i = 0; i < node->btn_nkeys && result == 0; i++) {
+        if (toc_start + (i + 1) * toc_entry_size > key_start) {
+            fprintf(stderr, "- The table of contents of the Fusion middle-tree node at block 0x%llx is malformed. Skipping its remaining entries.\n", node_addr);
+            break;
+        }
+        uint16_t k_off = fixed_kv_size ? ((kvoff_t*)toc_start)[i].k : ((kvloc_t*)toc_start)[i].k.off;
+        uint16_t v_off = fixed_kv_size ? ((kvoff_t*)toc_start)[i].v : ((kvloc_t*)toc_start)[i].v.off;
+        if (key_start + k_off + sizeof(fusion_mt_key_t) > val_end - v_off || v_off < val_size) {
+            fprintf(stderr, "- Entry %u of the Fusion middle-tree node at block 0x%llx is malformed. Skipping it.\n", i, node_addr);
+            continue;
+        }
+
+        if (is_leaf) {
+            fusion_mt_key_t key = *(fusion_mt_key_t*)(key_start + k_off);
+            result = fusion_map_add(map, key, (fusion_mt_val_t*)(val_end - v_off));
+        } else {
+            result = add_fusion_mt_node(map, *(oid_t*)(val_end - v_off), depth + 1);
+        }
+    }
+    free(node);
+    return result;
+}
+
+int compare_fusion_ranges(const void* a, const void* b) {
+    paddr_t addr_a = ((const fusion_range_t*)a)->tier2_addr;
+    paddr_t addr_b = ((const fusion_range_t*)b)->tier2_addr;
+    return (addr_a > addr_b) - (addr_a < addr_b);
+}
+
+fusion_map_t* load_fusion_map(nx_superblock_t* nxsb) {
+    if (!nxsb->nx_fusion_mt_oid) {
+        return NULL;
+    }
+    fusion_map_t* map = calloc(1, sizeof(fusion_map_t));
+    if (!map) {
+        fprintf(stderr, "\nABORT: load_fusion_map: Could not allocate sufficient memory for `map`.\n");
+        return NULL;
+    }
+    if (add_fusion_mt_node(map, nxsb->nx_fusion_mt_oid, 0) != 0) {
+        fusion_map_free(map);
+        return NULL;
+    }
+    // The leaves are normally visited in order already.
+    qsort(map->ranges, map->num_ranges, sizeof(fusion_range_t), compare_fusion_ranges);
+    return map;
+}
+
+uint64_t find_fusion_range(fusion_map_t* map, paddr_t tier2_addr) {
+    uint64_t lo = 0;
+    uint64_t hi = map->num_ranges;
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        fusion_range_t* range = map->ranges + mid;
+        if (range->tier2_addr + range->length <= tier2_addr) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+int open_fusion_tier2(char* tier2_path) {
+    fprintf(stderr, "Opening the second tier at `%s` in read-only mode ... ", tier2_path);
+    nx_device->tier2_path = tier2_path;
+    nx_device->tier2_file = fopen(tier2_path, "rb");
+    if (!nx_device->tier2_file) {
+        fprintf(stderr, "\nABORT: ");
+        report_fopen_error();
+        nx_device->tier2_path = NULL;
+        return -1;
+    }
+    fprintf(stderr, "OK.\n");
+    return 0;
+}
+
+size_t read_tier2_blocks(void* buffer, paddr_t start_block, size_t num_blocks) {
+    if (!nx_device->tier2_file) {
+        fprintf(stderr, "FAILED: read_blocks: Block 0x%llx is on the second tier of a Fusion container, which wasn't given.\n", start_block);
+        return -1;
+    }
+
+    fusion_map_t* map = nx_device->fusion_map;
+    paddr_t addr = start_block & ~FUSION_TIER2_DEVICE_BLOCK_ADDR(nx_device->block_size);
+    uint64_t i = map ? find_fusion_range(map, addr) : 0;
+    size_t num_read = 0;
+    while (num_read < num_blocks) {
+        // Read up to the end of the cached range containing `addr`, or up to
+        // the start of the next one.
+        size_t count = num_blocks - num_read;
+        bool cached = false;
+        paddr_t read_addr = addr;
+        if (map && i < map->num_ranges) {
+            fusion_range_t* range = map->ranges + i;
+            if (range->tier2_addr <= addr) {
+                cached = true;
+                read_addr = range->cache_addr + (addr - range->tier2_addr);
+                if (count > (size_t)(range->tier2_addr + range->length - addr)) {
+                    count = range->tier2_addr + range->length - addr;
+                }
+                i++;
+            } else if (count > (size_t)(range->tier2_addr - addr)) {
+                count = range->tier2_addr - addr;
+            }
+        }
+
+        size_t result = read_device_blocks(!cached, (char*)buffer + num_read * nx_device->block_size, read_addr, count);
+        if (result == (size_t)-1) {
+            return -1;
+        }
+        num_read += result;
+        addr += result;
+        if (result < count) {
+            break;
+        }
+    }
+    return num_read;
+}
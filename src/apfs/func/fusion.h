@@ -0,0 +1,113 @@
+/**
+ * Functions used to read Fusion containers, which span two devices: the main
+ * device (an SSD), which holds the container superblock and checkpoints, and
+ * the second tier (an HDD). Blocks on the second tier have addresses with
+ * `FUSION_TIER2_DEVICE_BLOCK_ADDR()` set.
+ *
+ * Part of the main device is used as a cache of second-tier blocks. The Fusion
+ * middle tree maps ranges of second-tier blocks to where they're cached on the
+ * main device; a cached range, if dirty, is newer than the second tier's copy.
+ * The middle tree is read once, into a sorted array of ranges held by the
+ * current container (see `fusion_map` in `nx_device_t`), and `read_blocks()`
+ * then reads each second-tier block from its cached copy if there is one,
+ * found by binary search, and from the second tier otherwise.
+ */
+
+#ifndef APFS_FUNC_FUSION_H
+#define APFS_FUNC_FUSION_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "../io.h"
+#include "../struct/general.h"
+#include "../struct/object.h"
+#include "../struct/nx.h"
+#include "../struct/btree.h"
+#include "../struct/fusion.h"
+
+#include "boolean.h"
+#include "cksum.h"
+#include "node_cache.h"
+
+/**
+ * A range of second-tier blocks that is cached on the main device.
+ *
+ * tier2_addr:  The address of the first block on the second tier, without
+ *      `FUSION_TIER2_DEVICE_BLOCK_ADDR()`.
+ *
+ * cache_addr:  The address of the first block's cached copy on the main device.
+ *
+ * length:      The number of blocks in the range.
+ *
+ * flags:       The flags of the middle-tree entry, e.g. `FUSION_MT_DIRTY`.
+ */
+typedef struct {
+    paddr_t     tier2_addr;
+    paddr_t     cache_addr;
+    uint32_t    length;
+    uint32_t    flags;
+} fusion_range_t;
+
+/**
+ * The ranges of second-tier blocks cached on the main device, sorted by
+ * `tier2_addr`, as read from a container's Fusion middle tree.
+ */
+typedef struct nx_fusion_map {
+    fusion_range_t* ranges;
+    uint64_t        num_ranges;
+    uint64_t        capacity;
+} fusion_map_t;
+
+/**
+ * Determine whether a block address refers to the second tier of a Fusion
+ * container.
+ */
+bool is_tier2_addr(paddr_t addr);
+
+/**
+ * Read a container's Fusion middle tree into a sorted array of ranges.
+ * Malformed nodes are reported and skipped, leaving their blocks to be read
+ * from the second tier.
+ *
+ * RETURN VALUE:
+ *      A pointer to the map, which must be freed with `fusion_map_free()`; or
+ *      NULL if the container has no middle tree or memory couldn't be allocated.
+ */
+fusion_map_t* load_fusion_map(nx_superblock_t* nxsb);
+
+void fusion_map_free(fusion_map_t* map);
+
+/**
+ * Find the first range in a map that ends after a given block.
+ *
+ * tier2_addr:  The address of the block on the second tier, without
+ *      `FUSION_TIER2_DEVICE_BLOCK_ADDR()`.
+ *
+ * RETURN VALUE:
+ *      The index of the range, which contains the block if its `tier2_addr` is
+ *      at most the block's address; or `map->num_ranges` if there's none.
+ */
+uint64_t find_fusion_range(fusion_map_t* map, paddr_t tier2_addr);
+
+/**
+ * Open the second tier of the current container, for reading alongside its
+ * main device; see `open_fusion_container()` in `apfs/func/container.h`.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value on failure.
+ */
+int open_fusion_tier2(char* tier2_path);
+
+/**
+ * Read blocks whose address refers to the second tier, from their cached copies
+ * on the main device where the middle tree has them, and otherwise from the
+ * second tier. This is how `read_blocks()` reads second-tier addresses, and it
+ * behaves like `read_blocks()`.
+ */
+size_t read_tier2_blocks(void* buffer, paddr_t start_block, size_t num_blocks);
+
+#endif // APFS_FUNC_FUSION_H
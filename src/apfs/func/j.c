@@ -0,0 +1,214 @@
+#include "j.h"
+
+j_rec_t* get_inode_record(j_rec_t** records) {
+    for (j_rec_t** cursor = records; cursor && *cursor; cursor++) {
+        j_key_t* hdr = (*cursor)->data;
+        if ( ((hdr->obj_id_and_type & OBJ_TYPE_MASK) >> OBJ_TYPE_SHIFT)  ==  APFS_TYPE_INODE ) {
+            return *cursor;
+        }
+    }
+    return NULL;
+}
+
+void* get_inode_xfield(j_rec_t* inode_rec, uint8_t x_type) {
+    if (inode_rec->val_len < sizeof(j_inode_val_t) + sizeof(xf_blob_t)) {
+        return NULL;
+    }
+
+    j_inode_val_t* val = inode_rec->data + inode_rec->key_len;
+    xf_blob_t* blob = val->xfields;
+    uint16_t blob_len = inode_rec->val_len - sizeof(j_inode_val_t) - sizeof(xf_blob_t);
+
+    // The array of `x_field_t` is followed by the data of each field, in the
+    // same order, with each field's data padded to a multiple of 8 bytes.
+    uint16_t data_offset = blob->xf_num_exts * sizeof(x_field_t);
+    for (uint16_t i = 0; i < blob->xf_num_exts; i++) {
+        x_field_t* field = blob->xf_data + i * sizeof(x_field_t);
+        if (data_offset + field->x_size > blob_len) {
+            return NULL;
+        }
+        if (field->x_type == x_type) {
+            return blob->xf_data + data_offset;
+        }
+        data_offset += (field->x_size + 7) & ~7;
+    }
+    return NULL;
+}
+
+j_dstream_t* get_inode_dstream(j_rec_t* inode_rec) {
+    return get_inode_xfield(inode_rec, INO_EXT_TYPE_DSTREAM);
+}
+
+j_rec_t** get_fs_records_for_path(btree_node_phys_t* fs_omap_btree, btree_node_phys_t* fs_root_btree, char* path, oid_t* file_id) {
+    oid_t fs_oid = ROOT_DIR_INO_NUM;
+    j_rec_t** fs_records = get_fs_records(fs_omap_btree, fs_root_btree, fs_oid, (xid_t)(~0) );
+
+    const char* element = path;
+    while (fs_records && *element) {
+        size_t element_len = strcspn(element, "/");
+        if (element_len == 0) {
+            element++;
+            continue;
+        }
+
+        j_rec_t* match = NULL;
+        for (j_rec_t** fs_rec_cursor = fs_records; *fs_rec_cursor; fs_rec_cursor++) {
+            j_rec_t* fs_rec = *fs_rec_cursor;
+            j_key_t* hdr = fs_rec->data;
+            if ( ((hdr->obj_id_and_type & OBJ_TYPE_MASK) >> OBJ_TYPE_SHIFT)  ==  APFS_TYPE_DIR_REC ) {
+                j_drec_hashed_key_t* key = fs_rec->data;
+                if (strncmp((char*)key->name, element, element_len) == 0 && key->name[element_len] == '\0') {
+                    match = fs_rec;
+                    break;
+                }
+            }
+        }
+
+        if (!match) {
+            free_j_rec_array(fs_records);
+            return NULL;
+        }
+
+        fs_oid = ((j_drec_val_t*)(match->data + match->key_len))->file_id;
+        free_j_rec_array(fs_records);
+        fs_records = get_fs_records(fs_omap_btree, fs_root_btree, fs_oid, (xid_t)(~0) );
+        element += element_len;
+    }
+
+    if (fs_records && file_id) {
+        *file_id = fs_oid;
+    }
+    return fs_records;
+}
+
+char* get_fs_object_path(btree_node_phys_t* fs_omap_btree, btree_node_phys_t* fs_root_btree, oid_t oid, xid_t max_xid) {
+    if (oid == ROOT_DIR_INO_NUM) {
+        return strdup("/");
+    }
+    return get_fs_object_relative_path(fs_omap_btree, fs_root_btree, oid, ROOT_DIR_INO_NUM, max_xid);
+}
+
+char* get_fs_object_relative_path(btree_node_phys_t* fs_omap_btree, btree_node_phys_t* fs_root_btree, oid_t oid, oid_t base_oid, xid_t max_xid) {
+    char* path = strdup("");
+    if (!path) {
+        return NULL;
+    }
+
+    // Prepend the name of each object in turn, up to the base directory. The
+    // number of steps is bounded, in case the parent IDs form a cycle.
+    for (int depth = 0; oid != base_oid; depth++) {
+        if (depth >= J_MAX_PATH_DEPTH || oid == ROOT_DIR_INO_NUM) {
+            goto onError;
+        }
+        j_rec_t** fs_records = get_fs_records(fs_omap_btree, fs_root_btree, oid, max_xid);
+        j_rec_t* inode_rec = get_inode_record(fs_records);
+        char* name = inode_rec ? get_inode_xfield(inode_rec, INO_EXT_TYPE_NAME) : NULL;
+        if (!name) {
+            free_j_rec_array(fs_records);
+            goto onError;
+        }
+
+        char* new_path = malloc(strlen(name) + strlen(path) + 2);
+        if (!new_path) {
+            free_j_rec_array(fs_records);
+            goto onError;
+        }
+        sprintf(new_path, "/%s%s", name, path);
+        free(path);
+        path = new_path;
+
+        oid = ((j_inode_val_t*)(inode_rec->data + inode_rec->key_len))->parent_id;
+        free_j_rec_array(fs_records);
+    }
+    return path;
+
+onError:
+    free(path);
+    return NULL;
+}
+
+/**
+ * Compare the names in two keys, such as those of extended attributes, as
+ * NULL-terminated strings; a name is cut short at the end of its key if it
+ * isn't terminated before then.
+ *
+ * max_len1, max_len2:  The number of bytes from the start of each name to the
+ *      end of its key.
+ */
+int compare_j_key_names(const uint8_t* name1, size_t max_len1, const uint8_t* name2, size_t max_len2) {
+    size_t len1 = strnlen((const char*)name1, max_len1);
+    size_t len2 = strnlen((const char*)name2, max_len2);
+    int result = memcmp(name1, name2, len1 < len2 ? len1 : len2);
+    if (result != 0) {
+        return result;
+    }
+    return (len1 > len2) - (len1 < len2);
+}
+
+int compare_j_keys(j_key_t* key1, uint16_t key1_len, j_key_t* key2, uint16_t key2_len) {
+    oid_t oid1 = key1->obj_id_and_type & OBJ_ID_MASK;
+    oid_t oid2 = key2->obj_id_and_type & OBJ_ID_MASK;
+    if (oid1 != oid2) {
+        return oid1 < oid2 ? -1 : 1;
+    }
+
+    uint64_t type1 = (key1->obj_id_and_type & OBJ_TYPE_MASK) >> OBJ_TYPE_SHIFT;
+    uint64_t type2 = (key2->obj_id_and_type & OBJ_TYPE_MASK) >> OBJ_TYPE_SHIFT;
+    if (type1 != type2) {
+        return type1 < type2 ? -1 : 1;
+    }
+
+    if (type1 == APFS_TYPE_FILE_EXTENT
+        && key1_len >= sizeof(j_file_extent_key_t) && key2_len >= sizeof(j_file_extent_key_t)
+    ) {
+        uint64_t addr1 = ((j_file_extent_key_t*)key1)->logical_addr;
+        uint64_t addr2 = ((j_file_extent_key_t*)key2)->logical_addr;
+        if (addr1 != addr2) {
+            return addr1 < addr2 ? -1 : 1;
+        }
+        return 0;
+    }
+
+    if (type1 == APFS_TYPE_XATTR
+        && key1_len >= sizeof(j_xattr_key_t) && key2_len >= sizeof(j_xattr_key_t)
+    ) {
+        return compare_j_key_names(
+            ((j_xattr_key_t*)key1)->name, key1_len - sizeof(j_xattr_key_t),
+            ((j_xattr_key_t*)key2)->name, key2_len - sizeof(j_xattr_key_t)
+        );
+    }
+
+    if (type1 == APFS_TYPE_SNAP_NAME
+        && key1_len >= sizeof(j_snap_name_key_t) && key2_len >= sizeof(j_snap_name_key_t)
+    ) {
+        return compare_j_key_names(
+            ((j_snap_name_key_t*)key1)->name, key1_len - sizeof(j_snap_name_key_t),
+            ((j_snap_name_key_t*)key2)->name, key2_len - sizeof(j_snap_name_key_t)
+        );
+    }
+
+    if (type1 == APFS_TYPE_DIR_REC
+        && key1_len >= sizeof(j_drec_hashed_key_t) && key2_len >= sizeof(j_drec_hashed_key_t)
+    ) {
+        uint32_t hash1 = (((j_drec_hashed_key_t*)key1)->name_len_and_hash & J_DREC_HASH_MASK) >> J_DREC_HASH_SHIFT;
+        uint32_t hash2 = (((j_drec_hashed_key_t*)key2)->name_len_and_hash & J_DREC_HASH_MASK) >> J_DREC_HASH_SHIFT;
+        if (hash1 != hash2) {
+            return hash1 < hash2 ? -1 : 1;
+        }
+        return compare_j_key_names(
+            ((j_drec_hashed_key_t*)key1)->name, key1_len - sizeof(j_drec_hashed_key_t),
+            ((j_drec_hashed_key_t*)key2)->name, key2_len - sizeof(j_drec_hashed_key_t)
+        );
+    }
+
+    // Keys of other types have no type-specific part that we know of, so as a
+    // last resort, compare the rest of them bytewise; a key that is a prefix of
+    // the other sorts first.
+    uint16_t len1 = key1_len - sizeof(j_key_t);
+    uint16_t len2 = key2_len - sizeof(j_key_t);
+    int result = memcmp(key1 + 1, key2 + 1, len1 < len2 ? len1 : len2);
+    if (result != 0) {
+        return result;
+    }
+    return (len1 > len2) - (len1 < len2);
+}
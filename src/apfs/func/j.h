@@ -0,0 +1,118 @@
+/**
+ * Functions used to interpret file-system records, such as those returned by
+ * `get_fs_records()`.
+ */
+
+#ifndef APFS_FUNC_J_H
+#define APFS_FUNC_J_H
+
+#include <string.h>
+
+#include "../struct/j.h"
+#include "../struct/dstream.h"
+#include "../struct/xf.h"
+#include "../struct/snap.h"
+
+#include "btree.h"
+
+/** Path constants **/
+
+#define J_MAX_PATH_DEPTH    4096    // Most ancestors followed by `get_fs_object_relative_path()`
+
+/**
+ * Find the inode record amongst a given array of file-system records.
+ *
+ * records:     A pointer to an array of file-system records pertaining to a
+ *      single file-system object, as returned by `get_fs_records()`.
+ *
+ * RETURN VALUE:
+ *      A pointer to the inode record within `records`, or NULL if there is no
+ *      such record.
+ */
+j_rec_t* get_inode_record(j_rec_t** records);
+
+/**
+ * Find an extended field of a given type within an inode record.
+ *
+ * inode_rec:   A pointer to an inode record.
+ *
+ * x_type:      The type of extended field to look for,
+ *      e.g. `INO_EXT_TYPE_DSTREAM`.
+ *
+ * RETURN VALUE:
+ *      A pointer to the extended field's data within `inode_rec`, or NULL if
+ *      the inode has no such extended field or its extended fields are
+ *      malformed.
+ */
+void* get_inode_xfield(j_rec_t* inode_rec, uint8_t x_type);
+
+/**
+ * Get the data stream of an inode, as described by its `INO_EXT_TYPE_DSTREAM`
+ * extended field.
+ *
+ * RETURN VALUE:
+ *      A pointer to the data stream info within `inode_rec`, or NULL if the
+ *      inode has no data stream (e.g. if it is a directory or an empty file).
+ */
+j_dstream_t* get_inode_dstream(j_rec_t* inode_rec);
+
+/**
+ * Get the file-system records of the object at a given path within a volume.
+ *
+ * path:        A `/`-separated path relative to the volume's root directory.
+ *      Empty path components are ignored, so "/", "" and "a//b/" are valid.
+ *
+ * file_id:     If not NULL, the ID of the object will be stored here.
+ *
+ * RETURN VALUE:
+ *      A pointer to an array of the object's file-system records, as returned
+ *      by `get_fs_records()`, which must be freed with `free_j_rec_array()`
+ *      when no longer needed; or NULL if no object exists at that path or an
+ *      error occurs.
+ */
+j_rec_t** get_fs_records_for_path(btree_node_phys_t* fs_omap_btree, btree_node_phys_t* fs_root_btree, char* path, oid_t* file_id);
+
+/**
+ * Determine the path of a file-system object within a volume, by following the
+ * parent IDs and names recorded in its inode and those of its ancestors. For a
+ * hard link, one of its paths is returned.
+ *
+ * max_xid:     The highest XID to resolve the tree's nodes as of; see
+ *      `get_fs_records()`.
+ *
+ * RETURN VALUE:
+ *      A pointer to a `/`-separated path relative to the volume's root
+ *      directory, e.g. "/Users/john", which must be freed when no longer
+ *      needed; or NULL if the object or one of its ancestors has no inode or
+ *      name, or an error occurs.
+ */
+char* get_fs_object_path(btree_node_phys_t* fs_omap_btree, btree_node_phys_t* fs_root_btree, oid_t oid, xid_t max_xid);
+
+/**
+ * As for `get_fs_object_path()`, but get the path relative to a given
+ * directory, e.g. "/john/notes.txt" for "/Users/john/notes.txt" relative to
+ * "/Users", or "" for the directory itself.
+ *
+ * base_oid:    The ID of the directory.
+ *
+ * RETURN VALUE:
+ *      As for `get_fs_object_path()`, and also NULL if the object isn't within
+ *      the directory.
+ */
+char* get_fs_object_relative_path(btree_node_phys_t* fs_omap_btree, btree_node_phys_t* fs_root_btree, oid_t oid, oid_t base_oid, xid_t max_xid);
+
+/**
+ * Compare the keys of two file-system records in the order in which they are
+ * sorted in a file-system root tree: by OID, then by record type, then by a
+ * type-specific part of the key: the logical address of a file extent; the
+ * name of an extended attribute or snapshot; or the hash and then the name of
+ * a directory entry. Names are compared as strings, not by their stored
+ * lengths. Keys of other types are compared bytewise.
+ *
+ * RETURN VALUE:
+ *      A negative value if `key1` sorts first, zero if the keys are equal, or a
+ *      positive value if `key2` sorts first.
+ */
+int compare_j_keys(j_key_t* key1, uint16_t key1_len, j_key_t* key2, uint16_t key2_len);
+
+#endif // APFS_FUNC_J_H
@@ -0,0 +1,527 @@
+#include <time.h>
+
+#include "keybag.h"
+
+/** Limits **/
+
+#define KEYBAG_MAX_BLOCKS   16
+#define PASSWORD_MAX_LEN    1024
+
+media_keybag_t* read_keybag(prange_t range, const uuid_t uuid, uint32_t type) {
+    if (range.pr_start_paddr <= 0 || range.pr_block_count == 0 || range.pr_block_count > KEYBAG_MAX_BLOCKS) {
+        return NULL;
+    }
+    size_t length = range.pr_block_count * nx_device->block_size;
+    media_keybag_t* keybag = malloc(length);
+    aes_xts_key_t* key = malloc(sizeof(aes_xts_key_t));
+    if (!keybag || !key) {
+        fprintf(stderr, "\nABORT: read_keybag: Could not allocate sufficient memory.\n");
+        goto onError;
+    }
+    if (read_blocks(keybag, range.pr_start_paddr, range.pr_block_count) != range.pr_block_count) {
+        goto onError;
+    }
+
+    uint8_t key_bytes[2 * sizeof(uuid_t)];
+    memcpy(key_bytes, uuid, sizeof(uuid_t));
+    memcpy(key_bytes + sizeof(uuid_t), uuid, sizeof(uuid_t));
+    aes_xts_init(key, key_bytes, sizeof(key_bytes));
+    aes_xts_decrypt(key, keybag, length, range.pr_start_paddr * (nx_device->block_size / AES_XTS_SECTOR_SIZE));
+    free(key);
+    key = NULL;
+
+    // The checksum covers the whole keybag, which `is_cksum_valid()` can only
+    // check if it's one block long, as it practically always is.
+    kb_locker_t* locker = &keybag->mk_locker;
+    if (
+            (range.pr_block_count == 1 && !is_cksum_valid((uint32_t*)keybag))
+            || keybag->mk_obj.o_type != type
+            || locker->kl_version != APFS_KEYBAG_VERSION
+            || locker->kl_nbytes > length - offsetof(media_keybag_t, mk_locker.kl_entries)
+    ) {
+        goto onError;
+    }
+    return keybag;
+
+onError:
+    free(key);
+    free(keybag);
+    return NULL;
+}
+
+keybag_entry_t* find_keybag_entry(media_keybag_t* keybag, const uuid_t uuid, uint16_t tag, keybag_entry_t* prev) {
+    kb_locker_t* locker = &keybag->mk_locker;
+    char* end = (char*)locker->kl_entries + locker->kl_nbytes;
+    char* cursor = (char*)locker->kl_entries;
+    bool past_prev = !prev;
+
+    for (uint16_t i = 0; i < locker->kl_nkeys; i++) {
+        keybag_entry_t* entry = (keybag_entry_t*)cursor;
+        if (
+                end - cursor < (ptrdiff_t)sizeof(keybag_entry_t)
+                || entry->ke_keylen > APFS_VOL_KEYBAG_ENTRY_MAX_SIZE
+                || end - cursor < (ptrdiff_t)(sizeof(keybag_entry_t) + entry->ke_keylen)
+        ) {
+            return NULL;
+        }
+        if (past_prev && entry->ke_tag == tag && (!uuid || memcmp(entry->ke_uuid, uuid, sizeof(uuid_t)) == 0)) {
+            return entry;
+        }
+        if (entry == prev) {
+            past_prev = true;
+        }
+        size_t entry_size = sizeof(keybag_entry_t) + entry->ke_keylen;
+        cursor += (entry_size + KEYBAG_ENTRY_ALIGNMENT - 1) / KEYBAG_ENTRY_ALIGNMENT * KEYBAG_ENTRY_ALIGNMENT;
+    }
+    return NULL;
+}
+
+/**
+ * Read the DER element at `*pos`, and advance `*pos` past it.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value if the element doesn't lie
+ *      entirely before `end`.
+ */
+int der_read(const uint8_t** pos, const uint8_t* end, uint8_t* tag, const uint8_t** value, size_t* value_len) {
+    const uint8_t* p = *pos;
+    if (end - p < 2) {
+        return -1;
+    }
+    *tag = *p++;
+
+    // The length is either a single byte, or the number of bytes in which it
+    // follows, big-endian, with the top bit set.
+    size_t length = *p++;
+    if (length & 0x80) {
+        size_t num_bytes = length & 0x7f;
+        if (num_bytes == 0 || num_bytes > 4 || end - p < (ptrdiff_t)num_bytes) {
+            return -1;
+        }
+        length = 0;
+        for (size_t i = 0; i < num_bytes; i++) {
+            length = (length << 8) | *p++;
+        }
+    }
+    if ((size_t)(end - p) < length) {
+        return -1;
+    }
+    *value = p;
+    *value_len = length;
+    *pos = p + length;
+    return 0;
+}
+
+/**
+ * Find the DER element with a given tag among those in a range.
+ *
+ * RETURN VALUE:
+ *      Zero if the element was found, or a negative value otherwise.
+ */
+int der_find(const uint8_t* data, size_t length, uint8_t tag, const uint8_t** value, size_t* value_len) {
+    const uint8_t* end = data + length;
+    while (data < end) {
+        uint8_t element_tag;
+        if (der_read(&data, end, &element_tag, value, value_len) != 0) {
+            return -1;
+        }
+        if (element_tag == tag) {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int parse_key_blob(const uint8_t* data, size_t length, key_blob_t* blob) {
+    memset(blob, 0, sizeof(key_blob_t));
+
+    // SEQUENCE { [0] version, [1] HMAC, [2] salt, [3] { [0] version,
+    // [1] UUID, [2] flags, [3] wrapped key, [4] iterations, [5] salt } }
+    const uint8_t* sequence;
+    const uint8_t* blob_data;
+    const uint8_t* value;
+    size_t sequence_len, blob_len, value_len;
+    if (
+            der_find(data, length, 0x30, &sequence, &sequence_len) != 0
+            || der_find(sequence, sequence_len, 0xa3, &blob_data, &blob_len) != 0
+    ) {
+        return -1;
+    }
+
+    if (der_find(blob_data, blob_len, 0x81, &value, &value_len) != 0 || value_len != sizeof(uuid_t)) {
+        return -1;
+    }
+    memcpy(blob->uuid, value, sizeof(uuid_t));
+    if (der_find(blob_data, blob_len, 0x82, &value, &value_len) != 0 || value_len > sizeof(blob->flags)) {
+        return -1;
+    }
+    memcpy(blob->flags, value, value_len);
+    if (der_find(blob_data, blob_len, 0x83, &value, &value_len) != 0 || value_len != KEY_BLOB_WRAPPED_KEY_SIZE) {
+        return -1;
+    }
+    memcpy(blob->wrapped_key, value, KEY_BLOB_WRAPPED_KEY_SIZE);
+
+    // Only a KEK's blob has the PBKDF2 parameters.
+    if (der_find(blob_data, blob_len, 0x84, &value, &value_len) == 0) {
+        if (value_len > sizeof(uint64_t)) {
+            return -1;
+        }
+        for (size_t i = 0; i < value_len; i++) {
+            blob->iterations = (blob->iterations << 8) | value[i];
+        }
+        if (der_find(blob_data, blob_len, 0x85, &value, &value_len) != 0 || value_len > KEY_BLOB_MAX_SALT_SIZE) {
+            return -1;
+        }
+        memcpy(blob->salt, value, value_len);
+        blob->salt_len = value_len;
+    }
+    return 0;
+}
+
+bool aes_key_unwrap(const uint8_t* kek, size_t kek_len, const uint8_t* wrapped, size_t wrapped_len, uint8_t* key) {
+    if ((kek_len != 16 && kek_len != 32) || wrapped_len % 8 != 0 || wrapped_len < 24) {
+        return false;
+    }
+    aes_xts_key_t* aes_key = malloc(sizeof(aes_xts_key_t));
+    if (!aes_key) {
+        fprintf(stderr, "\nABORT: aes_key_unwrap: Could not allocate sufficient memory for `aes_key`.\n");
+        return false;
+    }
+    // Only the first half of an AES-XTS key is used to decrypt blocks.
+    uint8_t key_bytes[64];
+    memcpy(key_bytes, kek, kek_len);
+    memcpy(key_bytes + kek_len, kek, kek_len);
+    aes_xts_init(aes_key, key_bytes, 2 * kek_len);
+    memset(key_bytes, 0, sizeof(key_bytes));
+
+    size_t n = wrapped_len / 8 - 1;
+    uint8_t block[AES_BLOCK_SIZE];
+    memcpy(block, wrapped, 8);
+    memcpy(key, wrapped + 8, 8 * n);
+    for (int j = 5; j >= 0; j--) {
+        for (size_t i = n; i >= 1; i--) {
+            // A ^= t, big-endian; then (A, R[i]) = AES-1(A || R[i])
+            uint64_t t = n * j + i;
+            for (int b = 0; b < 8; b++) {
+                block[7 - b] ^= t >> (8 * b);
+            }
+            memcpy(block + 8, key + 8 * (i - 1), 8);
+            aes_decrypt_block_scalar(aes_key, block);
+            memcpy(key + 8 * (i - 1), block + 8, 8);
+        }
+    }
+
+    bool valid = true;
+    for (int b = 0; b < 8; b++) {
+        valid &= block[b] == (uint8_t)(KEY_WRAP_IV >> (8 * b));
+    }
+    memset(block, 0, sizeof(block));
+    memset(aes_key, 0, sizeof(aes_xts_key_t));
+    free(aes_key);
+    if (!valid) {
+        memset(key, 0, 8 * n);
+    }
+    return valid;
+}
+
+/**
+ * Read the container keybag, and the blob of a volume's wrapped VEK in it.
+ *
+ * vek_entry:   A pointer to the VEK's entry, within the keybag, will be stored
+ *      here.
+ *
+ * RETURN VALUE:
+ *      A pointer to the container keybag, which must be freed when no longer
+ *      needed; or NULL if it or the VEK's entry can't be read.
+ */
+media_keybag_t* read_container_keybag(container_t* container, apfs_superblock_t* apsb, keybag_entry_t** vek_entry) {
+    nx_superblock_t* nxsb = container->nxsb;
+    media_keybag_t* keybag = read_keybag(nxsb->nx_keylocker, nxsb->nx_uuid, OBJECT_TYPE_CONTAINER_KEYBAG);
+    if (!keybag) {
+        fprintf(stderr, "The container keybag can't be read.\n");
+        return NULL;
+    }
+    *vek_entry = find_keybag_entry(keybag, apsb->apfs_vol_uuid, KB_TAG_VOLUME_KEY, NULL);
+    if (!*vek_entry) {
+        fprintf(stderr, "The container keybag has no key for the volume `%s`.\n", apsb->apfs_volname);
+        free(keybag);
+        return NULL;
+    }
+    return keybag;
+}
+
+/**
+ * Read a volume's keybag, whose location is given in the container keybag.
+ *
+ * RETURN VALUE:
+ *      A pointer to the volume keybag, which must be freed when no longer
+ *      needed; or NULL if it can't be read.
+ */
+media_keybag_t* read_volume_keybag(media_keybag_t* container_keybag, apfs_superblock_t* apsb) {
+    keybag_entry_t* entry = find_keybag_entry(container_keybag, apsb->apfs_vol_uuid, KB_TAG_VOLUME_UNLOCK_RECORDS, NULL);
+    if (!entry || entry->ke_keylen < sizeof(prange_t)) {
+        fprintf(stderr, "The container keybag doesn't locate the keybag of the volume `%s`.\n", apsb->apfs_volname);
+        return NULL;
+    }
+    prange_t range;
+    memcpy(&range, entry->ke_keydata, sizeof(prange_t));
+    media_keybag_t* keybag = read_keybag(range, apsb->apfs_vol_uuid, OBJECT_TYPE_VOLUME_KEYBAG);
+    if (!keybag) {
+        fprintf(stderr, "The keybag of the volume `%s` can't be read.\n", apsb->apfs_volname);
+    }
+    return keybag;
+}
+
+size_t unwrap_volume_key(container_t* container, uint32_t volume_id, const char* password, uint8_t* vek) {
+    apfs_superblock_t* apsb = get_volume_superblock(container, volume_id);
+    media_keybag_t* volume_keybag = NULL;
+    keybag_entry_t* vek_entry = NULL;
+    key_blob_t vek_blob, kek_blob;
+    size_t vek_len = 0;
+
+    media_keybag_t* container_keybag = read_container_keybag(container, apsb, &vek_entry);
+    if (!container_keybag) {
+        return 0;
+    }
+    if (parse_key_blob(vek_entry->ke_keydata, vek_entry->ke_keylen, &vek_blob) != 0) {
+        fprintf(stderr, "The wrapped key of the volume `%s` is malformed.\n", apsb->apfs_volname);
+        goto cleanup;
+    }
+    volume_keybag = read_volume_keybag(container_keybag, apsb);
+    if (!volume_keybag) {
+        goto cleanup;
+    }
+
+    // Each user's KEK is wrapped with a key derived from their password; the
+    // password can only be checked by trying to unwrap each in turn.
+    for (
+            keybag_entry_t* entry = NULL;
+            !vek_len && (entry = find_keybag_entry(volume_keybag, NULL, KB_TAG_VOLUME_UNLOCK_RECORDS, entry));
+    ) {
+        if (parse_key_blob(entry->ke_keydata, entry->ke_keylen, &kek_blob) != 0 || kek_blob.iterations == 0) {
+            continue;
+        }
+        uint8_t derived[32], kek[32];
+        pbkdf2_hmac_sha256(password, strlen(password), kek_blob.salt, kek_blob.salt_len, kek_blob.iterations, derived, sizeof(derived));
+        size_t kek_len = (kek_blob.flags[0] & KEY_BLOB_FLAG_AES_128) ? 16 : 32;
+        size_t wrapped_vek_len = (vek_blob.flags[0] & KEY_BLOB_FLAG_AES_128) ? 16 + 8 : 32 + 8;
+        if (
+                aes_key_unwrap(derived, kek_len, kek_blob.wrapped_key, kek_len + 8, kek)
+                && aes_key_unwrap(kek, kek_len, vek_blob.wrapped_key, wrapped_vek_len, vek)
+        ) {
+            // A 128-bit VEK is only half an AES-XTS key; the tweak key is
+            // derived from it and the volume's UUID.
+            if (wrapped_vek_len == 16 + 8) {
+                uint8_t digest[SHA256_DIGEST_SIZE];
+                sha256_ctx_t ctx;
+                sha256_init(&ctx);
+                sha256_update(&ctx, vek, 16);
+                sha256_update(&ctx, apsb->apfs_vol_uuid, sizeof(uuid_t));
+                sha256_final(&ctx, digest);
+                memcpy(vek + 16, digest, 16);
+                memset(digest, 0, sizeof(digest));
+            }
+            vek_len = 32;
+        }
+        memset(derived, 0, sizeof(derived));
+        memset(kek, 0, sizeof(kek));
+    }
+
+cleanup:
+    memset(&kek_blob, 0, sizeof(kek_blob));
+    free(volume_keybag);
+    free(container_keybag);
+    return vek_len;
+}
+
+char* get_key_cache_path(const uuid_t vol_uuid) {
+    if (getenv("APFS_NO_CACHE")) {
+        return NULL;
+    }
+
+    char* dir = NULL;
+    char* runtime_dir = getenv("XDG_RUNTIME_DIR");
+    if (runtime_dir && *runtime_dir) {
+        dir = malloc(strlen(runtime_dir) + 16);
+        if (dir) {
+            sprintf(dir, "%s/apfs-tools", runtime_dir);
+            mkdir(dir, 0700);
+        }
+    } else {
+        dir = get_cache_dir();
+    }
+    if (!dir) {
+        return NULL;
+    }
+
+    char* path = malloc(strlen(dir) + 64);
+    if (path) {
+        char* end = path + sprintf(path, "%s/vek-", dir);
+        for (size_t i = 0; i < sizeof(uuid_t); i++) {
+            end += sprintf(end, "%02x", vol_uuid[i]);
+        }
+        strcpy(end, ".key");
+    }
+    free(dir);
+    return path;
+}
+
+size_t load_cached_volume_key(const char* cache_path, const uuid_t vol_uuid, const uint8_t* vek_blob_digest, uint8_t* vek) {
+    int fd = open(cache_path, O_RDONLY | O_NOFOLLOW);
+    if (fd < 0) {
+        return 0;
+    }
+
+    size_t key_len = 0;
+    key_cache_t cache;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_uid != getuid() || (st.st_mode & 077)) {
+        fprintf(stderr, "Ignoring the key cache file `%s`, which others could access.\n", cache_path);
+    } else if (
+            read(fd, &cache, sizeof(key_cache_t)) == sizeof(key_cache_t)
+            && cache.magic == KEY_CACHE_MAGIC
+            && cache.version == KEY_CACHE_VERSION
+            && memcmp(cache.vol_uuid, vol_uuid, sizeof(uuid_t)) == 0
+            && memcmp(cache.vek_blob_digest, vek_blob_digest, SHA256_DIGEST_SIZE) == 0
+            && (cache.key_len == 32 || cache.key_len == 64)
+    ) {
+        key_len = cache.key_len;
+        memcpy(vek, cache.key, key_len);
+    }
+    close(fd);
+    memset(&cache, 0, sizeof(cache));
+    return key_len;
+}
+
+void save_cached_volume_key(const char* cache_path, const uuid_t vol_uuid, const uint8_t* vek_blob_digest, const uint8_t* vek, size_t vek_len) {
+    char* tmp_path = malloc(strlen(cache_path) + 32);
+    if (!tmp_path) {
+        return;
+    }
+
+    key_cache_t cache = {0};
+    cache.magic     = KEY_CACHE_MAGIC;
+    cache.version   = KEY_CACHE_VERSION;
+    cache.key_len   = vek_len;
+    memcpy(cache.vol_uuid, vol_uuid, sizeof(uuid_t));
+    memcpy(cache.vek_blob_digest, vek_blob_digest, SHA256_DIGEST_SIZE);
+    memcpy(cache.key, vek, vek_len);
+
+    // The file is created with restricted permissions from the start, so the
+    // key is never readable by anyone else, even briefly.
+    sprintf(tmp_path, "%s.%ld", cache_path, (long)getpid());
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_EXCL, 0600);
+    if (fd >= 0) {
+        bool ok = write(fd, &cache, sizeof(key_cache_t)) == sizeof(key_cache_t);
+        ok = (close(fd) == 0) && ok;
+        if (!ok || rename(tmp_path, cache_path) != 0) {
+            unlink(tmp_path);
+        }
+    }
+    memset(&cache, 0, sizeof(cache));
+    free(tmp_path);
+}
+
+char* read_password(const char* prompt) {
+    char* password = malloc(PASSWORD_MAX_LEN);
+    if (!password) {
+        fprintf(stderr, "\nABORT: read_password: Could not allocate sufficient memory for `password`.\n");
+        return NULL;
+    }
+    if (isatty(STDIN_FILENO)) {
+        char* entered = getpass(prompt);
+        if (!entered) {
+            free(password);
+            return NULL;
+        }
+        strncpy(password, entered, PASSWORD_MAX_LEN - 1);
+        password[PASSWORD_MAX_LEN - 1] = '\0';
+        memset(entered, 0, strlen(entered));
+        return password;
+    }
+    if (!fgets(password, PASSWORD_MAX_LEN, stdin)) {
+        free(password);
+        return NULL;
+    }
+    password[strcspn(password, "\r\n")] = '\0';
+    return password;
+}
+
+/**
+ * Print a volume's password hint, if its keybag has one.
+ */
+void print_password_hint(media_keybag_t* container_keybag, apfs_superblock_t* apsb) {
+    media_keybag_t* volume_keybag = read_volume_keybag(container_keybag, apsb);
+    if (!volume_keybag) {
+        return;
+    }
+    keybag_entry_t* entry = find_keybag_entry(volume_keybag, NULL, KB_TAG_VOLUME_PASSPHRASE_HINT, NULL);
+    if (entry) {
+        fprintf(stderr, "Password hint: %.*s\n", (int)entry->ke_keylen, (char*)entry->ke_keydata);
+    }
+    free(volume_keybag);
+}
+
+int unlock_volume(container_t* container, uint32_t volume_id) {
+    apfs_superblock_t* apsb = get_volume_superblock(container, volume_id);
+    if (!is_volume_encrypted(apsb)) {
+        fprintf(stderr, "The volume `%s` isn't encrypted; no password is needed.\n", apsb->apfs_volname);
+        return 0;
+    }
+
+    keybag_entry_t* vek_entry = NULL;
+    media_keybag_t* container_keybag = read_container_keybag(container, apsb, &vek_entry);
+    if (!container_keybag) {
+        return -1;
+    }
+    uint8_t vek_blob_digest[SHA256_DIGEST_SIZE];
+    sha256(vek_entry->ke_keydata, vek_entry->ke_keylen, vek_blob_digest);
+
+    int result = -1;
+    uint8_t vek[VOLUME_KEY_MAX_SIZE];
+    char* password = NULL;
+    char* cache_path = get_key_cache_path(apsb->apfs_vol_uuid);
+    size_t vek_len = cache_path ? load_cached_volume_key(cache_path, apsb->apfs_vol_uuid, vek_blob_digest, vek) : 0;
+    if (vek_len) {
+        fprintf(stderr, "Using the cached key of the volume `%s`.\n", apsb->apfs_volname);
+    } else {
+        print_password_hint(container_keybag, apsb);
+        char prompt[APFS_VOLNAME_LEN + 32];
+        snprintf(prompt, sizeof(prompt), "Password for `%s`: ", apsb->apfs_volname);
+        password = read_password(prompt);
+        if (!password) {
+            fprintf(stderr, "No password was given.\n");
+            goto cleanup;
+        }
+
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        vek_len = unwrap_volume_key(container, volume_id, password, vek);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        if (!vek_len) {
+            fprintf(stderr, "The password doesn't unlock the volume `%s`.\n", apsb->apfs_volname);
+            goto cleanup;
+        }
+        fprintf(stderr, "Unlocked the volume `%s` in %.2f seconds.\n", apsb->apfs_volname, (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+        if (cache_path) {
+            save_cached_volume_key(cache_path, apsb->apfs_vol_uuid, vek_blob_digest, vek, vek_len);
+        }
+    }
+
+    if (set_volume_key(vek, vek_len) == 0) {
+        const char* name = NULL;
+        get_aes_xts_decrypt_func(&name);
+        fprintf(stderr, "Decrypting the volume `%s` with AES-%zu-XTS (%s).\n", apsb->apfs_volname, vek_len * 4, name);
+        result = 0;
+    }
+
+cleanup:
+    memset(vek, 0, sizeof(vek));
+    if (password) {
+        memset(password, 0, PASSWORD_MAX_LEN);
+        free(password);
+    }
+    free(cache_path);
+    free(container_keybag);
+    return result;
+}
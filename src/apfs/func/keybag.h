@@ -0,0 +1,222 @@
+/**
+ * Functions used to unlock an encrypted volume with a password (or the
+ * personal recovery key), i.e. to recover its volume encryption key (VEK).
+ *
+ * The container keybag, at `nx_keylocker`, is encrypted with AES-XTS under a
+ * key made of the container's UUID twice. For each encrypted volume, it holds
+ * the volume's VEK, wrapped with a key encryption key (KEK), and the location
+ * of the volume keybag. The volume keybag is encrypted likewise under the
+ * volume's UUID, and holds the KEK once per user, each copy wrapped with a key
+ * derived from that user's password with PBKDF2. The keys are wrapped with
+ * AES key wrap (RFC 3394), and the blobs holding them are DER-encoded.
+ *
+ * PBKDF2 is deliberately slow, typically taking a second or more, so the VEK
+ * is cached once unwrapped; see `get_key_cache_path()`. A cached VEK is used
+ * only while the wrapped VEK in the container keybag is unchanged.
+ */
+
+#ifndef APFS_FUNC_KEYBAG_H
+#define APFS_FUNC_KEYBAG_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "../io.h"
+#include "../struct/general.h"
+#include "../struct/object.h"
+#include "../struct/nx.h"
+#include "../struct/fs.h"
+#include "../struct/crypto.h"
+
+#include "aes_xts.h"
+#include "cksum.h"
+#include "container.h"
+#include "crypto.h"
+#include "sha256.h"
+
+/** Keybag constants **/
+
+#define KEYBAG_ENTRY_ALIGNMENT      16
+#define KEY_WRAP_IV                 0xa6a6a6a6a6a6a6a6ULL   // RFC 3394 §2.2.3.1
+#define KEY_BLOB_WRAPPED_KEY_SIZE   0x28    // = a 256-bit key, wrapped
+#define KEY_BLOB_MAX_SALT_SIZE      32
+#define KEY_BLOB_FLAG_AES_128       0x02    // In the first byte of `flags`
+
+/** Key cache constants **/
+
+#define KEY_CACHE_MAGIC             0x4b465041  // = 'APFK' when read as bytes
+#define KEY_CACHE_VERSION           1
+
+/**
+ * The contents of a DER-encoded key blob from a keybag, as far as they're
+ * needed to unwrap the key in it.
+ *
+ * uuid:            The UUID of the volume (for a VEK) or user (for a KEK).
+ *
+ * flags:           Flags; if `KEY_BLOB_FLAG_AES_128` is set in the first byte,
+ *      the wrapped key is a 128-bit key, as on volumes converted from Core
+ *      Storage, and otherwise a 256-bit key.
+ *
+ * wrapped_key:     The wrapped key.
+ *
+ * iterations:      For a KEK, the number of PBKDF2 iterations used to derive
+ *      the key that it's wrapped with; zero for a VEK.
+ *
+ * salt:            For a KEK, the PBKDF2 salt, which is `salt_len` bytes long.
+ */
+typedef struct {
+    uuid_t      uuid;
+    uint8_t     flags[8];
+    uint8_t     wrapped_key[KEY_BLOB_WRAPPED_KEY_SIZE];
+    uint64_t    iterations;
+    uint8_t     salt[KEY_BLOB_MAX_SALT_SIZE];
+    size_t      salt_len;
+} key_blob_t;
+
+/**
+ * A key cache file. Key cache files are only ever read on the machine that
+ * wrote them, so they use native byte order.
+ *
+ * vol_uuid:        The UUID of the volume whose key this is.
+ *
+ * vek_blob_digest: The SHA-256 digest of the wrapped VEK in the container
+ *      keybag that this key was unwrapped from.
+ *
+ * key_len:         The length of the key, in bytes.
+ */
+typedef struct {
+    uint32_t    magic;
+    uint32_t    version;
+    uuid_t      vol_uuid;
+    uint8_t     vek_blob_digest[SHA256_DIGEST_SIZE];
+    uint32_t    key_len;
+    uint32_t    reserved;
+    uint8_t     key[VOLUME_KEY_MAX_SIZE];
+} key_cache_t;
+
+/**
+ * Read a keybag, decrypt it, and check that it's an object of the given type.
+ *
+ * uuid:        The UUID that the keybag's key consists of; the container's
+ *      UUID for the container keybag, or the volume's for a volume keybag.
+ *
+ * type:        `OBJECT_TYPE_CONTAINER_KEYBAG` or `OBJECT_TYPE_VOLUME_KEYBAG`.
+ *
+ * RETURN VALUE:
+ *      A pointer to the keybag, which must be freed when no longer needed; or
+ *      NULL if it can't be read or is malformed.
+ */
+media_keybag_t* read_keybag(prange_t range, const uuid_t uuid, uint32_t type);
+
+/**
+ * Find the next entry in a keybag with a given UUID and tag.
+ *
+ * uuid:        The UUID to look for, or NULL to match any UUID.
+ *
+ * prev:        The entry to search after, or NULL to search from the first.
+ *
+ * RETURN VALUE:
+ *      A pointer to the entry, within the keybag; or NULL if there are no more
+ *      such entries, or the remaining entries are malformed.
+ */
+keybag_entry_t* find_keybag_entry(media_keybag_t* keybag, const uuid_t uuid, uint16_t tag, keybag_entry_t* prev);
+
+/**
+ * Parse a DER-encoded key blob, as stored in a keybag entry with the tag
+ * `KB_TAG_VOLUME_KEY` (a wrapped VEK) or `KB_TAG_VOLUME_UNLOCK_RECORDS` in a
+ * volume keybag (a wrapped KEK).
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value if the blob is malformed.
+ */
+int parse_key_blob(const uint8_t* data, size_t length, key_blob_t* blob);
+
+/**
+ * Unwrap a key with AES key wrap (RFC 3394).
+ *
+ * kek:         The key it's wrapped with; 16 or 32 bytes.
+ *
+ * key:         The unwrapped key will be stored here; `wrapped_len - 8` bytes.
+ *
+ * RETURN VALUE:
+ *      True if the key was unwrapped, or false if its integrity check fails,
+ *      e.g. because the KEK is wrong.
+ */
+bool aes_key_unwrap(const uint8_t* kek, size_t kek_len, const uint8_t* wrapped, size_t wrapped_len, uint8_t* key);
+
+/**
+ * Unwrap a volume's VEK with a password, trying the password against each
+ * user's KEK in the volume keybag.
+ *
+ * vek:         The VEK will be stored here; at least `VOLUME_KEY_MAX_SIZE`
+ *      bytes.
+ *
+ * RETURN VALUE:
+ *      The length of the VEK in bytes, or zero if it can't be unwrapped.
+ */
+size_t unwrap_volume_key(container_t* container, uint32_t volume_id, const char* password, uint8_t* vek);
+
+/**
+ * Determine the path of the key cache file for a given volume.
+ *
+ * Key cache files are stored in `$XDG_RUNTIME_DIR/apfs-tools` if the
+ * environment variable `XDG_RUNTIME_DIR` is set, since that directory only
+ * lasts for the user's session; otherwise, in the directory given by
+ * `get_cache_dir()`. Setting `APFS_NO_CACHE` disables the key cache too.
+ *
+ * RETURN VALUE:
+ *      A pointer to the path, which must be freed when no longer needed; or
+ *      NULL if the cache is disabled or its directory can't be determined.
+ */
+char* get_key_cache_path(const uuid_t vol_uuid);
+
+/**
+ * Load a volume's VEK from its key cache file. The file is ignored unless it's
+ * owned by the current user and accessible to no one else.
+ *
+ * vek_blob_digest: The SHA-256 digest of the wrapped VEK currently in the
+ *      container keybag; the cached key is only used if it matches.
+ *
+ * vek:             The VEK will be stored here; at least `VOLUME_KEY_MAX_SIZE`
+ *      bytes.
+ *
+ * RETURN VALUE:
+ *      The length of the VEK in bytes, or zero if no valid cached key exists.
+ */
+size_t load_cached_volume_key(const char* cache_path, const uuid_t vol_uuid, const uint8_t* vek_blob_digest, uint8_t* vek);
+
+/**
+ * Save a volume's VEK to its key cache file, readable and writable only by the
+ * current user. Failure to save the key is not an error.
+ */
+void save_cached_volume_key(const char* cache_path, const uuid_t vol_uuid, const uint8_t* vek_blob_digest, const uint8_t* vek, size_t vek_len);
+
+/**
+ * Read a password: from the terminal, without echoing it, if standard input
+ * is a terminal, or else as a line of standard input.
+ *
+ * RETURN VALUE:
+ *      A pointer to the password, which must be cleared and freed when no
+ *      longer needed; or NULL if none could be read.
+ */
+char* read_password(const char* prompt);
+
+/**
+ * Unlock an encrypted volume, and set its VEK as the current container's
+ * volume key; see `set_volume_key()`. The cached VEK is used if there is one;
+ * otherwise, the user is asked for a password (showing the volume's password
+ * hint, if any), and the unwrapped VEK is cached.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value if the volume can't be unlocked.
+ */
+int unlock_volume(container_t* container, uint32_t volume_id);
+
+#endif // APFS_FUNC_KEYBAG_H
@@ -0,0 +1,143 @@
+#include "lzvn.h"
+
+lzvn_opcode_class lzvn_get_opcode_class(uint8_t op) {
+    if (op >= 0xf0) {
+        return op == 0xf0 ? LZVN_OP_LRG_M : LZVN_OP_SML_M;
+    }
+    if (op >= 0xe0) {
+        return op == 0xe0 ? LZVN_OP_LRG_L : LZVN_OP_SML_L;
+    }
+    if (op >= 0xa0 && op < 0xc0) {
+        return LZVN_OP_MED_D;
+    }
+    if ((op >= 0x70 && op < 0x80) || (op >= 0xd0 && op < 0xe0)) {
+        return LZVN_OP_UDEF;
+    }
+
+    switch (op & 0x7) {
+        case 7:
+            return LZVN_OP_LRG_D;
+        case 6:
+            if (op >= 0x40) {
+                return LZVN_OP_PRE_D;
+            }
+            if (op == 0x06) {
+                return LZVN_OP_EOS;
+            }
+            if (op == 0x0e || op == 0x16) {
+                return LZVN_OP_NOP;
+            }
+            return LZVN_OP_UDEF;
+        default:
+            return LZVN_OP_SML_D;
+    }
+}
+
+int64_t lzvn_decode(uint8_t* dst, size_t dst_size, const uint8_t* src, size_t src_size) {
+    size_t src_pos = 0;
+    size_t dst_pos = 0;
+
+    // Match distance, which persists across opcodes
+    size_t D = 0;
+
+    while (src_pos < src_size && dst_pos < dst_size) {
+        uint8_t op = src[src_pos];
+
+        size_t opc_len = 1;     // Length of the opcode, in bytes
+        size_t L = 0;           // Number of literal bytes
+        size_t M = 0;           // Number of match bytes
+
+        switch (lzvn_get_opcode_class(op)) {
+            case LZVN_OP_SML_D:
+                if (src_pos + 2 > src_size) {
+                    return -1;
+                }
+                opc_len = 2;
+                L = (op >> 6) & 0x3;
+                M = ((op >> 3) & 0x7) + 3;
+                D = ((size_t)(op & 0x7) << 8) | src[src_pos + 1];
+                break;
+            case LZVN_OP_MED_D:
+                if (src_pos + 3 > src_size) {
+                    return -1;
+                }
+                opc_len = 3;
+                L = (op >> 3) & 0x3;
+                M = ( ((size_t)(op & 0x7) << 2) | (src[src_pos + 1] & 0x3) ) + 3;
+                D = ( (size_t)src[src_pos + 1] | ((size_t)src[src_pos + 2] << 8) ) >> 2;
+                break;
+            case LZVN_OP_LRG_D:
+                if (src_pos + 3 > src_size) {
+                    return -1;
+                }
+                opc_len = 3;
+                L = (op >> 6) & 0x3;
+                M = ((op >> 3) & 0x7) + 3;
+                D = (size_t)src[src_pos + 1] | ((size_t)src[src_pos + 2] << 8);
+                break;
+            case LZVN_OP_PRE_D:
+                L = (op >> 6) & 0x3;
+                M = ((op >> 3) & 0x7) + 3;
+                break;
+            case LZVN_OP_SML_M:
+                M = op & 0xf;
+                break;
+            case LZVN_OP_LRG_M:
+                if (src_pos + 2 > src_size) {
+                    return -1;
+                }
+                opc_len = 2;
+                M = (size_t)src[src_pos + 1] + 16;
+                break;
+            case LZVN_OP_SML_L:
+                L = op & 0xf;
+                break;
+            case LZVN_OP_LRG_L:
+                if (src_pos + 2 > src_size) {
+                    return -1;
+                }
+                opc_len = 2;
+                L = (size_t)src[src_pos + 1] + 16;
+                break;
+            case LZVN_OP_NOP:
+                src_pos++;
+                continue;
+            case LZVN_OP_EOS:
+                return dst_pos;
+            case LZVN_OP_UDEF:
+            default:
+                return -1;
+        }
+        src_pos += opc_len;
+
+        // Copy literal bytes
+        if (L > 0) {
+            if (src_pos + L > src_size) {
+                return -1;
+            }
+            size_t n = L < dst_size - dst_pos ? L : dst_size - dst_pos;
+            memcpy(dst + dst_pos, src + src_pos, n);
+            src_pos += L;
+            dst_pos += n;
+        }
+
+        // Copy match bytes; source and destination may overlap, so this must
+        // be done one byte at a time (in the overlapping case, at least).
+        if (M > 0) {
+            if (D == 0 || D > dst_pos) {
+                return -1;
+            }
+            size_t n = M < dst_size - dst_pos ? M : dst_size - dst_pos;
+            if (D >= n) {
+                memcpy(dst + dst_pos, dst + dst_pos - D, n);
+            } else {
+                for (size_t i = 0; i < n; i++) {
+                    dst[dst_pos + i] = dst[dst_pos + i - D];
+                }
+            }
+            dst_pos += n;
+        }
+    }
+
+    return dst_pos;
+}
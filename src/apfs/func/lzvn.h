@@ -0,0 +1,60 @@
+/**
+ * A decoder for LZVN, the LZ77-style compression format that APFS (like HFS+)
+ * uses for many transparently compressed files. LZVN is not covered by the
+ * APFS specification; this decoder follows the opcode layout used by Apple's
+ * open-source LZFSE reference implementation (`lzvn_decode_base.c`).
+ *
+ * An LZVN stream is a sequence of opcodes. Each opcode may be followed by a
+ * number of literal bytes (copied verbatim to the output), and may describe a
+ * match (a copy of earlier output, from a given distance behind the current
+ * output position). The stream ends with an end-of-stream opcode.
+ */
+
+#ifndef APFS_FUNC_LZVN_H
+#define APFS_FUNC_LZVN_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/** Opcode Classes **/
+
+typedef enum {
+    LZVN_OP_SML_D,      // small distance
+    LZVN_OP_MED_D,      // medium distance
+    LZVN_OP_LRG_D,      // large distance
+    LZVN_OP_PRE_D,      // previous distance
+    LZVN_OP_SML_M,      // small match, previous distance
+    LZVN_OP_LRG_M,      // large match, previous distance
+    LZVN_OP_SML_L,      // small literal
+    LZVN_OP_LRG_L,      // large literal
+    LZVN_OP_NOP,
+    LZVN_OP_EOS,        // end of stream
+    LZVN_OP_UDEF,       // undefined; invalid stream
+} lzvn_opcode_class;
+
+/**
+ * Determine the class of a given LZVN opcode byte.
+ */
+lzvn_opcode_class lzvn_get_opcode_class(uint8_t op);
+
+/**
+ * Decode an LZVN stream.
+ *
+ * dst:         The location where decompressed data will be stored.
+ *
+ * dst_size:    The number of bytes available at `dst`. Decoding stops, without
+ *      error, once this many bytes have been produced, even if the end of the
+ *      stream has not been reached.
+ *
+ * src:         A pointer to the compressed stream.
+ *
+ * src_size:    The length of the compressed stream, in bytes.
+ *
+ * RETURN VALUE:
+ *      The number of bytes written to `dst`, or a negative value if the stream
+ *      is malformed.
+ */
+int64_t lzvn_decode(uint8_t* dst, size_t dst_size, const uint8_t* src, size_t src_size);
+
+#endif // APFS_FUNC_LZVN_H
@@ -0,0 +1,216 @@
+#include "metadata.h"
+
+void block_list_free(block_list_t* list) {
+    if (!list) {
+        return;
+    }
+    free(list->addrs);
+    free(list);
+}
+
+int block_list_add(block_list_t* list, paddr_t addr, uint64_t num_blocks) {
+    if (list->num_addrs + num_blocks > list->capacity) {
+        uint64_t capacity = list->capacity ? list->capacity : 1024;
+        while (capacity < list->num_addrs + num_blocks) {
+            capacity *= 2;
+        }
+        paddr_t* addrs = realloc(list->addrs, capacity * sizeof(paddr_t));
+        if (!addrs) {
+            fprintf(stderr, "\nABORT: block_list_add: Could not allocate sufficient memory for `addrs`.\n");
+            return -1;
+        }
+        list->addrs = addrs;
+        list->capacity = capacity;
+    }
+    for (uint64_t i = 0; i < num_blocks; i++) {
+        list->addrs[list->num_addrs++] = addr + i;
+    }
+    return 0;
+}
+
+int compare_block_addrs(const void* a, const void* b) {
+    paddr_t addr_a = *(const paddr_t*)a;
+    paddr_t addr_b = *(const paddr_t*)b;
+    return (addr_a > addr_b) - (addr_a < addr_b);
+}
+
+void block_list_sort(block_list_t* list) {
+    qsort(list->addrs, list->num_addrs, sizeof(paddr_t), compare_block_addrs);
+    uint64_t num_unique = 0;
+    for (uint64_t i = 0; i < list->num_addrs; i++) {
+        if (num_unique == 0 || list->addrs[num_unique - 1] != list->addrs[i]) {
+            list->addrs[num_unique++] = list->addrs[i];
+        }
+    }
+    list->num_addrs = num_unique;
+}
+
+int add_btree_blocks(block_list_t* list, paddr_t root_addr, btree_node_phys_t* omap_btree, xid_t xid) {
+    btree_node_phys_t* node = malloc(nx_device->block_size);
+    if (!node) {
+        fprintf(stderr, "\nABORT: add_btree_blocks: Could not allocate sufficient memory for `node`.\n");
+        return -1;
+    }
+    if (read_node(node, root_addr) != 1 || !is_cksum_valid((uint32_t*)node) || !is_btree_node_phys((obj_phys_t*)node)) {
+        fprintf(stderr, "- The B-tree node at block 0x%llx is malformed. Skipping it and its descendants.\n", root_addr);
+        free(node);
+        return 0;
+    }
+    if (block_list_add(list, root_addr, 1) != 0) {
+        free(node);
+        return -1;
+    }
+    if (node->btn_flags & BTNODE_LEAF) {
+        free(node);
+        return 0;
+    }
+
+    char* toc_start = (char*)(node->btn_data) + node->btn_table_space.off;
+    char* key_start = toc_start + node->btn_table_space.len;
+    char* val_end   = (char*)node + nx_device->block_size;
+    if (node->btn_flags & BTNODE_ROOT) {
+        val_end -= sizeof(btree_info_t);
+    }
+
+    // The TOC entries of nodes with fixed-size keys and values are instances
+    // of `kvoff_t`, and otherwise of `kvloc_t`.
+    bool fixed_kv_size = node->btn_flags & BTNODE_FIXED_KV_SIZE;
+    size_t toc_entry_size = fixed_kv_size ? sizeof(kvoff_t) : sizeof(kvloc_t);
+
+    int result = 0;
+    for (uint32_t i = 0; i < node->btn_nkeys && result == 0; i++) {
+        if (toc_start + (i + 1) * toc_entry_size > key_start) {
+            fprintf(stderr, "- The table of contents of the B-tree node at block 0x%llx is malformed. Skipping its remaining entries.\n", root_addr);
+            break;
+        }
+        uint16_t v_off = fixed_kv_size ? ((kvoff_t*)toc_start)[i].v : ((kvloc_t*)toc_start)[i].v.off;
+        if (v_off < sizeof(oid_t) || val_end - v_off < key_start) {
+            fprintf(stderr, "- Entry %u of the B-tree node at block 0x%llx is malformed. Skipping it.\n", i, root_addr);
+            continue;
+        }
+
+        oid_t child_oid = *(oid_t*)(val_end - v_off);
+        paddr_t child_addr = child_oid;
+        if (omap_btree) {
+            omap_val_t* omap_val = get_btree_phys_omap_val(omap_btree, child_oid, xid);
+            if (!omap_val) {
+                fprintf(stderr, "- The child node with OID 0x%llx of the B-tree node at block 0x%llx isn't in the object map. Skipping it.\n", child_oid, root_addr);
+                continue;
+            }
+            child_addr = omap_val->ov_paddr;
+            free(omap_val);
+        }
+        result = add_btree_blocks(list, child_addr, omap_btree, xid);
+    }
+    free(node);
+    return result;
+}
+
+/**
+ * Add the blocks of an object map, i.e. its `omap_phys_t` and the nodes of its
+ * B-trees, to a list.
+ *
+ * omap_btree:  If not NULL, the root node of the object map B-tree will be
+ *      stored here, if it can be read. It must be freed when no longer needed.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value if memory couldn't be allocated.
+ */
+int add_omap_blocks(block_list_t* list, paddr_t omap_addr, btree_node_phys_t** omap_btree) {
+    if (omap_btree) {
+        *omap_btree = NULL;
+    }
+    omap_phys_t* omap = malloc(nx_device->block_size);
+    if (!omap) {
+        fprintf(stderr, "\nABORT: add_omap_blocks: Could not allocate sufficient memory for `omap`.\n");
+        return -1;
+    }
+    if (read_blocks(omap, omap_addr, 1) != 1 || !is_cksum_valid((uint32_t*)omap)) {
+        fprintf(stderr, "- The object map at block 0x%llx is malformed. Skipping it.\n", omap_addr);
+        free(omap);
+        return 0;
+    }
+
+    int result = block_list_add(list, omap_addr, 1);
+    if (result == 0) {
+        result = add_btree_blocks(list, omap->om_tree_oid, NULL, (xid_t)(~0));
+    }
+    if (result == 0 && omap->om_snapshot_tree_oid) {
+        result = add_btree_blocks(list, omap->om_snapshot_tree_oid, NULL, (xid_t)(~0));
+    }
+    if (result == 0 && omap_btree) {
+        *omap_btree = malloc(nx_device->block_size);
+        if (*omap_btree && read_node(*omap_btree, omap->om_tree_oid) != 1) {
+            free(*omap_btree);
+            *omap_btree = NULL;
+        }
+    }
+    free(omap);
+    return result;
+}
+
+block_list_t* list_metadata_blocks(container_t* container, allocation_map_t* allocation_map) {
+    nx_superblock_t* nxsb = container->nxsb;
+    btree_node_phys_t* fs_omap_btree = NULL;
+
+    block_list_t* list = calloc(1, sizeof(block_list_t));
+    if (!list) {
+        fprintf(stderr, "\nABORT: list_metadata_blocks: Could not allocate sufficient memory for `list`.\n");
+        return NULL;
+    }
+
+    // Block 0x0, and the checkpoint areas, which hold the Ephemeral objects.
+    if (block_list_add(list, 0x0, 1) != 0) {
+        goto onError;
+    }
+    if (!(nxsb->nx_xp_desc_blocks >> 31) && block_list_add(list, nxsb->nx_xp_desc_base, nxsb->nx_xp_desc_blocks) != 0) {
+        goto onError;
+    }
+    if (!(nxsb->nx_xp_data_blocks >> 31) && block_list_add(list, nxsb->nx_xp_data_base, nxsb->nx_xp_data_blocks) != 0) {
+        goto onError;
+    }
+    if (allocation_map) {
+        for (uint64_t i = 0; i < allocation_map->num_sm_blocks; i++) {
+            if (block_list_add(list, allocation_map->sm_blocks[i], 1) != 0) {
+                goto onError;
+            }
+        }
+    }
+
+    if (add_omap_blocks(list, nxsb->nx_omap_oid, NULL) != 0) {
+        goto onError;
+    }
+
+    for (uint32_t i = 0; i < container->num_volumes; i++) {
+        apfs_superblock_t* apsb = get_volume_superblock(container, i);
+        container_volume_t* volume = container->volumes + i;
+        if (block_list_add(list, volume->apsb_addr, 1) != 0) {
+            goto onError;
+        }
+        if (add_omap_blocks(list, apsb->apfs_omap_oid, &fs_omap_btree) != 0) {
+            goto onError;
+        }
+        if (fs_omap_btree && volume->fs_root_addr) {
+            if (add_btree_blocks(list, volume->fs_root_addr, fs_omap_btree, apsb->apfs_o.o_xid) != 0) {
+                goto onError;
+            }
+        }
+        free(fs_omap_btree);
+        fs_omap_btree = NULL;
+
+        if (apsb->apfs_extentref_tree_oid && add_btree_blocks(list, apsb->apfs_extentref_tree_oid, NULL, (xid_t)(~0)) != 0) {
+            goto onError;
+        }
+        if (apsb->apfs_snap_meta_tree_oid && add_btree_blocks(list, apsb->apfs_snap_meta_tree_oid, NULL, (xid_t)(~0)) != 0) {
+            goto onError;
+        }
+    }
+
+    block_list_sort(list);
+    return list;
+
+onError:
+    free(fs_omap_btree);
+    block_list_free(list);
+    return NULL;
+}
@@ -0,0 +1,94 @@
+/**
+ * Functions used to list the blocks that hold the metadata of a container as
+ * of its current checkpoint, i.e. everything needed to mount the container
+ * and to list and look up the files in its volumes, but not the files' data.
+ *
+ * This is found by walking the structures themselves: the checkpoint areas,
+ * the space manager, the container object map, and for each volume its
+ * superblock, object map, file-system tree, extent reference tree, and
+ * snapshot metadata tree. Only the current version of each tree is walked;
+ * the nodes that snapshots alone refer to are not included.
+ */
+
+#ifndef APFS_FUNC_METADATA_H
+#define APFS_FUNC_METADATA_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "../io.h"
+#include "../struct/general.h"
+#include "../struct/object.h"
+#include "../struct/btree.h"
+#include "../struct/nx.h"
+#include "../struct/omap.h"
+#include "../struct/fs.h"
+
+#include "boolean.h"
+#include "cksum.h"
+#include "btree.h"
+#include "node_cache.h"
+#include "container.h"
+#include "spaceman.h"
+
+/**
+ * A set of block addresses.
+ *
+ * addrs:       The addresses; sorted and without duplicates once
+ *      `block_list_sort()` has been called.
+ */
+typedef struct {
+    paddr_t*    addrs;
+    uint64_t    num_addrs;
+    uint64_t    capacity;
+} block_list_t;
+
+void block_list_free(block_list_t* list);
+
+/**
+ * Add a range of blocks to a list.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value if memory couldn't be allocated.
+ */
+int block_list_add(block_list_t* list, paddr_t addr, uint64_t num_blocks);
+
+/**
+ * Sort a list, and remove duplicate addresses from it.
+ */
+void block_list_sort(block_list_t* list);
+
+/**
+ * Add the blocks of every node of a B-tree to a list. Nodes that can't be read
+ * are reported, and their descendants are skipped.
+ *
+ * root_addr:   The physical address of the root node.
+ *
+ * omap_btree:  The root node of the object map B-tree used to resolve the
+ *      tree's child nodes, or NULL if the tree refers to its child nodes by
+ *      physical address.
+ *
+ * xid:         The XID as of which child nodes are resolved.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value if memory couldn't be allocated.
+ */
+int add_btree_blocks(block_list_t* list, paddr_t root_addr, btree_node_phys_t* omap_btree, xid_t xid);
+
+/**
+ * List the metadata blocks of a container, as of the checkpoint that it has
+ * mounted.
+ *
+ * allocation_map:  The container's allocation map, whose own blocks are
+ *      included; or NULL.
+ *
+ * RETURN VALUE:
+ *      A pointer to the list, sorted and without duplicates, which must be
+ *      freed with `block_list_free()`; or NULL if an error occurs.
+ */
+block_list_t* list_metadata_blocks(container_t* container, allocation_map_t* allocation_map);
+
+#endif // APFS_FUNC_METADATA_H
@@ -0,0 +1,111 @@
+#include "node_cache.h"
+#include "carve.h"
+#include "crypto.h"
+
+bool node_cache_enable(size_t capacity) {
+    if (nx_device->node_cache) {
+        return true;
+    }
+
+    node_cache_t* cache = calloc(1, sizeof(node_cache_t));
+    if (!cache) {
+        fprintf(stderr, "\nABORT: node_cache_enable: Could not allocate sufficient memory for `cache`.\n");
+        return false;
+    }
+    cache->nodes = oid_map_create(capacity < 4096 ? capacity : 4096);
+    if (!cache->nodes) {
+        free(cache);
+        return false;
+    }
+    cache->capacity = capacity > 0 ? capacity : 1;
+    pthread_mutex_init(&cache->lock, NULL);
+
+    nx_device->node_cache = cache;
+    return true;
+}
+
+void node_cache_free(node_cache_t* cache) {
+    if (!cache) {
+        return;
+    }
+    oid_map_free(cache->nodes, free);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+}
+
+void node_cache_clear() {
+    node_cache_t* node_cache = nx_device->node_cache;
+    if (!node_cache) {
+        return;
+    }
+
+    oid_map_t* nodes = oid_map_create(node_cache->capacity < 4096 ? node_cache->capacity : 4096);
+    if (!nodes) {
+        return;
+    }
+    pthread_mutex_lock(&node_cache->lock);
+    oid_map_t* old_nodes = node_cache->nodes;
+    node_cache->nodes = nodes;
+    node_cache->evict_cursor = 0;
+    pthread_mutex_unlock(&node_cache->lock);
+    oid_map_free(old_nodes, free);
+}
+
+size_t read_node(void* buffer, paddr_t addr) {
+    if (read_carved_node(buffer, addr)) {
+        return 1;
+    }
+
+    node_cache_t* node_cache = nx_device->node_cache;
+    if (!node_cache) {
+        size_t result = read_blocks(buffer, addr, 1);
+        if (result == 1) {
+            decrypt_node(buffer, addr);
+        }
+        return result;
+    }
+
+    pthread_mutex_lock(&node_cache->lock);
+    char* cached = oid_map_get(node_cache->nodes, addr);
+    if (cached) {
+        memcpy(buffer, cached, nx_device->block_size);
+        node_cache->hits++;
+        pthread_mutex_unlock(&node_cache->lock);
+        return 1;
+    }
+    node_cache->misses++;
+    pthread_mutex_unlock(&node_cache->lock);
+
+    // Read without holding the lock, so that other threads aren't held up by
+    // I/O; if two threads miss on the same node, both will read it.
+    size_t result = read_blocks(buffer, addr, 1);
+    if (result != 1) {
+        return result;
+    }
+    decrypt_node(buffer, addr);
+
+    char* copy = malloc(nx_device->block_size);
+    if (!copy) {
+        return result;  // Not being able to cache the node isn't an error.
+    }
+    memcpy(copy, buffer, nx_device->block_size);
+
+    pthread_mutex_lock(&node_cache->lock);
+    if (oid_map_get(node_cache->nodes, addr)) {
+        free(copy);
+    } else {
+        while (node_cache->nodes->count >= node_cache->capacity) {
+            oid_map_entry_t* victim = oid_map_next(node_cache->nodes, &node_cache->evict_cursor);
+            if (!victim) {
+                node_cache->evict_cursor = 0;
+                continue;
+            }
+            free(oid_map_remove(node_cache->nodes, victim->key));
+        }
+        if (!oid_map_put(node_cache->nodes, addr, copy)) {
+            free(copy);
+        }
+    }
+    pthread_mutex_unlock(&node_cache->lock);
+    return result;
+}
@@ -0,0 +1,84 @@
+/**
+ * An in-memory cache of B-tree nodes, keyed by physical block address.
+ *
+ * Looking up a single file-system object involves descending the volume's
+ * object map and file-system tree from their roots, often several times over,
+ * so long-running tools can keep the nodes they've read in memory rather than
+ * reading them from the container again. Nodes are never modified in place
+ * (APFS is copy-on-write), so a cached node remains valid for as long as the
+ * tool is reading the same checkpoint.
+ *
+ * Each container has its own cache, which is disabled unless
+ * `node_cache_enable()` is called while the container is the current one, and
+ * may be used from multiple threads at once.
+ */
+
+#ifndef APFS_FUNC_NODE_CACHE_H
+#define APFS_FUNC_NODE_CACHE_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "../struct/general.h"
+#include "../io.h"
+
+#include "oid_map.h"
+
+/**
+ * nodes:       Maps the physical address of each cached node to a copy of it.
+ *
+ * capacity:    The maximum number of nodes to keep. Once the cache is full,
+ *      an arbitrary node is evicted to make room for each new one.
+ *
+ * evict_cursor:    Iteration cursor into `nodes`, which advances each time a
+ *      node is evicted, so that evictions are spread across the cache.
+ *
+ * hits, misses:    Statistics on lookups.
+ */
+typedef struct nx_node_cache {
+    oid_map_t*      nodes;
+    size_t          capacity;
+    size_t          evict_cursor;
+    pthread_mutex_t lock;
+
+    uint64_t        hits;
+    uint64_t        misses;
+} node_cache_t;
+
+/**
+ * Enable the node cache of the current container; see `nx_device` in
+ * `apfs/io.h`.
+ *
+ * capacity:    The maximum number of nodes to keep in memory.
+ *
+ * RETURN VALUE:
+ *      True on success, or false if memory could not be allocated.
+ */
+bool node_cache_enable(size_t capacity);
+
+/**
+ * Free a node cache and all of the nodes in it.
+ */
+void node_cache_free(node_cache_t* cache);
+
+/**
+ * Discard all of the nodes in the cache of the current container, if it's
+ * enabled, e.g. once the container has moved on to checkpoints that may have
+ * reused the blocks the nodes were read from.
+ */
+void node_cache_clear();
+
+/**
+ * Read a single B-tree node, from the current container's carved tree if the
+ * node is one of its nodes (see `apfs/func/carve.h`); from the node cache if
+ * it's enabled and has the node; or else from the container, in which case the
+ * node is decrypted if need be (see `decrypt_node()`) and added to the cache.
+ *
+ * RETURN VALUE:
+ *      The number of blocks read, as for `read_blocks()`; i.e. 1 on success.
+ */
+size_t read_node(void* buffer, paddr_t addr);
+
+#endif // APFS_FUNC_NODE_CACHE_H
@@ -0,0 +1,141 @@
+#include "oid_map.h"
+
+size_t oid_map_hash(oid_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+oid_map_t* oid_map_create(size_t capacity) {
+    oid_map_t* map = malloc(sizeof(oid_map_t));
+    if (!map) {
+        fprintf(stderr, "\nABORT: oid_map_create: Could not allocate sufficient memory for `map`.\n");
+        return NULL;
+    }
+
+    map->capacity = 16;
+    while (map->capacity < capacity) {
+        map->capacity *= 2;
+    }
+    map->count = 0;
+    map->num_deleted = 0;
+
+    map->entries = calloc(map->capacity, sizeof(oid_map_entry_t));
+    if (!map->entries) {
+        fprintf(stderr, "\nABORT: oid_map_create: Could not allocate sufficient memory for `map->entries`.\n");
+        free(map);
+        return NULL;
+    }
+    return map;
+}
+
+void oid_map_free(oid_map_t* map, void (*free_value)(void*)) {
+    if (!map) {
+        return;
+    }
+    if (free_value) {
+        for (size_t i = 0; i < map->capacity; i++) {
+            if (map->entries[i].state == OID_MAP_USED) {
+                free_value(map->entries[i].value);
+            }
+        }
+    }
+    free(map->entries);
+    free(map);
+}
+
+oid_map_entry_t* oid_map_find_slot(oid_map_t* map, oid_t key) {
+    size_t mask = map->capacity - 1;
+    oid_map_entry_t* insert_slot = NULL;
+
+    for (size_t i = oid_map_hash(key) & mask;    ;    i = (i + 1) & mask) {
+        oid_map_entry_t* entry = map->entries + i;
+        if (entry->state == OID_MAP_EMPTY) {
+            return insert_slot ? insert_slot : entry;
+        }
+        if (entry->state == OID_MAP_DELETED) {
+            if (!insert_slot) {
+                insert_slot = entry;
+            }
+            continue;
+        }
+        if (entry->key == key) {
+            return entry;
+        }
+    }
+}
+
+void* oid_map_get(oid_map_t* map, oid_t key) {
+    oid_map_entry_t* entry = oid_map_find_slot(map, key);
+    return entry->state == OID_MAP_USED ? entry->value : NULL;
+}
+
+bool oid_map_resize(oid_map_t* map, size_t capacity) {
+    oid_map_entry_t* old_entries = map->entries;
+    size_t old_capacity = map->capacity;
+
+    map->entries = calloc(capacity, sizeof(oid_map_entry_t));
+    if (!map->entries) {
+        fprintf(stderr, "\nABORT: oid_map_resize: Could not allocate sufficient memory for `map->entries`.\n");
+        map->entries = old_entries;
+        return false;
+    }
+    map->capacity = capacity;
+    map->num_deleted = 0;
+
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old_entries[i].state == OID_MAP_USED) {
+            *oid_map_find_slot(map, old_entries[i].key) = old_entries[i];
+        }
+    }
+    free(old_entries);
+    return true;
+}
+
+bool oid_map_put(oid_map_t* map, oid_t key, void* value) {
+    if ((map->count + map->num_deleted + 1) * 100 > map->capacity * OID_MAP_MAX_LOAD) {
+        size_t capacity = map->capacity;
+        if ((map->count + 1) * 100 > capacity * OID_MAP_MAX_LOAD / 2) {
+            capacity *= 2;
+        }
+        if (!oid_map_resize(map, capacity)) {
+            return false;
+        }
+    }
+
+    oid_map_entry_t* entry = oid_map_find_slot(map, key);
+    if (entry->state != OID_MAP_USED) {
+        if (entry->state == OID_MAP_DELETED) {
+            map->num_deleted--;
+        }
+        entry->key = key;
+        entry->state = OID_MAP_USED;
+        map->count++;
+    }
+    entry->value = value;
+    return true;
+}
+
+void* oid_map_remove(oid_map_t* map, oid_t key) {
+    oid_map_entry_t* entry = oid_map_find_slot(map, key);
+    if (entry->state != OID_MAP_USED) {
+        return NULL;
+    }
+    entry->state = OID_MAP_DELETED;
+    map->count--;
+    map->num_deleted++;
+    return entry->value;
+}
+
+oid_map_entry_t* oid_map_next(oid_map_t* map, size_t* cursor) {
+    while (*cursor < map->capacity) {
+        oid_map_entry_t* entry = map->entries + (*cursor)++;
+        if (entry->state == OID_MAP_USED) {
+            return entry;
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,122 @@
+/**
+ * A hash map keyed by 64-bit identifiers, such as OIDs, inode numbers, or
+ * physical block addresses. Used to remember which file-system objects or
+ * extents have already been dealt with, e.g. during recursive recovery.
+ */
+
+#ifndef APFS_FUNC_OID_MAP_H
+#define APFS_FUNC_OID_MAP_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "../struct/object.h"
+
+/** Entry states **/
+
+#define OID_MAP_EMPTY       0
+#define OID_MAP_USED        1
+#define OID_MAP_DELETED     2
+
+/**
+ * The map is grown once this fraction (in percent) of its entries are used or
+ * deleted.
+ */
+#define OID_MAP_MAX_LOAD    70
+
+typedef struct {
+    oid_t       key;
+    void*       value;
+    uint8_t     state;
+} oid_map_entry_t;
+
+/**
+ * capacity:    Number of entries allocated; always a power of two.
+ *
+ * count:       Number of entries in use.
+ *
+ * num_deleted: Number of entries which were removed but still occupy a slot,
+ *      so that lookups can probe past them.
+ */
+typedef struct {
+    oid_map_entry_t*    entries;
+    size_t              capacity;
+    size_t              count;
+    size_t              num_deleted;
+} oid_map_t;
+
+/**
+ * Hash a 64-bit key. Keys such as OIDs and block addresses are often
+ * sequential, so their bits must be mixed well before being used to index
+ * a table whose size is a power of two.
+ */
+size_t oid_map_hash(oid_t key);
+
+/**
+ * Create an empty map.
+ *
+ * capacity:    The number of entries to initially allocate. This is rounded
+ *      up to a power of two.
+ *
+ * RETURN VALUE:
+ *      A pointer to the new map, which must be freed with `oid_map_free()`
+ *      when no longer needed; or NULL if memory could not be allocated.
+ */
+oid_map_t* oid_map_create(size_t capacity);
+
+/**
+ * Free a map. If `free_value` is not NULL, it is called on the value of each
+ * entry in the map.
+ */
+void oid_map_free(oid_map_t* map, void (*free_value)(void*));
+
+/**
+ * Find the slot for a given key: either the slot containing it, or, if the
+ * key isn't in the map, the slot where it should be inserted.
+ */
+oid_map_entry_t* oid_map_find_slot(oid_map_t* map, oid_t key);
+
+/**
+ * Get the value associated with a given key.
+ *
+ * RETURN VALUE:
+ *      The value, or NULL if the key isn't in the map.
+ */
+void* oid_map_get(oid_map_t* map, oid_t key);
+
+/**
+ * Rebuild the map's table with a given capacity, discarding deleted entries.
+ */
+bool oid_map_resize(oid_map_t* map, size_t capacity);
+
+/**
+ * Associate a value with a given key, replacing any existing value.
+ *
+ * RETURN VALUE:
+ *      True on success, or false if memory could not be allocated.
+ */
+bool oid_map_put(oid_map_t* map, oid_t key, void* value);
+
+/**
+ * Remove a given key from the map.
+ *
+ * RETURN VALUE:
+ *      The value that was associated with the key, so that the caller can
+ *      free it if need be; or NULL if the key wasn't in the map.
+ */
+void* oid_map_remove(oid_map_t* map, oid_t key);
+
+/**
+ * Iterate over the entries of a map, in no particular order.
+ *
+ * cursor:      A pointer to an iteration cursor, which should be zero before
+ *      the first call. The map must not be modified during iteration.
+ *
+ * RETURN VALUE:
+ *      A pointer to the next entry in the map, or NULL if there are no more.
+ */
+oid_map_entry_t* oid_map_next(oid_map_t* map, size_t* cursor);
+
+#endif // APFS_FUNC_OID_MAP_H
@@ -0,0 +1,119 @@
+#include "omap_memo.h"
+
+void omap_memo_free_entries(void* list) {
+    omap_memo_entry_t* entry = list;
+    while (entry) {
+        omap_memo_entry_t* next = entry->next;
+        free(entry);
+        entry = next;
+    }
+}
+
+void omap_memo_free(omap_memo_t* memo) {
+    if (!memo) {
+        return;
+    }
+    oid_map_free(memo->entries, omap_memo_free_entries);
+    pthread_mutex_destroy(&memo->lock);
+    free(memo);
+}
+
+bool omap_memo_enable(size_t capacity) {
+    if (nx_device->omap_memo) {
+        return true;
+    }
+
+    omap_memo_t* memo = calloc(1, sizeof(omap_memo_t));
+    if (!memo) {
+        fprintf(stderr, "\nABORT: omap_memo_enable: Could not allocate sufficient memory for `memo`.\n");
+        return false;
+    }
+    memo->capacity = capacity ? capacity : OMAP_MEMO_DEFAULT_ENTRIES;
+    memo->entries = oid_map_create(1024);
+    if (!memo->entries) {
+        free(memo);
+        return false;
+    }
+    pthread_mutex_init(&memo->lock, NULL);
+
+    nx_device->omap_memo = memo;
+    return true;
+}
+
+bool omap_memo_get(btree_node_phys_t* root_node, oid_t oid, xid_t max_xid, omap_val_t* val, xid_t* version_xid) {
+    omap_memo_t* memo = nx_device->omap_memo;
+    if (!memo) {
+        return false;
+    }
+
+    bool found = false;
+    pthread_mutex_lock(&memo->lock);
+    for (omap_memo_entry_t* entry = oid_map_get(memo->entries, oid); entry; entry = entry->next) {
+        if (
+                entry->tree_oid == root_node->btn_o.o_oid
+                && entry->tree_xid == root_node->btn_o.o_xid
+                && entry->min_xid <= max_xid
+                && max_xid <= entry->max_xid
+        ) {
+            *val = entry->val;
+            if (version_xid) {
+                *version_xid = entry->min_xid;
+            }
+            found = true;
+            break;
+        }
+    }
+    if (found) {
+        memo->hits++;
+    } else {
+        memo->misses++;
+    }
+    pthread_mutex_unlock(&memo->lock);
+    return found;
+}
+
+void omap_memo_put(btree_node_phys_t* root_node, oid_t oid, xid_t min_xid, xid_t max_xid, omap_val_t* val) {
+    omap_memo_t* memo = nx_device->omap_memo;
+    if (!memo) {
+        return;
+    }
+
+    omap_memo_entry_t* entry = malloc(sizeof(omap_memo_entry_t));
+    if (!entry) {
+        return;
+    }
+    entry->tree_oid = root_node->btn_o.o_oid;
+    entry->tree_xid = root_node->btn_o.o_xid;
+    entry->min_xid = min_xid;
+    entry->max_xid = max_xid;
+    entry->val = *val;
+
+    pthread_mutex_lock(&memo->lock);
+
+    // Rather than track which entries are least recently used, start afresh
+    // when the memo is full; the entries that matter are soon remembered again.
+    if (memo->num_entries >= memo->capacity) {
+        oid_map_t* entries = oid_map_create(1024);
+        if (entries) {
+            oid_map_free(memo->entries, omap_memo_free_entries);
+            memo->entries = entries;
+            memo->num_entries = 0;
+        }
+    }
+
+    omap_memo_entry_t* head = oid_map_get(memo->entries, oid);
+    if (head) {
+        entry->next = head->next;
+        head->next = entry;
+        memo->num_entries++;
+    } else {
+        entry->next = NULL;
+        if (oid_map_put(memo->entries, oid, entry)) {
+            memo->num_entries++;
+        } else {
+            free(entry);
+        }
+    }
+
+    pthread_mutex_unlock(&memo->lock);
+}
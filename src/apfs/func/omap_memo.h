@@ -0,0 +1,122 @@
+/**
+ * Memoisation of object map lookups, such that resolving the same object as of
+ * many different XIDs (e.g. while walking several snapshots of a volume) only
+ * descends the object map B-tree once per version of the object.
+ *
+ * Each entry records an object map value together with the range of XIDs for
+ * which it is the answer, i.e. from the XID of the version it describes up to
+ * the XID before that of the next version of the same object. A lookup as of
+ * any XID in that range is then answered from the memo. When the next version
+ * couldn't be seen from the leaf node that was searched, the range ends at the
+ * XID that was asked for, so that a later lookup as of a greater XID descends
+ * the tree again rather than trusting a range that might be too wide.
+ *
+ * Each container has its own memo, which is created when the container is
+ * mounted (see `load_container()`), and may be used from multiple threads at
+ * once. Lookups still work if a container has no memo; they just always
+ * descend the tree.
+ */
+
+#ifndef APFS_FUNC_OMAP_MEMO_H
+#define APFS_FUNC_OMAP_MEMO_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "../io.h"
+#include "../struct/general.h"
+#include "../struct/object.h"
+#include "../struct/btree.h"
+#include "../struct/omap.h"
+
+#include "oid_map.h"
+
+/** Object map memo constants **/
+
+#define OMAP_MEMO_DEFAULT_ENTRIES   65536   // Entries remembered before the memo is cleared
+
+/**
+ * A remembered object map value.
+ *
+ * tree_oid, tree_xid:  The OID and XID of the root node of the object map
+ *      B-tree that the value was found in, since the same object may be mapped
+ *      differently by different volumes, or by different checkpoints of the
+ *      same volume.
+ *
+ * min_xid, max_xid:    The range of XIDs, inclusive, as of which `val` is the
+ *      latest version of the object.
+ *
+ * next:        The next entry for the same OID, or NULL.
+ */
+typedef struct omap_memo_entry {
+    oid_t                       tree_oid;
+    xid_t                       tree_xid;
+    xid_t                       min_xid;
+    xid_t                       max_xid;
+    omap_val_t                  val;
+    struct omap_memo_entry*     next;
+} omap_memo_entry_t;
+
+/**
+ * entries:     Maps each OID to a list of instances of `omap_memo_entry_t`.
+ *
+ * num_entries: The number of entries in all of the lists.
+ *
+ * capacity:    The number of entries after which the memo is cleared.
+ *
+ * hits, misses:    Statistics on lookups.
+ */
+typedef struct nx_omap_memo {
+    oid_map_t*      entries;
+    size_t          num_entries;
+    size_t          capacity;
+    pthread_mutex_t lock;
+
+    uint64_t        hits;
+    uint64_t        misses;
+} omap_memo_t;
+
+/**
+ * Create the memo of the current container (see `nx_device` in `apfs/io.h`),
+ * if it doesn't already have one.
+ *
+ * capacity:    The number of entries to remember, or zero to use
+ *      `OMAP_MEMO_DEFAULT_ENTRIES`.
+ *
+ * RETURN VALUE:
+ *      True on success, or false if memory could not be allocated.
+ */
+bool omap_memo_enable(size_t capacity);
+
+/**
+ * Free a memo and all of the entries in it.
+ */
+void omap_memo_free(omap_memo_t* memo);
+
+/**
+ * Look up the latest version of an object, up to a given XID, in the memo of
+ * the current container.
+ *
+ * root_node:   The root node of the object map B-tree being searched.
+ *
+ * val:         If the version is remembered, its object map value is copied
+ *      here.
+ *
+ * version_xid: If not NULL, and the version is remembered, its XID will be
+ *      stored here.
+ *
+ * RETURN VALUE:
+ *      True if the version is remembered, or false otherwise.
+ */
+bool omap_memo_get(btree_node_phys_t* root_node, oid_t oid, xid_t max_xid, omap_val_t* val, xid_t* version_xid);
+
+/**
+ * Remember that a given object map value is the latest version of an object as
+ * of each XID from `min_xid` to `max_xid`, inclusive. Failure to remember it is
+ * not an error.
+ */
+void omap_memo_put(btree_node_phys_t* root_node, oid_t oid, xid_t min_xid, xid_t max_xid, omap_val_t* val);
+
+#endif // APFS_FUNC_OMAP_MEMO_H
@@ -0,0 +1,927 @@
+#include "recover.h"
+
+j_rec_t* get_decmpfs_xattr_record(j_rec_t** fs_records) {
+    j_rec_t* inode_rec = get_inode_record(fs_records);
+    if (!inode_rec) {
+        return NULL;
+    }
+
+    j_inode_val_t* val = inode_rec->data + inode_rec->key_len;
+    if (!(val->bsd_flags & UF_COMPRESSED)) {
+        return NULL;
+    }
+    return get_xattr_record(fs_records, DECMPFS_XATTR_NAME);
+}
+
+int write_compressed_file(
+    btree_node_phys_t*  fs_omap_btree,
+    btree_node_phys_t*  fs_root_btree,
+    j_rec_t**           fs_records,
+    j_rec_t*            decmpfs_rec,
+    FILE*               out
+) {
+    uint64_t hdr_len = 0;
+    decmpfs_disk_header_t* hdr = get_xattr_value(fs_omap_btree, fs_root_btree, decmpfs_rec, &hdr_len);
+    if (!hdr) {
+        fprintf(stderr, "Could not read the `%s` extended attribute.\n", DECMPFS_XATTR_NAME);
+        return -1;
+    }
+    if (hdr_len < sizeof(decmpfs_disk_header_t) || hdr->compression_magic != DECMPFS_MAGIC) {
+        fprintf(stderr, "The `%s` extended attribute is malformed.\n", DECMPFS_XATTR_NAME);
+        free(hdr);
+        return -1;
+    }
+    fprintf(stderr, "The file is compressed (%s); uncompressed size is %llu bytes.\n", decmpfs_type_to_string(hdr->compression_type), hdr->uncompressed_size);
+
+    file_extent_t* rsrc_extents = NULL;
+    size_t num_rsrc_extents = 0;
+    uint64_t rsrc_size = 0;
+    if (decmpfs_type_uses_rsrc(hdr->compression_type)) {
+        j_rec_t* rsrc_rec = get_xattr_record(fs_records, RESOURCE_FORK_XATTR_NAME);
+        if (!rsrc_rec) {
+            fprintf(stderr, "The compressed data should be in the resource fork, but the file has no resource fork.\n");
+            free(hdr);
+            return -1;
+        }
+
+        j_xattr_val_t* rsrc_val = rsrc_rec->data + rsrc_rec->key_len;
+        rsrc_extents = get_xattr_dstream_extents(fs_omap_btree, fs_root_btree, rsrc_rec, &num_rsrc_extents, &rsrc_size);
+        if (!rsrc_extents) {
+            fprintf(stderr, "Could not find any extents for the resource fork.\n");
+            free(hdr);
+            return -1;
+        }
+    }
+
+    int result = decmpfs_write_data(hdr, hdr_len, rsrc_extents, num_rsrc_extents, rsrc_size, out);
+
+    free(rsrc_extents);
+    free(hdr);
+    return result;
+}
+
+void extent_index_free(extent_index_t* index) {
+    for (size_t i = 0; i < index->num_extents; i++) {
+        free(index->extents[i].path);
+    }
+    for (size_t i = 0; i < index->num_recent; i++) {
+        free(index->recent[i].path);
+    }
+    free(index->extents);
+    free(index->recent);
+    index->extents = NULL;
+    index->recent = NULL;
+    index->num_extents = 0;
+    index->num_recent = 0;
+}
+
+/**
+ * Find the position of the first range in a sorted array of written ranges
+ * that starts after a given address.
+ */
+size_t search_written_extents(written_extent_t* extents, size_t num_extents, uint64_t phys_addr) {
+    size_t lo = 0;
+    size_t hi = num_extents;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (extents[mid].phys_addr <= phys_addr) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+written_extent_t* find_written_extent(extent_index_t* index, uint64_t phys_addr, uint64_t* next_addr) {
+    written_extent_t* arrays[2] = { index->extents, index->recent };
+    size_t counts[2] = { index->num_extents, index->num_recent };
+
+    *next_addr = UINT64_MAX;
+    for (int i = 0; i < 2; i++) {
+        size_t pos = search_written_extents(arrays[i], counts[i], phys_addr);
+        if (pos > 0 && phys_addr - arrays[i][pos - 1].phys_addr < arrays[i][pos - 1].length) {
+            return arrays[i] + pos - 1;
+        }
+        if (pos < counts[i] && arrays[i][pos].phys_addr < *next_addr) {
+            *next_addr = arrays[i][pos].phys_addr;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Merge the ranges in `index->recent` into `index->extents`.
+ *
+ * RETURN VALUE:
+ *      True on success, or false if sufficient memory couldn't be allocated.
+ */
+bool merge_written_extents(extent_index_t* index) {
+    size_t num_merged = index->num_extents + index->num_recent;
+    written_extent_t* merged = realloc(index->extents, num_merged * sizeof(written_extent_t));
+    if (!merged) {
+        return false;
+    }
+
+    // Merge from the end, so that no range is overwritten before it's moved.
+    size_t i = index->num_extents;
+    size_t j = index->num_recent;
+    while (j > 0) {
+        if (i > 0 && merged[i - 1].phys_addr > index->recent[j - 1].phys_addr) {
+            merged[i + j - 1] = merged[i - 1];
+            i--;
+        } else {
+            merged[i + j - 1] = index->recent[j - 1];
+            j--;
+        }
+    }
+    index->extents = merged;
+    index->num_extents = num_merged;
+    index->num_recent = 0;
+    return true;
+}
+
+void add_written_extent(extent_index_t* index, uint64_t phys_addr, uint64_t length, char* path, uint64_t offset) {
+    if (index->num_recent == EXTENT_INDEX_RECENT_MAX && !merge_written_extents(index)) {
+        return;
+    }
+    if (!index->recent) {
+        index->recent = malloc(EXTENT_INDEX_RECENT_MAX * sizeof(written_extent_t));
+        if (!index->recent) {
+            return;
+        }
+    }
+    char* path_copy = malloc(strlen(path) + 1);
+    if (!path_copy) {
+        return;
+    }
+    strcpy(path_copy, path);
+
+    size_t pos = search_written_extents(index->recent, index->num_recent, phys_addr);
+    memmove(index->recent + pos + 1, index->recent + pos, (index->num_recent - pos) * sizeof(written_extent_t));
+    index->recent[pos].phys_addr    = phys_addr;
+    index->recent[pos].length       = length;
+    index->recent[pos].path         = path_copy;
+    index->recent[pos].offset       = offset;
+    index->num_recent++;
+}
+
+int copy_written_extent(extent_index_t* index, written_extent_t* source, uint64_t source_offset, uint64_t length, FILE* out, uint64_t dest_offset) {
+    int source_fd = open(source->path, O_RDONLY);
+    if (source_fd == -1) {
+        fprintf(stderr, "Could not open `%s` to copy shared data from it: %s.\n", source->path, strerror(errno));
+        return -1;
+    }
+    if (fflush(out) != 0) {
+        close(source_fd);
+        return -1;
+    }
+    int dest_fd = fileno(out);
+    uint64_t src_offset = source->offset + source_offset;
+    uint64_t done = 0;
+
+#ifdef FICLONERANGE
+    struct stat dest_stat;
+    if (fstat(dest_fd, &dest_stat) == 0 && dest_stat.st_blksize > 0) {
+        uint64_t alignment = dest_stat.st_blksize;
+        uint64_t clone_length = length - (length % alignment);
+        if (clone_length > 0 && src_offset % alignment == 0 && dest_offset % alignment == 0) {
+            struct file_clone_range range = {
+                .src_fd         = source_fd,
+                .src_offset     = src_offset,
+                .src_length     = clone_length,
+                .dest_offset    = dest_offset,
+            };
+            if (ioctl(dest_fd, FICLONERANGE, &range) == 0) {
+                done = clone_length;
+                index->bytes_cloned += clone_length;
+            }
+            // Otherwise, the host file system doesn't support cloning
+            // (or not across these files), so just copy the data.
+        }
+    }
+#endif
+
+    char* buffer = NULL;
+    if (done < length) {
+        size_t buffer_size = length - done < DSTREAM_MAX_READ_SIZE ? length - done : DSTREAM_MAX_READ_SIZE;
+        buffer = malloc(buffer_size);
+        if (!buffer) {
+            fprintf(stderr, "\nABORT: copy_written_extent: Could not allocate sufficient memory for `buffer`.\n");
+            close(source_fd);
+            return -1;
+        }
+
+        while (done < length) {
+            size_t piece = length - done < buffer_size ? length - done : buffer_size;
+            ssize_t num_read = pread(source_fd, buffer, piece, src_offset + done);
+            if (num_read <= 0) {
+                fprintf(stderr, "Could not read shared data from `%s`.\n", source->path);
+                goto onError;
+            }
+            if (pwrite(dest_fd, buffer, num_read, dest_offset + done) != num_read) {
+                fprintf(stderr, "Could not write shared data: %s.\n", strerror(errno));
+                goto onError;
+            }
+            done += num_read;
+            index->bytes_copied += num_read;
+        }
+    }
+
+    free(buffer);
+    close(source_fd);
+    // `pwrite()` and `ioctl()` don't move the file position
+    return fseeko(out, dest_offset + length, SEEK_SET);
+
+onError:
+    free(buffer);
+    close(source_fd);
+    return -1;
+}
+
+int write_dstream_indexed(
+    extent_index_t*     index,
+    file_extent_t*      extents,
+    size_t              num_extents,
+    uint64_t            size,
+    FILE*               out,
+    char*               output_path
+) {
+    char* buffer = NULL;
+
+    for (size_t i = 0; i < num_extents; i++) {
+        file_extent_t* extent = extents + i;
+        if (extent->logical_addr >= size) {
+            break;
+        }
+        if (extent->phys_block_num == 0) {
+            continue;
+        }
+
+        uint64_t length = extent->length;
+        if (length > size - extent->logical_addr) {
+            length = size - extent->logical_addr;
+        }
+
+        // Each part of the extent is either copied from where it was
+        // written before, or read from the container and recorded.
+        uint64_t extent_addr = extent->phys_block_num * nx_device->block_size;
+        for (uint64_t done = 0; done < length; ) {
+            uint64_t next_addr = 0;
+            written_extent_t* source = find_written_extent(index, extent_addr + done, &next_addr);
+            if (source) {
+                uint64_t source_offset = extent_addr + done - source->phys_addr;
+                uint64_t piece = source->length - source_offset < length - done ? source->length - source_offset : length - done;
+                if (copy_written_extent(index, source, source_offset, piece, out, extent->logical_addr + done) != 0) {
+                    goto onError;
+                }
+                done += piece;
+                continue;
+            }
+
+            uint64_t piece = next_addr - (extent_addr + done) < length - done ? next_addr - (extent_addr + done) : length - done;
+            if (fseeko(out, extent->logical_addr + done, SEEK_SET) != 0) {
+                fprintf(stderr, "\nERROR: write_dstream_indexed: Could not seek within `%s`: %s.\n", output_path, strerror(errno));
+                goto onError;
+            }
+            if (!buffer) {
+                buffer = malloc(DSTREAM_MAX_READ_SIZE);
+                if (!buffer) {
+                    fprintf(stderr, "\nABORT: write_dstream_indexed: Could not allocate sufficient memory for `buffer`.\n");
+                    goto onError;
+                }
+            }
+            for (uint64_t offset = 0; offset < piece; offset += DSTREAM_MAX_READ_SIZE) {
+                uint64_t chunk = piece - offset < DSTREAM_MAX_READ_SIZE ? piece - offset : DSTREAM_MAX_READ_SIZE;
+                if (read_dstream_range(extent, 1, extent->logical_addr + done + offset, chunk, buffer) != 0) {
+                    goto onError;
+                }
+                if (fwrite(buffer, chunk, 1, out) != 1) {
+                    fprintf(stderr, "\nERROR: write_dstream_indexed: Failed to write to `%s`.\n", output_path);
+                    goto onError;
+                }
+            }
+            add_written_extent(index, extent_addr + done, piece, output_path, extent->logical_addr + done);
+            done += piece;
+        }
+    }
+
+    // Extend the file over any trailing hole
+    free(buffer);
+    if (fflush(out) != 0 || ftruncate(fileno(out), size) != 0) {
+        fprintf(stderr, "\nERROR: write_dstream_indexed: Could not set the size of `%s`: %s.\n", output_path, strerror(errno));
+        return -1;
+    }
+    return 0;
+
+onError:
+    free(buffer);
+    return -1;
+}
+
+int get_file_data_extents(
+    btree_node_phys_t*  fs_omap_btree,
+    btree_node_phys_t*  fs_root_btree,
+    j_rec_t**           fs_records,
+    file_extent_t**     extents,
+    size_t*             num_extents,
+    uint64_t*           size
+) {
+    *extents = NULL;
+    *num_extents = 0;
+    *size = 0;
+
+    j_rec_t* inode_rec = get_inode_record(fs_records);
+    if (!inode_rec) {
+        fprintf(stderr, "Could not find an inode record for the specified path.\n");
+        return -1;
+    }
+
+    j_dstream_t* dstream = get_inode_dstream(inode_rec);
+    if (!dstream) {
+        return 0;
+    }
+    *size = dstream->size;
+
+    // A file's extents are keyed by its data stream ID (`private_id`), which
+    // is usually, but not necessarily, the same as its inode number.
+    j_inode_key_t* key = inode_rec->data;
+    j_inode_val_t* val = inode_rec->data + inode_rec->key_len;
+    j_rec_t** dstream_records = fs_records;
+    if (val->private_id != (key->hdr.obj_id_and_type & OBJ_ID_MASK)) {
+        dstream_records = get_fs_records(fs_omap_btree, fs_root_btree, val->private_id, (xid_t)(~0) );
+        if (!dstream_records) {
+            fprintf(stderr, "No records found for data stream 0x%llx.\n", val->private_id);
+            return -1;
+        }
+    }
+
+    *extents = get_file_extents(dstream_records, num_extents);
+    if (dstream_records != fs_records) {
+        free_j_rec_array(dstream_records);
+    }
+    return 0;
+}
+
+int write_file_data(
+    btree_node_phys_t*  fs_omap_btree,
+    btree_node_phys_t*  fs_root_btree,
+    j_rec_t**           fs_records,
+    extent_index_t*     extent_index,
+    FILE*               out,
+    char*               output_path
+) {
+    file_extent_t* extents = NULL;
+    size_t num_extents = 0;
+    uint64_t size = 0;
+    if (get_file_data_extents(fs_omap_btree, fs_root_btree, fs_records, &extents, &num_extents, &size) != 0) {
+        return -1;
+    }
+    if (size == 0) {
+        fprintf(stderr, "The file is empty.\n");
+        return 0;
+    }
+    if (!extents && size > 0) {
+        fprintf(stderr, "Could not find any file extents for the specified path; writing zeroes.\n");
+    }
+    fprintf(stderr, "The file is %llu bytes long, and has %lu extents.\n", size, num_extents);
+
+    int result = extent_index
+        ? write_dstream_indexed(extent_index, extents, num_extents, size, out, output_path)
+        : write_dstream(extents, num_extents, size, out);
+    free(extents);
+    return result;
+}
+
+int set_host_xattr(char* path, char* name, void* value, size_t size, uint32_t position) {
+#ifdef __APPLE__
+    return setxattr(path, name, value, size, position, XATTR_NOFOLLOW);
+#else
+    // Other platforms require a namespace prefix on attribute names, and only
+    // the `user` namespace is writable by unprivileged processes.
+    (void)position;
+    char* host_name = malloc(strlen("user.") + strlen(name) + 1);
+    if (!host_name) {
+        errno = ENOMEM;
+        return -1;
+    }
+    sprintf(host_name, "user.%s", name);
+    int result = lsetxattr(path, host_name, value, size, 0);
+    free(host_name);
+    return result;
+#endif
+}
+
+int restore_xattr_dstream(
+    btree_node_phys_t*  fs_omap_btree,
+    btree_node_phys_t*  fs_root_btree,
+    j_rec_t*            xattr_rec,
+    char*               output_path
+) {
+    j_xattr_key_t* key = xattr_rec->data;
+    char* name = (char*)key->name;
+
+    size_t num_extents = 0;
+    uint64_t size = 0;
+    file_extent_t* extents = get_xattr_dstream_extents(fs_omap_btree, fs_root_btree, xattr_rec, &num_extents, &size);
+    if (!extents && size != 0) {
+        fprintf(stderr, "Could not find any extents for extended attribute `%s`.\n", name);
+        return -1;
+    }
+
+    uint64_t piece_size = size;
+#ifdef __APPLE__
+    if (strcmp(name, RESOURCE_FORK_XATTR_NAME) == 0 && piece_size > DSTREAM_MAX_READ_SIZE) {
+        piece_size = DSTREAM_MAX_READ_SIZE;
+    }
+#endif
+
+    char* buffer = malloc(piece_size ? piece_size : 1);
+    if (!buffer) {
+        fprintf(stderr, "\nABORT: restore_xattr_dstream: Could not allocate sufficient memory for `buffer`.\n");
+        free(extents);
+        return -1;
+    }
+
+    uint64_t offset = 0;
+    do {
+        uint64_t length = size - offset < piece_size ? size - offset : piece_size;
+        if (read_dstream_range(extents, num_extents, offset, length, buffer) != 0) {
+            fprintf(stderr, "Could not read the value of extended attribute `%s`.\n", name);
+            goto onError;
+        }
+        if (set_host_xattr(output_path, name, buffer, length, offset) != 0) {
+            fprintf(stderr, "Could not restore extended attribute `%s`: %s.\n", name, strerror(errno));
+            goto onError;
+        }
+        offset += length;
+    } while (offset < size);
+
+    free(buffer);
+    free(extents);
+    return 0;
+
+onError:
+    free(buffer);
+    free(extents);
+    return -1;
+}
+
+int restore_xattrs(
+    btree_node_phys_t*  fs_omap_btree,
+    btree_node_phys_t*  fs_root_btree,
+    j_rec_t**           fs_records,
+    bool                skip_decmpfs,
+    char*               output_path
+) {
+    int num_failed = 0;
+
+    for (j_rec_t** fs_rec_cursor = fs_records; *fs_rec_cursor; fs_rec_cursor++) {
+        j_rec_t* fs_rec = *fs_rec_cursor;
+        j_key_t* hdr = fs_rec->data;
+        if ( ((hdr->obj_id_and_type & OBJ_TYPE_MASK) >> OBJ_TYPE_SHIFT)  !=  APFS_TYPE_XATTR ) {
+            continue;
+        }
+
+        j_xattr_key_t* key = fs_rec->data;
+        j_xattr_val_t* val = fs_rec->data + fs_rec->key_len;
+        char* name = (char*)key->name;
+
+        // Attributes owned by the file system, such as symlink targets,
+        // aren't visible as extended attributes on a mounted volume.
+        if (val->flags & XATTR_FILE_SYSTEM_OWNED) {
+            continue;
+        }
+        if (skip_decmpfs && (strcmp(name, DECMPFS_XATTR_NAME) == 0 || strcmp(name, RESOURCE_FORK_XATTR_NAME) == 0)) {
+            continue;
+        }
+
+        if (val->flags & XATTR_DATA_EMBEDDED) {
+            if (set_host_xattr(output_path, name, val->xdata, val->xdata_len, 0) != 0) {
+                fprintf(stderr, "Could not restore extended attribute `%s`: %s.\n", name, strerror(errno));
+                num_failed++;
+            }
+        } else if (restore_xattr_dstream(fs_omap_btree, fs_root_btree, fs_rec, output_path) != 0) {
+            num_failed++;
+        }
+    }
+
+    return num_failed;
+}
+
+void free_hard_link(void* hard_link) {
+    free(((hard_link_t*)hard_link)->path);
+    free(hard_link);
+}
+
+uint32_t count_sibling_links(j_rec_t** fs_records) {
+    uint32_t count = 0;
+    for (j_rec_t** fs_rec_cursor = fs_records; *fs_rec_cursor; fs_rec_cursor++) {
+        j_key_t* hdr = (*fs_rec_cursor)->data;
+        if ( ((hdr->obj_id_and_type & OBJ_TYPE_MASK) >> OBJ_TYPE_SHIFT)  ==  APFS_TYPE_SIBLING_LINK ) {
+            count++;
+        }
+    }
+    return count;
+}
+
+char* join_path(char* dir_path, char* name) {
+    char* path = malloc(strlen(dir_path) + 1 + strlen(name) + 1);
+    if (!path) {
+        fprintf(stderr, "\nABORT: join_path: Could not allocate sufficient memory for `path`.\n");
+        return NULL;
+    }
+    sprintf(path, "%s/%s", dir_path, name);
+    return path;
+}
+
+int recover_file(recovery_t* recovery, j_rec_t** fs_records, char* output_path) {
+    FILE* out = fopen(output_path, "wb");
+    if (!out) {
+        fprintf(stderr, "Could not open `%s` for writing: %s.\n", output_path, strerror(errno));
+        return -1;
+    }
+
+    // Transparently compressed files keep their data in the `com.apple.decmpfs`
+    // extended attribute or in their resource fork, rather than in file extents.
+    j_rec_t* decmpfs_rec = get_decmpfs_xattr_record(fs_records);
+    int result = decmpfs_rec
+        ? write_compressed_file(recovery->fs_omap_btree, recovery->fs_root_btree, fs_records, decmpfs_rec, out)
+        : write_file_data(recovery->fs_omap_btree, recovery->fs_root_btree, fs_records, &recovery->extent_index, out, output_path);
+
+    if (fclose(out) != 0) {
+        fprintf(stderr, "Could not finish writing `%s`: %s.\n", output_path, strerror(errno));
+        return -1;
+    }
+    if (result < 0) {
+        return result;
+    }
+
+    // Restore the extended attributes from the records we already have,
+    // in the same pass as writing the data.
+    int num_failed = restore_xattrs(recovery->fs_omap_btree, recovery->fs_root_btree, fs_records, decmpfs_rec != NULL, output_path);
+    if (num_failed > 0) {
+        fprintf(stderr, "%d extended attributes of `%s` could not be restored.\n", num_failed, output_path);
+        result = 1;
+    }
+    return result;
+}
+
+int recover_symlink(recovery_t* recovery, j_rec_t** fs_records, char* output_path) {
+    j_rec_t* target_rec = get_xattr_record(fs_records, SYMLINK_EA_NAME);
+    if (!target_rec) {
+        fprintf(stderr, "The symlink `%s` has no target.\n", output_path);
+        return -1;
+    }
+
+    uint64_t target_len = 0;
+    char* target = get_xattr_value(recovery->fs_omap_btree, recovery->fs_root_btree, target_rec, &target_len);
+    if (!target) {
+        return -1;
+    }
+
+    // The stored target usually includes a terminating NULL byte, but
+    // don't rely on that.
+    char* terminated_target = malloc(target_len + 1);
+    if (!terminated_target) {
+        fprintf(stderr, "\nABORT: recover_symlink: Could not allocate sufficient memory for `terminated_target`.\n");
+        free(target);
+        return -1;
+    }
+    memcpy(terminated_target, target, target_len);
+    terminated_target[target_len] = '\0';
+    free(target);
+
+    int result = symlink(terminated_target, output_path);
+    if (result != 0) {
+        fprintf(stderr, "Could not create symlink `%s`: %s.\n", output_path, strerror(errno));
+    }
+    free(terminated_target);
+    return result;
+}
+
+int recover_dir_entry(recovery_t* recovery, oid_t file_id, char* output_path) {
+    hard_link_t* hard_link = oid_map_get(recovery->hard_links, file_id);
+    if (hard_link) {
+        fprintf(stderr, "- %s (hard link to `%s`)\n", output_path, hard_link->path);
+        if (link(hard_link->path, output_path) != 0) {
+            fprintf(stderr, "Could not create hard link `%s`: %s.\n", output_path, strerror(errno));
+            return -1;
+        }
+        recovery->num_hard_links++;
+
+        if (--hard_link->links_remaining == 0) {
+            free_hard_link(oid_map_remove(recovery->hard_links, file_id));
+        }
+        return 0;
+    }
+
+    j_rec_t** fs_records = get_fs_records(recovery->fs_omap_btree, recovery->fs_root_btree, file_id, (xid_t)(~0) );
+    if (!fs_records) {
+        fprintf(stderr, "No records found for file-system object 0x%llx, which should be at `%s`.\n", file_id, output_path);
+        return -1;
+    }
+    int result = recover_fs_object(recovery, fs_records, output_path);
+    free_j_rec_array(fs_records);
+    return result;
+}
+
+int recover_directory(recovery_t* recovery, j_rec_t** fs_records, char* output_path) {
+    // Create the directory with full permissions for now, so that its
+    // descendants can be written; its own mode is set afterwards.
+    if (mkdir(output_path, 0700) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Could not create directory `%s`: %s.\n", output_path, strerror(errno));
+        return -1;
+    }
+
+    int result = 0;
+    for (j_rec_t** fs_rec_cursor = fs_records; *fs_rec_cursor; fs_rec_cursor++) {
+        j_rec_t* fs_rec = *fs_rec_cursor;
+        j_key_t* hdr = fs_rec->data;
+        if ( ((hdr->obj_id_and_type & OBJ_TYPE_MASK) >> OBJ_TYPE_SHIFT)  !=  APFS_TYPE_DIR_REC ) {
+            continue;
+        }
+
+        j_drec_hashed_key_t*    key = fs_rec->data;
+        j_drec_val_t*           val = fs_rec->data + fs_rec->key_len;
+
+        char* child_path = join_path(output_path, (char*)key->name);
+        if (!child_path) {
+            return -1;
+        }
+        if (recover_dir_entry(recovery, val->file_id, child_path) != 0) {
+            recovery->num_failed++;
+            result = 1;
+        }
+        free(child_path);
+    }
+    return result;
+}
+
+int recover_fs_object(recovery_t* recovery, j_rec_t** fs_records, char* output_path) {
+    j_rec_t* inode_rec = get_inode_record(fs_records);
+    if (!inode_rec) {
+        fprintf(stderr, "Could not find an inode record for `%s`.\n", output_path);
+        return -1;
+    }
+    j_inode_key_t* key = inode_rec->data;
+    j_inode_val_t* val = inode_rec->data + inode_rec->key_len;
+    oid_t inode_id = key->hdr.obj_id_and_type & OBJ_ID_MASK;
+
+    int result;
+    switch (val->mode & S_IFMT) {
+        case S_IFDIR:
+            fprintf(stderr, "- %s/\n", output_path);
+            result = recover_directory(recovery, fs_records, output_path);
+            recovery->num_dirs++;
+            break;
+        case S_IFREG: {
+            fprintf(stderr, "- %s\n", output_path);
+            result = recover_file(recovery, fs_records, output_path);
+            if (result < 0) {
+                break;
+            }
+            recovery->num_files++;
+
+            // The inode's sibling links tell us how many directory entries
+            // refer to it; remember where we wrote it until we've seen them all.
+            uint32_t num_links = count_sibling_links(fs_records);
+            if (num_links < (uint32_t)val->nlink) {
+                num_links = val->nlink;
+            }
+            if (num_links > 1) {
+                hard_link_t* hard_link = malloc(sizeof(hard_link_t));
+                char* path = malloc(strlen(output_path) + 1);
+                if (!hard_link || !path || !oid_map_put(recovery->hard_links, inode_id, hard_link)) {
+                    fprintf(stderr, "\nABORT: recover_fs_object: Could not allocate sufficient memory to track hard link `%s`.\n", output_path);
+                    free(hard_link);
+                    free(path);
+                    return -1;
+                }
+                strcpy(path, output_path);
+                hard_link->path = path;
+                hard_link->links_remaining = num_links - 1;
+            }
+        } break;
+        case S_IFLNK:
+            fprintf(stderr, "- %s (symlink)\n", output_path);
+            result = recover_symlink(recovery, fs_records, output_path);
+            if (result == 0) {
+                recovery->num_symlinks++;
+            }
+            // Symlinks have no permissions of their own to restore.
+            return result;
+        default:
+            fprintf(stderr, "- %s: skipping, as it is not a regular file, directory, or symlink (mode %#o).\n", output_path, val->mode);
+            return 0;
+    }
+
+    if (chmod(output_path, val->mode & 07777) != 0) {
+        fprintf(stderr, "Could not set the permissions of `%s`: %s.\n", output_path, strerror(errno));
+    }
+    return result;
+}
+
+int make_parent_directories(char* path, size_t base_len) {
+    for (char* slash = strchr(path + base_len + 1, '/'); slash; slash = strchr(slash + 1, '/')) {
+        *slash = '\0';
+        bool failed = mkdir(path, 0755) != 0 && errno != EEXIST;
+        if (failed) {
+            fprintf(stderr, "Could not create directory `%s`: %s.\n", path, strerror(errno));
+        }
+        *slash = '/';
+        if (failed) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * A changed directory whose permissions are set once everything beneath it
+ * has been recovered.
+ */
+typedef struct {
+    char*   path;
+    mode_t  mode;
+} pending_dir_t;
+
+int compare_pending_dirs_deepest_first(const void* a, const void* b) {
+    // A directory's path sorts before those of its descendants, so reverse
+    // the order to visit descendants first.
+    return strcmp(((const pending_dir_t*)b)->path, ((const pending_dir_t*)a)->path);
+}
+
+/**
+ * Recover an object found by `recover_changed_since()` to its path relative to
+ * `dir_id` beneath `output_path`. Objects that aren't beneath that directory
+ * are skipped.
+ *
+ * dir:         If the object is a directory, it is created, and its path and
+ *      permissions are stored here, to be set once its descendants have been
+ *      recovered; otherwise, `dir->path` is set to NULL.
+ *
+ * is_dstream:  Set to whether the object has no inode record, but has records
+ *      of a data stream, e.g. one shared by a clone.
+ *
+ * RETURN VALUE:
+ *      Zero on success or if the object was skipped, a positive value if it
+ *      could not be recovered, or a negative value on failure.
+ */
+int recover_changed_object(recovery_t* recovery, oid_t oid, oid_t dir_id, char* output_path, pending_dir_t* dir, bool* is_dstream) {
+    dir->path = NULL;
+    *is_dstream = false;
+
+    j_rec_t** fs_records = get_fs_records(recovery->fs_omap_btree, recovery->fs_root_btree, oid, (xid_t)(~0));
+    if (!fs_records) {
+        return 0;
+    }
+    j_rec_t* inode_rec = get_inode_record(fs_records);
+    if (!inode_rec) {
+        // The records of a data stream are grouped under its own ID, which
+        // only differs from its file's inode number for clones and the like.
+        for (j_rec_t** rec = fs_records; *rec; rec++) {
+            j_key_t* hdr = (*rec)->data;
+            uint8_t type = (hdr->obj_id_and_type & OBJ_TYPE_MASK) >> OBJ_TYPE_SHIFT;
+            if (type == APFS_TYPE_FILE_EXTENT || type == APFS_TYPE_DSTREAM_ID) {
+                *is_dstream = true;
+                break;
+            }
+        }
+        free_j_rec_array(fs_records);
+        return 0;
+    }
+
+    char* rel_path = get_fs_object_relative_path(recovery->fs_omap_btree, recovery->fs_root_btree, oid, dir_id, (xid_t)(~0));
+    if (!rel_path) {
+        free_j_rec_array(fs_records);
+        return 0;
+    }
+    size_t base_len = strlen(output_path);
+    char* path = malloc(base_len + strlen(rel_path) + 1);
+    if (!path) {
+        fprintf(stderr, "\nABORT: recover_changed_object: Could not allocate sufficient memory for `path`.\n");
+        free(rel_path);
+        free_j_rec_array(fs_records);
+        return -1;
+    }
+    sprintf(path, "%s%s", output_path, rel_path);
+    free(rel_path);
+
+    int result = 0;
+    j_inode_val_t* val = inode_rec->data + inode_rec->key_len;
+    if (make_parent_directories(path, base_len) != 0) {
+        recovery->num_failed++;
+        result = 1;
+    } else if ((val->mode & S_IFMT) == S_IFDIR) {
+        // Only the directory itself changed; its unchanged contents
+        // aren't recovered.
+        fprintf(stderr, "- %s/\n", path);
+        if (mkdir(path, 0700) != 0 && errno != EEXIST) {
+            fprintf(stderr, "Could not create directory `%s`: %s.\n", path, strerror(errno));
+            recovery->num_failed++;
+            result = 1;
+        } else {
+            recovery->num_dirs++;
+            dir->path = path;
+            dir->mode = val->mode & 07777;
+            path = NULL;
+        }
+    } else if (recover_fs_object(recovery, fs_records, path) != 0) {
+        recovery->num_failed++;
+        result = 1;
+    }
+    free(path);
+    free_j_rec_array(fs_records);
+    return result;
+}
+
+int recover_changed_since(recovery_t* recovery, oid_t dir_id, char* output_path, xid_t since_xid) {
+    if (mkdir(output_path, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Could not create directory `%s`: %s.\n", output_path, strerror(errno));
+        return -1;
+    }
+
+    changed_set_t* changed = get_fs_objects_changed_since(recovery->fs_omap_btree, recovery->fs_root_btree, since_xid);
+    if (!changed) {
+        return -1;
+    }
+    fprintf(stderr, "Read %llu nodes of the file-system tree, skipping %llu unchanged subtrees; records of %zu objects may have changed.\n",
+        changed->nodes_read, changed->subtrees_skipped, changed->num_oids
+    );
+
+    pending_dir_t* dirs = malloc(changed->num_oids * sizeof(pending_dir_t));
+    oid_t* dstream_ids = malloc(changed->num_oids * sizeof(oid_t));
+    size_t num_dirs = 0;
+    size_t num_dstream_ids = 0;
+    if ((!dirs || !dstream_ids) && changed->num_oids > 0) {
+        fprintf(stderr, "\nABORT: recover_changed_since: Could not allocate sufficient memory for `dirs`.\n");
+        free(dirs);
+        free(dstream_ids);
+        changed_set_free(changed);
+        return -1;
+    }
+
+    int result = 0;
+    for (size_t i = 0; i < changed->num_oids && result >= 0; i++) {
+        oid_t oid = changed->oids[i];
+        if (oid == dir_id) {
+            continue;
+        }
+        bool is_dstream = false;
+        int object_result = recover_changed_object(recovery, oid, dir_id, output_path, dirs + num_dirs, &is_dstream);
+        if (object_result != 0) {
+            result = object_result;
+        }
+        if (dirs[num_dirs].path) {
+            num_dirs++;
+        }
+        if (is_dstream) {
+            // Changed IDs are sorted, so these are too.
+            dstream_ids[num_dstream_ids++] = oid;
+        }
+    }
+
+    // The files whose data streams changed are found by reading the inode
+    // records of the whole tree, which is only needed for clones and the like.
+    if (result >= 0 && num_dstream_ids > 0) {
+        fprintf(stderr, "Looking for the files that own %zu changed data streams ...\n", num_dstream_ids);
+        changed_set_t* owners = get_fs_dstream_owners(recovery->fs_omap_btree, recovery->fs_root_btree, dstream_ids, num_dstream_ids);
+        pending_dir_t* grown = owners ? realloc(dirs, (num_dirs + owners->num_oids + 1) * sizeof(pending_dir_t)) : NULL;
+        if (!owners) {
+            result = -1;
+        } else if (!grown) {
+            fprintf(stderr, "\nABORT: recover_changed_since: Could not allocate sufficient memory for `dirs`.\n");
+            result = -1;
+        } else {
+            dirs = grown;
+            for (size_t i = 0; i < owners->num_oids && result >= 0; i++) {
+                oid_t oid = owners->oids[i];
+                if (oid == dir_id || is_fs_object_changed(changed, oid)) {
+                    continue;
+                }
+                bool is_dstream = false;
+                int object_result = recover_changed_object(recovery, oid, dir_id, output_path, dirs + num_dirs, &is_dstream);
+                if (object_result != 0) {
+                    result = object_result;
+                }
+                if (dirs[num_dirs].path) {
+                    num_dirs++;
+                }
+            }
+        }
+        changed_set_free(owners);
+    }
+
+    qsort(dirs, num_dirs, sizeof(pending_dir_t), compare_pending_dirs_deepest_first);
+    for (size_t i = 0; i < num_dirs; i++) {
+        if (chmod(dirs[i].path, dirs[i].mode) != 0) {
+            fprintf(stderr, "Could not set the permissions of `%s`: %s.\n", dirs[i].path, strerror(errno));
+        }
+        free(dirs[i].path);
+    }
+    free(dirs);
+    free(dstream_ids);
+    changed_set_free(changed);
+    return result;
+}
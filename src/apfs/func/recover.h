@@ -0,0 +1,403 @@
+/**
+ * Functions used to recover file-system objects from a volume, i.e. to write
+ * their data, extended attributes, and (for directories) their contents to
+ * the host file system.
+ */
+
+#ifndef APFS_FUNC_RECOVER_H
+#define APFS_FUNC_RECOVER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/errno.h>
+#include <sys/xattr.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <linux/fs.h>   // for `FICLONERANGE`
+#endif
+
+#include "../struct/j.h"
+#include "../struct/dstream.h"
+#include "../struct/sibling.h"
+#include "../struct/decmpfs.h"
+
+#include "btree.h"
+#include "j.h"
+#include "dstream.h"
+#include "xattr.h"
+#include "decmpfs.h"
+#include "oid_map.h"
+#include "changed.h"
+
+/**
+ * Get the `com.apple.decmpfs` extended attribute record of a file-system
+ * object, if the object is a transparently compressed file.
+ *
+ * RETURN VALUE:
+ *      A pointer to the record within `fs_records`, or NULL if the object
+ *      isn't compressed or has no such extended attribute.
+ */
+j_rec_t* get_decmpfs_xattr_record(j_rec_t** fs_records);
+
+/**
+ * Decompress a transparently compressed file and write its data to `out`.
+ *
+ * RETURN VALUE:
+ *      Zero on success, a positive value if some of the data could not be
+ *      decompressed (and was written as zeroes), or a negative value if the
+ *      data could not be written at all.
+ */
+int write_compressed_file(
+    btree_node_phys_t*  fs_omap_btree,
+    btree_node_phys_t*  fs_root_btree,
+    j_rec_t**           fs_records,
+    j_rec_t*            decmpfs_rec,
+    FILE*               out
+);
+
+/** Recovery constants **/
+
+#define EXTENT_INDEX_RECENT_MAX     4096    // Ranges added before `recent` is merged into `extents`
+
+/**
+ * A range of the container whose data has already been written to an output
+ * file during a recovery.
+ *
+ * phys_addr:   The byte address within the container where the range starts.
+ *
+ * length:      The length of the range, in bytes.
+ *
+ * path:        The output file which the range's data was written to.
+ *
+ * offset:      The offset within that file where the range's data starts.
+ */
+typedef struct {
+    uint64_t    phys_addr;
+    uint64_t    length;
+    char*       path;
+    uint64_t    offset;
+} written_extent_t;
+
+/**
+ * An index of the ranges of the container whose data has already been written
+ * to the output during a recovery, so that data shared between files (e.g. by
+ * clones) is only read from the container once, even where a file shares only
+ * part of another's extent.
+ *
+ * extents:         The ranges written so far, sorted by address. No two ranges
+ *      in the index overlap.
+ *
+ * recent:          The ranges written most recently, likewise sorted. They are
+ *      merged into `extents` once there are `EXTENT_INDEX_RECENT_MAX` of them,
+ *      so that adding a range doesn't move the whole index.
+ *
+ * bytes_cloned:    Number of bytes that were recreated by cloning
+ *      (reflinking) a range of an already-written file.
+ *
+ * bytes_copied:    Number of bytes that were copied from an already-written
+ *      file, where cloning wasn't possible.
+ */
+typedef struct {
+    written_extent_t*   extents;
+    size_t              num_extents;
+    written_extent_t*   recent;
+    size_t              num_recent;
+
+    uint64_t    bytes_cloned;
+    uint64_t    bytes_copied;
+} extent_index_t;
+
+void extent_index_free(extent_index_t* index);
+
+/**
+ * Find the written range that contains a given byte address of the container.
+ *
+ * next_addr:   If no range contains the address, the address where the next
+ *      range after it starts will be stored here, or `UINT64_MAX` if there's
+ *      none.
+ *
+ * RETURN VALUE:
+ *      A pointer to the range, which is only valid until the next range is
+ *      added; or NULL if no range contains the address.
+ */
+written_extent_t* find_written_extent(extent_index_t* index, uint64_t phys_addr, uint64_t* next_addr);
+
+/**
+ * Record that a range of the container, which doesn't overlap any range in
+ * the index, was written to a given output file. Failure to do so isn't
+ * fatal; the range will just be read again if it is encountered again.
+ */
+void add_written_extent(extent_index_t* index, uint64_t phys_addr, uint64_t length, char* path, uint64_t offset);
+
+/**
+ * Recreate `length` bytes at `dest_offset` in the file `out`, using the data
+ * that was previously written for the range `source`, starting
+ * `source_offset` bytes into it. Where the platform and the host file system
+ * support it, the block-aligned part of the range is cloned (reflinked), so
+ * that no data is copied at all; the rest is copied from the file that
+ * `source` was written to, which doesn't involve reading the container.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value if an error occurs.
+ */
+int copy_written_extent(extent_index_t* index, written_extent_t* source, uint64_t source_offset, uint64_t length, FILE* out, uint64_t dest_offset);
+
+/**
+ * Write the whole of a data stream to `out`, like `write_dstream()`, but
+ * consult and update an index of already-written ranges, so that data shared
+ * with previously recovered files, in whole extents or in parts of them, is
+ * cloned or copied from them rather than read from the container again. Holes and sparse extents are
+ * skipped over rather than written, so the output file is sparse too.
+ *
+ * output_path:     The path of the file `out`, to be recorded in the index.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value if an error occurs.
+ */
+int write_dstream_indexed(
+    extent_index_t*     index,
+    file_extent_t*      extents,
+    size_t              num_extents,
+    uint64_t            size,
+    FILE*               out,
+    char*               output_path
+);
+
+/**
+ * Get the file extents and logical size of the data stream of an uncompressed
+ * file.
+ *
+ * extents:     A pointer to an array of the file's extents, sorted by logical
+ *      address, will be stored here; or NULL if the file has no extents. This
+ *      array must be freed when no longer needed.
+ *
+ * num_extents: The number of extents will be stored here.
+ *
+ * size:        The logical size of the file will be stored here; zero if the
+ *      file has no data stream.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value if an error occurs.
+ */
+int get_file_data_extents(
+    btree_node_phys_t*  fs_omap_btree,
+    btree_node_phys_t*  fs_root_btree,
+    j_rec_t**           fs_records,
+    file_extent_t**     extents,
+    size_t*             num_extents,
+    uint64_t*           size
+);
+
+/**
+ * Write the data of an uncompressed file to `out`.
+ *
+ * extent_index:    If not NULL, an index of the extents that have already been
+ *      written, which will be consulted and updated; see
+ *      `write_dstream_indexed()`. In this case, `output_path` must be the path
+ *      of the file `out`.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value if an error occurs.
+ */
+int write_file_data(
+    btree_node_phys_t*  fs_omap_btree,
+    btree_node_phys_t*  fs_root_btree,
+    j_rec_t**           fs_records,
+    extent_index_t*     extent_index,
+    FILE*               out,
+    char*               output_path
+);
+
+/**
+ * Set an extended attribute of a file in the host file system. Symlinks are
+ * not followed.
+ *
+ * position:    The offset within the attribute's value at which to write
+ *      `value`. This must be zero, except for the resource fork on macOS.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or -1 on failure, in which case `errno` is set.
+ */
+int set_host_xattr(char* path, char* name, void* value, size_t size, uint32_t position);
+
+/**
+ * Restore an extended attribute whose value is stored in a data stream. The
+ * value is read with as few large reads as possible. On macOS, the resource
+ * fork, which can be arbitrarily large, is written in pieces of at most
+ * `DSTREAM_MAX_READ_SIZE` bytes; other values are written in one piece.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value if an error occurs.
+ */
+int restore_xattr_dstream(
+    btree_node_phys_t*  fs_omap_btree,
+    btree_node_phys_t*  fs_root_btree,
+    j_rec_t*            xattr_rec,
+    char*               output_path
+);
+
+/**
+ * Restore the extended attributes of a file-system object onto a file in the
+ * host file system. This uses the records that were already fetched in order
+ * to write the object's data, so the file-system tree is only consulted again
+ * for the extents of attributes that are stored in data streams.
+ *
+ * skip_decmpfs:    If true, the `com.apple.decmpfs` and `com.apple.ResourceFork`
+ *      attributes are not restored. This is used for compressed files, whose
+ *      data has already been written in decompressed form.
+ *
+ * RETURN VALUE:
+ *      The number of extended attributes that could not be restored.
+ */
+int restore_xattrs(
+    btree_node_phys_t*  fs_omap_btree,
+    btree_node_phys_t*  fs_root_btree,
+    j_rec_t**           fs_records,
+    bool                skip_decmpfs,
+    char*               output_path
+);
+
+/**
+ * State kept whilst recovering a file-system object and, if it is a directory,
+ * its descendants.
+ *
+ * hard_links:  Maps the inode number of each hard-linked file that has been
+ *      written so far to a `hard_link_t`. Further directory entries for the
+ *      same inode are then recreated with `link()`, without fetching the
+ *      inode's records or reading its data again.
+ *
+ * extent_index:    The ranges of the container written so far, so that data
+ *      shared between files (e.g. clones) is only read once. It starts out
+ *      zeroed, and is freed with `extent_index_free()`.
+ */
+typedef struct {
+    btree_node_phys_t*  fs_omap_btree;
+    btree_node_phys_t*  fs_root_btree;
+    oid_map_t*          hard_links;
+    extent_index_t      extent_index;
+
+    uint64_t    num_files;
+    uint64_t    num_dirs;
+    uint64_t    num_symlinks;
+    uint64_t    num_hard_links;
+    uint64_t    num_failed;
+} recovery_t;
+
+/**
+ * path:            The path that the hard-linked file was first written to.
+ *
+ * links_remaining: The number of links to the file that have not yet been
+ *      recreated. Once this reaches zero, the entry is removed from
+ *      `recovery_t.hard_links`, so that the map only holds files whose
+ *      siblings may still be encountered.
+ */
+typedef struct {
+    char*       path;
+    uint32_t    links_remaining;
+} hard_link_t;
+
+void free_hard_link(void* hard_link);
+
+/**
+ * Count the sibling links (i.e. hard links) listed amongst a given array of
+ * file-system records for an inode.
+ */
+uint32_t count_sibling_links(j_rec_t** fs_records);
+
+/**
+ * Join a directory path and a file name with a `/`.
+ *
+ * RETURN VALUE:
+ *      The joined path, which must be freed when no longer needed; or NULL if
+ *      memory could not be allocated.
+ */
+char* join_path(char* dir_path, char* name);
+
+/**
+ * Write a regular file, including its extended attributes, to `output_path`.
+ *
+ * RETURN VALUE:
+ *      Zero on success, a positive value if the file was written but some of
+ *      its data or extended attributes could not be recovered, or a negative
+ *      value if the file could not be written.
+ */
+int recover_file(recovery_t* recovery, j_rec_t** fs_records, char* output_path);
+
+/**
+ * Recreate a symbolic link at `output_path`.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value if an error occurs.
+ */
+int recover_symlink(recovery_t* recovery, j_rec_t** fs_records, char* output_path);
+
+/**
+ * Recover a directory entry, i.e. the file-system object with inode number
+ * `file_id`, to `output_path`. If the object is a hard-linked file that has
+ * already been written, it is linked to rather than written again.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a non-zero value if an error occurs.
+ */
+int recover_dir_entry(recovery_t* recovery, oid_t file_id, char* output_path);
+
+/**
+ * Recreate a directory at `output_path`, and recover all of its descendants.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a non-zero value if the directory or any of its
+ *      descendants could not be recovered.
+ */
+int recover_directory(recovery_t* recovery, j_rec_t** fs_records, char* output_path);
+
+/**
+ * Recover a file-system object, given its records, to `output_path`.
+ * Directories are recovered recursively.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a non-zero value if the object or any of its
+ *      descendants could not be recovered.
+ */
+int recover_fs_object(recovery_t* recovery, j_rec_t** fs_records, char* output_path);
+
+/**
+ * Create each missing directory in `path` after the first `base_len`
+ * characters, up to but excluding the last component of `path`.
+ * Directories are created with mode 0755.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value if a directory could not be
+ *      created.
+ */
+int make_parent_directories(char* path, size_t base_len);
+
+/**
+ * Recover only the descendants of a directory that have changed since a given
+ * transaction, to their relative paths beneath `output_path`, without reading
+ * the parts of the file-system tree that haven't changed; see
+ * `apfs/func/changed.h`. Changed files and symlinks are recovered in full;
+ * changed directories are created, but their contents are only recovered if
+ * they have changed too. Parent directories that haven't changed are created
+ * as needed, with default permissions.
+ *
+ * Objects that were deleted since the transaction aren't recovered, as their
+ * records no longer exist; nor are objects whose only change was the removal
+ * of some of their records. The extent records of a clone are keyed by the ID
+ * of its data stream rather than of the file, so if any changed IDs are those
+ * of data streams, the whole tree is then read to find the files that own them
+ * (see `get_fs_dstream_owners()`), which are recovered too.
+ *
+ * dir_id:      The inode number of the directory.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a non-zero value if any of the changed objects
+ *      could not be recovered.
+ */
+int recover_changed_since(recovery_t* recovery, oid_t dir_id, char* output_path, xid_t since_xid);
+
+#endif // APFS_FUNC_RECOVER_H
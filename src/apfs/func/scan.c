@@ -0,0 +1,274 @@
+#include "scan.h"
+
+/**
+ * The state of a scan, shared by its threads.
+ *
+ * next_addr:   The address of the next chunk to be claimed by a thread.
+ *
+ * cancelled:   Whether the callback has stopped the scan.
+ *
+ * failed:      Whether a thread couldn't allocate its buffers.
+ *
+ * free_map:    If not NULL, only the blocks that this map reports as free are
+ *      scanned.
+ */
+typedef struct {
+    nx_device_t*    device;
+    paddr_t         next_addr;
+    paddr_t         end_addr;
+    bool            cancelled;
+    bool            failed;
+
+    allocation_map_t*   free_map;
+    bool            find_signatures;
+
+    scan_callback_t callback;
+    void*           context;
+    scan_stats_t    stats;
+    pthread_mutex_t lock;
+} scan_state_t;
+
+/**
+ * Read a chunk of blocks. If the chunk can't be read in one go, e.g. due to a
+ * bad sector, it is read one block at a time instead, and the blocks that
+ * can't be read are zeroed, so that they fail checksum validation.
+ *
+ * RETURN VALUE:
+ *      The number of blocks read, which is less than `num_blocks` if the end of
+ *      the container was reached.
+ */
+size_t scan_read_chunk(char* chunk, paddr_t addr, size_t num_blocks, uint64_t* num_unreadable) {
+    size_t num_read = read_blocks(chunk, addr, num_blocks);
+    if (num_read != (size_t)(-1)) {
+        return num_read;
+    }
+
+    for (num_read = 0; num_read < num_blocks; num_read++) {
+        char* block = chunk + num_read * nx_device->block_size;
+        size_t result = read_blocks(block, addr + num_read, 1);
+        if (result == 0) {
+            break;
+        }
+        if (result != 1) {
+            memset(block, 0, nx_device->block_size);
+            (*num_unreadable)++;
+        }
+    }
+    return num_read;
+}
+
+/**
+ * A file signature: bytes that files of a given format have at a given offset
+ * from their start.
+ */
+typedef struct {
+    uint32_t    signature;
+    const char* name;
+    uint32_t    offset;
+    uint32_t    length;
+    const char* bytes;
+} file_signature_t;
+
+const file_signature_t file_signatures[] = {
+    { SCAN_SIGNATURE_JPEG,      "JPEG",     0,  3,  "\xff\xd8\xff" },
+    { SCAN_SIGNATURE_PNG,       "PNG",      0,  8,  "\x89PNG\r\n\x1a\n" },
+    { SCAN_SIGNATURE_GIF,       "GIF",      0,  4,  "GIF8" },
+    { SCAN_SIGNATURE_PDF,       "PDF",      0,  5,  "%PDF-" },
+    { SCAN_SIGNATURE_ZIP,       "ZIP",      0,  4,  "PK\x03\x04" },
+    { SCAN_SIGNATURE_GZIP,      "gzip",     0,  3,  "\x1f\x8b\x08" },
+    { SCAN_SIGNATURE_SQLITE,    "SQLite",   0,  16, "SQLite format 3\0" },
+    { SCAN_SIGNATURE_BPLIST,    "bplist",   0,  8,  "bplist00" },
+    { SCAN_SIGNATURE_ISO_BMFF,  "ISO BMFF", 4,  4,  "ftyp" },
+    { SCAN_SIGNATURE_MACH_O,    "Mach-O",   0,  4,  "\xcf\xfa\xed\xfe" },
+};
+#define NUM_FILE_SIGNATURES     (sizeof(file_signatures) / sizeof(file_signature_t))
+
+const char* get_signature_name(uint32_t signature) {
+    for (size_t i = 0; i < NUM_FILE_SIGNATURES; i++) {
+        if (file_signatures[i].signature == signature) {
+            return file_signatures[i].name;
+        }
+    }
+    return "unknown";
+}
+
+/**
+ * Determine which file signature, if any, a block starts with.
+ *
+ * RETURN VALUE:
+ *      One of the `SCAN_SIGNATURE_...` values, or zero if the block doesn't
+ *      start with any of them.
+ */
+uint32_t find_file_signature(char* block) {
+    for (size_t i = 0; i < NUM_FILE_SIGNATURES; i++) {
+        const file_signature_t* sig = file_signatures + i;
+        if (memcmp(block + sig->offset, sig->bytes, sig->length) == 0) {
+            return sig->signature;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Claim the next chunk of blocks to scan. The caller must hold the scan's
+ * lock. When only free blocks are scanned, chunks don't extend past the end of
+ * the run of free blocks they start in.
+ *
+ * RETURN VALUE:
+ *      The number of blocks in the chunk, or zero if there are none left.
+ */
+size_t claim_scan_chunk(scan_state_t* scan, paddr_t* addr) {
+    paddr_t end_addr = scan->end_addr;
+    if (scan->free_map) {
+        scan->next_addr = find_next_block(scan->free_map, scan->next_addr, false);
+        if (scan->next_addr < end_addr) {
+            end_addr = find_next_block(scan->free_map, scan->next_addr, true);
+            if (end_addr > scan->end_addr) {
+                end_addr = scan->end_addr;
+            }
+        }
+    }
+    if (scan->next_addr >= end_addr) {
+        return 0;
+    }
+
+    *addr = scan->next_addr;
+    size_t num_blocks = SCAN_CHUNK_BLOCKS;
+    if (end_addr - *addr < SCAN_CHUNK_BLOCKS) {
+        num_blocks = end_addr - *addr;
+    }
+    scan->next_addr += num_blocks;
+    return num_blocks;
+}
+
+void* scan_worker(void* arg) {
+    scan_state_t* scan = arg;
+    nx_device = scan->device;
+
+    char* chunk = malloc(SCAN_CHUNK_BLOCKS * nx_device->block_size);
+    scan_record_t* records = malloc(SCAN_CHUNK_BLOCKS * sizeof(scan_record_t));
+    uint8_t ok[SCAN_CHUNK_BLOCKS];
+    if (!chunk || !records) {
+        fprintf(stderr, "\nABORT: scan_worker: Could not allocate sufficient memory for `chunk`.\n");
+        pthread_mutex_lock(&scan->lock);
+        scan->failed = true;
+        pthread_mutex_unlock(&scan->lock);
+        goto cleanup;
+    }
+
+    while (true) {
+        pthread_mutex_lock(&scan->lock);
+        paddr_t addr = 0;
+        size_t num_blocks = 0;
+        if (!scan->cancelled && !scan->failed) {
+            num_blocks = claim_scan_chunk(scan, &addr);
+        }
+        pthread_mutex_unlock(&scan->lock);
+        if (num_blocks == 0) {
+            break;
+        }
+
+        uint64_t num_unreadable = 0;
+        size_t num_read = scan_read_chunk(chunk, addr, num_blocks, &num_unreadable);
+        validate_block_range(chunk, num_read, ok);
+
+        size_t num_records = 0;
+        uint64_t num_signatures = 0;
+        for (size_t i = 0; i < num_read; i++) {
+            if (!ok[i]) {
+                uint32_t signature = scan->find_signatures ? find_file_signature(chunk + i * nx_device->block_size) : 0;
+                if (signature) {
+                    scan_record_t* record = records + num_records++;
+                    memset(record, 0, sizeof(scan_record_t));
+                    record->addr    = addr + i;
+                    record->type    = SCAN_TYPE_FILE_SIGNATURE;
+                    record->subtype = signature;
+                    num_signatures++;
+                }
+                continue;
+            }
+            obj_phys_t* obj = (obj_phys_t*)(chunk + i * nx_device->block_size);
+            scan_record_t* record = records + num_records++;
+            record->addr    = addr + i;
+            record->oid     = obj->o_oid;
+            record->xid     = obj->o_xid;
+            record->type    = obj->o_type;
+            record->subtype = obj->o_subtype;
+            record->flags   = 0;
+            record->level   = 0;
+            record->reserved = 0;
+
+            uint32_t type = obj->o_type & OBJECT_TYPE_MASK;
+            if (type == OBJECT_TYPE_BTREE || type == OBJECT_TYPE_BTREE_NODE) {
+                btree_node_phys_t* node = (btree_node_phys_t*)obj;
+                record->flags = node->btn_flags;
+                record->level = node->btn_level;
+            }
+        }
+
+        pthread_mutex_lock(&scan->lock);
+        if (num_read < num_blocks && scan->end_addr > addr + (paddr_t)num_read) {
+            // Reached the end of the container; don't claim any more chunks.
+            scan->end_addr = addr + num_read;
+        }
+        scan->stats.blocks_scanned += num_read;
+        scan->stats.blocks_unreadable += num_unreadable;
+        scan->stats.objects_found += num_records - num_signatures;
+        scan->stats.signatures_found += num_signatures;
+        if (!scan->cancelled && !scan->callback(scan->context, records, num_records, &scan->stats)) {
+            scan->cancelled = true;
+        }
+        pthread_mutex_unlock(&scan->lock);
+    }
+
+cleanup:
+    free(records);
+    free(chunk);
+    return NULL;
+}
+
+int scan_free_blocks(allocation_map_t* allocation_map, paddr_t start_addr, paddr_t end_addr, unsigned int num_threads, bool find_signatures, scan_callback_t callback, void* context, scan_stats_t* stats) {
+    scan_state_t scan = {
+        .device     = nx_device,
+        .next_addr  = start_addr,
+        .end_addr   = end_addr,
+        .cancelled  = false,
+        .failed     = false,
+        .free_map   = allocation_map,
+        .find_signatures    = find_signatures,
+        .callback   = callback,
+        .context    = context,
+    };
+    pthread_mutex_init(&scan.lock, NULL);
+
+    if (num_threads == 0) {
+        num_threads = SCAN_DEFAULT_NUM_THREADS;
+    }
+
+    // The calling thread also acts as a worker, so we spawn one fewer thread.
+    pthread_t threads[num_threads];
+    size_t num_spawned = 0;
+    for (unsigned int i = 1; i < num_threads; i++) {
+        if (pthread_create(&threads[num_spawned], NULL, scan_worker, &scan) != 0) {
+            break;
+        }
+        num_spawned++;
+    }
+    scan_worker(&scan);
+    for (size_t i = 0; i < num_spawned; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_mutex_destroy(&scan.lock);
+
+    if (stats) {
+        *stats = scan.stats;
+    }
+    if (scan.failed) {
+        return -1;
+    }
+    return scan.cancelled ? 1 : 0;
+}
+
+int scan_blocks(paddr_t start_addr, paddr_t end_addr, unsigned int num_threads, scan_callback_t callback, void* context, scan_stats_t* stats) {
+    return scan_free_blocks(NULL, start_addr, end_addr, num_threads, false, callback, context, stats);
+}
@@ -0,0 +1,188 @@
+/**
+ * Functions used to scan a whole container (or a range of it) for objects,
+ * regardless of whether anything still refers to them, e.g. to find B-tree
+ * nodes from old checkpoints during recovery.
+ *
+ * The range is read in large sequential chunks, split across several threads,
+ * and the checksums of each chunk's blocks are validated as a batch (see
+ * `validate_blocks()`). Each block whose checksum is valid is classified by
+ * the header of the object it contains, and the results are handed to a
+ * callback, from which they can be e.g. streamed to an index file.
+ *
+ * A scan can be limited to the blocks that the space manager reports as free
+ * (see `scan_free_blocks()`), which is where deleted nodes and file data
+ * survive; on most containers, that's a small part of the whole. Blocks there
+ * that aren't objects can also be checked for the signatures of common file
+ * formats, to find the first blocks of deleted files.
+ */
+
+#ifndef APFS_FUNC_SCAN_H
+#define APFS_FUNC_SCAN_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "../io.h"
+#include "../struct/general.h"
+#include "../struct/object.h"
+#include "../struct/btree.h"
+
+#include "cksum.h"
+#include "spaceman.h"
+
+/** Scan constants **/
+
+#define SCAN_CHUNK_BLOCKS       256     // = 1 MiB of 4 KiB blocks per read
+#define SCAN_DEFAULT_NUM_THREADS    4
+
+/** File signature constants **/
+
+// Records of blocks that start with a file signature, rather than of objects,
+// have a `type` of `SCAN_TYPE_FILE_SIGNATURE`, and one of the following as
+// their `subtype`. No object has that type, and it's nonzero, so that it can
+// be queried for like any other (a type of zero matches any type; see
+// `block_index_query_t`).
+#define SCAN_TYPE_FILE_SIGNATURE    0x0000fffe
+
+#define SCAN_SIGNATURE_JPEG     1
+#define SCAN_SIGNATURE_PNG      2
+#define SCAN_SIGNATURE_GIF      3
+#define SCAN_SIGNATURE_PDF      4
+#define SCAN_SIGNATURE_ZIP      5
+#define SCAN_SIGNATURE_GZIP     6
+#define SCAN_SIGNATURE_SQLITE   7
+#define SCAN_SIGNATURE_BPLIST   8
+#define SCAN_SIGNATURE_ISO_BMFF 9       // MP4, MOV, HEIC, and the like
+#define SCAN_SIGNATURE_MACH_O   10
+
+/** Index file constants **/
+
+#define SCAN_INDEX_MAGIC        0x49535041  // = 'APSI' when read as bytes
+#define SCAN_INDEX_VERSION      3
+
+// Values of `flags` in `scan_index_header_t`
+#define SCAN_INDEX_FREE_ONLY    0x00000001  // Only the blocks that were free were scanned
+
+/**
+ * An object found by a scan.
+ *
+ * addr:        The physical address of the block containing the object.
+ *
+ * type:        The object's `o_type`, including its storage type and flags.
+ *
+ * subtype:     The object's `o_subtype`.
+ *
+ * flags, level:    For B-tree nodes, the node's `btn_flags` and `btn_level`;
+ *      e.g. `BTNODE_LEAF` is set in `flags` for leaf nodes. Otherwise, zero.
+ */
+typedef struct {
+    paddr_t     addr;
+    oid_t       oid;
+    xid_t       xid;
+    uint32_t    type;
+    uint32_t    subtype;
+    uint16_t    flags;
+    uint16_t    level;
+    uint32_t    reserved;
+} scan_record_t;
+
+/**
+ * The header of an index file, as written by `apfs-scan`. It is followed by
+ * `scan_record_t`s, one per object found, in no particular order, up to the end
+ * of the file. Index files use native byte order.
+ *
+ * start_addr, end_addr:    The range of blocks that was scanned, i.e.
+ *      `start_addr` up to but not including `end_addr`.
+ *
+ * flags:       A bit field of `SCAN_INDEX_*` flags. If `SCAN_INDEX_FREE_ONLY`
+ *      is set, the blocks in the range that were allocated weren't read, so
+ *      the absence of a record for a block doesn't mean that it holds no
+ *      object.
+ */
+typedef struct {
+    uint32_t    magic;
+    uint32_t    version;
+    uint32_t    block_size;
+    uint32_t    record_size;
+    paddr_t     start_addr;
+    paddr_t     end_addr;
+    uint32_t    flags;
+    uint32_t    reserved;
+} scan_index_header_t;
+
+/**
+ * Statistics on a scan.
+ *
+ * blocks_scanned:      The number of blocks read, including blocks whose
+ *      checksum is invalid.
+ *
+ * blocks_unreadable:   The number of blocks that couldn't be read due to an
+ *      I/O error.
+ *
+ * objects_found:       The number of blocks whose checksum is valid.
+ *
+ * signatures_found:    The number of other blocks that start with a file
+ *      signature, if signatures were looked for.
+ */
+typedef struct {
+    uint64_t    blocks_scanned;
+    uint64_t    blocks_unreadable;
+    uint64_t    objects_found;
+    uint64_t    signatures_found;
+} scan_stats_t;
+
+/**
+ * A function that is handed the objects found in each chunk of a scan, in the
+ * order of their addresses within the chunk. Chunks are handed over in the
+ * order in which their scans finish, which isn't necessarily address order.
+ * Calls are never concurrent, so the function needn't lock anything.
+ *
+ * stats:       Statistics on the scan so far, including this chunk.
+ *
+ * RETURN VALUE:
+ *      True to continue the scan, or false to stop it.
+ */
+typedef bool (*scan_callback_t)(void* context, scan_record_t* records, size_t num_records, scan_stats_t* stats);
+
+/**
+ * Scan a range of blocks of the current container (see `nx_device` in
+ * `apfs/io.h`) for objects whose checksums are valid.
+ *
+ * start_addr, end_addr:    The range of blocks to scan, i.e. `start_addr` up to
+ *      but not including `end_addr`. The scan also stops at the end of the
+ *      container.
+ *
+ * num_threads: The number of threads to read with; zero means
+ *      `SCAN_DEFAULT_NUM_THREADS`.
+ *
+ * callback, context:   Called on the objects found in each chunk.
+ *
+ * stats:       If not NULL, statistics on the scan will be stored here.
+ *
+ * RETURN VALUE:
+ *      Zero if the whole range was scanned, a positive value if the callback
+ *      stopped the scan, or a negative value on failure.
+ */
+int scan_blocks(paddr_t start_addr, paddr_t end_addr, unsigned int num_threads, scan_callback_t callback, void* context, scan_stats_t* stats);
+
+/**
+ * As for `scan_blocks()`, but only scan the blocks in the range that are free
+ * according to a given allocation map, reading each run of free blocks in
+ * chunks as usual.
+ *
+ * find_signatures:     Whether to also look for file signatures at the start
+ *      of blocks that aren't objects, handing them to the callback as records
+ *      of type `SCAN_TYPE_FILE_SIGNATURE`.
+ */
+int scan_free_blocks(allocation_map_t* allocation_map, paddr_t start_addr, paddr_t end_addr, unsigned int num_threads, bool find_signatures, scan_callback_t callback, void* context, scan_stats_t* stats);
+
+/**
+ * Get the name of a file signature, e.g. "JPEG" for `SCAN_SIGNATURE_JPEG`.
+ */
+const char* get_signature_name(uint32_t signature);
+
+#endif // APFS_FUNC_SCAN_H
@@ -0,0 +1,219 @@
+#include "sha256.h"
+
+const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROTR32(x, n)    (((x) >> (n)) | ((x) << (32 - (n))))
+
+uint32_t load_be32(const uint8_t* bytes) {
+    return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | bytes[3];
+}
+
+void store_be32(uint8_t* bytes, uint32_t value) {
+    bytes[0] = value >> 24;
+    bytes[1] = value >> 16;
+    bytes[2] = value >> 8;
+    bytes[3] = value;
+}
+
+/**
+ * Process a single 64-byte block, updating a hash state.
+ */
+void sha256_compress(uint32_t* state, const uint8_t* block) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = load_be32(block + 4 * i);
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = ROTR32(w[i - 15], 7) ^ ROTR32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ROTR32(w[i - 2], 17) ^ ROTR32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = h + (ROTR32(e, 6) ^ ROTR32(e, 11) ^ ROTR32(e, 25)) + ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+        uint32_t t2 = (ROTR32(a, 2) ^ ROTR32(a, 13) ^ ROTR32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    state[0] += a;  state[1] += b;  state[2] += c;  state[3] += d;
+    state[4] += e;  state[5] += f;  state[6] += g;  state[7] += h;
+}
+
+void sha256_init(sha256_ctx_t* ctx) {
+    static const uint32_t initial_state[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    memcpy(ctx->state, initial_state, sizeof(initial_state));
+    ctx->length = 0;
+}
+
+void sha256_update(sha256_ctx_t* ctx, const void* data, size_t length) {
+    const uint8_t* bytes = data;
+    size_t used = ctx->length % SHA256_BLOCK_SIZE;
+    ctx->length += length;
+
+    if (used > 0) {
+        size_t n = SHA256_BLOCK_SIZE - used < length ? SHA256_BLOCK_SIZE - used : length;
+        memcpy(ctx->buffer + used, bytes, n);
+        bytes += n;
+        length -= n;
+        if (used + n < SHA256_BLOCK_SIZE) {
+            return;
+        }
+        sha256_compress(ctx->state, ctx->buffer);
+    }
+    for (; length >= SHA256_BLOCK_SIZE; bytes += SHA256_BLOCK_SIZE, length -= SHA256_BLOCK_SIZE) {
+        sha256_compress(ctx->state, bytes);
+    }
+    memcpy(ctx->buffer, bytes, length);
+}
+
+void sha256_final(sha256_ctx_t* ctx, uint8_t* digest) {
+    uint64_t bit_length = ctx->length * 8;
+    size_t used = ctx->length % SHA256_BLOCK_SIZE;
+
+    // Padding is a 1 bit, then zeros up to the last 8 bytes of a block, which
+    // hold the message length in bits.
+    ctx->buffer[used++] = 0x80;
+    if (used > SHA256_BLOCK_SIZE - 8) {
+        memset(ctx->buffer + used, 0, SHA256_BLOCK_SIZE - used);
+        sha256_compress(ctx->state, ctx->buffer);
+        used = 0;
+    }
+    memset(ctx->buffer + used, 0, SHA256_BLOCK_SIZE - 8 - used);
+    store_be32(ctx->buffer + SHA256_BLOCK_SIZE - 8, bit_length >> 32);
+    store_be32(ctx->buffer + SHA256_BLOCK_SIZE - 4, bit_length);
+    sha256_compress(ctx->state, ctx->buffer);
+
+    for (int i = 0; i < 8; i++) {
+        store_be32(digest + 4 * i, ctx->state[i]);
+    }
+    memset(ctx, 0, sizeof(sha256_ctx_t));
+}
+
+void sha256(const void* data, size_t length, uint8_t* digest) {
+    sha256_ctx_t ctx;
+    sha256_init(&ctx);
+    sha256_update(&ctx, data, length);
+    sha256_final(&ctx, digest);
+}
+
+/**
+ * Begin an HMAC-SHA-256 computation, leaving the state after hashing the inner
+ * padded key in `inner`, and that after hashing the outer padded key in `outer`.
+ */
+void hmac_sha256_init(const uint8_t* key, size_t key_len, sha256_ctx_t* inner, sha256_ctx_t* outer) {
+    uint8_t key_block[SHA256_BLOCK_SIZE] = {0};
+    if (key_len > SHA256_BLOCK_SIZE) {
+        sha256(key, key_len, key_block);
+    } else {
+        memcpy(key_block, key, key_len);
+    }
+
+    uint8_t pad[SHA256_BLOCK_SIZE];
+    for (int i = 0; i < SHA256_BLOCK_SIZE; i++) {
+        pad[i] = key_block[i] ^ 0x36;
+    }
+    sha256_init(inner);
+    sha256_update(inner, pad, SHA256_BLOCK_SIZE);
+    for (int i = 0; i < SHA256_BLOCK_SIZE; i++) {
+        pad[i] = key_block[i] ^ 0x5c;
+    }
+    sha256_init(outer);
+    sha256_update(outer, pad, SHA256_BLOCK_SIZE);
+
+    memset(key_block, 0, sizeof(key_block));
+    memset(pad, 0, sizeof(pad));
+}
+
+void hmac_sha256(const uint8_t* key, size_t key_len, const void* data, size_t length, uint8_t* mac) {
+    sha256_ctx_t inner, outer;
+    uint8_t inner_digest[SHA256_DIGEST_SIZE];
+    hmac_sha256_init(key, key_len, &inner, &outer);
+    sha256_update(&inner, data, length);
+    sha256_final(&inner, inner_digest);
+    sha256_update(&outer, inner_digest, SHA256_DIGEST_SIZE);
+    sha256_final(&outer, mac);
+}
+
+void pbkdf2_hmac_sha256(
+    const char* password, size_t password_len,
+    const uint8_t* salt, size_t salt_len,
+    uint64_t iterations,
+    uint8_t* derived, size_t derived_len
+) {
+    sha256_ctx_t inner, outer;
+    hmac_sha256_init((const uint8_t*)password, password_len, &inner, &outer);
+
+    // After the first iteration, each HMAC input is a digest, so the inner and
+    // outer hashes each consist of exactly one more block, padded the same
+    // way every time: the digest, a 1 bit, and the length of the padded key
+    // plus the digest, in bits.
+    uint8_t block[SHA256_BLOCK_SIZE] = {0};
+    block[SHA256_DIGEST_SIZE] = 0x80;
+    store_be32(block + SHA256_BLOCK_SIZE - 4, (SHA256_BLOCK_SIZE + SHA256_DIGEST_SIZE) * 8);
+
+    for (uint32_t block_index = 1; derived_len > 0; block_index++) {
+        // U_1 = HMAC(password, salt || INT(block_index))
+        uint8_t index_bytes[4];
+        store_be32(index_bytes, block_index);
+        sha256_ctx_t ctx = inner;
+        sha256_update(&ctx, salt, salt_len);
+        sha256_update(&ctx, index_bytes, sizeof(index_bytes));
+        sha256_final(&ctx, block);
+        ctx = outer;
+        sha256_update(&ctx, block, SHA256_DIGEST_SIZE);
+        sha256_final(&ctx, block);
+        block[SHA256_DIGEST_SIZE] = 0x80;
+
+        uint32_t result[8];
+        for (int i = 0; i < 8; i++) {
+            result[i] = load_be32(block + 4 * i);
+        }
+
+        // U_j = HMAC(password, U_(j-1)); the result is U_1 ^ U_2 ^ ...
+        for (uint64_t j = 1; j < iterations; j++) {
+            uint32_t state[8];
+            memcpy(state, inner.state, sizeof(state));
+            sha256_compress(state, block);
+            for (int i = 0; i < 8; i++) {
+                store_be32(block + 4 * i, state[i]);
+            }
+            memcpy(state, outer.state, sizeof(state));
+            sha256_compress(state, block);
+            for (int i = 0; i < 8; i++) {
+                store_be32(block + 4 * i, state[i]);
+                result[i] ^= state[i];
+            }
+        }
+
+        size_t n = derived_len < SHA256_DIGEST_SIZE ? derived_len : SHA256_DIGEST_SIZE;
+        for (size_t i = 0; i < n; i++) {
+            derived[i] = result[i / 4] >> (24 - 8 * (i % 4));
+        }
+        derived += n;
+        derived_len -= n;
+        memset(result, 0, sizeof(result));
+    }
+
+    memset(block, 0, sizeof(block));
+    memset(&inner, 0, sizeof(inner));
+    memset(&outer, 0, sizeof(outer));
+}
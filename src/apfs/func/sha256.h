@@ -0,0 +1,67 @@
+/**
+ * Functions related to SHA-256, and the HMAC and PBKDF2 constructions built on
+ * it, as used to derive and check the keys that unlock encrypted volumes (see
+ * `apfs/func/keybag.h`).
+ */
+
+#ifndef APFS_FUNC_SHA256_H
+#define APFS_FUNC_SHA256_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+/** SHA-256 constants **/
+
+#define SHA256_BLOCK_SIZE       64
+#define SHA256_DIGEST_SIZE      32
+
+/**
+ * The state of a SHA-256 computation.
+ *
+ * state:       The intermediate hash value.
+ *
+ * length:      The number of bytes hashed so far.
+ *
+ * buffer:      The bytes of the current, incomplete block.
+ */
+typedef struct {
+    uint32_t    state[8];
+    uint64_t    length;
+    uint8_t     buffer[SHA256_BLOCK_SIZE];
+} sha256_ctx_t;
+
+void sha256_init(sha256_ctx_t* ctx);
+void sha256_update(sha256_ctx_t* ctx, const void* data, size_t length);
+void sha256_final(sha256_ctx_t* ctx, uint8_t* digest);
+
+/**
+ * Compute the SHA-256 digest of some data.
+ *
+ * digest:      The digest will be stored here; `SHA256_DIGEST_SIZE` bytes.
+ */
+void sha256(const void* data, size_t length, uint8_t* digest);
+
+/**
+ * Compute the HMAC-SHA-256 of some data.
+ *
+ * mac:         The MAC will be stored here; `SHA256_DIGEST_SIZE` bytes.
+ */
+void hmac_sha256(const uint8_t* key, size_t key_len, const void* data, size_t length, uint8_t* mac);
+
+/**
+ * Derive a key from a password with PBKDF2, using HMAC-SHA-256. The inner and
+ * outer hash states of the HMAC key are computed once, rather than once per
+ * iteration, so each iteration costs two SHA-256 block compressions.
+ *
+ * derived:     The derived key will be stored here; `derived_len` bytes.
+ */
+void pbkdf2_hmac_sha256(
+    const char* password, size_t password_len,
+    const uint8_t* salt, size_t salt_len,
+    uint64_t iterations,
+    uint8_t* derived, size_t derived_len
+);
+
+#endif // APFS_FUNC_SHA256_H
@@ -0,0 +1,298 @@
+#include "snapshot.h"
+
+void free_snapshots(snapshot_t* snapshots, uint32_t num_snapshots) {
+    if (!snapshots) {
+        return;
+    }
+    for (uint32_t i = 0; i < num_snapshots; i++) {
+        free(snapshots[i].name);
+    }
+    free(snapshots);
+}
+
+int compare_snapshots(const void* a, const void* b) {
+    xid_t xid_a = ((const snapshot_t*)a)->xid;
+    xid_t xid_b = ((const snapshot_t*)b)->xid;
+    return xid_a < xid_b ? -1 : xid_a > xid_b;
+}
+
+snapshot_t* find_snapshot(snapshot_t* snapshots, uint32_t num_snapshots, const char* name) {
+    for (uint32_t i = 0; i < num_snapshots; i++) {
+        if (snapshots[i].name && strcmp(snapshots[i].name, name) == 0) {
+            return snapshots + i;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Look up the entry for a given snapshot XID in the snapshot tree of an object
+ * map, whose root node is `node` (a whole block, which is overwritten).
+ *
+ * RETURN VALUE:
+ *      True if the entry was found and copied to `snapshot`, or false if not.
+ */
+bool get_omap_snapshot(btree_node_phys_t* node, xid_t xid, omap_snapshot_t* snapshot) {
+    char* toc_start = (char*)(node->btn_data) + node->btn_table_space.off;
+    char* key_start = toc_start + node->btn_table_space.len;
+    char* val_end   = (char*)node + nx_device->block_size - sizeof(btree_info_t);
+
+    while (true) {
+        if (!(node->btn_flags & BTNODE_FIXED_KV_SIZE)) {
+            return false;
+        }
+
+        // Find the last TOC entry whose key doesn't exceed `xid`
+        kvoff_t* toc = (kvoff_t*)toc_start;
+        uint32_t i = 0;
+        while (i < node->btn_nkeys && *(xid_t*)(key_start + toc[i].k) <= xid) {
+            i++;
+        }
+        if (i == 0) {
+            return false;
+        }
+        kvoff_t* toc_entry = toc + i - 1;
+
+        if (node->btn_flags & BTNODE_LEAF) {
+            if (*(xid_t*)(key_start + toc_entry->k) != xid) {
+                return false;
+            }
+            memcpy(snapshot, val_end - toc_entry->v, sizeof(omap_snapshot_t));
+            return true;
+        }
+
+        paddr_t child_node_addr = *(paddr_t*)(val_end - toc_entry->v);
+        if (read_node(node, child_node_addr) != 1 || !verify_node(node, child_node_addr)) {
+            fprintf(stderr, "WARNING: get_omap_snapshot: Failed to read block 0x%llx.\n", child_node_addr);
+            return false;
+        }
+
+        toc_start = (char*)(node->btn_data) + node->btn_table_space.off;
+        key_start = toc_start + node->btn_table_space.len;
+        val_end   = (char*)node + nx_device->block_size;    // Always dealing with non-root node here
+    }
+}
+
+int get_volume_snapshots(container_t* container, uint32_t volume_id, snapshot_t** snapshots, uint32_t* num_snapshots) {
+    int result = -1;
+    *snapshots = NULL;
+    *num_snapshots = 0;
+
+    apfs_superblock_t* apsb = get_volume_superblock(container, volume_id);
+    btree_node_phys_t* snap_meta_tree = NULL;
+    omap_phys_t* fs_omap = NULL;
+    j_rec_t** name_records = NULL;
+
+    if (!apsb->apfs_snap_meta_tree_oid) {
+        return 0;
+    }
+    if ((apsb->apfs_snap_meta_tree_type & OBJ_STORAGETYPE_MASK) != OBJ_PHYSICAL) {
+        fprintf(stderr, "\nABORT: get_volume_snapshots: The snapshot metadata tree of volume %u is not a Physical object.\n", volume_id);
+        return -1;
+    }
+
+    snap_meta_tree = malloc(nx_device->block_size);
+    fs_omap = malloc(nx_device->block_size);
+    if (!snap_meta_tree || !fs_omap) {
+        fprintf(stderr, "\nABORT: get_volume_snapshots: Could not allocate sufficient memory for the root nodes.\n");
+        goto cleanup;
+    }
+    if (
+            read_node(snap_meta_tree, apsb->apfs_snap_meta_tree_oid) != 1
+            || !verify_node(snap_meta_tree, apsb->apfs_snap_meta_tree_oid)
+    ) {
+        fprintf(stderr, "\nABORT: get_volume_snapshots: Failed to read the snapshot metadata tree at block 0x%llx.\n", apsb->apfs_snap_meta_tree_oid);
+        goto cleanup;
+    }
+
+    // Every snapshot has a name record, all of which share the OID `~0`.
+    // The snapshot metadata tree refers to its child nodes by physical address.
+    name_records = get_fs_records(NULL, snap_meta_tree, OBJ_ID_MASK, (xid_t)(~0));
+    if (!name_records) {
+        goto cleanup;
+    }
+    size_t capacity = 0;
+    for (j_rec_t** cursor = name_records; *cursor; cursor++) {
+        capacity++;
+    }
+    *snapshots = calloc(capacity ? capacity : 1, sizeof(snapshot_t));
+    if (!*snapshots) {
+        fprintf(stderr, "\nABORT: get_volume_snapshots: Could not allocate sufficient memory for `snapshots`.\n");
+        goto cleanup;
+    }
+
+    for (j_rec_t** cursor = name_records; *cursor; cursor++) {
+        j_snap_name_key_t* key = (j_snap_name_key_t*)(*cursor)->data;
+        if ((key->hdr.obj_id_and_type >> OBJ_TYPE_SHIFT) != APFS_TYPE_SNAP_NAME) {
+            continue;
+        }
+        if ((*cursor)->key_len < sizeof(j_snap_name_key_t) + key->name_len || (*cursor)->val_len < sizeof(j_snap_name_val_t)) {
+            continue;
+        }
+        j_snap_name_val_t* val = (j_snap_name_val_t*)((*cursor)->data + (*cursor)->key_len);
+
+        snapshot_t* snapshot = *snapshots + *num_snapshots;
+        snapshot->xid = val->snap_xid;
+        snapshot->name = strndup((char*)key->name, key->name_len);
+        if (!snapshot->name) {
+            fprintf(stderr, "\nABORT: get_volume_snapshots: Could not allocate sufficient memory for a snapshot name.\n");
+            goto cleanup;
+        }
+        (*num_snapshots)++;
+
+        // The metadata record is keyed by the snapshot's XID
+        j_rec_t** meta_records = get_fs_records(NULL, snap_meta_tree, snapshot->xid, (xid_t)(~0));
+        for (j_rec_t** meta = meta_records; meta && *meta; meta++) {
+            j_key_t* meta_key = (j_key_t*)(*meta)->data;
+            if (
+                    (meta_key->obj_id_and_type >> OBJ_TYPE_SHIFT) == APFS_TYPE_SNAP_METADATA
+                    && (*meta)->val_len >= sizeof(j_snap_metadata_val_t)
+            ) {
+                j_snap_metadata_val_t* meta_val = (j_snap_metadata_val_t*)((*meta)->data + (*meta)->key_len);
+                snapshot->sblock_addr = meta_val->sblock_oid;
+                snapshot->create_time = meta_val->create_time;
+            }
+        }
+        free_j_rec_array(meta_records);
+    }
+
+    // Whether each snapshot has since been deleted is recorded in the volume
+    // object map. Not being able to read it isn't an error.
+    if (
+            read_node(fs_omap, apsb->apfs_omap_oid) == 1
+            && is_cksum_valid(fs_omap)
+            && fs_omap->om_snapshot_tree_oid
+    ) {
+        oid_t tree_oid = fs_omap->om_snapshot_tree_oid;
+        btree_node_phys_t* node = (btree_node_phys_t*)fs_omap;
+        for (uint32_t i = 0; i < *num_snapshots; i++) {
+            omap_snapshot_t omap_snapshot;
+            if (read_node(node, tree_oid) == 1 && verify_node(node, tree_oid) && get_omap_snapshot(node, (*snapshots)[i].xid, &omap_snapshot)) {
+                (*snapshots)[i].omap_flags = omap_snapshot.oms_flags;
+            }
+        }
+    }
+
+    qsort(*snapshots, *num_snapshots, sizeof(snapshot_t), compare_snapshots);
+    result = 0;
+
+cleanup:
+    if (result != 0) {
+        free_snapshots(*snapshots, *num_snapshots);
+        *snapshots = NULL;
+        *num_snapshots = 0;
+    }
+    free_j_rec_array(name_records);
+    free(fs_omap);
+    free(snap_meta_tree);
+    return result;
+}
+
+int select_volume_snapshot(container_t* container, uint32_t volume_id, const char* name, xid_t* xid) {
+    snapshot_t* snapshots = NULL;
+    uint32_t num_snapshots = 0;
+    if (get_volume_snapshots(container, volume_id, &snapshots, &num_snapshots) != 0) {
+        return -1;
+    }
+
+    fprintf(stderr, "\n Snapshots of volume %u\n================\n", volume_id);
+    if (num_snapshots == 0) {
+        fprintf(stderr, "(none)\n");
+    }
+    for (uint32_t i = 0; i < num_snapshots; i++) {
+        fprintf(stderr, "XID %#llx: %s%s\n", snapshots[i].xid, snapshots[i].name, (snapshots[i].omap_flags & OMAP_SNAPSHOT_DELETED) ? " (deleted)" : "");
+    }
+
+    int result = 0;
+    if (name) {
+        snapshot_t* snapshot = find_snapshot(snapshots, num_snapshots, name);
+        if (snapshot) {
+            *xid = snapshot->xid;
+        } else {
+            fprintf(stderr, "There is no snapshot named `%s` in the list above.\n", name);
+            result = -1;
+        }
+    }
+    free_snapshots(snapshots, num_snapshots);
+    return result;
+}
+
+int open_volume_at_xid(container_t* container, uint32_t volume_id, xid_t xid, btree_node_phys_t** fs_omap_btree, btree_node_phys_t** fs_root_btree) {
+    *fs_omap_btree = NULL;
+    *fs_root_btree = NULL;
+
+    container_volume_t* volume = container->volumes + volume_id;
+    apfs_superblock_t* apsb = get_volume_superblock(container, volume_id);
+    apfs_superblock_t* snap_apsb = NULL;
+    if (!volume->omap_tree_addr) {
+        fprintf(stderr, "\nABORT: open_volume_at_xid: The object map B-tree of volume %u could not be located.\n", volume_id);
+        return -1;
+    }
+
+    *fs_omap_btree = malloc(nx_device->block_size);
+    *fs_root_btree = malloc(nx_device->block_size);
+    snap_apsb = malloc(nx_device->block_size);
+    if (!*fs_omap_btree || !*fs_root_btree || !snap_apsb) {
+        fprintf(stderr, "\nABORT: open_volume_at_xid: Could not allocate sufficient memory for the root nodes.\n");
+        goto onError;
+    }
+    if (read_node(*fs_omap_btree, volume->omap_tree_addr) != 1 || !is_cksum_valid(*fs_omap_btree)) {
+        fprintf(stderr, "\nABORT: open_volume_at_xid: Failed to read the volume object map B-tree at block 0x%llx.\n", volume->omap_tree_addr);
+        goto onError;
+    }
+
+    // Use the copy of the volume superblock taken with the snapshot, if there
+    // is one, since the file-system tree may have been replaced since then.
+    // The volume object map is the current one either way, as it retains
+    // every version of an object that a snapshot refers to.
+    oid_t root_tree_oid = apsb->apfs_root_tree_oid;
+    snapshot_t* snapshots = NULL;
+    uint32_t num_snapshots = 0;
+    bool is_snapshot = false;
+    if (get_volume_snapshots(container, volume_id, &snapshots, &num_snapshots) == 0) {
+        for (uint32_t i = 0; i < num_snapshots; i++) {
+            if (snapshots[i].xid != xid) {
+                continue;
+            }
+            is_snapshot = true;
+            if (
+                    snapshots[i].sblock_addr
+                    && read_node(snap_apsb, snapshots[i].sblock_addr) == 1
+                    && is_cksum_valid(snap_apsb)
+                    && snap_apsb->apfs_magic == APFS_MAGIC
+            ) {
+                root_tree_oid = snap_apsb->apfs_root_tree_oid;
+            }
+        }
+        free_snapshots(snapshots, num_snapshots);
+    }
+    if (!is_snapshot && xid < apsb->apfs_o.o_xid) {
+        fprintf(stderr, "WARNING: XID 0x%llx is not that of a snapshot of volume %u, so objects it refers to may have been deleted since.\n", xid, volume_id);
+    }
+
+    fprintf(stderr, "Resolving the file-system tree of volume %u as of XID 0x%llx ... ", volume_id, xid);
+    omap_val_t* fs_root_val = get_btree_phys_omap_val(*fs_omap_btree, root_tree_oid, xid);
+    if (!fs_root_val) {
+        fprintf(stderr, "FAILED. The volume object map has no root node as of that XID.\n");
+        goto onError;
+    }
+    paddr_t fs_root_addr = fs_root_val->ov_paddr;
+    free(fs_root_val);
+    if (read_node(*fs_root_btree, fs_root_addr) != 1 || !is_cksum_valid(*fs_root_btree)) {
+        fprintf(stderr, "FAILED. The root node at block 0x%llx could not be read.\n", fs_root_addr);
+        goto onError;
+    }
+    fprintf(stderr, "OK (0x%llx).\n", fs_root_addr);
+
+    fs_view_xid = xid;
+    free(snap_apsb);
+    return 0;
+
+onError:
+    free(snap_apsb);
+    free(*fs_omap_btree);
+    free(*fs_root_btree);
+    *fs_omap_btree = NULL;
+    *fs_root_btree = NULL;
+    return -1;
+}
@@ -0,0 +1,116 @@
+/**
+ * Functions used to list the snapshots of a volume and to read a volume as of
+ * any one of them.
+ *
+ * A volume's snapshots are listed in its snapshot metadata tree, which maps
+ * each snapshot's name to its XID (`j_snap_name_key_t`) and each XID to the
+ * snapshot's metadata, including a copy of the volume superblock as it was
+ * when the snapshot was taken (`j_snap_metadata_val_t`). The volume object map
+ * also keeps a tree of snapshots (`omap_snapshot_t`), which records whether
+ * each one has since been deleted.
+ *
+ * Reading a volume as of a snapshot just means resolving every Virtual OID
+ * using the versions of objects whose XIDs don't exceed the snapshot's XID,
+ * since the object map retains every version that a snapshot refers to. See
+ * `fs_view_xid` in `apfs/func/btree.h`.
+ */
+
+#ifndef APFS_FUNC_SNAPSHOT_H
+#define APFS_FUNC_SNAPSHOT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "../io.h"
+#include "../struct/general.h"
+#include "../struct/object.h"
+#include "../struct/btree.h"
+#include "../struct/omap.h"
+#include "../struct/fs.h"
+#include "../struct/j.h"
+#include "../struct/snap.h"
+
+#include "btree.h"
+#include "container.h"
+
+/**
+ * A snapshot of a volume.
+ *
+ * name:        The snapshot's name, as a NULL-terminated UTF-8 string.
+ *
+ * sblock_addr: Physical address of the copy of the volume superblock taken
+ *      with the snapshot, or zero if the snapshot has no metadata record.
+ *
+ * create_time: The time that the snapshot was created, in nanoseconds since
+ *      1970-01-01 00:00:00 UTC.
+ *
+ * omap_flags:  The snapshot's flags in the volume object map, e.g.
+ *      `OMAP_SNAPSHOT_DELETED`, or zero if it isn't listed there.
+ */
+typedef struct {
+    xid_t       xid;
+    char*       name;
+    paddr_t     sblock_addr;
+    uint64_t    create_time;
+    uint32_t    omap_flags;
+} snapshot_t;
+
+/**
+ * Get the snapshots of a given volume in a container.
+ *
+ * snapshots:   An array of the snapshots, sorted by XID, oldest first, will be
+ *      stored here. It must be freed with `free_snapshots()`.
+ *
+ * num_snapshots:   The length of the array will be stored here.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value on failure.
+ */
+int get_volume_snapshots(container_t* container, uint32_t volume_id, snapshot_t** snapshots, uint32_t* num_snapshots);
+
+void free_snapshots(snapshot_t* snapshots, uint32_t num_snapshots);
+
+/**
+ * Find the snapshot with a given name in an array returned by
+ * `get_volume_snapshots()`.
+ *
+ * RETURN VALUE:
+ *      A pointer to the snapshot within the array, or NULL if there is no
+ *      snapshot with that name.
+ */
+snapshot_t* find_snapshot(snapshot_t* snapshots, uint32_t num_snapshots, const char* name);
+
+/**
+ * List the snapshots of a given volume to stderr, for the tools' `--snapshot`
+ * and `--xid` options, and determine which XID to read the volume as of.
+ *
+ * name:        The name of the snapshot to read, or NULL.
+ *
+ * xid:         If `name` isn't NULL, the snapshot's XID will be stored here.
+ *      Otherwise, it should already hold the XID given with `--xid`, or zero.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value if there is no snapshot with the
+ *      given name, or an error occurs.
+ */
+int select_volume_snapshot(container_t* container, uint32_t volume_id, const char* name, xid_t* xid);
+
+/**
+ * As for `open_volume()`, but read the volume as of a given XID, usually that
+ * of one of its snapshots: resolve the root node of the file-system tree as of
+ * that XID, and set `fs_view_xid` so that the rest of the tree is resolved the
+ * same way in the current thread.
+ *
+ * xid:         The XID to read the volume as of. If it isn't the XID of one of
+ *      the volume's snapshots, then the objects it refers to may have since
+ *      been deleted from the object map, in which case reading them fails.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value on failure.
+ */
+int open_volume_at_xid(container_t* container, uint32_t volume_id, xid_t xid, btree_node_phys_t** fs_omap_btree, btree_node_phys_t** fs_root_btree);
+
+#endif // APFS_FUNC_SNAPSHOT_H
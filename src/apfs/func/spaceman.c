@@ -0,0 +1,271 @@
+#include "spaceman.h"
+
+void allocation_map_free(allocation_map_t* map) {
+    if (!map) {
+        return;
+    }
+    if (map->chunk_bitmaps) {
+        for (uint64_t i = 0; i < map->chunk_count; i++) {
+            free(map->chunk_bitmaps[i]);
+        }
+    }
+    free(map->chunk_bitmaps);
+    free(map->chunk_states);
+    free(map->sm_blocks);
+    free(map);
+}
+
+/**
+ * Record that a block of the space manager was read.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value if memory couldn't be allocated.
+ */
+int add_sm_block(allocation_map_t* map, paddr_t addr) {
+    if (map->num_sm_blocks == map->sm_blocks_capacity) {
+        uint64_t capacity = map->sm_blocks_capacity ? 2 * map->sm_blocks_capacity : 64;
+        paddr_t* sm_blocks = realloc(map->sm_blocks, capacity * sizeof(paddr_t));
+        if (!sm_blocks) {
+            fprintf(stderr, "\nABORT: add_sm_block: Could not allocate sufficient memory for `sm_blocks`.\n");
+            return -1;
+        }
+        map->sm_blocks = sm_blocks;
+        map->sm_blocks_capacity = capacity;
+    }
+    map->sm_blocks[map->num_sm_blocks++] = addr;
+    return 0;
+}
+
+/**
+ * Record what a chunk-info entry says about its chunk in an allocation map,
+ * reading the chunk's bitmap if some but not all of its blocks are free.
+ * Entries that don't make sense are skipped, leaving their chunks allocated.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value if memory couldn't be allocated.
+ */
+int add_chunk_info(allocation_map_t* map, chunk_info_t* chunk_info) {
+    uint64_t chunk = chunk_info->ci_addr / map->blocks_per_chunk;
+    uint32_t block_count = chunk_info->ci_block_count;
+    uint32_t free_count = chunk_info->ci_free_count & CI_COUNT_MASK;
+    if (
+            chunk_info->ci_addr % map->blocks_per_chunk != 0
+            || chunk >= map->chunk_count
+            || block_count > map->blocks_per_chunk
+            || free_count > block_count
+    ) {
+        fprintf(stderr, "- Skipping the malformed chunk info for the chunk at block 0x%llx.\n", chunk_info->ci_addr);
+        return 0;
+    }
+
+    if (free_count == 0) {
+        return 0;
+    }
+    if (free_count == block_count) {
+        map->chunk_states[chunk] = CHUNK_FREE;
+        map->free_count += free_count;
+        return 0;
+    }
+    if (!chunk_info->ci_bitmap_addr) {
+        fprintf(stderr, "- The chunk at block 0x%llx has free blocks, but no bitmap.\n", chunk_info->ci_addr);
+        return 0;
+    }
+
+    // The bitmap is a whole block, whatever the size of the chunk.
+    uint64_t* bitmap = malloc(nx_device->block_size);
+    if (!bitmap) {
+        fprintf(stderr, "\nABORT: add_chunk_info: Could not allocate sufficient memory for `bitmap`.\n");
+        return -1;
+    }
+    if (read_blocks(bitmap, chunk_info->ci_bitmap_addr, 1) != 1) {
+        fprintf(stderr, "- Failed to read the bitmap at block 0x%llx.\n", chunk_info->ci_bitmap_addr);
+        free(bitmap);
+        return 0;
+    }
+    map->chunk_states[chunk] = CHUNK_MIXED;
+    map->chunk_bitmaps[chunk] = bitmap;
+    map->free_count += free_count;
+    return add_sm_block(map, chunk_info->ci_bitmap_addr);
+}
+
+/**
+ * Read a chunk-info block, and add each of the chunks it describes to an
+ * allocation map.
+ *
+ * RETURN VALUE:
+ *      Zero on success, or a negative value if memory couldn't be allocated.
+ */
+int add_chunk_info_block(allocation_map_t* map, chunk_info_block_t* cib, paddr_t addr) {
+    if (
+            read_blocks(cib, addr, 1) != 1
+            || !is_cksum_valid(cib)
+            || (cib->cib_o.o_type & OBJECT_TYPE_MASK) != OBJECT_TYPE_SPACEMAN_CIB
+    ) {
+        fprintf(stderr, "- The chunk-info block at 0x%llx is malformed. The chunks it describes are taken to be allocated.\n", addr);
+        return 0;
+    }
+    if (add_sm_block(map, addr) != 0) {
+        return -1;
+    }
+
+    uint32_t max_count = (nx_device->block_size - sizeof(chunk_info_block_t)) / sizeof(chunk_info_t);
+    for (uint32_t i = 0; i < cib->cib_chunk_info_count && i < max_count; i++) {
+        if (add_chunk_info(map, cib->cib_chunk_info + i) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+allocation_map_t* load_allocation_map(nx_superblock_t* nxsb) {
+    size_t block_size = nx_device->block_size;
+    allocation_map_t* map = NULL;
+    chunk_info_block_t* cib = NULL;
+    cib_addr_block_t* cab = NULL;
+
+    uint32_t sm_size = 0;
+    spaceman_phys_t* sm = read_ephemeral_object(nxsb, nxsb->nx_spaceman_oid, &sm_size);
+    if (!sm) {
+        return NULL;
+    }
+    if ((sm->sm_o.o_type & OBJECT_TYPE_MASK) != OBJECT_TYPE_SPACEMAN || sm_size < sizeof(spaceman_phys_t)) {
+        fprintf(stderr, "\nABORT: load_allocation_map: The object with OID 0x%llx is not a space manager.\n", nxsb->nx_spaceman_oid);
+        goto onError;
+    }
+
+    spaceman_device_t* dev = sm->sm_dev + SD_MAIN;
+    uint32_t num_addrs = dev->sm_cab_count ? dev->sm_cab_count : dev->sm_cib_count;
+    if (
+            sm->sm_blocks_per_chunk == 0
+            || (uint64_t)dev->sm_addr_offset + (uint64_t)num_addrs * sizeof(paddr_t) > sm_size
+    ) {
+        fprintf(stderr, "\nABORT: load_allocation_map: The space manager is malformed.\n");
+        goto onError;
+    }
+
+    map = calloc(1, sizeof(allocation_map_t));
+    cib = malloc(block_size);
+    cab = malloc(block_size);
+    if (!map || !cib || !cab) {
+        fprintf(stderr, "\nABORT: load_allocation_map: Could not allocate sufficient memory.\n");
+        goto onError;
+    }
+    map->xid                = nxsb->nx_o.o_xid;
+    map->block_count        = dev->sm_block_count;
+    map->blocks_per_chunk   = sm->sm_blocks_per_chunk;
+    map->chunk_count        = (dev->sm_block_count + sm->sm_blocks_per_chunk - 1) / sm->sm_blocks_per_chunk;
+    if (sm->sm_blocks_per_chunk > 8 * block_size) {
+        fprintf(stderr, "\nABORT: load_allocation_map: Chunks of %u blocks don't fit in one bitmap block.\n", sm->sm_blocks_per_chunk);
+        goto onError;
+    }
+
+    // Chunks that no chunk-info block describes are taken to be allocated.
+    map->chunk_states = calloc(map->chunk_count ? map->chunk_count : 1, sizeof(uint8_t));
+    map->chunk_bitmaps = calloc(map->chunk_count ? map->chunk_count : 1, sizeof(uint64_t*));
+    if (!map->chunk_states || !map->chunk_bitmaps) {
+        fprintf(stderr, "\nABORT: load_allocation_map: Could not allocate sufficient memory for %llu chunks.\n", map->chunk_count);
+        goto onError;
+    }
+
+    paddr_t* addrs = (paddr_t*)((char*)sm + dev->sm_addr_offset);
+    for (uint32_t i = 0; i < num_addrs; i++) {
+        if (!dev->sm_cab_count) {
+            if (add_chunk_info_block(map, cib, addrs[i]) != 0) {
+                goto onError;
+            }
+            continue;
+        }
+
+        if (
+                read_blocks(cab, addrs[i], 1) != 1
+                || !is_cksum_valid(cab)
+                || (cab->cab_o.o_type & OBJECT_TYPE_MASK) != OBJECT_TYPE_SPACEMAN_CAB
+        ) {
+            fprintf(stderr, "- The chunk-info address block at 0x%llx is malformed. The chunks it describes are taken to be allocated.\n", addrs[i]);
+            continue;
+        }
+        if (add_sm_block(map, addrs[i]) != 0) {
+            goto onError;
+        }
+        uint32_t max_count = (block_size - sizeof(cib_addr_block_t)) / sizeof(paddr_t);
+        for (uint32_t j = 0; j < cab->cab_cib_count && j < max_count; j++) {
+            if (add_chunk_info_block(map, cib, cab->cab_cib_addr[j]) != 0) {
+                goto onError;
+            }
+        }
+    }
+
+    free(cab);
+    free(cib);
+    free(sm);
+    return map;
+
+onError:
+    allocation_map_free(map);
+    free(cab);
+    free(cib);
+    free(sm);
+    return NULL;
+}
+
+bool is_block_allocated(allocation_map_t* map, paddr_t addr) {
+    if ((uint64_t)addr >= map->block_count) {
+        return false;
+    }
+    uint64_t chunk = addr / map->blocks_per_chunk;
+    switch (map->chunk_states[chunk]) {
+        case CHUNK_FREE:
+            return false;
+        case CHUNK_MIXED: {
+            uint64_t offset = addr - chunk * map->blocks_per_chunk;
+            return (map->chunk_bitmaps[chunk][offset / 64] >> (offset % 64)) & 1;
+        }
+        default:
+            return true;
+    }
+}
+
+paddr_t find_next_block(allocation_map_t* map, paddr_t addr, bool allocated) {
+    chunk_state_t wanted = allocated ? CHUNK_ALLOCATED : CHUNK_FREE;
+    while ((uint64_t)addr < map->block_count) {
+        uint64_t chunk = addr / map->blocks_per_chunk;
+        paddr_t chunk_start = chunk * map->blocks_per_chunk;
+        paddr_t chunk_end = chunk_start + map->blocks_per_chunk;
+        if ((uint64_t)chunk_end > map->block_count) {
+            chunk_end = map->block_count;
+        }
+
+        chunk_state_t state = map->chunk_states[chunk];
+        if (state == wanted) {
+            return addr;
+        }
+        if (state == CHUNK_MIXED) {
+            // Test a word of the bitmap at a time, inverting it when looking
+            // for free blocks, and masking off the bits before `addr`.
+            uint64_t* bitmap = map->chunk_bitmaps[chunk];
+            uint64_t offset = addr - chunk_start;
+            uint64_t num_words = (chunk_end - chunk_start + 63) / 64;
+            uint64_t mask = ~0ULL << (offset % 64);
+            for (uint64_t i = offset / 64; i < num_words; i++, mask = ~0ULL) {
+                uint64_t word = (allocated ? bitmap[i] : ~bitmap[i]) & mask;
+                if (word) {
+                    paddr_t found = chunk_start + i * 64 + __builtin_ctzll(word);
+                    if (found < chunk_end) {
+                        return found;
+                    }
+                    break;
+                }
+            }
+        }
+        addr = chunk_end;
+    }
+    return map->block_count;
+}
+
+uint64_t find_next_run(allocation_map_t* map, paddr_t addr, bool allocated, paddr_t* run_start) {
+    *run_start = find_next_block(map, addr, allocated);
+    if ((uint64_t)*run_start >= map->block_count) {
+        return 0;
+    }
+    return find_next_block(map, *run_start, !allocated) - *run_start;
+}
@@ -0,0 +1,124 @@
+/**
+ * Functions used to read the space manager of a container, i.e. to determine
+ * which of the container's blocks are allocated, so that tools which read the
+ * whole container (scanners, imagers, and the like) can skip free space.
+ *
+ * The space manager is an Ephemeral object of each checkpoint. It describes
+ * the container's blocks in chunks, each normally covering as many blocks as
+ * there are bits in a block; the chunks are described by chunk-info blocks,
+ * whose addresses are listed either in the space manager itself or, for larger
+ * containers, in chunk-info address blocks. Each chunk records how many of its
+ * blocks are free, and the address of a bitmap with one bit per block, set if
+ * the block is allocated.
+ *
+ * Chunks whose blocks are all free or all allocated, which are the majority on
+ * most containers, are held as just that fact; a bitmap is only read and kept
+ * for the other chunks. Blocks that have been freed but are still waiting in
+ * the space manager's free queues are counted as allocated, as are blocks in
+ * any chunk that couldn't be read, so that nothing that might still be in use
+ * is ever reported as free.
+ *
+ * Only the main device is described; see `SD_MAIN` in
+ * `apfs/struct/spaceman.h`.
+ */
+
+#ifndef APFS_FUNC_SPACEMAN_H
+#define APFS_FUNC_SPACEMAN_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "../io.h"
+#include "../struct/general.h"
+#include "../struct/object.h"
+#include "../struct/nx.h"
+#include "../struct/spaceman.h"
+
+#include "boolean.h"
+#include "cksum.h"
+#include "checkpoint.h"
+
+/**
+ * What is known about the blocks of a chunk.
+ */
+typedef enum {
+    CHUNK_ALLOCATED = 0,    // Every block is allocated, or the chunk couldn't be read
+    CHUNK_FREE,             // Every block is free
+    CHUNK_MIXED,            // See the chunk's bitmap
+} chunk_state_t;
+
+/**
+ * The blocks of a container that are allocated, as of one checkpoint.
+ *
+ * block_count:     The number of blocks in the container.
+ *
+ * chunk_states:    The state of each chunk; one `chunk_state_t` per chunk.
+ *
+ * chunk_bitmaps:   For each chunk whose state is `CHUNK_MIXED`, its bitmap,
+ *      with one bit per block, the lowest-order bit of each word being the
+ *      first block; or NULL for other chunks.
+ *
+ * free_count:      The number of free blocks.
+ *
+ * sm_blocks:       The addresses of the chunk-info address blocks, chunk-info
+ *      blocks, and bitmaps that the map was read from, in the order read.
+ */
+typedef struct {
+    xid_t       xid;
+    uint64_t    block_count;
+    uint32_t    blocks_per_chunk;
+    uint64_t    chunk_count;
+    uint8_t*    chunk_states;
+    uint64_t**  chunk_bitmaps;
+    uint64_t    free_count;
+
+    paddr_t*    sm_blocks;
+    uint64_t    num_sm_blocks;
+    uint64_t    sm_blocks_capacity;
+} allocation_map_t;
+
+/**
+ * Load the allocation map of the checkpoint described by a given container
+ * superblock, e.g. `container->nxsb`.
+ *
+ * RETURN VALUE:
+ *      A pointer to the map, which must be freed with `allocation_map_free()`;
+ *      or NULL if the space manager can't be read.
+ */
+allocation_map_t* load_allocation_map(nx_superblock_t* nxsb);
+
+void allocation_map_free(allocation_map_t* map);
+
+/**
+ * Determine whether a given block is allocated. Blocks beyond the end of the
+ * container are reported as free.
+ */
+bool is_block_allocated(allocation_map_t* map, paddr_t addr);
+
+/**
+ * Find the first block at or after `addr` that is allocated, or that is free.
+ *
+ * allocated:   Whether to look for an allocated block, rather than a free one.
+ *
+ * RETURN VALUE:
+ *      The address of the block, or `map->block_count` if there is no such
+ *      block.
+ */
+paddr_t find_next_block(allocation_map_t* map, paddr_t addr, bool allocated);
+
+/**
+ * Find the first run of allocated blocks, or of free blocks, that starts at or
+ * after `addr`, i.e. that contains `addr` (in which case the run is taken to
+ * start at `addr`) or that lies beyond it.
+ *
+ * run_start:   The address of the first block in the run will be stored here.
+ *
+ * RETURN VALUE:
+ *      The number of blocks in the run, or zero if there is no such run.
+ */
+uint64_t find_next_run(allocation_map_t* map, paddr_t addr, bool allocated, paddr_t* run_start);
+
+#endif // APFS_FUNC_SPACEMAN_H
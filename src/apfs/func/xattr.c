@@ -0,0 +1,94 @@
+#include "xattr.h"
+
+j_rec_t* get_xattr_record(j_rec_t** records, char* name) {
+    for (j_rec_t** cursor = records; cursor && *cursor; cursor++) {
+        j_rec_t* fs_rec = *cursor;
+        j_key_t* hdr = fs_rec->data;
+        if ( ((hdr->obj_id_and_type & OBJ_TYPE_MASK) >> OBJ_TYPE_SHIFT)  !=  APFS_TYPE_XATTR ) {
+            continue;
+        }
+
+        // NOTE: `name_len` includes the terminating NULL byte
+        j_xattr_key_t* key = fs_rec->data;
+        if (strncmp((char*)key->name, name, key->name_len) == 0) {
+            return fs_rec;
+        }
+    }
+    return NULL;
+}
+
+file_extent_t* get_xattr_dstream_extents(
+    btree_node_phys_t*  vol_omap_root_node,
+    btree_node_phys_t*  vol_fs_root_node,
+    j_rec_t*            xattr_rec,
+    size_t*             num_extents,
+    uint64_t*           size
+) {
+    *num_extents = 0;
+    *size = 0;
+
+    j_xattr_val_t* val = xattr_rec->data + xattr_rec->key_len;
+    if (!(val->flags & XATTR_DATA_STREAM) || val->xdata_len < sizeof(j_xattr_dstream_t)) {
+        return NULL;
+    }
+
+    j_xattr_dstream_t* xattr_dstream = val->xdata;
+    *size = xattr_dstream->dstream.size;
+
+    j_rec_t** dstream_records = get_fs_records(vol_omap_root_node, vol_fs_root_node, xattr_dstream->xattr_obj_id, (xid_t)(~0) );
+    if (!dstream_records) {
+        fprintf(stderr, "\nERROR: get_xattr_dstream_extents: No records found for data stream 0x%llx.\n", xattr_dstream->xattr_obj_id);
+        return NULL;
+    }
+
+    file_extent_t* extents = get_file_extents(dstream_records, num_extents);
+    free_j_rec_array(dstream_records);
+    return extents;
+}
+
+char* get_xattr_value(
+    btree_node_phys_t*  vol_omap_root_node,
+    btree_node_phys_t*  vol_fs_root_node,
+    j_rec_t*            xattr_rec,
+    uint64_t*           length
+) {
+    *length = 0;
+    j_xattr_val_t* val = xattr_rec->data + xattr_rec->key_len;
+
+    if (val->flags & XATTR_DATA_EMBEDDED) {
+        char* value = malloc(val->xdata_len ? val->xdata_len : 1);
+        if (!value) {
+            fprintf(stderr, "\nABORT: get_xattr_value: Could not allocate sufficient memory for `value`.\n");
+            return NULL;
+        }
+        memcpy(value, val->xdata, val->xdata_len);
+        *length = val->xdata_len;
+        return value;
+    }
+
+    size_t num_extents = 0;
+    uint64_t size = 0;
+    file_extent_t* extents = get_xattr_dstream_extents(vol_omap_root_node, vol_fs_root_node, xattr_rec, &num_extents, &size);
+    if (!extents && size != 0) {
+        // A non-empty data stream always has at least one extent record;
+        // reading from no extents would yield a value of all zeroes.
+        fprintf(stderr, "\nERROR: get_xattr_value: Found no extents for a data stream of %llu bytes.\n", size);
+        return NULL;
+    }
+
+    char* value = malloc(size ? size : 1);
+    if (!value) {
+        fprintf(stderr, "\nABORT: get_xattr_value: Could not allocate sufficient memory for `value`.\n");
+        free(extents);
+        return NULL;
+    }
+    if (read_dstream_range(extents, num_extents, 0, size, value) != 0) {
+        free(value);
+        free(extents);
+        return NULL;
+    }
+
+    free(extents);
+    *length = size;
+    return value;
+}
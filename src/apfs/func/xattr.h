@@ -0,0 +1,89 @@
+/**
+ * Functions used to look up and read the extended attributes of
+ * file-system objects.
+ */
+
+#ifndef APFS_FUNC_XATTR_H
+#define APFS_FUNC_XATTR_H
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "../struct/j.h"
+#include "../struct/const.h"
+#include "../struct/dstream.h"
+
+#include "btree.h"
+#include "dstream.h"
+
+/**
+ * Find the record for the extended attribute with a given name, amongst a
+ * given array of file-system records.
+ *
+ * records:     A pointer to an array of file-system records pertaining to a
+ *      single file-system object, as returned by `get_fs_records()`.
+ *
+ * name:        The name of the desired extended attribute,
+ *      e.g. "com.apple.decmpfs".
+ *
+ * RETURN VALUE:
+ *      A pointer to the matching record within `records`, or NULL if the
+ *      object has no extended attribute with the given name.
+ */
+j_rec_t* get_xattr_record(j_rec_t** records, char* name);
+
+/**
+ * Get the file extents of an extended attribute whose data is stored in a
+ * data stream, i.e. which has the flag `XATTR_DATA_STREAM` set.
+ *
+ * vol_omap_root_node:  A pointer to the root node of the volume object map.
+ *
+ * vol_fs_root_node:    A pointer to the root node of the volume's
+ *      file-system root tree.
+ *
+ * xattr_rec:   A pointer to the extended attribute's record.
+ *
+ * num_extents: The number of extents found will be stored here.
+ *
+ * size:        The logical size of the data stream, in bytes, will be stored
+ *      here.
+ *
+ * RETURN VALUE:
+ *      A pointer to an array of `*num_extents` file extents, as returned by
+ *      `get_file_extents()`, which must be freed when no longer needed; or
+ *      NULL if the data stream has no extents or an error occurs.
+ */
+file_extent_t* get_xattr_dstream_extents(
+    btree_node_phys_t*  vol_omap_root_node,
+    btree_node_phys_t*  vol_fs_root_node,
+    j_rec_t*            xattr_rec,
+    size_t*             num_extents,
+    uint64_t*           size
+);
+
+/**
+ * Read the whole value of an extended attribute into memory, regardless of
+ * whether it is embedded in its record or stored in a data stream.
+ *
+ * vol_omap_root_node:  A pointer to the root node of the volume object map.
+ *
+ * vol_fs_root_node:    A pointer to the root node of the volume's
+ *      file-system root tree.
+ *
+ * xattr_rec:   A pointer to the extended attribute's record.
+ *
+ * length:      The length of the value, in bytes, will be stored here.
+ *
+ * RETURN VALUE:
+ *      A pointer to the value, which must be freed when no longer needed;
+ *      or NULL if an error occurs, including when the value is stored in a
+ *      non-empty data stream that has no extents.
+ */
+char* get_xattr_value(
+    btree_node_phys_t*  vol_omap_root_node,
+    btree_node_phys_t*  vol_fs_root_node,
+    j_rec_t*            xattr_rec,
+    uint64_t*           length
+);
+
+#endif // APFS_FUNC_XATTR_H
@@ -0,0 +1,102 @@
+#include "io.h"
+#include "func/fusion.h"
+
+nx_device_t nx_default_device = {
+    .block_size = 4096,
+};
+__thread nx_device_t* nx_device = &nx_default_device;
+
+void report_fopen_error() {
+    switch (errno) {
+        case ENOMEM:
+            fprintf(stderr, "Unable to allocate sufficient memory to buffer file.\n");
+            break;
+        case EACCES:
+            fprintf(stderr, "You do not have sufficient privileges to read this file.\n");
+            break;
+        case EFAULT:
+            fprintf(stderr, "Segmentation fault.\n");
+            break;
+        case EINTR:
+            fprintf(stderr, "The process was interrupted.\n");
+            break;
+        case ELOOP:
+            fprintf(stderr, "Too many symlinks were encountered; perhaps you specified a looping symlink.\n");
+            break;
+        case EMFILE:
+            fprintf(stderr, "This process is forbidden from opening any more file descriptors.\n");
+            break;
+        case ENAMETOOLONG:
+            fprintf(stderr, "The specified filepath or one of its componenets is too long.\n");
+            break;
+        case ENOENT:
+            fprintf(stderr, "The specified file does not exist.\n");
+            break;
+        case ENOTDIR:
+            fprintf(stderr, "A component of the specified filepath is not a directory.\n");
+            break;
+        case ENXIO:
+            fprintf(stderr, "The device associated with the specified file does not exist.\n");
+            break;
+        case EOVERFLOW:
+            fprintf(stderr, "The specified file is a regular file, but its size exceeds %lu bytes, so is too large to be handled.\n", sizeof(off_t));
+            break;
+        case EILSEQ:
+            fprintf(stderr, "The specified filepath does not match the encoding rules.\n");
+            break;
+        default:
+            fprintf(stderr, "Unknown error.\n");
+            break;
+    }
+}
+
+size_t read_blocks(void* buffer, long start_block, size_t num_blocks) {
+    if (is_tier2_addr(start_block)) {
+        return read_tier2_blocks(buffer, start_block, num_blocks);
+    }
+    return read_device_blocks(false, buffer, start_block, num_blocks);
+}
+
+size_t read_device_blocks(bool tier2, void* buffer, long start_block, size_t num_blocks) {
+    // `pread()` doesn't use or move the file position, so blocks can safely be
+    // read by multiple threads at once. Only the main device can be read
+    // through `nx_device->read`.
+    nx_read_func_t read_func = tier2 ? NULL : nx_device->read;
+    char* path = tier2 ? nx_device->tier2_path : nx_device->path;
+    int fd = read_func ? -1 : fileno(tier2 ? nx_device->tier2_file : nx_device->file);
+    size_t length = num_blocks * nx_device->block_size;
+    size_t num_bytes_read = 0;
+    while (num_bytes_read < length) {
+        char* dest = (char*)buffer + num_bytes_read;
+        uint64_t offset = (uint64_t)start_block * nx_device->block_size + num_bytes_read;
+        ssize_t result = read_func
+            ? read_func(nx_device->read_context, dest, length - num_bytes_read, offset)
+            : pread(fd, dest, length - num_bytes_read, (off_t)offset);
+        if (result == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            switch (errno) {
+                case EINVAL:
+                    fprintf(stderr, "FAILED: read_blocks: The specified starting block address, 0x%lx, is invalid, as it lies outside of the file `%s`.\n", start_block, path);
+                    break;
+                case EOVERFLOW:
+                    fprintf(stderr, "FAILED: read_blocks: The specified starting block address, 0x%lx, exceeds %lu bits in length, which would result in an overflow.\n", start_block, 8 * sizeof(long));
+                    break;
+                case ESPIPE:
+                    fprintf(stderr, "FAILED: read_blocks: The data stream associated with the file `%s` is a pipe or FIFO, and thus cannot be seeked through.\n", path);
+                    break;
+                default:
+                    fprintf(stderr, "FAILED: read_blocks: An error occurred whilst reading from `%s`: %s.\n", path, strerror(errno));
+                    break;
+            }
+            return -1;
+        }
+        if (result == 0) {
+            // Reached end-of-file
+            break;
+        }
+        num_bytes_read += result;
+    }
+    return num_bytes_read / nx_device->block_size;
+}
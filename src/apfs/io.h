@@ -9,55 +9,101 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
 #include <sys/errno.h>
 
-char*   nx_path;
-FILE*   nx;
-size_t  nx_block_size = 4096;
+struct nx_node_cache;
+struct nx_cksum_memo;
+struct nx_carved_tree;
+struct nx_omap_memo;
+struct nx_aes_xts_key;
+struct nx_fusion_map;
 
-void report_fopen_error() {
-    switch (errno) {
-        case ENOMEM:
-            fprintf(stderr, "Unable to allocate sufficient memory to buffer file.\n");
-            break;
-        case EACCES:
-            fprintf(stderr, "You do not have sufficient privileges to read this file.\n");
-            break;
-        case EFAULT:
-            fprintf(stderr, "Segmentation fault.\n");
-            break;
-        case EINTR:
-            fprintf(stderr, "The process was interrupted.\n");
-            break;
-        case ELOOP:
-            fprintf(stderr, "Too many symlinks were encountered; perhaps you specified a looping symlink.\n");
-            break;
-        case EMFILE:
-            fprintf(stderr, "This process is forbidden from opening any more file descriptors.\n");
-            break;
-        case ENAMETOOLONG:
-            fprintf(stderr, "The specified filepath or one of its componenets is too long.\n");
-            break;
-        case ENOENT:
-            fprintf(stderr, "The specified file does not exist.\n");
-            break;
-        case ENOTDIR:
-            fprintf(stderr, "A component of the specified filepath is not a directory.\n");
-            break;
-        case ENXIO:
-            fprintf(stderr, "The device associated with the specified file does not exist.\n");
-            break;
-        case EOVERFLOW:
-            fprintf(stderr, "The specified file is a regular file, but its size exceeds %lu bytes, so is too large to be handled.\n", sizeof(off_t));
-            break;
-        case EILSEQ:
-            fprintf(stderr, "The specified filepath does not match the encoding rules.\n");
-            break;
-        default:
-            fprintf(stderr, "Unknown error.\n");
-            break;
-    }
-}
+/**
+ * A function that reads from a container through something other than a file,
+ * e.g. a disk image held in memory or on the other end of a network
+ * connection. It should behave like `pread()`: read `length` bytes from byte
+ * `offset` of the container into `buffer`, and return the number of bytes
+ * read, which is zero at the end of the container; or -1 on failure.
+ */
+typedef ssize_t (*nx_read_func_t)(void* context, void* buffer, size_t length, uint64_t offset);
+
+/**
+ * A container that the I/O functions can read from.
+ *
+ * path:        The path of the container's (device special) file, or a name
+ *      describing the container if it isn't read from a file.
+ *
+ * file:        The container's file.
+ *
+ * block_size:  The container's block size, in bytes.
+ *
+ * read, read_context:  If `read` isn't NULL, blocks are read by calling
+ *      `read(read_context, ...)` rather than by reading from `file`.
+ *
+ * node_cache:  The cache of B-tree nodes read from the container, or NULL if
+ *      it's disabled; see `apfs/func/node_cache.h`.
+ *
+ * cksum_memo:  The outcomes of verifying the checksums of B-tree nodes read
+ *      from the container, or NULL if they aren't being remembered; see
+ *      `apfs/func/cksum_memo.h`.
+ *
+ * carved_tree: A file-system tree rebuilt from the container's leaf nodes,
+ *      whose nodes are read from it rather than from the container, or NULL;
+ *      see `apfs/func/carve.h`.
+ *
+ * omap_memo:   Object map values already resolved in the container, or NULL if
+ *      they aren't being remembered; see `apfs/func/omap_memo.h`.
+ *
+ * volume_key:  The key that encrypted nodes and file data read from the
+ *      container are decrypted with, or NULL; see `apfs/func/crypto.h`.
+ *
+ * tier2_path, tier2_file:  The path and file of the second tier of a Fusion
+ *      container, or NULL; see `apfs/func/fusion.h`.
+ *
+ * fusion_map:  The ranges of second-tier blocks cached on the main device of a
+ *      Fusion container, or NULL.
+ *
+ * cksum_policy:    What to do with nodes read from the container whose
+ *      checksums don't validate, as a `cksum_policy_t`; see
+ *      `apfs/func/cksum_memo.h`. Zero means `CKSUM_POLICY_DEFAULT`.
+ *
+ * decmpfs_num_threads: The number of threads to decompress the resource-fork
+ *      chunks of files in the container with; zero means one thread per online
+ *      CPU core. See `apfs/func/decmpfs.h`.
+ */
+typedef struct {
+    char*                   path;
+    FILE*                   file;
+    size_t                  block_size;
+    nx_read_func_t          read;
+    void*                   read_context;
+    struct nx_node_cache*   node_cache;
+    struct nx_cksum_memo*   cksum_memo;
+    struct nx_carved_tree*  carved_tree;
+    struct nx_omap_memo*    omap_memo;
+    struct nx_aes_xts_key*  volume_key;
+    char*                   tier2_path;
+    FILE*                   tier2_file;
+    struct nx_fusion_map*   fusion_map;
+    uint32_t                cksum_policy;
+    unsigned int            decmpfs_num_threads;
+} nx_device_t;
+
+/**
+ * The container that I/O functions act upon in the current thread. This is
+ * `nx_default_device` unless the thread has selected another one, so that a
+ * program can work with several containers at once (see `apfs/apfs.h`), each
+ * from as many threads as it likes. Tools which only ever deal with one
+ * container just use the default one.
+ */
+extern nx_device_t              nx_default_device;
+extern __thread nx_device_t*    nx_device;
+
+void report_fopen_error();
 
 /**
  * Read given number of blocks from the APFS container.
@@ -69,52 +115,22 @@ void report_fopen_error() {
  * - num_blocks:    The number of APFS physical blocks to read into `buffer`.
  * 
  * RETURN VALUE:    On success or partial success, the number of blocks read
- *              (a non-negative value). On failure, a negative value.
+ *              (a non-negative value), which is less than `num_blocks` if the
+ *              end of the container was reached. On failure, a negative value.
+ *
+ * Addresses on the second tier of a Fusion container are read as described in
+ * `apfs/func/fusion.h`.
  */
-size_t read_blocks(void* buffer, long start_block, size_t num_blocks) {
-    if (fseek(nx, start_block * nx_block_size, SEEK_SET) == -1) {
-        // An error occurred.
-        printf("FAILED: read_blocks: ");
-        switch (errno) {
-            case EBADF:
-                fprintf(stderr, "The file `%s` cannot be seeked through.\n", nx_path);
-                break;
-            case EINVAL:
-                fprintf(stderr, "The specified starting block address, 0x%lx, is invalid, as it lies outside of the file `%s`.\n", start_block, nx_path);
-                break;
-            case EOVERFLOW:
-                fprintf(stderr, "The specified starting block address, 0x%lx, exceeds %lu bits in length, which would result in an overflow.\n", start_block, 8 * sizeof(long));
-                break;
-            case ESPIPE:
-                fprintf(stderr, "The data stream associated with the file `%s` is a pipe or FIFO, and thus cannot be seeked through.\n", nx_path);
-                break;
-            default:
-                fprintf(stderr, "Unknown error.\n");
-                break;
-        }
-        return -1;
-    }
-
-    size_t num_blocks_read = fread(buffer, nx_block_size, num_blocks, nx);
-    if (num_blocks_read != num_blocks) {
-        // An error occured or we reached end-of-file.
+size_t read_blocks(void* buffer, long start_block, size_t num_blocks);
 
-        // NOTE: This is intended to act as an `assert` statement with a message
-        if (!ferror(nx) && !feof(nx)) {
-            fprintf(stderr, "ABORT: read_blocks: Unexpected beaviour --- `fread` read fewer blocks than expected, but `feof` did not report EOF and `ferror` did not detect an error.\n\n");
-            return -2;
-        }
-        
-        if (ferror(nx)) {
-            fprintf(stderr, "FAILED: read_blocks: An unknown error occurred whilst reading from the stream.\n");
-            return -3;
-        }
-
-        assert(feof(nx));
-        // printf("read_blocks: Reached end-of-file after reading %lu blocks.\n", num_blocks_read);
-        printf("num_blocks_read=%lli @ 0x%llx\n", (uint64_t)num_blocks_read, (uint64_t)start_block);
-    }
-    return num_blocks_read;
-}
+/**
+ * Read blocks from one of the container's devices, as `read_blocks()` does,
+ * but without any Fusion address translation.
+ *
+ * - tier2:         Whether to read from the second tier of a Fusion container,
+ *      rather than from the main device. `start_block` is then the address of
+ *      the block on the second tier, without the second-tier marker.
+ */
+size_t read_device_blocks(bool tier2, void* buffer, long start_block, size_t num_blocks);
 
 #endif // APFS_IO_H
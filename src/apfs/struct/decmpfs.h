@@ -0,0 +1,99 @@
+/**
+ * Structures and related items relating to transparent file compression
+ * (`decmpfs`). These are not covered by the APFS specification; they are
+ * based on `bsd/sys/decmpfs.h` in Apple's XNU sources, and on the
+ * resource-fork layout used by HFS+ compressed files, which APFS inherits.
+ */
+
+#ifndef APFS_STRUCT_DECMPFS_H
+#define APFS_STRUCT_DECMPFS_H
+
+#include <stdint.h>
+
+/**
+ * BSD flag which marks an inode as being compressed. This is defined in
+ * <sys/stat.h> on macOS, but not on all other platforms.
+ */
+#ifndef UF_COMPRESSED
+#define UF_COMPRESSED   0x00000020
+#endif
+
+/** Extended Attribute Names **/
+
+#define DECMPFS_XATTR_NAME      "com.apple.decmpfs"
+#define RESOURCE_FORK_XATTR_NAME    "com.apple.ResourceFork"
+
+/** `decmpfs_disk_header_t` **/
+
+#define DECMPFS_MAGIC   'cmpf'
+
+typedef struct {
+    uint32_t    compression_magic;
+    uint32_t    compression_type;
+    uint64_t    uncompressed_size;
+    uint8_t     attr_bytes[0];
+} __attribute__((packed))   decmpfs_disk_header_t;
+
+/** Compression Types **/
+
+typedef enum {
+    DECMPFS_TYPE_UNCOMPRESSED_ATTR  = 1,
+    DECMPFS_TYPE_ZLIB_ATTR          = 3,
+    DECMPFS_TYPE_ZLIB_RSRC          = 4,
+    DECMPFS_TYPE_DATALESS           = 5,
+    DECMPFS_TYPE_LZVN_ATTR          = 7,
+    DECMPFS_TYPE_LZVN_RSRC          = 8,
+    DECMPFS_TYPE_RAW_ATTR           = 9,
+    DECMPFS_TYPE_RAW_RSRC           = 10,
+    DECMPFS_TYPE_LZFSE_ATTR         = 11,
+    DECMPFS_TYPE_LZFSE_RSRC         = 12,
+    DECMPFS_TYPE_LZBITMAP_ATTR      = 13,
+    DECMPFS_TYPE_LZBITMAP_RSRC      = 14,
+} decmpfs_compression_type;
+
+/**
+ * Compressed data stored in a resource fork is divided into chunks, each of
+ * which decompresses to this many bytes (except possibly the last one).
+ */
+#define DECMPFS_CHUNK_SIZE      0x10000     // = 64 KiB
+
+/**
+ * NOTE: Resource forks that hold zlib-compressed data (type 4) begin with a
+ * standard big-endian resource-fork header. The compressed data begins at
+ * `data_offset + 4`, and starts with a little-endian chunk table:
+ * `uint32_t num_chunks`, followed by `num_chunks` instances of
+ * `decmpfs_zlib_chunk_t`, whose offsets are relative to `data_offset + 4`.
+ *
+ * Resource forks that hold LZVN-, LZFSE-, or un-compressed data (types 8, 10,
+ * and 12) instead begin with an array of `num_chunks + 1` little-endian
+ * `uint32_t` offsets, relative to the start of the resource fork, where chunk
+ * `i` spans from offset `i` (inclusive) to offset `i + 1` (exclusive).
+ */
+
+/** `decmpfs_rsrc_header_t` **/
+
+typedef struct {
+    uint32_t    data_offset;    // big-endian
+    uint32_t    map_offset;     // big-endian
+    uint32_t    data_length;    // big-endian
+    uint32_t    map_length;     // big-endian
+} __attribute__((packed))   decmpfs_rsrc_header_t;
+
+/** `decmpfs_zlib_chunk_t` **/
+
+typedef struct {
+    uint32_t    offset;
+    uint32_t    length;
+} __attribute__((packed))   decmpfs_zlib_chunk_t;
+
+/** Chunk Markers **/
+
+/*
+ * A chunk (or inline attribute payload) whose first byte matches these
+ * markers is stored uncompressed, starting from the following byte.
+ */
+#define DECMPFS_ZLIB_RAW_MARKER_MASK    0x0f
+#define DECMPFS_LZVN_RAW_MARKER         0x06
+#define DECMPFS_LZFSE_RAW_MARKER        0xff
+
+#endif // APFS_STRUCT_DECMPFS_H
@@ -0,0 +1,107 @@
+/**
+ * Tests that each Fletcher-64 kernel compiled in and supported by the CPU
+ * gives the same sums as `fletcher_sums_scalar()`.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apfs/func/cksum.h"
+
+/** Test constants **/
+
+#define NUM_RANDOM_BLOCKS   16
+
+typedef struct {
+    const char*             name;
+    fletcher_sums_func_t    func;
+    bool                    supported;
+} kernel_t;
+
+/**
+ * Compare a kernel with `fletcher_sums_scalar()` on the words of a block,
+ * both with and without the two words where a block's checksum is stored.
+ *
+ * RETURN VALUE:    The number of comparisons that failed.
+ */
+int compare_kernel(kernel_t* kernel, uint32_t* block, size_t block_size, const char* description) {
+    int num_failed = 0;
+    size_t num_words = block_size / 4;
+
+    for (size_t skip = 0; skip <= 2; skip += 2) {
+        uint64_t expected_sum1 = 0, expected_sum2 = 0;
+        uint64_t actual_sum1 = 0, actual_sum2 = 0;
+        fletcher_sums_scalar(block + skip, num_words - skip, &expected_sum1, &expected_sum2);
+        kernel->func(block + skip, num_words - skip, &actual_sum1, &actual_sum2);
+
+        if (actual_sum1 != expected_sum1 || actual_sum2 != expected_sum2) {
+            fprintf(stderr, "FAILED: %s kernel, %s %zu-byte block from word %zu: got (%#llx, %#llx), expected (%#llx, %#llx).\n",
+                kernel->name, description, block_size, skip,
+                actual_sum1, actual_sum2, expected_sum1, expected_sum2
+            );
+            num_failed++;
+        }
+    }
+    return num_failed;
+}
+
+int main() {
+    int num_failed = 0;
+    size_t block_sizes[] = { 4096, 65536 };
+
+    kernel_t kernels[] = {
+#if defined(__x86_64__) || defined(__i386__)
+        { "sse2",   fletcher_sums_sse2,     false },
+        { "avx2",   fletcher_sums_avx2,     false },
+        { "avx512", fletcher_sums_avx512,   false },
+#endif
+        { NULL,     NULL,                   false },
+    };
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    kernels[0].supported = __builtin_cpu_supports("sse2");
+    kernels[1].supported = __builtin_cpu_supports("avx2");
+    kernels[2].supported = __builtin_cpu_supports("avx512f");
+#endif
+
+    uint32_t* block = malloc(block_sizes[1]);
+    if (!block) {
+        fprintf(stderr, "ABORT: Could not allocate sufficient memory for `block`.\n");
+        return 1;
+    }
+
+    srand(1);   // A fixed seed makes any failure reproducible
+    for (kernel_t* kernel = kernels; kernel->name; kernel++) {
+        if (!kernel->supported) {
+            printf("Skipping the %s kernel, which this CPU doesn't support.\n", kernel->name);
+            continue;
+        }
+
+        for (size_t i = 0; i < sizeof(block_sizes) / sizeof(block_sizes[0]); i++) {
+            size_t block_size = block_sizes[i];
+
+            // All-ones words give the largest sums, so they would be the first
+            // to overflow a lane before reduction.
+            memset(block, 0xff, block_size);
+            num_failed += compare_kernel(kernel, block, block_size, "all-0xFF");
+
+            for (int j = 0; j < NUM_RANDOM_BLOCKS; j++) {
+                unsigned char* bytes = (unsigned char*)block;
+                for (size_t k = 0; k < block_size; k++) {
+                    bytes[k] = rand() & 0xff;
+                }
+                num_failed += compare_kernel(kernel, block, block_size, "random");
+            }
+        }
+    }
+
+    free(block);
+
+    if (num_failed) {
+        fprintf(stderr, "%d tests failed.\n", num_failed);
+        return 1;
+    }
+    printf("All cksum tests passed.\n");
+    return 0;
+}
@@ -0,0 +1,188 @@
+/**
+ * Tests for reading extended attributes whose values are stored in data
+ * streams, using a file-system tree held in memory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apfs/io.h"
+#include "apfs/func/xattr.h"
+
+#include "apfs/struct/btree.h"
+#include "apfs/struct/j.h"
+#include "apfs/struct/dstream.h"
+
+/** Test constants **/
+
+#define BLOCK_SIZE          4096
+#define DATA_BLOCK          1
+#define DATA                "The quick brown fox jumps over the lazy dog."
+
+// Data streams whose records are in the test tree
+#define OID_WITH_EXTENT     0x20
+#define OID_WITHOUT_EXTENT  0x30
+
+/**
+ * The container's blocks: block 0 is empty, and block `DATA_BLOCK` starts with
+ * `DATA`.
+ */
+char container[2 * BLOCK_SIZE];
+
+ssize_t read_container(void* context, void* buffer, size_t length, uint64_t offset) {
+    (void)context;
+    if (offset >= sizeof(container)) {
+        return 0;
+    }
+    if (length > sizeof(container) - offset) {
+        length = sizeof(container) - offset;
+    }
+    memcpy(buffer, container + offset, length);
+    return length;
+}
+
+/**
+ * Append a record to a root leaf node of a file-system tree. Records must be
+ * appended in key order.
+ */
+void add_record(btree_node_phys_t* node, void* key, uint16_t key_len, void* val, uint16_t val_len) {
+    kvloc_t* toc = (char*)node->btn_data + node->btn_table_space.off;
+    char* key_start = (char*)node->btn_data + node->btn_table_space.off + node->btn_table_space.len;
+    char* val_end = (char*)node + BLOCK_SIZE - sizeof(btree_info_t);
+
+    kvloc_t* entry = toc + node->btn_nkeys;
+    entry->k.off = node->btn_free_space.off;
+    entry->k.len = key_len;
+    entry->v.off = (node->btn_nkeys ? toc[node->btn_nkeys - 1].v.off : 0) + val_len;
+    entry->v.len = val_len;
+
+    memcpy(key_start + entry->k.off, key, key_len);
+    memcpy(val_end - entry->v.off, val, val_len);
+    node->btn_free_space.off += key_len;
+    node->btn_nkeys++;
+}
+
+/**
+ * Make a file-system tree consisting of a single root leaf node, holding the
+ * records of two data streams: one with an extent that maps its first block to
+ * `DATA_BLOCK`, and one whose extent record is missing.
+ */
+btree_node_phys_t* make_fs_tree() {
+    btree_node_phys_t* node = calloc(1, BLOCK_SIZE);
+    if (!node) {
+        return NULL;
+    }
+    node->btn_flags = BTNODE_ROOT | BTNODE_LEAF;
+    node->btn_table_space.len = 8 * sizeof(kvloc_t);
+
+    j_dstream_id_val_t dstream_id_val = { .refcnt = 1 };
+
+    j_file_extent_key_t extent_key = {
+        .hdr.obj_id_and_type = OID_WITH_EXTENT | ((uint64_t)APFS_TYPE_FILE_EXTENT << OBJ_TYPE_SHIFT),
+        .logical_addr = 0,
+    };
+    j_file_extent_val_t extent_val = {
+        .len_and_flags = BLOCK_SIZE,
+        .phys_block_num = DATA_BLOCK,
+        .crypto_id = 0,
+    };
+    add_record(node, &extent_key, sizeof(extent_key), &extent_val, sizeof(extent_val));
+
+    j_dstream_id_key_t dstream_id_key = {
+        .hdr.obj_id_and_type = OID_WITH_EXTENT | ((uint64_t)APFS_TYPE_DSTREAM_ID << OBJ_TYPE_SHIFT),
+    };
+    add_record(node, &dstream_id_key, sizeof(dstream_id_key), &dstream_id_val, sizeof(dstream_id_val));
+
+    dstream_id_key.hdr.obj_id_and_type = OID_WITHOUT_EXTENT | ((uint64_t)APFS_TYPE_DSTREAM_ID << OBJ_TYPE_SHIFT);
+    add_record(node, &dstream_id_key, sizeof(dstream_id_key), &dstream_id_val, sizeof(dstream_id_val));
+
+    return node;
+}
+
+/**
+ * Make the record of an extended attribute whose value is stored in the data
+ * stream with the given OID and has the given size.
+ */
+j_rec_t* make_xattr_record(oid_t dstream_oid, uint64_t size) {
+    char name[] = "com.example.test";
+    uint16_t key_len = sizeof(j_xattr_key_t) + sizeof(name);
+    uint16_t val_len = sizeof(j_xattr_val_t) + sizeof(j_xattr_dstream_t);
+
+    j_rec_t* rec = calloc(1, sizeof(j_rec_t) + key_len + val_len);
+    if (!rec) {
+        return NULL;
+    }
+    rec->key_len = key_len;
+    rec->val_len = val_len;
+
+    j_xattr_key_t* key = rec->data;
+    key->hdr.obj_id_and_type = 0x10 | ((uint64_t)APFS_TYPE_XATTR << OBJ_TYPE_SHIFT);
+    key->name_len = sizeof(name);
+    memcpy(key->name, name, sizeof(name));
+
+    j_xattr_val_t* val = rec->data + key_len;
+    val->flags = XATTR_DATA_STREAM;
+    val->xdata_len = sizeof(j_xattr_dstream_t);
+
+    j_xattr_dstream_t xattr_dstream = { .xattr_obj_id = dstream_oid };
+    xattr_dstream.dstream.size = size;
+    memcpy(val->xdata, &xattr_dstream, sizeof(xattr_dstream));
+
+    return rec;
+}
+
+int main() {
+    int num_failed = 0;
+
+    memcpy(container + DATA_BLOCK * BLOCK_SIZE, DATA, strlen(DATA));
+    nx_device->block_size = BLOCK_SIZE;
+    nx_device->read = read_container;
+
+    btree_node_phys_t* fs_tree = make_fs_tree();
+    j_rec_t* with_extent = make_xattr_record(OID_WITH_EXTENT, strlen(DATA));
+    j_rec_t* without_extent = make_xattr_record(OID_WITHOUT_EXTENT, strlen(DATA));
+    j_rec_t* empty = make_xattr_record(OID_WITHOUT_EXTENT, 0);
+    if (!fs_tree || !with_extent || !without_extent || !empty) {
+        fprintf(stderr, "ABORT: Could not allocate sufficient memory for the test records.\n");
+        return 1;
+    }
+
+    // A data stream with an extent is read from the container
+    uint64_t length = 0;
+    char* value = get_xattr_value(NULL, fs_tree, with_extent, &length);
+    if (!value || length != strlen(DATA) || memcmp(value, DATA, length) != 0) {
+        fprintf(stderr, "FAILED: The value of a data stream with an extent was not read correctly.\n");
+        num_failed++;
+    }
+    free(value);
+
+    // A non-empty data stream whose extent record is missing is an error,
+    // rather than a value of all zeroes
+    value = get_xattr_value(NULL, fs_tree, without_extent, &length);
+    if (value) {
+        fprintf(stderr, "FAILED: The value of a data stream with a missing extent record was read as %llu bytes.\n", length);
+        num_failed++;
+    }
+    free(value);
+
+    // An empty data stream needs no extents
+    value = get_xattr_value(NULL, fs_tree, empty, &length);
+    if (!value || length != 0) {
+        fprintf(stderr, "FAILED: The value of an empty data stream was not read.\n");
+        num_failed++;
+    }
+    free(value);
+
+    free(empty);
+    free(without_extent);
+    free(with_extent);
+    free(fs_tree);
+
+    if (num_failed) {
+        fprintf(stderr, "%d tests failed.\n", num_failed);
+        return 1;
+    }
+    printf("All xattr tests passed.\n");
+    return 0;
+}